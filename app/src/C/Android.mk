@@ -21,16 +21,53 @@ include $(BUILD_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_CFLAGS     += -I$(INCLUDE_PATH) -O3 -std=c99
-LOCAL_MODULE     := dbscan_c
-LOCAL_SRC_FILES  := source/dbscan_c.c
+LOCAL_MODULE     := threadpool
+LOCAL_SRC_FILES  := source/threadpool.c source/cputopo.c source/jobctl.c source/barrier.c \
+                    source/jobsched.c source/trace.c
+LOCAL_SHARED_LIBRARIES = OpenCL
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS     += -I$(INCLUDE_PATH) -O3 -std=c99
+LOCAL_MODULE     := oclbuffer
+LOCAL_SRC_FILES  := source/oclbuffer.c
+LOCAL_SHARED_LIBRARIES = OpenCL
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS     += -I$(INCLUDE_PATH) -O3 -std=c99
+LOCAL_MODULE     := ocltune
+LOCAL_SRC_FILES  := source/ocltune.c
 LOCAL_SHARED_LIBRARIES = OpenCL rwlock_wp
 include $(BUILD_SHARED_LIBRARY)
 
+include $(CLEAR_VARS)
+LOCAL_CFLAGS     += -I$(INCLUDE_PATH) -O3 -std=c99
+LOCAL_MODULE     := oclstore
+LOCAL_SRC_FILES  := source/oclstore.c
+LOCAL_SHARED_LIBRARIES = OpenCL oclbuffer
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS     += -I$(INCLUDE_PATH) -O3 -std=c99
+LOCAL_MODULE     := agpudm
+LOCAL_SRC_FILES  := source/agpudm.c source/kmeans_c.c source/dbscan_c.c source/datagen.c \
+                    source/dataset.c source/kmstream.c
+LOCAL_SHARED_LIBRARIES = OpenCL oclbuffer ocltune oclstore threadpool
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS     += -I$(INCLUDE_PATH) -O3 -std=c99
+LOCAL_MODULE     := dbscan_c
+LOCAL_SRC_FILES  := source/dbscan_jni.c
+LOCAL_SHARED_LIBRARIES = agpudm threadpool oclwrapper
+include $(BUILD_SHARED_LIBRARY)
+
 include $(CLEAR_VARS)
 LOCAL_CFLAGS     += -I$(INCLUDE_PATH) -O3 -std=c99
 LOCAL_MODULE     := kmeans_c
-LOCAL_SRC_FILES  := source/kmeans_c.c
-LOCAL_SHARED_LIBRARIES = OpenCL rwlock_wp
+LOCAL_SRC_FILES  := source/kmeans_jni.c
+LOCAL_SHARED_LIBRARIES = agpudm threadpool oclwrapper
 include $(BUILD_SHARED_LIBRARY)
 
 
@@ -45,7 +82,7 @@ include $(CLEAR_VARS)
 LOCAL_MODULE     := oclwrapper
 LOCAL_SRC_FILES  := source/oclwrapper.c
 LOCAL_CFLAGS     += -I$(INCLUDE_PATH) -O3 -std=c99
-LOCAL_SHARED_LIBRARIES := OpenCL
+LOCAL_SHARED_LIBRARIES := OpenCL ocltune threadpool agpudm
 include $(BUILD_SHARED_LIBRARY)
 
 
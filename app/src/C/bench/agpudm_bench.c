@@ -0,0 +1,1012 @@
+/*!
+ \file agpudm_bench.c
+ \brief Throughput and latency benchmark of the k-means and DBSCAN engines
+ \details
+ Generates Gaussian clusters like dataminingtask.createRandomClusters (agpudm_generate, same
+ seed -> same data items) and runs every engine of the public C interface
+ (agpudm.h) on them. The sweep covers the data items per cluster, the features, the number of
+ clusters and, for the multithreaded engine, the number of threads:
+ - k-means searches for as many clusters as have been generated (eps = 1e-6 like the app),
+ - DBSCAN uses the defaults of the app (radius sqrt(features), 10 * features neighbours),
+ - mini-batch k-means (*--algorithms minibatch*) uses the default batches of
+   agpudm_kmeans_minibatch and the same centers as k-means.
+ Every configuration is run once to warm up (OpenCL program build, tuning of the work-group
+ size) and then *reps* times. Printed are the median and the minimum of the wall time of one
+ call (latency), the median of the exclusive runtime reported by the engine, the data items
+ per second at the median wall time (throughput) and the work of the last run: iterations
+ (k-means) or passes of the cluster expansion (DBSCAN) and distance evaluations (see struct
+ agpudm_stats).
+ Build and run on the host (see CMakeLists.txt); the GPU engine needs an OpenCL implementation,
+ e.g. PoCL on the CPU:
+ <pre>
+ cmake -S . -B build && cmake --build build -j
+ ./build/agpudm_bench --sizes 128,512,2048 --features 1,2,4 --clusters 2,4,8 --threads 1,2,4 --json
+ </pre>
+ Output: CSV (default) or JSON on stdout; one row per algorithm, engine, data items, features,
+ clusters and threads. Rows of engines that fail carry the status (see agpudm.h).
+ k-means starts from fixed centers (seed + 2) so that every run does the same work.
+ Regression suite: *--suite quick* runs the grid of the fixed mode of the app, *--suite full*
+ adds larger tiers (see bench_tier), both with 7 runs per configuration. *--save* stores the
+ results as JSON baseline, *--compare* runs the same configurations and reports which of them
+ became significantly slower (see bench_compare); the exit code is 3 if any did:
+ <pre>
+ ./build/agpudm_bench --suite full --save baseline.json
+ ./build/agpudm_bench --suite full --compare baseline.json
+ </pre>
+ Baselines are only comparable on the same machine (and OpenCL implementation).
+ *--trace file* records the timeline of all runs (set up, iterations, chunks of the workers,
+ OpenCL calls) and writes it as Chrome trace_event JSON (chrome://tracing, Perfetto).
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "agpudm.h"
+#include "AndroidOpenCL.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+                              //! maximum number of values of a list option
+#define BENCH_MAXLIST 16
+                              //! maximum value of a list option
+#define BENCH_MAXVALUE (1 << 24)
+                              //! maximum number of timed runs per configuration
+#define BENCH_MAXREPS 101
+                              //! significant change: more than this many standard deviations
+#define BENCH_ZLIMIT 3
+                              //! algorithm: mini-batch k-means (after AGPUDM_KMEANS, _DBSCAN)
+#define BENCH_MINIBATCH 3
+
+                              //! A list option
+struct bench_list {
+                              //! the values
+  int v[BENCH_MAXLIST];
+                              //! number of values
+  int n;
+};
+
+                              //! The options of the benchmark
+struct bench_opts {
+                              //! data items per cluster
+  struct bench_list sizes;
+                              //! features per data item
+  struct bench_list features;
+                              //! number of clusters
+  struct bench_list clusters;
+                              //! threads of the multithreaded engine
+  struct bench_list threads;
+                              //! engines (AGPUDM_ENGINE_*)
+  struct bench_list engines;
+                              //! algorithms (AGPUDM_KMEANS, AGPUDM_DBSCAN, BENCH_MINIBATCH)
+  struct bench_list algos;
+                              //! tiers of the regression suite (see bench_tier), 0 = the lists
+  int tiers;
+                              //! timed runs per configuration
+  int reps;
+                              //! seed of the data items
+  long long seed;
+                              //! 1 = JSON, 0 = CSV
+  int json;
+                              //! OpenCL library loaded for the GPU engine
+  const char* opencl;
+                              //! file of the baseline to write, NULL = none
+  const char* save;
+                              //! file of the baseline to compare with, NULL = none
+  const char* compare;
+                              //! smallest relevant change (%) for the comparison
+  double threshold;
+                              //! file of the timeline (Chrome trace_event JSON), NULL = none
+  const char* trace;
+};
+
+                              //! The result of a configuration
+struct bench_row {
+                              //! AGPUDM_KMEANS or AGPUDM_DBSCAN
+  int algo;
+                              //! AGPUDM_ENGINE_*
+  int engine;
+                              //! number of data items
+  int items;
+                              //! features per data item
+  int features;
+                              //! number of clusters generated
+  int clusters;
+                              //! threads (multithreaded engine, 1 otherwise)
+  int threads;
+                              //! timed runs
+  int reps;
+                              //! status of the last run (AGPUDM_OK or an error code)
+  int status;
+                              //! result code of the engine
+  int code;
+                              //! median, median absolute deviation and minimum of the wall time
+  long long wmed, wmad, wmin;
+                              //! median of the exclusive runtime
+  long long emed;
+                              //! data items per second at the median
+  double tput;
+                              //! iterations (k-means) or expansion passes (DBSCAN) of the last run
+  int iters;
+                              //! distance evaluations of the last run
+  long long dists;
+};
+
+                              //! names of the engines (index = AGPUDM_ENGINE_*)
+static const char* const bench_engines[] = { "auto", "single", "pthreads", "gpu" };
+                              //! names of the algorithms (index = AGPUDM_KMEANS, ...)
+static const char* const bench_algos[] = { "", "kmeans", "dbscan", "minibatch" };
+
+
+
+/*!
+ \brief Generates Gaussian clusters
+ \details
+ Same data as the app (see agpudm_generate): every cluster gets a center (N(0,10) per feature)
+ and a spread (N(0,2.5) per feature), its data items are drawn around the center and the data
+ items are shuffled.
+ \param data (out) the data items (clusters * size * features values)
+ \param clusters (in) number of clusters
+ \param size (in) data items per cluster
+ \param features (in) features per data item
+ \param seed (in) the seed
+ \returns 0 = no error, -1 = malloc error or no workers
+ \mt fully threadsafe
+ */
+int bench_clusters( float* data, int clusters, int size, int features, long long seed ){
+
+  int* sizes = (int*) malloc( sizeof(int) * clusters );
+
+  if (sizes == NULL) {
+    return( -1 );
+  }
+
+  for (int i1 = 0; i1 < clusters; i1++) {
+    sizes[i1] = size;
+  }
+
+  const int ret = agpudm_generate( sizes, clusters, features, (unsigned long long) seed, 0, data );
+
+  free( sizes );
+
+  return( (ret == AGPUDM_OK) ? 0 : -1 );
+
+} // bench_clusters
+
+
+
+/*!
+ \brief Returns the monotonic time
+ \returns time in ns
+ \mt fully threadsafe
+ */
+long long bench_now( void ){
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return( (long long) t.tv_sec * 1000000000LL + t.tv_nsec );
+
+} // bench_now
+
+
+
+/*!
+ \brief Compares two times (qsort)
+ \param a (in) first time
+ \param b (in) second time
+ \returns <0, 0, >0
+ \mt fully threadsafe
+ */
+int bench_cmp( const void* a, const void* b ){
+
+  const long long x = *(const long long*) a;
+  const long long y = *(const long long*) b;
+
+  return( (x > y) - (x < y) );
+
+} // bench_cmp
+
+
+
+/*!
+ \brief Returns the median of times
+ \param t (in+out) the times (sorted on return)
+ \param n (in) number of times (> 0)
+ \returns the median
+ \mt fully threadsafe
+ */
+long long bench_median( long long* t, int n ){
+
+  qsort( t, n, sizeof(long long), &bench_cmp );
+
+  return( ((n & 1) != 0) ? t[n / 2] : (t[n / 2 - 1] + t[n / 2]) / 2 );
+
+} // bench_median
+
+
+
+/*!
+ \brief Parses a comma separated list of numbers
+ \param l (out) the list
+ \param s (in) the text
+ \returns 0 = no error, -1 = invalid or too many values
+ \mt fully threadsafe
+ */
+int bench_parselist( struct bench_list* l, const char* s ){
+
+  l->n = 0;
+
+  while (*s != 0) {
+
+    char* end;
+    const long v = strtol( s, &end, 10 );
+
+    if ((end == s) || (v <= 0) || (v > BENCH_MAXVALUE) || (l->n == BENCH_MAXLIST)) {
+      return( -1 );
+    }
+
+    l->v[l->n++] = (int) v;
+
+    s = (*end == ',') ? end + 1 : end;
+
+    if ((*end != ',') && (*end != 0)) {
+      return( -1 );
+    }
+  }
+
+  return( (l->n > 0) ? 0 : -1 );
+
+} // bench_parselist
+
+
+
+/*!
+ \brief Parses a comma separated list of names
+ \param l (out) the list (indices of the names)
+ \param s (in) the text
+ \param names (in) the names
+ \param nnames (in) number of names
+ \param first (in) index of the first name
+ \returns 0 = no error, -1 = unknown name
+ \mt fully threadsafe
+ */
+int bench_parsenames( struct bench_list* l, const char* s, const char* const* names, int nnames,
+                      int first ){
+
+  l->n = 0;
+
+  while (*s != 0) {
+
+    const size_t len = strcspn( s, "," );
+    int found = -1;
+
+    for (int i1 = first; i1 < nnames; i1++) {
+      if ((strlen( names[i1] ) == len) && (strncmp( s, names[i1], len ) == 0)) {
+        found = i1;
+      }
+    }
+
+    if ((found < 0) || (l->n == BENCH_MAXLIST)) {
+      return( -1 );
+    }
+
+    l->v[l->n++] = found;
+
+    s += (s[len] == ',') ? len + 1 : len;
+  }
+
+  return( (l->n > 0) ? 0 : -1 );
+
+} // bench_parsenames
+
+
+
+/*!
+ \brief Prints the usage
+ \param prog (in) name of the program
+ \mt fully threadsafe
+ */
+void bench_usage( const char* prog ){
+
+  fprintf( stderr,
+           "usage: %s [options]\n"
+           "  --sizes n,...      data items per cluster (default 128,512,2048)\n"
+           "  --features n,...   features per data item (default 1,2,4)\n"
+           "  --clusters n,...   number of clusters (default 2,4,8)\n"
+           "  --threads n,...    threads of the multithreaded engine (default 1,2,4)\n"
+           "  --engines e,...    single, pthreads, gpu (default all)\n"
+           "  --algorithms a,... kmeans, dbscan, minibatch (default kmeans,dbscan)\n"
+           "  --suite s          quick (grid of the app) or full (grid and larger tiers);\n"
+           "                     replaces the lists above, 7 runs per configuration\n"
+           "  --reps n           timed runs per configuration (default 3)\n"
+           "  --seed n           seed of the data items and the k-means centers (default 1)\n"
+           "  --opencl path      OpenCL library (default libOpenCL.so.1)\n"
+           "  --save file        store the results as JSON baseline\n"
+           "  --compare file     compare with a JSON baseline, print the comparison\n"
+           "  --threshold pct    smallest relevant change for --compare (default 5)\n"
+           "  --trace file       write the timeline of all runs (Chrome trace_event JSON)\n"
+           "  --json             JSON instead of CSV\n", prog );
+
+} // bench_usage
+
+
+
+/*!
+ \brief Sets the lists of a tier of the regression suite
+ \details
+ Tier 0 is the grid of the fixed mode of the app (features 1,2,4; clusters 2,4,6,8; data
+ items per cluster 128..2048) for both algorithms. The larger tiers: k-means with 8192 and
+ 32768 data items per cluster, DBSCAN with 4096 data items per cluster (O(n^2)).
+ \param o (in+out) the options
+ \param tier (in) the tier
+ \returns 0 = no error, -1 = no such tier
+ \mt fully threadsafe
+ */
+int bench_tier( struct bench_opts* o, int tier ){
+
+  int ret = 0;
+
+  bench_parselist( &o->features, "1,2,4" );
+
+  if (tier == 0) {
+    bench_parsenames( &o->algos, "kmeans,dbscan", bench_algos, 4, 1 );
+    bench_parselist( &o->sizes, "128,256,512,1024,2048" );
+    bench_parselist( &o->clusters, "2,4,6,8" );
+  } else if (tier == 1) {
+    bench_parsenames( &o->algos, "kmeans", bench_algos, 4, 1 );
+    bench_parselist( &o->sizes, "8192,32768" );
+    bench_parselist( &o->clusters, "2,8" );
+  } else if (tier == 2) {
+    bench_parsenames( &o->algos, "dbscan", bench_algos, 4, 1 );
+    bench_parselist( &o->sizes, "4096" );
+    bench_parselist( &o->clusters, "2,8" );
+  } else {
+    ret = -1;
+  }
+
+  return( ret );
+
+} // bench_tier
+
+
+
+/*!
+ \brief Parses the command line
+ \param o (out) the options
+ \param argc (in) number of arguments
+ \param argv (in) the arguments
+ \returns 0 = no error, -1 = invalid arguments
+ \mt fully threadsafe
+ */
+int bench_options( struct bench_opts* o, int argc, char** argv ){
+
+  bench_parselist( &o->sizes, "128,512,2048" );
+  bench_parselist( &o->features, "1,2,4" );
+  bench_parselist( &o->clusters, "2,4,8" );
+  bench_parselist( &o->threads, "1,2,4" );
+  bench_parsenames( &o->engines, "single,pthreads,gpu", bench_engines, 4, 1 );
+  bench_parsenames( &o->algos, "kmeans,dbscan", bench_algos, 4, 1 );
+  o->reps = 0;
+  o->seed = 1;
+  o->json = 0;
+  o->tiers = 0;
+  o->threshold = 5;
+  o->opencl = "libOpenCL.so.1";
+  o->save = NULL;
+  o->compare = NULL;
+  o->trace = NULL;
+
+  int ret = 0;
+
+  for (int i1 = 1; (i1 < argc) && (ret == 0); i1++) {
+
+    const char* a = argv[i1];
+    const char* v = (i1 + 1 < argc) ? argv[i1 + 1] : NULL;
+
+    if (strcmp( a, "--json" ) == 0) {
+      o->json = 1;
+    } else if (v == NULL) {
+      ret = -1;
+    } else {
+
+      i1++;
+
+      if (strcmp( a, "--sizes" ) == 0) {
+        ret = bench_parselist( &o->sizes, v );
+      } else if (strcmp( a, "--features" ) == 0) {
+        ret = bench_parselist( &o->features, v );
+      } else if (strcmp( a, "--clusters" ) == 0) {
+        ret = bench_parselist( &o->clusters, v );
+      } else if (strcmp( a, "--threads" ) == 0) {
+        ret = bench_parselist( &o->threads, v );
+      } else if (strcmp( a, "--engines" ) == 0) {
+        ret = bench_parsenames( &o->engines, v, bench_engines, 4, 1 );
+      } else if (strcmp( a, "--algorithms" ) == 0) {
+        ret = bench_parsenames( &o->algos, v, bench_algos, 4, 1 );
+      } else if (strcmp( a, "--suite" ) == 0) {
+        o->tiers = (strcmp( v, "quick" ) == 0) ? 1 : (strcmp( v, "full" ) == 0) ? 3 : 0;
+        ret = (o->tiers > 0) ? 0 : -1;
+      } else if (strcmp( a, "--reps" ) == 0) {
+        o->reps = atoi( v );
+        ret = ((o->reps > 0) && (o->reps <= BENCH_MAXREPS)) ? 0 : -1;
+      } else if (strcmp( a, "--seed" ) == 0) {
+        o->seed = atoll( v );
+      } else if (strcmp( a, "--opencl" ) == 0) {
+        o->opencl = v;
+      } else if (strcmp( a, "--save" ) == 0) {
+        o->save = v;
+      } else if (strcmp( a, "--compare" ) == 0) {
+        o->compare = v;
+      } else if (strcmp( a, "--trace" ) == 0) {
+        o->trace = v;
+      } else if (strcmp( a, "--threshold" ) == 0) {
+        o->threshold = atof( v );
+        ret = (o->threshold >= 0) ? 0 : -1;
+      } else {
+        ret = -1;
+      }
+    }
+  }
+
+  if (o->reps == 0) {                  // more runs for the regression suite
+    o->reps = (o->tiers > 0) ? 7 : 3;
+  }
+
+  return( ret );
+
+} // bench_options
+
+
+
+/*!
+ \brief Prints a result
+ \param f (in) the file
+ \param r (in) the result
+ \param json (in) 1 = JSON, 0 = CSV
+ \param first (in) 1 = first result of the file (JSON)
+ \mt not threadsafe (prints to *f*)
+ */
+void bench_print( FILE* f, const struct bench_row* r, int json, int first ){
+
+  const char* aname = bench_algos[r->algo];
+
+  if (json != 0) {
+    fprintf( f, "%s\n    {\"algorithm\": \"%s\", \"engine\": \"%s\", \"items\": %d, "
+             "\"features\": %d, \"clusters\": %d, \"threads\": %d, \"reps\": %d, \"status\": %d, "
+             "\"error\": \"%s\", \"code\": %d, \"wall_median_ns\": %lld, \"wall_mad_ns\": %lld, "
+             "\"wall_min_ns\": %lld, \"exclusive_median_ns\": %lld, \"items_per_s\": %.1f, "
+             "\"iterations\": %d, \"distances\": %lld}",
+             (first != 0) ? "" : ",", aname, bench_engines[r->engine], r->items, r->features,
+             r->clusters, r->threads, r->reps, r->status, agpudm_strerror( r->status ), r->code,
+             r->wmed, r->wmad, r->wmin, r->emed, r->tput, r->iters, r->dists );
+  } else {
+    fprintf( f, "%s,%s,%d,%d,%d,%d,%d,%d,%d,%lld,%lld,%lld,%lld,%.1f,%d,%lld\n", aname,
+             bench_engines[r->engine], r->items, r->features, r->clusters, r->threads, r->reps,
+             r->status, r->code, r->wmed, r->wmad, r->wmin, r->emed, r->tput, r->iters, r->dists );
+  }
+
+  fflush( f );
+
+} // bench_print
+
+
+
+/*!
+ \brief Runs one configuration
+ \details
+ *r* names the configuration on entry (algo, engine, items, features, clusters, threads).
+ \param o (in) the options
+ \param r (in+out) the result
+ \param data (in) the data items
+ \param labels (out) cluster numbers (r->items values)
+ \mt fully threadsafe
+ */
+void bench_run( const struct bench_opts* o, struct bench_row* r, const float* data,
+                unsigned short* labels ){
+
+  struct agpudm_config cfg;             // the engine
+  struct agpudm* ctx;
+  struct agpudm_result res;             // details of the last run
+  struct agpudm_stats st;               // counters of the last run
+
+  long long wall[BENCH_MAXREPS];        // wall time of the runs
+  long long excl[BENCH_MAXREPS];        // exclusive runtime of the runs
+
+  agpudm_config_default( &cfg );
+  cfg.engine = r->engine;
+  cfg.cores = r->threads;
+
+  int status = agpudm_create( &cfg, &ctx );
+
+  memset( &st, 0, sizeof(st) );
+  res.workers = NULL;
+  res.wlen = 0;
+  res.stats = &st;
+  res.code = 0;
+
+                              // fixed centers: the data items use seed, the shuffle seed + 1
+  const struct agpudm_kmeans_params kp = { r->clusters, 1e-6f, (unsigned int) (o->seed + 2) };
+  const struct agpudm_dbscan_params dp = { (float) sqrt( r->features ), 10 * r->features };
+  const struct agpudm_minibatch_params mp = { 0, 0, 0 };
+
+  for (int i1 = -1; (i1 < o->reps) && (status == AGPUDM_OK); i1++) {  // -1 = warm-up
+
+    const long long t = bench_now();
+
+    if (r->algo == AGPUDM_KMEANS) {
+      status = agpudm_kmeans( ctx, data, r->items, r->features, &kp, 0, labels, &res );
+    } else if (r->algo == BENCH_MINIBATCH) {
+      status = agpudm_kmeans_minibatch( ctx, data, r->items, r->features, &kp, &mp, 0, labels,
+                                        &res );
+    } else {
+      status = agpudm_dbscan( ctx, data, r->items, r->features, &dp, 0, labels, &res );
+    }
+
+    if (i1 >= 0) {
+      wall[i1] = bench_now() - t;
+      excl[i1] = res.elapsed;
+    }
+  }
+
+  if (ctx != NULL) {
+    agpudm_destroy( ctx );
+  }
+
+  r->reps = o->reps;
+  r->status = status;
+  r->code = res.code;
+  r->wmed = 0;
+  r->wmad = 0;
+  r->wmin = 0;
+  r->emed = 0;
+  r->tput = 0;
+  r->iters = (r->algo != AGPUDM_DBSCAN) ? st.iterations : st.passes;
+  r->dists = st.distances;
+
+  if (status == AGPUDM_OK) {
+
+    r->wmed = bench_median( wall, o->reps );
+    r->wmin = wall[0];                  // sorted
+    r->emed = bench_median( excl, o->reps );
+    r->tput = (r->wmed > 0) ? (double) r->items * 1e9 / (double) r->wmed : 0;
+
+    for (int i1 = 0; i1 < o->reps; i1++) {      // median absolute deviation
+      wall[i1] = llabs( wall[i1] - r->wmed );
+    }
+
+    r->wmad = bench_median( wall, o->reps );
+  }
+
+} // bench_run
+
+
+
+/*!
+ \brief Runs the sweep of the lists of the options
+ \param o (in) the options
+ \param rows (in+out) the results (grown with realloc)
+ \param nrows (in+out) number of results
+ \returns 0 = no error, -1 = malloc error
+ \mt not threadsafe (prints to stdout)
+ */
+int bench_sweep( const struct bench_opts* o, struct bench_row** rows, int* nrows ){
+
+  int ret = 0;
+
+  for (int f = 0; (f < o->features.n) && (ret == 0); f++) {
+    for (int c = 0; (c < o->clusters.n) && (ret == 0); c++) {
+      for (int s = 0; (s < o->sizes.n) && (ret == 0); s++) {
+
+        const int features = o->features.v[f];
+        const int clusters = o->clusters.v[c];
+        const int n = clusters * o->sizes.v[s];
+
+        float* data = (float*) malloc( sizeof(float) * n * features );
+        unsigned short* labels = (unsigned short*) malloc( sizeof(unsigned short) * n );
+
+        if ((data != NULL) && (labels != NULL) &&
+            (bench_clusters( data, clusters, o->sizes.v[s], features, o->seed ) == 0)) {
+
+          for (int a = 0; (a < o->algos.n) && (ret == 0); a++) {
+            for (int e = 0; (e < o->engines.n) && (ret == 0); e++) {
+
+              const int engine = o->engines.v[e];
+              const int nt = (engine == AGPUDM_ENGINE_PTHREADS) ? o->threads.n : 1;
+
+              for (int t = 0; (t < nt) && (ret == 0); t++) {
+
+                struct bench_row* nr = (struct bench_row*) realloc( *rows,
+                                                sizeof(struct bench_row) * (*nrows + 1) );
+
+                if (nr != NULL) {
+
+                  struct bench_row* r = &nr[*nrows];
+
+                  *rows = nr;
+
+                  r->algo = o->algos.v[a];
+                  r->engine = engine;
+                  r->items = n;
+                  r->features = features;
+                  r->clusters = clusters;
+                  r->threads = (engine == AGPUDM_ENGINE_PTHREADS) ? o->threads.v[t] : 1;
+
+                  bench_run( o, r, data, labels );
+
+                  if (o->compare == NULL) {
+                    bench_print( stdout, r, o->json, *nrows == 0 );
+                  }
+
+                  (*nrows)++;
+
+                } else {
+                  ret = -1;
+                }
+              }
+            }
+          }
+
+        } else {
+          ret = -1;
+        }
+
+        free( data );
+        free( labels );
+      }
+    }
+  }
+
+  return( ret );
+
+} // bench_sweep
+
+
+
+/*!
+ \brief Writes results as JSON baseline
+ \param o (in) the options
+ \param rows (in) the results
+ \param nrows (in) number of results
+ \returns 0 = no error, -1 = file could not be written
+ \mt fully threadsafe
+ */
+int bench_save( const struct bench_opts* o, const struct bench_row* rows, int nrows ){
+
+  FILE* f = fopen( o->save, "w" );
+
+  if (f == NULL) {
+    return( -1 );
+  }
+
+  fprintf( f, "{\n  \"benchmark\": \"agpudm_bench\",\n  \"seed\": %lld,\n  \"runs\": [", o->seed );
+
+  for (int i1 = 0; i1 < nrows; i1++) {
+    bench_print( f, &rows[i1], 1, i1 == 0 );
+  }
+
+  fprintf( f, "\n  ]\n}\n" );
+
+  return( (fclose( f ) == 0) ? 0 : -1 );
+
+} // bench_save
+
+
+
+/*!
+ \brief Returns a number of a JSON result line
+ \param line (in) the line (one result, see bench_print)
+ \param key (in) name of the value
+ \param v (out) the value
+ \returns 0 = found, -1 = not found
+ \mt fully threadsafe
+ */
+int bench_jsonnum( const char* line, const char* key, double* v ){
+
+  char k[64];
+
+  snprintf( k, sizeof(k), "\"%s\": ", key );
+
+  const char* p = strstr( line, k );
+
+  if (p == NULL) {
+    return( -1 );
+  }
+
+  *v = strtod( p + strlen( k ), NULL );
+
+  return( 0 );
+
+} // bench_jsonnum
+
+
+
+/*!
+ \brief Reads a JSON baseline
+ \details
+ Reads the files written by bench_save (or by --json): one result per line.
+ \param file (in) the file
+ \param rows (out) the results (malloc)
+ \param nrows (out) number of results
+ \returns 0 = no error, -1 = file could not be read, -2 = malloc error
+ \mt fully threadsafe
+ */
+int bench_load( const char* file, struct bench_row** rows, int* nrows ){
+
+  static const char* const keys[] = { "items", "features", "clusters", "threads", "reps",
+                                      "status", "wall_median_ns", "wall_mad_ns" };
+
+  char line[1024];
+  int ret = 0;
+
+  *rows = NULL;
+  *nrows = 0;
+
+  FILE* f = fopen( file, "r" );
+
+  if (f == NULL) {
+    return( -1 );
+  }
+
+  while ((ret == 0) && (fgets( line, sizeof(line), f ) != NULL)) {
+
+    struct bench_row r;
+    double v[8];
+    int ok = 0;
+
+    for (int i1 = 0; i1 < 8; i1++) {
+      ok |= bench_jsonnum( line, keys[i1], &v[i1] );
+    }
+
+    r.algo = AGPUDM_KMEANS;
+
+    for (int i1 = 1; i1 < 4; i1++) {
+
+      char a[64];
+
+      snprintf( a, sizeof(a), "\"algorithm\": \"%s\"", bench_algos[i1] );
+
+      if (strstr( line, a ) != NULL) {
+        r.algo = i1;
+      }
+    }
+
+    r.engine = -1;
+
+    for (int i1 = 1; i1 < 4; i1++) {
+
+      char e[64];
+
+      snprintf( e, sizeof(e), "\"engine\": \"%s\"", bench_engines[i1] );
+
+      if (strstr( line, e ) != NULL) {
+        r.engine = i1;
+      }
+    }
+
+    if ((ok == 0) && (r.engine > 0)) {
+
+      struct bench_row* nr = (struct bench_row*) realloc( *rows,
+                                                          sizeof(struct bench_row) * (*nrows + 1) );
+
+      if (nr != NULL) {
+
+        r.items = (int) v[0];
+        r.features = (int) v[1];
+        r.clusters = (int) v[2];
+        r.threads = (int) v[3];
+        r.reps = (int) v[4];
+        r.status = (int) v[5];
+        r.wmed = (long long) v[6];
+        r.wmad = (long long) v[7];
+
+        *rows = nr;
+        nr[(*nrows)++] = r;
+
+      } else {
+        ret = -2;
+      }
+    }
+  }
+
+  fclose( f );
+
+  return( ret );
+
+} // bench_load
+
+
+
+/*!
+ \brief Compares results with a baseline
+ \details
+ A configuration is slower (faster) if its median wall time changed by more than the
+ threshold and by more than BENCH_ZLIMIT standard deviations: the deviation of the difference
+ is estimated from the MADs of both medians (1.4826 * MAD per median, added in quadrature).
+ Prints one row per configuration: the medians, the change, the z value and the verdict (ok,
+ slower, faster, failed = the engine failed in one of the runs, new = not in the baseline).
+ \param o (in) the options
+ \param rows (in) the results
+ \param nrows (in) number of results
+ \param base (in) the baseline
+ \param nbase (in) number of results of the baseline
+ \returns number of slower configurations
+ \mt not threadsafe (prints to stdout)
+ */
+int bench_compare( const struct bench_opts* o, const struct bench_row* rows, int nrows,
+                   const struct bench_row* base, int nbase ){
+
+  int slower = 0, faster = 0, unchanged = 0;
+
+  if (o->json != 0) {
+    printf( "{\n  \"benchmark\": \"agpudm_bench\",\n  \"baseline\": \"%s\",\n"
+            "  \"threshold_pct\": %.1f,\n  \"comparison\": [", o->compare, o->threshold );
+  } else {
+    printf( "algorithm,engine,items,features,clusters,threads,base_median_ns,median_ns,"
+            "change_pct,z,verdict\n" );
+  }
+
+  for (int i1 = 0; i1 < nrows; i1++) {
+
+    const struct bench_row* r = &rows[i1];
+    const struct bench_row* b = NULL;
+
+    for (int i2 = 0; (i2 < nbase) && (b == NULL); i2++) {
+      if ((base[i2].algo == r->algo) && (base[i2].engine == r->engine) &&
+          (base[i2].items == r->items) && (base[i2].features == r->features) &&
+          (base[i2].clusters == r->clusters) && (base[i2].threads == r->threads)) {
+        b = &base[i2];
+      }
+    }
+
+    const char* verdict = "new";
+    double change = 0, z = 0;
+
+    if ((b != NULL) && ((b->status != AGPUDM_OK) || (r->status != AGPUDM_OK))) {
+      verdict = "failed";
+    } else if ((b != NULL) && (b->wmed > 0)) {
+
+      const double sb = 1.4826 * (double) b->wmad;
+      const double sr = 1.4826 * (double) r->wmad;
+      const double diff = (double) (r->wmed - b->wmed);
+      const double sd = sqrt( sb * sb + sr * sr );
+
+      change = 100.0 * diff / (double) b->wmed;
+      z = (sd > 0) ? diff / sd : ((diff > 0) ? BENCH_ZLIMIT + 1 : -BENCH_ZLIMIT - 1);
+
+      if ((change > o->threshold) && (z > BENCH_ZLIMIT)) {
+        verdict = "slower";
+        slower++;
+      } else if ((change < -o->threshold) && (z < -BENCH_ZLIMIT)) {
+        verdict = "faster";
+        faster++;
+      } else {
+        verdict = "ok";
+        unchanged++;
+      }
+    }
+
+    const char* aname = bench_algos[r->algo];
+    const long long bmed = (b != NULL) ? b->wmed : 0;
+
+    if (o->json != 0) {
+      printf( "%s\n    {\"algorithm\": \"%s\", \"engine\": \"%s\", \"items\": %d, "
+              "\"features\": %d, \"clusters\": %d, \"threads\": %d, \"base_median_ns\": %lld, "
+              "\"median_ns\": %lld, \"change_pct\": %.2f, \"z\": %.2f, \"verdict\": \"%s\"}",
+              (i1 == 0) ? "" : ",", aname, bench_engines[r->engine], r->items, r->features,
+              r->clusters, r->threads, bmed, r->wmed, change, z, verdict );
+    } else {
+      printf( "%s,%s,%d,%d,%d,%d,%lld,%lld,%.2f,%.2f,%s\n", aname, bench_engines[r->engine],
+              r->items, r->features, r->clusters, r->threads, bmed, r->wmed, change, z, verdict );
+    }
+  }
+
+  if (o->json != 0) {
+    printf( "\n  ]\n}\n" );
+  }
+
+  fprintf( stderr, "%d slower, %d faster, %d unchanged (threshold %.1f%%, |z| > %.1f)\n", slower,
+           faster, unchanged, o->threshold, (double) BENCH_ZLIMIT );
+
+  return( slower );
+
+} // bench_compare
+
+
+
+/*!
+ \brief Main function of the benchmark
+ \param argc (in) number of arguments
+ \param argv (in) the arguments (see bench_usage)
+ \returns 0 = no error, 1 = invalid arguments, 2 = malloc error, 3 = slower than the baseline,
+ 4 = baseline or trace could not be read or written
+ \mt not threadsafe
+ */
+int main( int argc, char** argv ){
+
+  struct bench_opts o;
+
+  if (bench_options( &o, argc, argv ) != 0) {
+    bench_usage( argv[0] );
+    return( 1 );
+  }
+
+  int ret = 0;
+
+  struct bench_row* base = NULL;         // the baseline
+  int nbase = 0;
+
+  if ((o.compare != NULL) && (bench_load( o.compare, &base, &nbase ) != 0)) {
+    fprintf( stderr, "%s could not be read\n", o.compare );
+    ret = 4;
+  }
+
+  for (int i1 = 0; i1 < o.engines.n; i1++) {    // the GPU engine needs the OpenCL library
+
+    if ((o.engines.v[i1] == AGPUDM_ENGINE_GPU) && (loadOpenCL( o.opencl ) < -1)) {
+      fprintf( stderr, "%s could not be loaded, the GPU engine will fail\n", o.opencl );
+    }
+  }
+
+  if (o.compare == NULL) {
+    if (o.json != 0) {
+      printf( "{\n  \"benchmark\": \"agpudm_bench\",\n  \"seed\": %lld,\n  \"runs\": [", o.seed );
+    } else {
+      printf( "algorithm,engine,items,features,clusters,threads,reps,status,code,wall_median_ns,"
+              "wall_mad_ns,wall_min_ns,exclusive_median_ns,items_per_s,iterations,distances\n" );
+    }
+  }
+
+  struct bench_row* rows = NULL;         // the results
+  int nrows = 0;
+
+  if ((ret == 0) && (o.trace != NULL) && (agpudm_trace_start( 1 << 20 ) != AGPUDM_OK)) {
+    ret = 2;
+  }
+
+  if (ret == 0) {
+    if (o.tiers == 0) {
+      ret = (bench_sweep( &o, &rows, &nrows ) == 0) ? 0 : 2;
+    } else {
+      for (int i1 = 0; (i1 < o.tiers) && (ret == 0); i1++) {
+        bench_tier( &o, i1 );
+        ret = (bench_sweep( &o, &rows, &nrows ) == 0) ? 0 : 2;
+      }
+    }
+  }
+
+  if ((o.compare == NULL) && (o.json != 0)) {
+    printf( "\n  ]\n}\n" );
+  }
+
+  if (o.trace != NULL) {
+    agpudm_trace_stop();
+    if ((ret == 0) && (agpudm_trace_write( o.trace ) != AGPUDM_OK)) {
+      fprintf( stderr, "%s could not be written\n", o.trace );
+      ret = 4;
+    }
+  }
+
+  if ((ret == 0) && (o.save != NULL) && (bench_save( &o, rows, nrows ) != 0)) {
+    fprintf( stderr, "%s could not be written\n", o.save );
+    ret = 4;
+  }
+
+  if ((ret == 0) && (o.compare != NULL) && (bench_compare( &o, rows, nrows, base, nbase ) > 0)) {
+    ret = 3;
+  }
+
+  free( rows );
+  free( base );
+
+  unloadOpenCL();
+
+  return( ret );
+
+} // main
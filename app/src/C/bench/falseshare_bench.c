@@ -0,0 +1,326 @@
+/*!
+ \file falseshare_bench.c
+ \brief Benchmark for the false sharing between the participants of the scheduler
+ \details
+ Runs loops on the work-stealing scheduler of the thread pool (see threadpool.h) and counts the
+ cache misses of all threads with the perf counters of the kernel (perf_event_open). Every loop
+ is run twice, with the old layout ("packed") and with the cache line layout ("padded"):
+ - counters: every participant increments its own counter once per data item (like the item
+   counters of DBSCAN); packed = int array, padded = one counter per THREADPOOL_CACHELINE bytes.
+ - labels: every data item gets a label (unsigned short) like the cluster numbers of k-means
+   and DBSCAN, the loops are short (like one DBSCAN query); packed = malloc'd array and chunks
+   of any size, padded = array from threadpool_alloc and threadpool_sched_align.
+ The cache misses of the threads include the coherence misses caused by the other threads
+ writing to the same lines. The counters are opened with *inherit* before the pool is started;
+ the counts of the workers are added when the pool is shut down after every run.
+ If the perf counters are not available (kernel.perf_event_paranoid, containers) -1 is printed.
+ Build and run on the host (target falseshare_bench, or with the NDK toolchain for a device):
+ <pre>
+ cmake -S . -B build && cmake --build build -j --target falseshare_bench
+ ./build/falseshare_bench [participants] [data items] [loops]
+ </pre>
+ The result is printed as CSV: loop, layout, participants, ms, cache misses, L1D read misses.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef _GNU_SOURCE
+                              //! needed for syscall
+#define _GNU_SOURCE
+#endif
+
+#include "threadpool.h"
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+
+                              //! number of perf counters
+#define BENCH_NCOUNTERS 2
+
+                              //! Counter of a participant (padded layout)
+struct bench_count {
+                              //! the counter
+  volatile int n;
+} __attribute__((aligned(THREADPOOL_CACHELINE)));
+
+                              //! Parameters of a loop
+struct bench_loop {
+                              //! counters of the participants (packed layout)
+  volatile int* packed;
+                              //! counters of the participants (padded layout)
+  struct bench_count* padded;
+                              //! labels of the data items
+  volatile unsigned short* labels;
+};
+
+
+
+/*!
+ \brief Returns the monotonic time
+ \returns time in ns
+ */
+long long bench_now( void ){
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return( (long long) t.tv_sec * 1000000000LL + t.tv_nsec );
+
+} // bench_now
+
+
+
+/*!
+ \brief Opens the perf counters of the calling thread and of the threads it creates later
+ \param fd (out) BENCH_NCOUNTERS file descriptors (-1 = counter not available)
+ */
+void bench_open( int* fd ){
+
+  struct perf_event_attr pe;
+
+  for (int i1 = 0; i1 < BENCH_NCOUNTERS; i1++) {
+
+    memset( &pe, 0, sizeof(pe) );
+    pe.size = sizeof(pe);
+    pe.disabled = 1;
+    pe.inherit = 1;                          // count the workers started later
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+
+    if (i1 == 0) {
+      pe.type = PERF_TYPE_HARDWARE;
+      pe.config = PERF_COUNT_HW_CACHE_MISSES;
+    } else {
+      pe.type = PERF_TYPE_HW_CACHE;
+      pe.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    fd[i1] = (int) syscall( __NR_perf_event_open, &pe, 0, -1, -1, 0 );
+
+    if (fd[i1] >= 0) {
+      ioctl( fd[i1], PERF_EVENT_IOC_RESET, 0 );
+      ioctl( fd[i1], PERF_EVENT_IOC_ENABLE, 0 );
+    }
+  }
+
+} // bench_open
+
+
+
+/*!
+ \brief Reads and closes the perf counters
+ \param fd (in) BENCH_NCOUNTERS file descriptors
+ \param val (out) BENCH_NCOUNTERS values (-1 = counter not available)
+ */
+void bench_close( int* fd, long long* val ){
+
+  for (int i1 = 0; i1 < BENCH_NCOUNTERS; i1++) {
+
+    val[i1] = -1;
+
+    if (fd[i1] >= 0) {
+
+      ioctl( fd[i1], PERF_EVENT_IOC_DISABLE, 0 );
+
+      if (read( fd[i1], &val[i1], sizeof(long long) ) != sizeof(long long)) {
+        val[i1] = -1;
+      }
+
+      close( fd[i1] );
+    }
+  }
+
+} // bench_close
+
+
+
+/*!
+ \brief Chunk of the counter loop, packed layout
+ \param arg (in+out) the parameters of the loop
+ \param part (in) number of the participant
+ \param start (in) first data item
+ \param len (in) number of data items
+ */
+void bench_count_packed( void* arg, int part, int start, int len ){
+
+  struct bench_loop* l = (struct bench_loop*) arg;
+
+  for (int i1 = start; i1 < start + len; i1++) {
+    l->packed[part]++;
+  }
+
+} // bench_count_packed
+
+
+
+/*!
+ \brief Chunk of the counter loop, padded layout
+ \param arg (in+out) the parameters of the loop
+ \param part (in) number of the participant
+ \param start (in) first data item
+ \param len (in) number of data items
+ */
+void bench_count_padded( void* arg, int part, int start, int len ){
+
+  struct bench_loop* l = (struct bench_loop*) arg;
+
+  for (int i1 = start; i1 < start + len; i1++) {
+    l->padded[part].n++;
+  }
+
+} // bench_count_padded
+
+
+
+/*!
+ \brief Chunk of the label loop
+ \param arg (in+out) the parameters of the loop
+ \param part (in) number of the participant
+ \param start (in) first data item
+ \param len (in) number of data items
+ */
+void bench_label( void* arg, int part, int start, int len ){
+
+  struct bench_loop* l = (struct bench_loop*) arg;
+
+  for (int i1 = start; i1 < start + len; i1++) {
+    l->labels[i1] = (unsigned short) ((l->labels[i1] + i1 + part) & 0x7fff);
+  }
+
+} // bench_label
+
+
+
+/*!
+ \brief Runs a loop a number of times and prints the result
+ \param name (in) name of the loop
+ \param padded (in) 0 = packed layout, 1 = padded layout
+ \param parts (in) number of participants
+ \param n (in) number of data items
+ \param loops (in) number of loops
+ \returns 0 = no error, -1 = malloc error, -2 = scheduler or pool could not be started
+ */
+int bench_run( const char* name, int padded, int parts, int n, int loops ){
+
+  struct bench_loop l;
+  int ret = 0;
+
+  l.packed = (volatile int*) calloc( parts, sizeof(int) );
+  l.padded = (struct bench_count*) threadpool_alloc( sizeof(struct bench_count) * parts );
+  l.labels = (padded == 0) ? (unsigned short*) malloc( sizeof(unsigned short) * n + 2 )
+                           : (unsigned short*) threadpool_alloc( sizeof(unsigned short) * n );
+
+  if ((l.packed != NULL) && (l.padded != NULL) && (l.labels != NULL)) {
+
+    if (padded == 0) {
+      l.labels = (volatile unsigned short*) (((char*) l.labels) + 2);    // not on a cache line
+    }
+
+    memset( (void*) l.labels, 0, sizeof(unsigned short) * n );
+    memset( l.padded, 0, sizeof(struct bench_count) * parts );
+
+    threadpool_loopfn fn = &bench_label;
+
+    if (strcmp( name, "counters" ) == 0) {
+      fn = (padded == 0) ? &bench_count_packed : &bench_count_padded;
+    }
+
+    int fd[BENCH_NCOUNTERS];
+    long long val[BENCH_NCOUNTERS];
+    struct threadpool_sched sched;
+
+    bench_open( fd );                        // before the workers are started
+
+    if ((threadpool_sched_init( &sched, parts, CPUTOPO_NONE ) == 0) &&
+        (threadpool_reserve( parts ) > 0)) {
+
+      if ((padded == 1) && (fn == &bench_label)) {
+        threadpool_sched_align( &sched, sizeof(unsigned short) );
+      }
+
+      const long long t0 = bench_now();
+
+      for (int i1 = 0; i1 < loops; i1++) {
+        threadpool_sched_submit( &sched, fn, &l, n );
+        threadpool_sched_wait( &sched );
+      }
+
+      const long long t1 = bench_now();
+
+      threadpool_shutdown();                 // adds the counts of the workers
+
+      bench_close( fd, val );
+
+      printf( "%s,%s,%d,%.2f,%lld,%lld\n", name, (padded == 0) ? "packed" : "padded", parts,
+              (double) (t1 - t0) / 1e6, val[0], val[1] );
+
+      threadpool_sched_destroy( &sched );
+
+    } else {
+      bench_close( fd, val );
+      ret = -2;
+    }
+
+    if (padded == 0) {
+      l.labels = (volatile unsigned short*) (((char*) l.labels) - 2);
+    }
+
+  } else {
+    ret = -1;
+  }
+
+  free( (void*) l.packed );
+  free( l.padded );
+  free( (void*) l.labels );
+
+  return( ret );
+
+} // bench_run
+
+
+
+/*!
+ \brief Runs the benchmark
+ \param argc (in) number of arguments
+ \param argv (in) participants, data items, loops
+ \returns 0 = no error, 1 = error
+ */
+int main( int argc, char** argv ){
+
+  int parts = (argc > 1) ? atoi( argv[1] ) : 4;
+  int n = (argc > 2) ? atoi( argv[2] ) : 4096;
+  int loops = (argc > 3) ? atoi( argv[3] ) : 5000;
+
+  if (parts < 1) {
+    parts = 1;
+  }
+
+  if (n < 1) {
+    n = 1;
+  }
+
+  printf( "loop,layout,participants,ms,cache_misses,l1d_read_misses\n" );
+
+  for (int padded = 0; padded < 2; padded++) {
+
+    if ((bench_run( "counters", padded, parts, n, loops ) != 0) ||
+        (bench_run( "labels", padded, parts, n, loops ) != 0)) {
+      fprintf( stderr, "benchmark could not be started\n" );
+      return( 1 );
+    }
+  }
+
+  return( 0 );
+
+} // main
@@ -0,0 +1,317 @@
+/*!
+ \file rwlock_bench.c
+ \brief Contention benchmark for the reader/writer lock
+ \details
+ Compares the reader/writer lock of rwlock_wp.c (atomic reader fast path) with the previous
+ implementation that takes the mutex twice per read (included below as *rwlockmx*).
+ A number of threads acquire and release the reader lock in a loop and read a shared flag in
+ between, like the cancellation tests of the engines did. Optionally a writer thread acquires
+ the writer lock periodically.
+ Build and run on the host (or with the NDK toolchain for a device):
+ <pre>
+ gcc -O2 -std=gnu99 -Iinclude bench/rwlock_bench.c source/rwlock_wp.c -lpthread -o rwlock_bench
+ ./rwlock_bench [reads per thread] [max. threads] [writer period in us, 0 = no writer]
+ </pre>
+ The result is printed as CSV: lock, threads, writer period, ns per read (wall time divided by
+ the reads of one thread) and number of writes.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "rwlock_wp.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+
+                              //! The previous reader/writer lock (mutex on every access)
+struct rwlockmx {
+                              //! A mutex for the reader/writer lock
+  pthread_mutex_t g;
+                              //! A condition variable for the reader/writer lock
+  pthread_cond_t c;
+                              //! Number of writers waiting
+  int num_writers_waiting;
+                              //! Number of readers active
+  int num_reader_active;
+                              //! Number of writers active
+  int writer_active;
+};
+
+                              //! Parameters of a benchmark run
+struct bench_run {
+                              //! 0 = rwlockmx, 1 = rwlockwp
+  int kind;
+                              //! reads per reader thread
+  long reads;
+                              //! writer period (us), 0 = no writer
+  int period;
+                              //! the previous lock
+  struct rwlockmx mx;
+                              //! the lock with the atomic reader fast path
+  struct rwlockwp wp;
+                              //! the flag protected by the lock
+  volatile int flag;
+                              //! 1 = readers finished, stop the writer
+  volatile int done;
+                              //! number of writes made
+  long writes;
+};
+
+
+
+/*!
+ \brief Acquires the reader lock of the previous implementation
+ \param rwl (in) the lock
+ */
+void rwlockmx_reader_acquire( struct rwlockmx* rwl ){
+
+  pthread_mutex_lock( &rwl->g );
+
+  while ((rwl->num_writers_waiting > 0) || (rwl->writer_active > 0)) {
+    pthread_cond_wait( &rwl->c, &rwl->g );
+  }
+
+  rwl->num_reader_active++;
+
+  pthread_mutex_unlock( &rwl->g );
+
+} // rwlockmx_reader_acquire
+
+
+
+/*!
+ \brief Releases the reader lock of the previous implementation
+ \param rwl (in) the lock
+ */
+void rwlockmx_reader_release( struct rwlockmx* rwl ){
+
+  pthread_mutex_lock( &rwl->g );
+
+  rwl->num_reader_active--;
+
+  if (rwl->num_reader_active == 0) {
+    pthread_cond_broadcast( &rwl->c );
+  }
+
+  pthread_mutex_unlock( &rwl->g );
+
+} // rwlockmx_reader_release
+
+
+
+/*!
+ \brief Acquires the writer lock of the previous implementation
+ \param rwl (in) the lock
+ */
+void rwlockmx_writer_acquire( struct rwlockmx* rwl ){
+
+  pthread_mutex_lock( &rwl->g );
+  rwl->num_writers_waiting++;
+
+  while ((rwl->num_reader_active > 0) || (rwl->writer_active > 0)) {
+    pthread_cond_wait( &rwl->c, &rwl->g );
+  }
+
+  rwl->num_writers_waiting--;
+  rwl->writer_active = 1;
+
+  pthread_mutex_unlock( &rwl->g );
+
+} // rwlockmx_writer_acquire
+
+
+
+/*!
+ \brief Releases the writer lock of the previous implementation
+ \param rwl (in) the lock
+ */
+void rwlockmx_writer_release( struct rwlockmx* rwl ){
+
+  pthread_mutex_lock( &rwl->g );
+
+  rwl->writer_active = 0;
+
+  pthread_cond_broadcast( &rwl->c );
+
+  pthread_mutex_unlock( &rwl->g );
+
+} // rwlockmx_writer_release
+
+
+
+/*!
+ \brief Returns the monotonic time
+ \returns time in ns
+ */
+long long bench_now( void ){
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return( (long long) t.tv_sec * 1000000000LL + t.tv_nsec );
+
+} // bench_now
+
+
+
+/*!
+ \brief Reader thread
+ \param arg (in+out) the benchmark run
+ \returns number of times the flag was found set (keeps the read alive)
+ */
+void* bench_reader( void* arg ){
+
+  struct bench_run* r = (struct bench_run*) arg;
+  long seen = 0;
+
+  for (long i1 = 0; i1 < r->reads; i1++) {
+
+    if (r->kind == 0) {
+      rwlockmx_reader_acquire( &r->mx );
+      seen += r->flag;
+      rwlockmx_reader_release( &r->mx );
+    } else {
+      rwlockwp_reader_acquire( &r->wp );
+      seen += r->flag;
+      rwlockwp_reader_release( &r->wp );
+    }
+  }
+
+  return( (void*) seen );
+
+} // bench_reader
+
+
+
+/*!
+ \brief Writer thread
+ \param arg (in+out) the benchmark run
+ \returns NULL
+ */
+void* bench_writer( void* arg ){
+
+  struct bench_run* r = (struct bench_run*) arg;
+
+  while (r->done == 0) {
+
+    usleep( r->period );
+
+    if (r->kind == 0) {
+      rwlockmx_writer_acquire( &r->mx );
+      r->flag ^= 1;
+      rwlockmx_writer_release( &r->mx );
+    } else {
+      rwlockwp_writer_acquire( &r->wp );
+      r->flag ^= 1;
+      rwlockwp_writer_release( &r->wp );
+    }
+
+    r->writes++;
+  }
+
+  return( NULL );
+
+} // bench_writer
+
+
+
+/*!
+ \brief Runs the benchmark for one lock and one number of threads
+ \param kind (in) 0 = rwlockmx, 1 = rwlockwp
+ \param threads (in) number of reader threads
+ \param reads (in) reads per reader thread
+ \param period (in) writer period (us), 0 = no writer
+ \returns 0 = no error, -1 = threads could not be created
+ */
+int bench_lock( int kind, int threads, long reads, int period ){
+
+  struct bench_run r = { kind, reads, period,
+                         { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0 },
+                         RWLOCK_STATIC_INITIALIZER, 0, 0, 0 };
+
+  pthread_t* th = (pthread_t*) malloc( sizeof(pthread_t) * threads );
+  pthread_t wr;
+
+  if (th == NULL) {
+    return( -1 );
+  }
+
+  int ret = 0;
+  int started = 0;
+
+  if ((period > 0) && (pthread_create( &wr, NULL, &bench_writer, &r ) != 0)) {
+    period = 0;
+    ret = -1;
+  }
+
+  const long long t0 = bench_now();
+
+  for (; (ret == 0) && (started < threads); started++) {
+    if (pthread_create( &th[started], NULL, &bench_reader, &r ) != 0) {
+      ret = -1;
+      break;
+    }
+  }
+
+  for (int i1 = 0; i1 < started; i1++) {
+    pthread_join( th[i1], NULL );
+  }
+
+  const long long t1 = bench_now();
+
+  r.done = 1;
+
+  if (period > 0) {
+    pthread_join( wr, NULL );
+  }
+
+  if (ret == 0) {
+    printf( "%s,%d,%d,%.2f,%ld\n", (kind == 0) ? "mutex" : "atomic", threads, r.period,
+            (double) (t1 - t0) / (double) reads, r.writes );
+  }
+
+  free( th );
+
+  return( ret );
+
+} // bench_lock
+
+
+
+/*!
+ \brief Runs the benchmark
+ \param argc (in) number of arguments
+ \param argv (in) reads per thread, maximum number of threads, writer period (us)
+ \returns 0 = no error, 1 = threads could not be created
+ */
+int main( int argc, char** argv ){
+
+  long reads = (argc > 1) ? atol( argv[1] ) : 1000000;
+  int maxthreads = (argc > 2) ? atoi( argv[2] ) : 8;
+  int period = (argc > 3) ? atoi( argv[3] ) : 0;
+
+  if (reads < 1) {
+    reads = 1;
+  }
+
+  printf( "lock,threads,writer_us,ns_per_read,writes\n" );
+
+  for (int threads = 1; threads <= maxthreads; threads *= 2) {
+    for (int kind = 0; kind < 2; kind++) {
+      if (bench_lock( kind, threads, reads, period ) != 0) {
+        fprintf( stderr, "threads could not be created\n" );
+        return( 1 );
+      }
+    }
+  }
+
+  return( 0 );
+
+} // main
@@ -0,0 +1,747 @@
+/*!
+ \file agpudm.h
+ \brief Public C interface of the clustering engines
+ \details
+ The k-means and DBSCAN engines (single threaded CPU, multithreaded CPU and GPU) can be called
+ from any C or C++ program through this header; it does not need the JVM or jni.h. The Java
+ classes of the app use the same functions through a thin JNI layer.
+ <ul>
+ <li>A context (struct agpudm, opaque) holds the configuration of the calls: the engine, the
+ cores and the placement of the workers, the storage of the data items on the GPU and a
+ deadline. Contexts are independent of each other and can be used by several threads at the
+ same time.</li>
+ <li>The synchronous calls (agpudm_kmeans, agpudm_dbscan) work in place: the engines read the
+ data items from and write the cluster numbers into the arrays of the caller, on the GPU the
+ arrays back the device buffers (CL_MEM_USE_HOST_PTR). Nothing is copied.</li>
+ <li>The asynchronous calls (agpudm_kmeans_submit, agpudm_dbscan_submit) copy the data items
+ once and queue the search on the job scheduler; the result is fetched with the handle of the
+ job. agpudm_kmeans_adopt and agpudm_dbscan_adopt take over a buffer of the caller instead of
+ copying it.</li>
+ <li>Every call can be cancelled with a job handle (agpudm_job_create, agpudm_job_cancel).</li>
+ <li>The synchronous calls count the work of the engine on request (struct agpudm_stats):
+ iterations and displacement of the cluster centers (k-means), passes of the cluster expansion
+ and the kind of the points (DBSCAN) and the distance evaluations of both.</li>
+ <li>agpudm_generate creates Gaussian clusters as test data in parallel.</li>
+ <li>Datasets can be stored in a binary file (agpudm_dataset_write) and mapped into memory
+ (agpudm_dataset_open). The mapping is passed to the calls like any array, so files larger than
+ the heap of the app are clustered without copies; the GPU uses the mapped pages as host memory
+ of its buffers.</li>
+ <li>agpudm_kmeans_stream clusters data items that do not fit into the memory: it reads them
+ chunk by chunk from a reader (e.g. a mapped dataset file) with read-ahead.</li>
+ <li>agpudm_kmeans_minibatch approximates k-means with random batches of data items instead of
+ passes over all of them (large data sets).</li>
+ <li>agpudm_kmeans_warm starts from the cluster centers of an earlier search and returns the
+ final centers and the inertia (data that changes a little between the searches).</li>
+ <li>A process wide tracer (agpudm_trace_start) records the timeline of the engines as Chrome
+ trace_event JSON.</li>
+ </ul>
+ All functions return AGPUDM_OK or a negative error code (AGPUDM_E...). The code of the engine
+ (see the JNI methods of kmeans_c.h and dbscan_c.h) is returned in struct agpudm_result; both
+ algorithms report a cancelled job or a passed deadline with -30.
+ Link with the library agpudm (and threadpool, oclbuffer, oclstore, ocltune, OpenCL).
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_AGPUDM_H
+#define OPENCLAPP_AGPUDM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+                              //! version of the interface
+#define AGPUDM_VERSION 1
+
+                              //! no error
+#define AGPUDM_OK 0
+                              //! error: invalid argument
+#define AGPUDM_EINVAL -1
+                              //! error: out of memory
+#define AGPUDM_ENOMEM -2
+                              //! error: the call has been cancelled or its deadline has passed
+#define AGPUDM_ECANCELLED -3
+                              //! error: unknown job handle
+#define AGPUDM_ENOJOB -4
+                              //! error: the workers, the job or the scheduler could not be started
+#define AGPUDM_ENOSTART -5
+                              //! error: no OpenCL device or an OpenCL call failed
+#define AGPUDM_EOPENCL -6
+                              //! error: the job has not finished yet
+#define AGPUDM_EPENDING -7
+                              //! error: other error of the engine (see agpudm_result.code)
+#define AGPUDM_EENGINE -8
+                              //! error: a file could not be read or written (or has a wrong format)
+#define AGPUDM_EIO -9
+
+                              //! engine: GPU, multithreaded CPU if the GPU can not be used
+#define AGPUDM_ENGINE_AUTO 0
+                              //! engine: single threaded CPU
+#define AGPUDM_ENGINE_SINGLE 1
+                              //! engine: multithreaded CPU (workers of the thread pool)
+#define AGPUDM_ENGINE_PTHREADS 2
+                              //! engine: GPU (first device of the first OpenCL platform)
+#define AGPUDM_ENGINE_GPU 3
+
+                              //! placement of the workers: default
+#define AGPUDM_POLICY_DEFAULT 0
+                              //! placement of the workers: pinned to single CPUs, fastest first
+#define AGPUDM_POLICY_PIN 1
+                              //! placement of the workers: chunks weighted by CPU speed
+#define AGPUDM_POLICY_WEIGHT 2
+                              //! placement of the workers: pinned and weighted
+#define AGPUDM_POLICY_HETERO 3
+
+                              //! storage of the data items on the GPU: single precision
+#define AGPUDM_STORE_FP32 0
+                              //! storage of the data items on the GPU: half precision
+#define AGPUDM_STORE_FP16 1
+                              //! storage of the data items on the GPU: 8 bit quantized per feature
+#define AGPUDM_STORE_INT8 2
+
+                              //! algorithm: k-means
+#define AGPUDM_KMEANS 1
+                              //! algorithm: DBSCAN
+#define AGPUDM_DBSCAN 2
+
+                              //! state of a submitted job: queued
+#define AGPUDM_QUEUED 0
+                              //! state of a submitted job: running
+#define AGPUDM_RUNNING 1
+                              //! state of a submitted job: finished
+#define AGPUDM_DONE 2
+
+                              //! type of the features of a dataset file: float (IEEE 754, 32 bit)
+#define AGPUDM_DTYPE_FP32 0
+                              //! layout of a dataset file: data item after data item
+#define AGPUDM_LAYOUT_ROWS 0
+
+                              //! streaming search: default data items per chunk
+#define AGPUDM_STREAM_CHUNK 65536
+                              //! streaming search: default number of chunks read ahead
+#define AGPUDM_STREAM_PREFETCH 2
+
+                              //! mini-batch k-means: default data items per batch
+#define AGPUDM_MINIBATCH_BATCH 1024
+                              //! mini-batch k-means: default maximum number of batches
+#define AGPUDM_MINIBATCH_BATCHES 1000
+                              //! mini-batch k-means: default batches without improvement
+#define AGPUDM_MINIBATCH_PLATEAU 10
+
+
+                              //! A context (opaque)
+struct agpudm;
+
+                              //! Configuration of a context
+struct agpudm_config {
+                              //! AGPUDM_ENGINE_AUTO, _SINGLE, _PTHREADS or _GPU
+  int engine;
+                              //! cores of the multithreaded engine, <= 0 = all (submit: scheduler)
+  int cores;
+                              //! placement of the workers (AGPUDM_POLICY_...)
+  int policy;
+                              //! storage of the data items on the GPU (AGPUDM_STORE_...)
+  int storage;
+                              //! deadline of every call (ms), <= 0 = none
+  long long timeoutms;
+};
+
+                              //! Parameters of a k-means search
+struct agpudm_kmeans_params {
+                              //! number of clusters (1 .. 65535)
+  int clusters;
+                              //! maximum displacement of the cluster centers (stop criterion)
+  float eps;
+                              //! seed of the initial cluster centers, 0 = taken from the clock
+  unsigned int seed;
+};
+
+                              //! Parameters of a mini-batch k-means search
+struct agpudm_minibatch_params {
+                              //! data items per batch, <= 0 = AGPUDM_MINIBATCH_BATCH
+  int batch;
+                              //! maximum number of batches, <= 0 = AGPUDM_MINIBATCH_BATCHES
+  int batches;
+                              //! stop after this many batches without a new minimum of the
+                              //! smoothed inertia, <= 0 = AGPUDM_MINIBATCH_PLATEAU
+  int plateau;
+};
+
+                              //! Parameters of a DBSCAN search
+struct agpudm_dbscan_params {
+                              //! search radius
+  float eps;
+                              //! number of neighbours of a core point
+  int neighbours;
+};
+
+                              //! Convergence and work counters of a search
+struct agpudm_stats {
+                              //! (out) k-means: iterations executed
+  int iterations;
+                              //! (out) DBSCAN: passes of the cluster expansion
+  int passes;
+                              //! (out) distance evaluations (k-means: data item to cluster center,
+                              //! DBSCAN: data item to data item)
+  long long distances;
+                              //! (out) k-means: data items that changed their cluster (the first
+                              //! iteration counts all data items)
+  long long reassignments;
+                              //! (out) number of clusters (k-means: non-empty clusters)
+  int clusters;
+                              //! (out) DBSCAN: core, border and noise points
+  int core, border, noise;
+                              //! (in) k-means: displacement of the cluster centers per iteration,
+                              //! NULL = not needed
+  float* displacement;
+                              //! (in) k-means: reassignments per iteration, NULL = not needed
+  int* moved;
+                              //! (in) number of values that fit into *displacement* and *moved*
+  int ilen;
+};
+
+                              //! Result of a call
+struct agpudm_result {
+                              //! (out) AGPUDM_OK or the error of the engine
+  int status;
+                              //! (out) result code of the engine (DBSCAN: >= 0 number of clusters,
+                              //! -30 = cancelled or deadline passed)
+  int code;
+                              //! (out) engine that has run (AGPUDM_ENGINE_SINGLE, _PTHREADS or _GPU)
+  int engine;
+                              //! (out) cores used (multithreaded engine), 1 otherwise
+  int cores;
+                              //! (out) exclusive runtime of the engine (ns)
+  long long elapsed;
+                              //! (out) time in the queue and running (ns, submitted jobs only)
+  long long queued, running;
+                              //! (in) four values per worker of the multithreaded engine: busy time
+                              //! (ns), data items, chunks, steals; NULL = not needed
+  long long* workers;
+                              //! (in) number of values that fit into *workers*
+  int wlen;
+                              //! (in) counters of the engine that has run, NULL = not needed
+  struct agpudm_stats* stats;
+};
+
+                              //! A dataset file mapped into memory (see agpudm_dataset_open)
+struct agpudm_dataset {
+                              //! (out) the data items (n x features, read only)
+  const float* data;
+                              //! (out) number of data items
+  long long n;
+                              //! (out) features per data item
+  int features;
+                              //! (out) type of the features (AGPUDM_DTYPE_...)
+  int dtype;
+                              //! (out) layout of the data items (AGPUDM_LAYOUT_...)
+  int layout;
+                              //! (out) the mapping (whole file)
+  void* map;
+                              //! (out) length of the mapping (bytes)
+  long long maplen;
+};
+
+/*!
+ \brief Reads data items of a streaming search
+ \details
+ Called by the read-ahead thread of the search, one call at a time, with increasing chunks and
+ from the start again for every pass.
+ \param arg (in) argument of the reader (see agpudm_stream_params)
+ \param start (in) first data item
+ \param count (in) number of data items
+ \param buf (in) memory for *count* x *features* floats
+ \returns the data items: *buf* (filled) or memory of the reader that stays valid until the
+ search returns (e.g. a mapping); NULL = read error
+ */
+typedef const float* (*agpudm_readfn)( void* arg, long long start, int count, float* buf );
+
+/*!
+ \brief Receives the cluster numbers of a streaming search
+ \details
+ Called once per chunk, in order, after the search has converged.
+ \param arg (in) argument of the receiver (see agpudm_stream_params)
+ \param start (in) first data item
+ \param count (in) number of data items
+ \param labels (in) the cluster numbers (valid during the call)
+ \returns 0 = continue, other values = abort the search (AGPUDM_EIO)
+ */
+typedef int (*agpudm_labelfn)( void* arg, long long start, int count,
+                               const unsigned short* labels );
+
+                              //! Input and output of a streaming search
+struct agpudm_stream_params {
+                              //! data items per chunk, <= 0 = AGPUDM_STREAM_CHUNK
+  int chunk;
+                              //! chunks read ahead, <= 0 = AGPUDM_STREAM_PREFETCH
+  int prefetch;
+                              //! the reader (agpudm_dataset_reader for a mapped dataset file)
+  agpudm_readfn read;
+                              //! argument of the reader
+  void* readarg;
+                              //! receiver of the cluster numbers, NULL = not needed
+  agpudm_labelfn labels;
+                              //! argument of the receiver
+  void* labelarg;
+};
+
+/*!
+ \brief Completion function of a submitted job
+ \param job (in) handle of the job
+ \param code (in) result code of the engine (-30 = cancelled or deadline passed)
+ \param arg (in) argument given at the submission
+ */
+typedef void (*agpudm_donefn)( int job, short code, void* arg );
+
+
+/*!
+ \brief Initializes a configuration with the defaults
+ \details
+ AGPUDM_ENGINE_AUTO, all cores, AGPUDM_POLICY_DEFAULT, AGPUDM_STORE_FP32, no deadline.
+ \param cfg (out) the configuration
+ \mt fully threadsafe
+ */
+void agpudm_config_default( struct agpudm_config* cfg );
+
+/*!
+ \brief Creates a context
+ \param cfg (in) the configuration (copied), NULL = defaults
+ \param ctx (out) the context
+ \returns AGPUDM_OK, AGPUDM_EINVAL or AGPUDM_ENOMEM
+ \mt fully threadsafe
+ */
+int agpudm_create( const struct agpudm_config* cfg, struct agpudm** ctx );
+
+/*!
+ \brief Destroys a context
+ \details
+ Calls that use the context must have returned. Submitted jobs are not affected.
+ \param ctx (in) the context (NULL = nothing to do)
+ \mt not threadsafe (per context)
+ */
+void agpudm_destroy( struct agpudm* ctx );
+
+/*!
+ \brief Returns the configuration of a context
+ \param ctx (in) the context
+ \param cfg (out) the configuration
+ \mt fully threadsafe
+ */
+void agpudm_get_config( const struct agpudm* ctx, struct agpudm_config* cfg );
+
+/*!
+ \brief Returns a description of an error code
+ \param err (in) AGPUDM_OK or AGPUDM_E...
+ \returns the description (static string)
+ \mt fully threadsafe
+ */
+const char* agpudm_strerror( int err );
+
+/*!
+ \brief k-means search
+ \details
+ Works in place on *data* and *labels*. With AGPUDM_ENGINE_AUTO the GPU is tried first, the
+ multithreaded engine is used if the GPU can not be used or fails. If the call has been
+ cancelled, *labels* holds the assignment of the last cycle; after other errors the content of
+ *labels* is undefined.
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats)
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters
+ \param job (in) handle of a job (agpudm_job_create), 0 = none (a deadline of the context
+ applies)
+ \param labels (out) n cluster numbers
+ \param res (in+out) details of the call, NULL = not needed
+ \returns AGPUDM_OK or an error code
+ \mt fully threadsafe
+ */
+int agpudm_kmeans( struct agpudm* ctx, const float* data, int n, int features,
+                   const struct agpudm_kmeans_params* p, int job, unsigned short* labels,
+                   struct agpudm_result* res );
+
+/*!
+ \brief Mini-batch k-means search
+ \details
+ Approximates agpudm_kmeans in a fraction of the distance evaluations (Sculley, Web-scale k-means
+ clustering, 2010): every batch draws *mb->batch* random data items, assigns them to the closest
+ cluster center on the engine of the context (GPU: kernel testdistance, multithreaded: the
+ workers of the thread pool) and moves every center towards its data items with a learning rate
+ of 1 / (data items the center has seen). The initial centers are the same as for agpudm_kmeans.
+ The search stops after *mb->batches* batches, if the centers move less than *p->eps* in a batch
+ or if the inertia per data item (smoothed over the batches) has not reached a new minimum for
+ *mb->plateau* batches. Finally all data items are assigned to the centers.
+ The counters count a batch as an iteration; the distances include the final assignment, the
+ reassignments only the first batch. The GPU keeps one batch in single precision on the device
+ (the storage of the context does not apply).
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats)
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters (eps: displacement of the centers in a batch)
+ \param mb (in) batch size, number of batches and plateau
+ \param job (in) handle of a job (agpudm_job_create), 0 = none (a deadline of the context
+ applies)
+ \param labels (out) n cluster numbers
+ \param res (in+out) details of the call, NULL = not needed
+ \returns AGPUDM_OK or an error code (see agpudm_kmeans)
+ \mt fully threadsafe
+ */
+int agpudm_kmeans_minibatch( struct agpudm* ctx, const float* data, int n, int features,
+                             const struct agpudm_kmeans_params* p,
+                             const struct agpudm_minibatch_params* mb, int job,
+                             unsigned short* labels, struct agpudm_result* res );
+
+/*!
+ \brief k-means search with a warm start
+ \details
+ Like agpudm_kmeans, but the Lloyd iterations start from the cluster centers *init* (e.g. the
+ result of the last search on slightly changed data, which then converges in a few iterations)
+ and the final cluster centers and the inertia are returned. Empty clusters keep their center.
+ *centers* and *inertia* are only written if the call returns AGPUDM_OK.
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats)
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters (seed: only used without *init*)
+ \param init (in) initial cluster centers (p->clusters x features floats), NULL = selected like
+ agpudm_kmeans
+ \param job (in) handle of a job (agpudm_job_create), 0 = none (a deadline of the context
+ applies)
+ \param labels (out) n cluster numbers
+ \param centers (out) final cluster centers (p->clusters x features floats, may be *init*), NULL =
+ not needed
+ \param inertia (out) sum of the squared distances of the data items to their cluster center,
+ NULL = not needed
+ \param res (in+out) details of the call, NULL = not needed
+ \returns AGPUDM_OK or an error code (see agpudm_kmeans)
+ \mt fully threadsafe
+ */
+int agpudm_kmeans_warm( struct agpudm* ctx, const float* data, int n, int features,
+                        const struct agpudm_kmeans_params* p, const float* init, int job,
+                        unsigned short* labels, float* centers, double* inertia,
+                        struct agpudm_result* res );
+
+/*!
+ \brief DBSCAN search
+ \details
+ Works in place on *data* and *labels*. With AGPUDM_ENGINE_AUTO the GPU is tried first, the
+ multithreaded engine is used if the GPU can not be used or an OpenCL call fails (not if there
+ are too many clusters: AGPUDM_EENGINE). The number of clusters found is returned in
+ *res->code*; after an error the content of *labels* is undefined.
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats)
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters
+ \param job (in) handle of a job (agpudm_job_create), 0 = none (a deadline of the context
+ applies)
+ \param labels (out) n cluster numbers (0 = noise)
+ \param res (in+out) details of the call, NULL = not needed
+ \returns AGPUDM_OK or an error code
+ \mt fully threadsafe
+ */
+int agpudm_dbscan( struct agpudm* ctx, const float* data, int n, int features,
+                   const struct agpudm_dbscan_params* p, int job, unsigned short* labels,
+                   struct agpudm_result* res );
+
+/*!
+ \brief Submits a k-means search to the job scheduler
+ \details
+ The data items are copied, the call returns immediately. The engine, the cores, the storage
+ and the deadline are taken from the context. With AGPUDM_ENGINE_AUTO the job runs on the workers
+ if the scheduler has no GPU slot left, or again on the workers if OpenCL fails (as in
+ agpudm_kmeans).
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats)
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters
+ \param done (in) completion function (called once, by a thread of the scheduler), NULL = none
+ \param arg (in) argument of the completion function
+ \returns handle of the job (> 0) or an error code (the completion function is not called)
+ \mt fully threadsafe
+ */
+int agpudm_kmeans_submit( struct agpudm* ctx, const float* data, int n, int features,
+                          const struct agpudm_kmeans_params* p, agpudm_donefn done, void* arg );
+
+/*!
+ \brief Submits a k-means search to the job scheduler without copying the data items
+ \details
+ Like agpudm_kmeans_submit, but the scheduler takes over *data* (allocated with malloc) and frees
+ it when the job is done; on an error it is freed before the call returns.
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats, malloc), owned by the library afterwards
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters
+ \param done (in) completion function (called once, by a thread of the scheduler), NULL = none
+ \param arg (in) argument of the completion function
+ \returns handle of the job (> 0) or an error code (the completion function is not called)
+ \mt fully threadsafe
+ */
+int agpudm_kmeans_adopt( struct agpudm* ctx, float* data, int n, int features,
+                         const struct agpudm_kmeans_params* p, agpudm_donefn done, void* arg );
+
+/*!
+ \brief Submits a DBSCAN search to the job scheduler
+ \details
+ See agpudm_kmeans_submit.
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats)
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters
+ \param done (in) completion function (called once, by a thread of the scheduler), NULL = none
+ \param arg (in) argument of the completion function
+ \returns handle of the job (> 0) or an error code (the completion function is not called)
+ \mt fully threadsafe
+ */
+int agpudm_dbscan_submit( struct agpudm* ctx, const float* data, int n, int features,
+                          const struct agpudm_dbscan_params* p, agpudm_donefn done, void* arg );
+
+/*!
+ \brief Submits a DBSCAN search to the job scheduler without copying the data items
+ \details
+ Like agpudm_dbscan_submit, but the scheduler takes over *data* (allocated with malloc) and frees
+ it when the job is done; on an error it is freed before the call returns.
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats, malloc), owned by the library afterwards
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters
+ \param done (in) completion function (called once, by a thread of the scheduler), NULL = none
+ \param arg (in) argument of the completion function
+ \returns handle of the job (> 0) or an error code (the completion function is not called)
+ \mt fully threadsafe
+ */
+int agpudm_dbscan_adopt( struct agpudm* ctx, float* data, int n, int features,
+                         const struct agpudm_dbscan_params* p, agpudm_donefn done, void* arg );
+
+/*!
+ \brief Generates Gaussian clusters (test data)
+ \details
+ Same model as the test data of the app: every cluster gets a center (N(0,10) per feature) and
+ a spread (N(0,2.5) per feature), its data items are drawn around the center. The data items of
+ all clusters are shuffled. The workers of the thread pool write the data items directly into
+ *data*; the result depends only on the seed (not on the number of cores).
+ \param sizes (in) number of data items of the clusters
+ \param clusters (in) number of clusters
+ \param features (in) features per data item
+ \param seed (in) the seed
+ \param cores (in) number of cores, <= 0 = all online CPUs
+ \param data (out) the data items (sum of *sizes* x *features* floats)
+ \returns AGPUDM_OK, AGPUDM_EINVAL, AGPUDM_ENOMEM or AGPUDM_ENOSTART (no workers)
+ \mt fully threadsafe
+ */
+int agpudm_generate( const int* sizes, int clusters, int features, unsigned long long seed,
+                     int cores, float* data );
+
+/*!
+ \brief Writes data items into a dataset file
+ \details
+ The file starts with a header of 64 bytes (magic "AGPUDMDS", version, type and layout, number
+ of features and data items, offset of the data items, byte order mark; see dataset.c),
+ followed by the data items at the next multiple of the page size (4096). The values are stored
+ in the byte order of the machine.
+ \param file (in) the file (overwritten)
+ \param data (in) the data items (n x features floats)
+ \param n (in) number of data items
+ \param features (in) features per data item
+ \returns AGPUDM_OK, AGPUDM_EINVAL or AGPUDM_EIO
+ \mt fully threadsafe
+ */
+int agpudm_dataset_write( const char* file, const float* data, long long n, int features );
+
+/*!
+ \brief Maps a dataset file into memory (read only)
+ \details
+ Checks the header and maps the whole file; *ds->data* points to the data items in the mapping
+ (page aligned). Nothing is read before the pages are accessed. The calls of this interface need
+ AGPUDM_DTYPE_FP32 and AGPUDM_LAYOUT_ROWS (the only type and layout of version 1).
+ \param file (in) the file
+ \param ds (out) the mapped dataset
+ \returns AGPUDM_OK, AGPUDM_EINVAL (NULL argument) or AGPUDM_EIO (file could not be mapped,
+ wrong magic, version, type, layout or byte order, or truncated)
+ \mt fully threadsafe
+ */
+int agpudm_dataset_open( const char* file, struct agpudm_dataset* ds );
+
+/*!
+ \brief Unmaps a dataset file
+ \param ds (in+out) the dataset (cleared), nothing to do if it is not mapped
+ \mt not threadsafe (per dataset, no call may use the data items)
+ */
+void agpudm_dataset_close( struct agpudm_dataset* ds );
+
+/*!
+ \brief Reader of a mapped dataset file for streaming searches
+ \details
+ Returns the data items in the mapping (no copy). The pages are requested from the file and
+ touched by the read-ahead thread, so the workers do not wait for the disk.
+ \param arg (in) the dataset (const struct agpudm_dataset*)
+ \param start (in) first data item
+ \param count (in) number of data items
+ \param buf (in) not used
+ \returns the data items in the mapping, NULL = out of range
+ \mt fully threadsafe
+ */
+const float* agpudm_dataset_reader( void* arg, long long start, int count, float* buf );
+
+/*!
+ \brief Streaming k-means search (data items larger than the memory)
+ \details
+ Lloyd iterations over the data items chunk by chunk: a read-ahead thread reads up to
+ *s->prefetch* chunks ahead while the workers of the thread pool (engine AGPUDM_ENGINE_SINGLE: one
+ worker, all other engines: the cores of the context) calculate the distances of the current
+ chunk and add the data items to per-worker sums of their clusters. Only the cluster centers, the
+ sums and the chunks read ahead are kept in memory. After the last iteration the cluster numbers
+ are calculated in an additional pass and handed to *s->labels* (if set).
+ The initial cluster centers are the data items agpudm_kmeans would choose for the same seed
+ (n <= RAND_MAX); empty clusters keep their center. The counters do not include reassignments.
+ \param ctx (in) the context (engine, cores, deadline)
+ \param n (in) number of data items
+ \param features (in) features per data item
+ \param p (in) the parameters of the search
+ \param s (in) reader, receiver of the cluster numbers, chunk size and read ahead
+ \param job (in) handle of a job (cancellation), 0 = none
+ \param centers (out) the cluster centers (clusters x features floats), NULL = not needed
+ \param res (out) details of the call, NULL = not needed
+ \returns AGPUDM_OK, AGPUDM_EINVAL, AGPUDM_ENOMEM, AGPUDM_ECANCELLED, AGPUDM_ENOJOB,
+ AGPUDM_ENOSTART or AGPUDM_EIO (reader or receiver failed)
+ \mt fully threadsafe
+ */
+int agpudm_kmeans_stream( struct agpudm* ctx, long long n, int features,
+                          const struct agpudm_kmeans_params* p,
+                          const struct agpudm_stream_params* s, int job, float* centers,
+                          struct agpudm_result* res );
+
+/*!
+ \brief Creates a job handle for the cancellation of synchronous calls
+ \param timeoutms (in) time until the job expires (ms), <= 0 = no deadline
+ \returns handle of the job (> 0) or AGPUDM_ENOSTART (too many jobs)
+ \mt fully threadsafe
+ */
+int agpudm_job_create( long long timeoutms );
+
+/*!
+ \brief Cancels a job
+ \details
+ Works for handles of agpudm_job_create and of the submit functions. A queued job finishes
+ without running.
+ \param job (in) handle of the job
+ \returns AGPUDM_OK or AGPUDM_ENOJOB
+ \mt fully threadsafe
+ */
+int agpudm_job_cancel( int job );
+
+/*!
+ \brief Returns the state of a submitted job
+ \param job (in) handle of the job
+ \returns AGPUDM_QUEUED, AGPUDM_RUNNING, AGPUDM_DONE or AGPUDM_ENOJOB
+ \mt fully threadsafe
+ */
+int agpudm_job_poll( int job );
+
+/*!
+ \brief Waits until a submitted job has finished
+ \param job (in) handle of the job
+ \param timeoutms (in) maximum time to wait (ms), <= 0 = no limit
+ \returns AGPUDM_QUEUED or AGPUDM_RUNNING (time is up), AGPUDM_DONE or AGPUDM_ENOJOB
+ \mt fully threadsafe
+ */
+int agpudm_job_wait( int job, long long timeoutms );
+
+/*!
+ \brief Returns the result of a finished job
+ \details
+ The cluster numbers remain valid until the job is released.
+ \param job (in) handle of the job
+ \param labels (out) the cluster numbers
+ \param n (out) number of cluster numbers
+ \param res (in+out) details of the job (*status* = result of the search; *stats* is not
+ filled), NULL = not needed
+ \returns AGPUDM_OK (the job has finished), AGPUDM_EPENDING or AGPUDM_ENOJOB
+ \mt fully threadsafe
+ */
+int agpudm_job_result( int job, const unsigned short** labels, int* n,
+                       struct agpudm_result* res );
+
+/*!
+ \brief Releases a job
+ \details
+ The handle becomes invalid; a running job continues and is freed when it has finished.
+ \param job (in) handle of the job
+ \mt fully threadsafe
+ */
+void agpudm_job_release( int job );
+
+/*!
+ \brief Cancels all running and later calls of an algorithm
+ \param algorithm (in) AGPUDM_KMEANS or AGPUDM_DBSCAN
+ \mt fully threadsafe
+ */
+void agpudm_cancel_all( int algorithm );
+
+/*!
+ \brief Allows new calls of an algorithm after agpudm_cancel_all
+ \param algorithm (in) AGPUDM_KMEANS or AGPUDM_DBSCAN
+ \mt fully threadsafe
+ */
+void agpudm_resume_all( int algorithm );
+
+/*!
+ \brief Sets the limits of the job scheduler (process wide)
+ \param cores (in) number of cores, <= 0 = all online CPUs
+ \param memory (in) memory budget (bytes), <= 0 = a quarter of the physical memory
+ \param gpus (in) number of jobs that may use the GPU at the same time, 0 = no GPU, < 0 = one if
+ the first OpenCL platform has a GPU device (default)
+ \mt fully threadsafe
+ */
+void agpudm_limits( int cores, long long memory, int gpus );
+
+/*!
+ \brief Starts the timeline tracer (process wide)
+ \details
+ While the tracer is on, the engines record spans of the set up, of every iteration, of every
+ chunk of a worker and of the OpenCL calls (see trace.h). The spans are exported as Chrome
+ trace_event JSON (chrome://tracing, Perfetto).
+ \param capacity (in) number of spans that are kept, <= 0 = default
+ \returns AGPUDM_OK, AGPUDM_ENOMEM or AGPUDM_EINVAL (capacity too large)
+ \mt not threadsafe (no search may run)
+ */
+int agpudm_trace_start( int capacity );
+
+/*!
+ \brief Stops the timeline tracer
+ \details
+ The recorded spans are kept until the next agpudm_trace_start.
+ \mt fully threadsafe
+ */
+void agpudm_trace_stop( void );
+
+/*!
+ \brief Exports the recorded spans as Chrome trace_event JSON
+ \param buf (out) the JSON (NUL terminated), NULL = only the length is returned
+ \param len (in) size of *buf*
+ \returns length of the complete JSON (without the NUL), >= *len* = *buf* was too small
+ \mt fully threadsafe
+ */
+long agpudm_trace_json( char* buf, long len );
+
+/*!
+ \brief Writes the recorded spans as Chrome trace_event JSON into a file
+ \param file (in) the file (overwritten)
+ \returns AGPUDM_OK, AGPUDM_ENOMEM or AGPUDM_EIO
+ \mt fully threadsafe
+ */
+int agpudm_trace_write( const char* file );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
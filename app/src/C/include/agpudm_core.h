@@ -0,0 +1,103 @@
+/*!
+ \file agpudm_core.h
+ \brief Internal header file of the public C interface
+ \details
+ Defines the context of agpudm.h and the functions that the context (agpudm.c) and the engines
+ (kmeans_c.c, kmstream.c, dbscan_c.c) share. Not part of the public interface.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_AGPUDM_CORE_H
+#define OPENCLAPP_AGPUDM_CORE_H
+
+#include "agpudm.h"
+#include "jobctl.h"
+
+
+                              //! A context
+struct agpudm {
+                              //! the configuration (const)
+  struct agpudm_config cfg;
+};
+
+
+/*!
+ \brief Attaches a synchronous call to its job
+ \details
+ Without a job handle and with a deadline in the context an anonymous job with this deadline
+ is created.
+ \param ctx (in) the context
+ \param job (in) handle of the job, 0 = none
+ \param group (in) JOBCTL_KMEANS or JOBCTL_DBSCAN
+ \returns the job (see jobctl_attach), NULL = unknown handle or too many jobs
+ \mt fully threadsafe
+ */
+struct jobctl* agpudm_attach( const struct agpudm* ctx, int job, int group );
+
+/*!
+ \brief Returns the cores of the multithreaded engine
+ \param ctx (in) the context
+ \returns the cores of the configuration, all CPUs if not set
+ \mt fully threadsafe
+ */
+int agpudm_cores( const struct agpudm* ctx );
+
+/*!
+ \brief Sets the details of a call
+ \param res (out) the details (NULL = nothing to do)
+ \param status (in) AGPUDM_OK or an error code
+ \param code (in) result code of the engine
+ \param engine (in) engine that has run
+ \param cores (in) cores used
+ \param elapsed (in) exclusive runtime (ns)
+ \mt fully threadsafe
+ */
+void agpudm_setresult( struct agpudm_result* res, int status, int code, int engine, int cores,
+                       long long elapsed );
+
+/*!
+ \brief Clears the counters of a search
+ \details
+ The (in) fields (per-iteration arrays) are not changed.
+ \param st (out) the counters (NULL = nothing to do)
+ \mt fully threadsafe
+ */
+void agpudm_clearstats( struct agpudm_stats* st );
+
+/*!
+ \brief Returns a uniformly distributed random number (defined in kmeans_c.c)
+ \details
+ Used for the initial cluster centers, so that all k-means engines pick the same data items for
+ the same seed.
+ \param limit (in) the maximum random number desired
+ \param state (in+out) state of the generator (see rand_r)
+ \returns a random number of [0,limit]
+ \mt fully threadsafe
+ */
+int rand_lim( int limit, unsigned int* state );
+
+/*!
+ \brief Translates the result code of a k-means engine
+ \param engine (in) AGPUDM_ENGINE_SINGLE, _PTHREADS or _GPU
+ \param code (in) result code of the engine
+ \returns AGPUDM_OK or an error code
+ \mt fully threadsafe
+ */
+int kmeans_status( int engine, int code );
+
+/*!
+ \brief Translates the result code of a DBSCAN engine
+ \param engine (in) AGPUDM_ENGINE_SINGLE, _PTHREADS or _GPU
+ \param code (in) result code of the engine
+ \returns AGPUDM_OK or an error code (too many clusters = AGPUDM_EENGINE on every engine,
+ AGPUDM_EOPENCL only for errors of OpenCL)
+ \mt fully threadsafe
+ */
+int dbscan_status( int engine, int code );
+
+
+#endif
@@ -0,0 +1,62 @@
+/*!
+ \file barrier.h
+ \brief Header file for a spin-then-park barrier
+ \details
+ A reusable sense-reversing barrier for a fixed number of threads. The last thread that arrives
+ resets the counter and flips the sense, the other threads wait until the sense has changed.
+ The waiting threads poll the sense with an exponential backoff for a short time (about
+ BARRIER_SPIN polls) and then park on a futex. The last thread wakes the parked threads with a
+ single system call, and only if there are any. On a single CPU the threads park immediately.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_BARRIER_H
+#define OPENCLAPP_BARRIER_H
+
+                              //! number of polls of the sense before a thread parks
+#define BARRIER_SPIN 2048
+                              //! maximum number of pause instructions between two polls
+#define BARRIER_MAXBACKOFF 64
+
+
+                              //! A spin-then-park barrier
+struct barrier {
+                              //! number of threads (const)
+  int parties;
+                              //! number of polls before parking, 0 = park immediately (const)
+  int spin;
+                              //! number of threads arrived in the current phase (atomic access)
+  volatile int count;
+                              //! sense of the current phase, flipped by the last thread (futex word)
+  volatile int sense;
+                              //! number of threads parked on the futex (atomic access)
+  volatile int sleepers;
+};
+
+
+/*!
+ \brief Initializes a barrier
+ \param b (out) the barrier
+ \param parties (in) number of threads that have to arrive (>= 1)
+ \mt not threadsafe (per barrier)
+ */
+void barrier_init( struct barrier* b, int parties );
+
+/*!
+ \brief Waits until all threads have arrived
+ \details
+ Blocks until *parties* threads have called this function for the current phase. All memory
+ writes made by the threads before they arrived are visible to all threads afterwards. The
+ barrier can be used again immediately.
+ \param b (in+out) the barrier
+ \returns 1 = the calling thread was the last one to arrive, 0 = otherwise
+ \mt fully threadsafe
+ */
+int barrier_wait( struct barrier* b );
+
+
+#endif
@@ -0,0 +1,105 @@
+/*!
+ \file cputopo.h
+ \brief Header file for the CPU topology module
+ \details
+ Heterogeneous processors (big.LITTLE on ARM, performance and efficiency cores on x86) have cores
+ of different speed. This module determines the relative speed of every online CPU the process
+ may run on (affinity mask of the process) and allows to pin threads to single CPUs.
+ The speed of a CPU is taken (in this order of preference) from
+ <ul>
+ <li>a short calibration loop run by a thread pinned to the CPU (cputopo_calibrate)</li>
+ <li>/sys/devices/system/cpu/cpuN/cpu_capacity, scaled by the current frequency limit
+ (cpufreq/scaling_max_freq divided by cpufreq/cpuinfo_max_freq)</li>
+ <li>the frequency limit cpufreq/scaling_max_freq (or cpufreq/cpuinfo_max_freq)</li>
+ </ul>
+ and is normalized so that the fastest CPU has the speed 1. Once a CPU has been calibrated all
+ speeds are on the measured scale: CPUs that have not been calibrated yet are estimated from
+ their sysfs speed times the average ratio of the calibrated CPUs. If nothing can be read, all
+ CPUs have the same speed.
+ The thread pool uses this module if a policy other than CPUTOPO_NONE is passed together with
+ the number of cores.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_CPUTOPO_H
+#define OPENCLAPP_CPUTOPO_H
+
+                              //! maximum number of CPUs considered
+#define CPUTOPO_MAXCPUS 64
+
+                              //! policy: default placement, even split of the data items
+#define CPUTOPO_NONE 0
+                              //! policy flag: pin the workers to single CPUs (fastest first)
+#define CPUTOPO_PIN 1
+                              //! policy flag: weight the chunks of the workers by CPU speed
+#define CPUTOPO_WEIGHT 2
+
+
+/*!
+ \brief Reads the topology
+ \details
+ Reads the list of online CPUs in the affinity mask of the process and their capacities and
+ frequency limits. Called automatically by the other functions; the topology (and the mask) is
+ read only once.
+ \returns number of CPUs found (>= 1)
+ \mt fully threadsafe
+ */
+int cputopo_init( void );
+
+/*!
+ \brief Returns the number of CPUs
+ \returns number of online CPUs found in the affinity mask of the process (>= 1)
+ \mt fully threadsafe
+ */
+int cputopo_count( void );
+
+/*!
+ \brief Returns the CPU of a given rank
+ \details
+ The CPUs are ranked by their speed from sysfs (fastest first, ties by CPU number). The ranking
+ does not change after cputopo_init.
+ \param rank (in) rank (taken modulo the number of CPUs)
+ \returns CPU number
+ \mt fully threadsafe
+ */
+int cputopo_cpu( int rank );
+
+/*!
+ \brief Returns the relative speed of a CPU
+ \param cpu (in) CPU number (<0 = unknown, returns 1)
+ \returns speed (0..1], 1 = fastest CPU
+ \mt fully threadsafe
+ */
+float cputopo_speed( int cpu );
+
+/*!
+ \brief Pins the calling thread to a CPU
+ \param cpu (in) CPU number, <0 = allow all CPUs
+ \returns 0 = no error, -1 = affinity could not be set
+ \mt fully threadsafe
+ */
+int cputopo_pin( int cpu );
+
+/*!
+ \brief Measures the speed of a CPU
+ \details
+ Runs a short floating point loop (about one millisecond) and keeps the best result for the CPU.
+ The calling thread must be pinned to the CPU.
+ \param cpu (in) CPU number
+ \mt fully threadsafe
+ */
+void cputopo_calibrate( int cpu );
+
+/*!
+ \brief Returns the CPU the calling thread is running on
+ \returns CPU number or -1 if unknown
+ \mt fully threadsafe
+ */
+int cputopo_current( void );
+
+
+#endif
@@ -39,6 +39,26 @@ extern "C" {
 JNIEXPORT jshort JNICALL Java_com_example_dmocl_dbscan_dbscan_1c
   (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features);
 
+/*!
+ \details
+ Performs a DBSCAN cluster search on the input data with one thread on behalf of a job that can
+ be cancelled separately (see jobctl.h).
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers (0=noise point)
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features per data item contained in the data array
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \returns number of clusters found (can be zero if only noise points have been detected) or - if negative - an error code
+ (-30 = cancelled or deadline passed, -122 = unknown job)
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_dbscan_dbscan_1c_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint job);
+
 /*!
  \details
  Performs a DBSCAN cluster search on the GPU.
@@ -58,6 +78,55 @@ Java_com_example_dmocl_dbscan_dbscan_1c_1gpu
   (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
    jlongArray e);
 
+/*!
+ \details
+ Performs a DBSCAN cluster search on the GPU with the data items stored in reduced precision
+ on the device. Distances close to *eps* are rechecked with the original data items, therefore
+ the result is the same as with single precision storage.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers (0=noise point)
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features per data item contained in the data array
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of exactly one long value, contains the exclusive time needed (in ns)
+ \returns number of clusters found (can be zero if only noise points have been detected) or - if negative - an error code
+ (-30 = cancelled or deadline passed, -122 = unknown job)
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1gpu_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint storage, jint job, jlongArray e);
+
+/*!
+ \details
+ Like Java_com_example_dmocl_dbscan_dbscan_1c_1gpu_1ex, but on direct NIO buffers (native byte
+ order) without any copy: the device works on the memory of the buffers (CL_MEM_USE_HOST_PTR,
+ also on unified memory) and the cluster numbers are written into *b*. If an error occurs the
+ content of *b* is undefined.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) direct ShortBuffer of cluster numbers (capacity = number of data items, 0=noise point)
+ \param rf (in) direct FloatBuffer of data points
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features per data item contained in the data buffer
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of exactly one long value, contains the exclusive time needed (in ns)
+ \returns number of clusters found or - if negative - an error code (-30 = cancelled or deadline
+ passed, -104 = not a direct buffer, -122 = unknown job)
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1gpu_1direct
+  (JNIEnv *env, jclass jc, jobject b, jobject rf, jfloat eps, jint kk, jint features,
+   jint storage, jint job, jlongArray e);
+
 
 /*!
  \details
@@ -70,7 +139,9 @@ Java_com_example_dmocl_dbscan_dbscan_1c_1gpu
  \param kk (in) number of neighbours
  \param features (in) number of features per data item contained in the data array
  \param cores (in) number of cores that should be used
- \param e (out) Array of exactly one long value, contains the exclusive time needed (in ns)
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow: busy time (ns), data items, chunks and steals of
+ the work-stealing scheduler
  \returns number of clusters found (can be zero if only noise points have been detected) or - if negative - an error code
  \mt fully threadsafe
  */
@@ -79,12 +150,128 @@ Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads
   (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
    jint cores, jlongArray e);
 
+/*!
+ \details
+ Performs a DBSCAN cluster search on the input data with multiple threads and a placement
+ policy for heterogeneous processors.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers (0=noise point)
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features per data item contained in the data array
+ \param cores (in) number of cores that should be used
+ \param policy (in) placement of the workers: 0 = default, 1 = pin to single CPUs (fastest first),
+ 2 = chunks weighted by CPU speed, 3 = both (see cputopo.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow: busy time (ns), data items, chunks and steals of
+ the work-stealing scheduler
+ \returns number of clusters found (can be zero if only noise points have been detected) or - if negative - an error code
+ (-30 = cancelled or deadline passed, -122 = unknown job)
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint cores, jint policy, jint job, jlongArray e);
+
+/*!
+ \details
+ Like Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1ex, but on direct NIO buffers (native
+ byte order) without any copy: the workers read the data items from and write the cluster
+ numbers into the memory of the buffers. If an error occurs the content of *b* is undefined.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) direct ShortBuffer of cluster numbers (capacity = number of data items, 0=noise point)
+ \param rf (in) direct FloatBuffer of data points
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features per data item contained in the data buffer
+ \param cores (in) number of cores that should be used
+ \param policy (in) placement of the workers (see cputopo.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow (see Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1ex)
+ \returns number of clusters found or - if negative - an error code (-30 = cancelled or deadline
+ passed, -104 = not a direct buffer, -122 = unknown job)
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1direct
+  (JNIEnv *env, jclass jc, jobject b, jobject rf, jfloat eps, jint kk, jint features,
+   jint cores, jint policy, jint job, jlongArray e);
+
+
+/*!
+ \details
+ Performs a DBSCAN cluster search on any engine and returns the counters of the search, to
+ explain runtimes that differ with the same data shape (e.g. many passes of the expansion).
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers (0=noise point)
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features per data item contained in the data array
+ \param engine (in) 0 = GPU, multithreaded if the GPU can not be used, 1 = single threaded,
+ 2 = multithreaded, 3 = GPU
+ \param cores (in) number of cores of the multithreaded engine, 0 = all
+ \param policy (in) placement of the workers (see cputopo.h)
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow (see Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1ex)
+ \param s (out) Array of long values (as many as fit): passes of the cluster expansion, distance
+ evaluations, clusters, core points, border points, noise points
+ \returns number of clusters found (can be zero if only noise points have been detected) or - if negative - an error code
+ (-30 = cancelled or deadline passed, -122 = unknown job)
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1stats
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint engine, jint cores, jint policy, jint storage, jint job, jlongArray e, jlongArray s);
+
+/*!
+ \details
+ Submits a DBSCAN search to the job scheduler (see jobsched.h) and returns immediately. The data
+ items are copied once. The state of the job is queried with
+ Java_com_example_dmocl_oclwrap_pollJob or waited for with
+ Java_com_example_dmocl_oclwrap_waitJob, the cluster numbers are fetched with
+ Java_com_example_dmocl_oclwrap_fetchJob; the job must be released with
+ Java_com_example_dmocl_oclwrap_releaseJob.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features per data item contained in the data array
+ \param engine (in) 0 = chosen by the scheduler, 1 = single threaded, 2 = multithreaded, 3 = GPU
+ \param cores (in) number of cores for the multithreaded engine, 0 = chosen by the scheduler
+ \param policy (in) placement of the workers: 0 = default, 1 = pin to single CPUs (fastest first),
+ 2 = chunks weighted by CPU speed, 3 = both (see cputopo.h)
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param timeoutms (in) time until the job expires (ms), 0 = no deadline
+ \param cb (in) completion function (com.example.dmocl.jobcallback), called once when the job has
+ finished (see oclwrap_setcallback), NULL = none
+ \returns handle of the job (>0), -103 = data array does not hold whole data items, -104 = cb has
+ no method jobDone, -105 = malloc error, -40 = too many jobs, -43 = invalid engine
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1submit
+  (JNIEnv *env, jclass jc, jfloatArray rf, jfloat eps, jint kk, jint features, jint engine,
+   jint cores, jint policy, jint storage, jlong timeoutms, jobject cb);
+
 
 
 /*!
  \details
  Aborts and inhibits all new calls to the DBSCAN algorithms. This method acts on a
- 'global' scale and will effect all methods that use this library.
+ 'global' scale and will effect all methods that use this library. To stop a single search
+ cancel its job (see Java_com_example_dmocl_oclwrap_cancelJob).
  \param env JNI environment variable
  \param clazz JNI class variable
  \mt fully threadsafe
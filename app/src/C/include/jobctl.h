@@ -0,0 +1,146 @@
+/*!
+ \file jobctl.h
+ \brief Header file for the cancellation of single calculations
+ \details
+ Every calculation (k-means or DBSCAN search) runs on behalf of a job. A job is identified by a
+ handle that is created by jobctl_create before the calculation starts; another thread can use
+ the handle to cancel the job (jobctl_cancel) or to query its state (jobctl_status). A job may
+ have a deadline, it expires automatically when the deadline has passed.
+ The engines attach to a job when they start (jobctl_attach) and test it at bounded intervals
+ (jobctl_check): once per distance query of DBSCAN, once per cycle of k-means on the GPU and
+ every JOBCTL_STRIDE data items in the k-means loops on the CPU. The test is a read
+ of a volatile flag and, if the job has a deadline, a read of the monotonic clock; it takes no
+ lock.
+ Calculations that are started without a handle get an anonymous job that lives as long as the
+ calculation. All jobs of a library (a group) can still be cancelled together; a cancelled group
+ also cancels every calculation of the group that starts later, until the group is resumed.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_JOBCTL_H
+#define OPENCLAPP_JOBCTL_H
+
+                              //! maximum number of jobs that exist at the same time
+#define JOBCTL_MAXJOBS 256
+                              //! number of data items between two tests in the k-means loops (power of 2)
+#define JOBCTL_STRIDE 1024
+
+                              //! state: the job may continue
+#define JOBCTL_RUNNING 0
+                              //! state: the job has been cancelled
+#define JOBCTL_CANCELLED 1
+                              //! state: the deadline of the job has passed
+#define JOBCTL_EXPIRED 2
+
+                              //! group of the k-means calculations
+#define JOBCTL_KMEANS 1
+                              //! group of the DBSCAN calculations
+#define JOBCTL_DBSCAN 2
+
+
+                              //! A job
+struct jobctl {
+                              //! handle of the job, 0 = slot not used (table lock)
+  int handle;
+                              //! number of calculations attached (table lock)
+  int refs;
+                              //! 1 = free the slot when the last calculation detaches (table lock)
+  int autofree;
+                              //! groups of the calculations attached (table lock)
+  int groups;
+                              //! JOBCTL_RUNNING, JOBCTL_CANCELLED or JOBCTL_EXPIRED
+  volatile int state;
+                              //! deadline (CLOCK_MONOTONIC in ns), 0 = none
+  long long deadline;
+};
+
+
+/*!
+ \brief Creates a job
+ \param timeoutms (in) time until the job expires (ms), <=0 = no deadline
+ \returns handle of the job (>0), -1 = too many jobs
+ \mt fully threadsafe
+ */
+int jobctl_create( long long timeoutms );
+
+/*!
+ \brief Cancels a job
+ \details
+ All calculations attached to the job stop at their next test; calculations that attach later
+ stop immediately.
+ \param handle (in) handle of the job
+ \returns 0 = no error, -1 = unknown handle
+ \mt fully threadsafe
+ */
+int jobctl_cancel( int handle );
+
+/*!
+ \brief Returns the state of a job
+ \param handle (in) handle of the job
+ \returns JOBCTL_RUNNING, JOBCTL_CANCELLED, JOBCTL_EXPIRED or -1 = unknown handle
+ \mt fully threadsafe
+ */
+int jobctl_status( int handle );
+
+/*!
+ \brief Releases a job
+ \details
+ The handle becomes invalid. Calculations that are still attached continue, the job is freed
+ when the last of them detaches.
+ \param handle (in) handle of the job
+ \mt fully threadsafe
+ */
+void jobctl_release( int handle );
+
+/*!
+ \brief Attaches a calculation to a job
+ \details
+ Must be called once by every calculation before it starts. If the group has been cancelled
+ (jobctl_cancelgroup) the job is cancelled.
+ \param handle (in) handle of the job, 0 = create an anonymous job
+ \param group (in) group of the calculation (JOBCTL_KMEANS or JOBCTL_DBSCAN)
+ \returns the job, NULL = unknown handle or too many jobs
+ \mt fully threadsafe
+ */
+struct jobctl* jobctl_attach( int handle, int group );
+
+/*!
+ \brief Detaches a calculation from a job
+ \param job (in+out) the job returned by jobctl_attach
+ \mt fully threadsafe
+ */
+void jobctl_detach( struct jobctl* job );
+
+/*!
+ \brief Tests if a calculation has to stop
+ \param job (in+out) the job (NULL = never stops)
+ \returns JOBCTL_RUNNING (0) = continue, JOBCTL_CANCELLED or JOBCTL_EXPIRED = stop
+ \mt fully threadsafe
+ */
+int jobctl_check( struct jobctl* job );
+
+/*!
+ \brief Cancels all calculations of a group
+ \details
+ Cancels the jobs of all running calculations of the group. Calculations of the group that
+ start later are cancelled immediately until jobctl_resumegroup is called.
+ \param group (in) JOBCTL_KMEANS or JOBCTL_DBSCAN
+ \mt fully threadsafe
+ */
+void jobctl_cancelgroup( int group );
+
+/*!
+ \brief Allows new calculations of a group
+ \details
+ Reverts the effect of jobctl_cancelgroup for calculations that start later.
+ \param group (in) JOBCTL_KMEANS or JOBCTL_DBSCAN
+ \mt fully threadsafe
+ */
+void jobctl_resumegroup( int group );
+
+
+#endif
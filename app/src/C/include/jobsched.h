@@ -0,0 +1,236 @@
+/*!
+ \file jobsched.h
+ \brief Header file for the concurrent job scheduler of the native engines
+ \details
+ The scheduler accepts k-means and DBSCAN jobs (a descriptor with the data items and the
+ parameters), queues them and starts as many of them at the same time as the machine can take.
+ Every job gets a handle of the job control (see jobctl.h), it can be polled, cancelled and its
+ result can be fetched with the handle.
+ Admission control: the queue is served strictly in submission order; the first job of the
+ queue is started when
+ - the cores it needs are free: one core for the single threaded engine and the GPU engine, for
+   the multithreaded engine the cores requested or, if the scheduler decides, one core per
+   JOBSCHED_COREWORK distance calculations (at most all cores). Small jobs are therefore packed
+   side by side on the cores, large jobs get the whole machine;
+ - its memory estimate (data items, cluster numbers and, on the GPU, the device copies) fits into
+   the memory budget that is left;
+ - for the GPU engine: a GPU slot is free. A job that lets the scheduler choose the engine runs
+   on the GPU if a slot is free and on the workers of the thread pool otherwise. If its GPU
+   engine fails (JOBSCHED_EFALLBACK), it is put back at the head of the queue for the workers.
+ A job is always started if no other job is running, even if its estimates exceed the limits.
+ The thread pool is grown to the cores of all running multithreaded jobs when a job is started, so
+ that the jobs admitted side by side find enough workers for their participants.
+ Every running job has its own thread; the thread starts the next jobs of the queue when the job
+ has finished.
+ Completion: a job can be polled (jobsched_poll), waited for (jobsched_wait) or can notify its
+ submitter by a completion function. The completion function is called exactly once per job,
+ usually by the thread of the job; jobs that finish without running (cancelled or expired in the
+ queue) are reported by the thread that calls the scheduler next. The completion functions are
+ called one at a time, in the order the jobs finished (a thread that finds another one calling
+ them leaves its calls to that thread). They are never called with the lock of the scheduler
+ held, so they may call the functions of the scheduler.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_JOBSCHED_H
+#define OPENCLAPP_JOBSCHED_H
+
+#include "jobctl.h"
+
+                              //! engine: chosen by the scheduler (GPU if free, else multithreaded)
+#define JOBSCHED_AUTO 0
+                              //! engine: single threaded CPU
+#define JOBSCHED_SINGLE 1
+                              //! engine: multithreaded CPU (workers of the thread pool)
+#define JOBSCHED_PTHREADS 2
+                              //! engine: GPU (OpenCL)
+#define JOBSCHED_GPU 3
+
+                              //! state: the job waits in the queue
+#define JOBSCHED_QUEUED 0
+                              //! state: the job is running
+#define JOBSCHED_RUNNING 1
+                              //! state: the job has finished (or was cancelled in the queue)
+#define JOBSCHED_DONE 2
+
+                              //! error: the job could not be started (thread or job control)
+#define JOBSCHED_ENOSTART -40
+                              //! error: the job has not finished yet
+#define JOBSCHED_EPENDING -41
+                              //! error: unknown handle
+#define JOBSCHED_EUNKNOWN -42
+                              //! error: invalid descriptor
+#define JOBSCHED_EDESC -43
+                              //! result of a run function: the GPU engine of a JOBSCHED_AUTO job
+                              //! failed, the job is run again on the multithreaded engine
+#define JOBSCHED_EFALLBACK -44
+
+                              //! distance calculations (data items x centers x features) per core
+#define JOBSCHED_COREWORK (1LL << 22)
+                              //! number of values returned by jobsched_result
+#define JOBSCHED_NINFO 6
+
+
+struct jobsched_desc;
+
+/*!
+ \brief Runs a job (provided by the engine library)
+ \param desc (in) the descriptor of the job (desc->b receives the cluster numbers)
+ \param engine (in) JOBSCHED_SINGLE, JOBSCHED_PTHREADS or JOBSCHED_GPU
+ \param cores (in) number of cores granted (participants of the multithreaded engine)
+ \param job (in+out) the job, attached for the group of the descriptor
+ \param elapsed (out) exclusive runtime of the engine (ns)
+ \returns result of the engine, JOBSCHED_EFALLBACK = the GPU could not be used (only if
+ desc->engine is JOBSCHED_AUTO)
+ */
+typedef short (*jobsched_runfn)( const struct jobsched_desc* desc, int engine, int cores,
+                                 struct jobctl* job, long long* elapsed );
+
+/*!
+ \brief Completion function of a job (optional)
+ \param handle (in) handle of the job
+ \param result (in) result of the job (see jobsched_result)
+ \param arg (in) *donearg* of the descriptor
+ */
+typedef void (*jobsched_donefn)( int handle, short result, void* arg );
+
+                              //! A job descriptor
+struct jobsched_desc {
+                              //! JOBCTL_KMEANS or JOBCTL_DBSCAN
+  int group;
+                              //! JOBSCHED_AUTO, _SINGLE, _PTHREADS or _GPU
+  int engine;
+                              //! cores for the multithreaded engine, 0 = decided by the scheduler
+  int cores;
+                              //! placement of the workers (see cputopo.h)
+  int policy;
+                              //! storage of the data items on the GPU (see oclstore.h)
+  int storage;
+                              //! data items (malloc, owned by the scheduler after the submission)
+  float* data;
+                              //! number of data items
+  int blen;
+                              //! number of features per data item
+  int features;
+                              //! k-means: maximum center displacement, DBSCAN: search radius
+  float eps;
+                              //! k-means: number of clusters, DBSCAN: number of neighbours
+  int param;
+                              //! k-means: seed of the initial cluster centers (0 = clock)
+  unsigned int seed;
+                              //! time until the job expires (ms), <= 0 = no deadline
+  long long timeoutms;
+                              //! result if the job is cancelled or expires before it has started
+  short stopped;
+                              //! cluster numbers (threadpool_alloc, owned by the scheduler)
+  unsigned short* b;
+                              //! the engine
+  jobsched_runfn run;
+                              //! completion function, NULL = none
+  jobsched_donefn done;
+                              //! argument of the completion function
+  void* donearg;
+};
+
+
+/*!
+ \brief Submits a job
+ \details
+ On success the scheduler takes over *desc->data* and *desc->b* and frees them; the data items
+ are freed as soon as the job has finished, the cluster numbers when the job is released. On
+ failure the completion function is not called.
+ \param desc (in) the descriptor (copied)
+ \returns handle of the job (> 0), JOBSCHED_EDESC = invalid descriptor, JOBSCHED_ENOSTART = too
+ many jobs
+ \mt fully threadsafe
+ */
+int jobsched_submit( const struct jobsched_desc* desc );
+
+/*!
+ \brief Returns the state of a job
+ \param handle (in) handle of the job
+ \returns JOBSCHED_QUEUED, JOBSCHED_RUNNING, JOBSCHED_DONE or JOBSCHED_EUNKNOWN
+ \mt fully threadsafe
+ */
+int jobsched_poll( int handle );
+
+/*!
+ \brief Waits until a job has finished
+ \param handle (in) handle of the job
+ \param timeoutms (in) maximum time to wait (ms), <= 0 = no limit
+ \returns JOBSCHED_QUEUED or JOBSCHED_RUNNING (time is up), JOBSCHED_DONE or JOBSCHED_EUNKNOWN
+ \mt fully threadsafe
+ */
+int jobsched_wait( int handle, long long timeoutms );
+
+/*!
+ \brief Returns the result of a finished job
+ \details
+ The cluster numbers remain valid until the job is released.
+ \param handle (in) handle of the job
+ \param result (out) result of the engine (see the engine), JOBSCHED_ENOSTART = the job could not
+ be started
+ \param b (out) the cluster numbers
+ \param blen (out) number of cluster numbers
+ \param info (out) JOBSCHED_NINFO values: engine, cores, time in the queue (ns), time running
+ (ns), exclusive runtime of the engine (ns), group; NULL = not needed
+ \param ilen (in) number of values that fit into *info*
+ \returns 0 = no error, JOBSCHED_EPENDING = the job has not finished, JOBSCHED_EUNKNOWN = unknown
+ handle
+ \mt fully threadsafe
+ */
+int jobsched_result( int handle, short* result, const unsigned short** b, int* blen,
+                     long long* info, int ilen );
+
+/*!
+ \brief Cancels a job
+ \details
+ A queued job is removed from the queue and finishes with the result *desc->stopped*; a running
+ job is cancelled through the job control and stops at its next test. Handles that do not belong
+ to the scheduler are passed to jobctl_cancel.
+ \param handle (in) handle of the job
+ \returns 0 = no error, JOBSCHED_EUNKNOWN = unknown handle
+ \mt fully threadsafe
+ */
+int jobsched_cancel( int handle );
+
+/*!
+ \brief Releases a job
+ \details
+ The handle becomes invalid. A queued job is cancelled, a running job continues and is freed
+ when it has finished. Handles that do not belong to the scheduler are passed to
+ jobctl_release.
+ \param handle (in) handle of the job
+ \mt fully threadsafe
+ */
+void jobsched_release( int handle );
+
+/*!
+ \brief Sets the limits of the admission control
+ \details
+ Default: all online CPUs, a quarter of the physical memory and one GPU slot if the first OpenCL
+ platform has a GPU device (probed once when the next job is started, see jobsched_reprobe).
+ Running jobs are not affected.
+ \param cores (in) number of cores, <= 0 = number of online CPUs
+ \param memory (in) memory budget (bytes), <= 0 = a quarter of the physical memory
+ \param gpus (in) number of jobs that may use the GPU at the same time, 0 = no GPU, < 0 = one if
+ there is a GPU
+ \mt fully threadsafe
+ */
+void jobsched_limits( int cores, long long memory, int gpus );
+
+/*!
+ \brief Probes the GPU slots again
+ \details
+ Called after OpenCL has been loaded or unloaded. Has no effect if the GPU slots have been set
+ with jobsched_limits (gpus >= 0).
+ \mt fully threadsafe
+ */
+void jobsched_reprobe( void );
+
+
+#endif
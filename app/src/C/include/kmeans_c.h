@@ -39,6 +39,25 @@ extern "C" {
 JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c
   (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features);
 
+/*!
+ \details
+ Performs a Kmeans cluster search on the CPU (one thread) on behalf of a job that can be
+ cancelled separately (see jobctl.h).
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers (0=noise point)
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param kk (in) number of clusters to search for
+ \param features (in) number of features per data item contained in the data array
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \returns 0 = no error, -30 = cancelled or deadline passed, -31 = unknown job, <0 = error number
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint job);
+
 /*!
  \details
  Performs a Kmeans cluster search on the GPU.
@@ -57,6 +76,51 @@ JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1gpu
   (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
    jlongArray e);
 
+/*!
+ \details
+ Performs a Kmeans cluster search on the GPU with the data items stored in reduced precision
+ on the device (the distances are accumulated in single precision).
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers (0=noise point)
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item contained in the data array
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of exactly one long value, contains the exclusive time needed (in ns)
+ \returns 0 = no error, -30 = cancelled or deadline passed, -31 = unknown job, <0 = error number
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1gpu_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint storage, jint job, jlongArray e);
+
+/*!
+ \details
+ Like Java_com_example_dmocl_kmeans_kmeans_1c_1gpu_1ex, but on direct NIO buffers (native byte
+ order) without any copy: the device works on the memory of the buffers (CL_MEM_USE_HOST_PTR,
+ also on unified memory) and the cluster numbers are written into *b*. If an error occurs the
+ content of *b* is undefined.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) direct ShortBuffer of cluster numbers (capacity = number of data items)
+ \param rf (in) direct FloatBuffer of data points
+ \param eps (in) search radius
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item contained in the data buffer
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of exactly one long value, contains the exclusive time needed (in ns)
+ \returns 0 = no error, -5 = not a direct buffer, -30 = cancelled or deadline passed, -31 =
+ unknown job, <0 = error number
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1gpu_1direct
+  (JNIEnv *env, jclass jc, jobject b, jobject rf, jfloat eps, jint cluno, jint features,
+   jint storage, jint job, jlongArray e);
+
 /*!
  \details
  Performs a Kmeans cluster search on the CPU (multiple threads).
@@ -68,7 +132,9 @@ JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1gpu
  \param cluno (in) numbers of clusters that should be found
  \param features (in) number of features per data item contained in the data array
  \param cores (in) number of cores that should be used
- \param e (out) Array of exactly one long value, contains the exclusive time needed (in ns)
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow: busy time (ns), data items, chunks and steals of
+ the work-stealing scheduler
  \returns 0 = no error, <0 = error number
  \mt fully threadsafe
  */
@@ -76,6 +142,150 @@ JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads
   (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
    jint cores, jlongArray e );
 
+/*!
+ \details
+ Performs a Kmeans cluster search on the CPU (multiple threads) with a placement policy for
+ heterogeneous processors.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param cluno (in) numbers of clusters that should be found
+ \param features (in) number of features per data item contained in the data array
+ \param cores (in) number of cores that should be used
+ \param policy (in) placement of the workers: 0 = default, 1 = pin to single CPUs (fastest first),
+ 2 = chunks weighted by CPU speed, 3 = both (see cputopo.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow: busy time (ns), data items, chunks and steals of
+ the work-stealing scheduler
+ \returns 0 = no error, -30 = cancelled or deadline passed, -31 = unknown job, <0 = error number
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint cores, jint policy, jint job, jlongArray e );
+
+/*!
+ \details
+ Like Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1ex, but on direct NIO buffers (native
+ byte order) without any copy: the workers read the data items from and write the cluster
+ numbers into the memory of the buffers. If an error occurs the content of *b* is undefined.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) direct ShortBuffer of cluster numbers (capacity = number of data items)
+ \param rf (in) direct FloatBuffer of data points
+ \param eps (in) search radius
+ \param cluno (in) numbers of clusters that should be found
+ \param features (in) number of features per data item contained in the data buffer
+ \param cores (in) number of cores that should be used
+ \param policy (in) placement of the workers (see cputopo.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow (see Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1ex)
+ \returns 0 = no error, -5 = not a direct buffer, -30 = cancelled or deadline passed, -31 =
+ unknown job, <0 = error number
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1direct
+  (JNIEnv *env, jclass jc, jobject b, jobject rf, jfloat eps, jint cluno, jint features,
+   jint cores, jint policy, jint job, jlongArray e );
+
+/*!
+ \details
+ Performs a Kmeans cluster search on any engine and returns the counters of the iterations, to
+ explain runtimes that differ with the same data shape (e.g. many iterations or empty clusters).
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param cluno (in) numbers of clusters that should be found
+ \param features (in) number of features per data item contained in the data array
+ \param engine (in) 0 = GPU, multithreaded if the GPU can not be used, 1 = single threaded,
+ 2 = multithreaded, 3 = GPU
+ \param cores (in) number of cores of the multithreaded engine, 0 = all
+ \param policy (in) placement of the workers (see cputopo.h)
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow (see Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1ex)
+ \param s (out) Array of long values (as many as fit): iterations, distance evaluations,
+ reassignments (the first iteration counts all data items), non-empty clusters; then two values
+ per iteration: reassignments and the displacement of the cluster centers (bits of a float, see
+ Float.intBitsToFloat)
+ \returns 0 = no error, -30 = cancelled or deadline passed, -31 = unknown job, <0 = error number
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1stats
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint engine, jint cores, jint policy, jint storage, jint job, jlongArray e, jlongArray s);
+
+/*!
+ \details
+ Performs a Kmeans cluster search on any engine that starts from given cluster centers (warm
+ start, e.g. the centers of the last search on slightly changed data) and returns the final
+ cluster centers and the inertia (see agpudm_kmeans_warm). Empty clusters keep their center.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param b (out) Array of cluster numbers
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param cluno (in) numbers of clusters that should be found
+ \param features (in) number of features per data item contained in the data array
+ \param engine (in) 0 = GPU, multithreaded if the GPU can not be used, 1 = single threaded,
+ 2 = multithreaded, 3 = GPU
+ \param cores (in) number of cores of the multithreaded engine, 0 = all
+ \param policy (in) placement of the workers (see cputopo.h)
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param job (in) handle of the job (see Java_com_example_dmocl_oclwrap_createJob), 0 = none
+ \param init (in) Array of initial cluster centers (cluno x features), null = random data items
+ \param c (out) Array of final cluster centers (cluno x features, may be *init*), null = not
+ needed; only written if no error occurred
+ \param in (out) Array of at least one double: the inertia (sum of the squared distances of the
+ data items to their cluster center), null = not needed; only written if no error occurred
+ \param e (out) Array of long values, the first contains the exclusive time needed (in ns). If the
+ array is longer, four values per worker follow (see Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1ex)
+ \returns 0 = no error, -4 = lengths of the arrays do not match, -30 = cancelled or deadline
+ passed, -31 = unknown job, <0 = error number
+ \mt fully threadsafe
+ */
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1warm
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint engine, jint cores, jint policy, jint storage, jint job, jfloatArray init, jfloatArray c,
+   jdoubleArray in, jlongArray e);
+
+/*!
+ \details
+ Submits a Kmeans cluster search to the job scheduler (see jobsched.h) and returns immediately.
+ The data items are copied once. The state of the job is queried with
+ Java_com_example_dmocl_oclwrap_pollJob or waited for with
+ Java_com_example_dmocl_oclwrap_waitJob, the cluster numbers are fetched with
+ Java_com_example_dmocl_oclwrap_fetchJob; the job must be released with
+ Java_com_example_dmocl_oclwrap_releaseJob.
+ \param env JNI environment variable
+ \param jc JNI class variable
+ \param rf (in) Array of data points
+ \param eps (in) search radius
+ \param cluno (in) numbers of clusters that should be found
+ \param features (in) number of features per data item contained in the data array
+ \param engine (in) 0 = chosen by the scheduler, 1 = single threaded, 2 = multithreaded, 3 = GPU
+ \param cores (in) number of cores for the multithreaded engine, 0 = chosen by the scheduler
+ \param policy (in) placement of the workers: 0 = default, 1 = pin to single CPUs (fastest first),
+ 2 = chunks weighted by CPU speed, 3 = both (see cputopo.h)
+ \param storage (in) 0 = float, 1 = half, 2 = 8 bit quantized per feature (see oclstore.h)
+ \param timeoutms (in) time until the job expires (ms), 0 = no deadline
+ \param cb (in) completion function (com.example.dmocl.jobcallback), called once when the job has
+ finished (see oclwrap_setcallback), NULL = none
+ \returns handle of the job (>0), -4 = data array does not hold whole data items, -5 = cb has no
+ method jobDone, -6 = malloc error, -40 = too many jobs, -43 = invalid engine
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1submit
+  (JNIEnv *env, jclass jc, jfloatArray rf, jfloat eps, jint cluno, jint features, jint engine,
+   jint cores, jint policy, jint storage, jlong timeoutms, jobject cb);
+
 
 
 
@@ -84,7 +294,8 @@ JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads
  Signals all running Kmeans algorithms to abort immediately.
  Any new Kmeans cluster search will be aborted imediately.
  \warning This function acts on a 'global' scale: All callers that use this library will
- not be any more able to make calls to the library functions of this library.
+ not be any more able to make calls to the library functions of this library. To stop a single
+ search cancel its job (see Java_com_example_dmocl_oclwrap_cancelJob).
  \param env JNI environment variable
  \param clazz JNI class variable
  \mt fully threadsafe
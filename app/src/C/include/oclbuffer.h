@@ -0,0 +1,187 @@
+/*!
+ \file oclbuffer.h
+ \brief Header file for the OpenCL buffer strategy layer
+ \details
+ Defines a small wrapper around OpenCL buffer objects that hides how the host accesses the
+ buffer content. On devices that share their memory with the host
+ (CL_DEVICE_HOST_UNIFIED_MEMORY) the buffers are allocated by the driver
+ (CL_MEM_ALLOC_HOST_PTR) and accessed with clEnqueueMapBuffer/clEnqueueUnmapMemObject without
+ any copy. On all other devices the buffers are backed by a host array and the map/unmap calls
+ fall back to explicit read/write copies.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_OCLBUFFER_H
+#define OPENCLAPP_OCLBUFFER_H
+
+                             //! rescue definition of the OpenCL version
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+
+#include <CL/opencl.h>
+
+                              //! host access by explicit copies (clEnqueueRead/WriteBuffer)
+#define OCLBUF_COPY 0
+                              //! host access by mapping driver allocated memory (zero copy)
+#define OCLBUF_MAP 1
+                              //! flag for oclbuf_create: the host array backs the buffer (both strategies)
+#define OCLBUF_INPLACE 2
+
+
+                              //! A struct that holds an OpenCL buffer and its host access strategy
+struct oclbuf {
+                              //! the OpenCL buffer object
+  cl_mem mem;
+                              //! host array (OCLBUF_COPY only, NULL otherwise)
+  void* host;
+                              //! size of the buffer in bytes
+  size_t size;
+                              //! strategy used (OCLBUF_COPY or OCLBUF_MAP)
+  int mode;
+                              //! 1 = host array has been allocated by this layer
+  int ownhost;
+                              //! flags of the current mapping
+  cl_map_flags mapflags;
+                              //! pointer returned by the current mapping (NULL = not mapped)
+  void* mapped;
+};
+
+
+/*!
+ \brief Selects the buffer strategy for a device
+ \details
+ Returns OCLBUF_MAP if the device reports CL_DEVICE_HOST_UNIFIED_MEMORY, OCLBUF_COPY otherwise
+ (or if the device can not be queried).
+ \param dev (in) the OpenCL device
+ \returns OCLBUF_MAP or OCLBUF_COPY
+ \mt fully threadsafe
+ */
+int oclbuf_strategy( cl_device_id dev );
+
+/*!
+ \brief Creates a buffer
+ \details
+ Creates an OpenCL buffer with the given strategy. OCLBUF_MAP: the buffer is allocated
+ with CL_MEM_ALLOC_HOST_PTR, the content of *host* (if not NULL) is copied once into the buffer.
+ OCLBUF_COPY: the buffer is created with CL_MEM_USE_HOST_PTR if *host* is not NULL, otherwise a
+ host array of the same size is allocated that serves as the target of the explicit copies.
+ With the flag OCLBUF_INPLACE the buffer is created with CL_MEM_USE_HOST_PTR on *host* (if not
+ NULL) for both strategies; on unified memory the mappings then return *host* itself, the driver
+ copies only if it can not use the array (alignment). *host* must stay valid until the buffer
+ is released.
+ \param buf (out) the buffer struct to initialize
+ \param context (in) the OpenCL context
+ \param flags (in) access flags of the buffer (CL_MEM_READ_ONLY, CL_MEM_READ_WRITE, ...)
+ \param size (in) size of the buffer in bytes
+ \param host (in) host array with the initial content or NULL
+ \param mode (in) OCLBUF_MAP or OCLBUF_COPY, optionally | OCLBUF_INPLACE
+ \returns CL_SUCCESS or an OpenCL error code
+ \mt fully threadsafe
+ */
+cl_int oclbuf_create( struct oclbuf* buf, cl_context context, cl_mem_flags flags, size_t size,
+                      void* host, int mode );
+
+/*!
+ \brief Gives the host access to the buffer content
+ \details
+ Maps the buffer (OCLBUF_MAP) or reads the buffer into the host array (OCLBUF_COPY, only if
+ *flags* contains CL_MAP_READ). The call blocks until the content can be accessed. The pointer
+ returned is valid until oclbuf_unmap is called and may differ between two mappings.
+ \param commands (in) the OpenCL command queue
+ \param buf (in+out) the buffer
+ \param flags (in) CL_MAP_READ, CL_MAP_WRITE or CL_MAP_WRITE_INVALIDATE_REGION
+ \param err (out) CL_SUCCESS or an OpenCL error code
+ \returns pointer to the buffer content or NULL if an error occurred
+ \mt not threadsafe (per buffer)
+ */
+void* oclbuf_map( cl_command_queue commands, struct oclbuf* buf, cl_map_flags flags,
+                  cl_int* err );
+
+/*!
+ \brief Returns the buffer content to the device
+ \details
+ Unmaps the buffer (OCLBUF_MAP) or writes the host array back to the device (OCLBUF_COPY, only if
+ the buffer has been mapped for writing). Commands enqueued afterwards see the new content.
+ \param commands (in) the OpenCL command queue
+ \param buf (in+out) the buffer
+ \returns CL_SUCCESS or an OpenCL error code
+ \mt not threadsafe (per buffer)
+ */
+cl_int oclbuf_unmap( cl_command_queue commands, struct oclbuf* buf );
+
+/*!
+ \brief Enqueues host access to the buffer content
+ \details
+ Non-blocking variant of oclbuf_map. The access starts after all events of the wait list have
+ completed. If *blocking* is CL_FALSE the content may be accessed only after *event* has
+ completed.
+ \param commands (in) the OpenCL command queue
+ \param buf (in+out) the buffer
+ \param flags (in) CL_MAP_READ, CL_MAP_WRITE or CL_MAP_WRITE_INVALIDATE_REGION
+ \param blocking (in) CL_TRUE = wait until the content can be accessed
+ \param nwait (in) number of events in the wait list
+ \param wait (in) wait list (may be NULL if nwait is 0)
+ \param event (out) event that signals that the content can be accessed (may be NULL)
+ \param err (out) CL_SUCCESS or an OpenCL error code
+ \returns pointer to the buffer content or NULL if an error occurred
+ \mt not threadsafe (per buffer)
+ */
+void* oclbuf_enqueue_map( cl_command_queue commands, struct oclbuf* buf, cl_map_flags flags,
+                          cl_bool blocking, cl_uint nwait, const cl_event* wait, cl_event* event,
+                          cl_int* err );
+
+/*!
+ \brief Enqueues the return of the buffer content to the device
+ \details
+ Non-blocking variant of oclbuf_unmap. The host must not access the content any more. Commands
+ that use the buffer on the device have to wait for *event* on an out-of-order queue.
+ \param commands (in) the OpenCL command queue
+ \param buf (in+out) the buffer
+ \param nwait (in) number of events in the wait list
+ \param wait (in) wait list (may be NULL if nwait is 0)
+ \param event (out) event that signals that the device may use the buffer (may be NULL)
+ \returns CL_SUCCESS or an OpenCL error code
+ \mt not threadsafe (per buffer)
+ */
+cl_int oclbuf_enqueue_unmap( cl_command_queue commands, struct oclbuf* buf, cl_uint nwait,
+                             const cl_event* wait, cl_event* event );
+
+/*!
+ \brief Creates a command queue for the buffers
+ \details
+ Creates an out-of-order command queue if the device supports it, an in-order queue otherwise.
+ All commands on the queue therefore have to state their dependencies with events.
+ \param context (in) the OpenCL context
+ \param dev (in) the OpenCL device
+ \param err (out) CL_SUCCESS or an OpenCL error code
+ \returns the command queue or NULL if an error occurred
+ \mt fully threadsafe
+ */
+cl_command_queue oclbuf_create_queue( cl_context context, cl_device_id dev, cl_int* err );
+
+/*!
+ \brief Releases an event
+ \details
+ Releases the event (if not NULL) and sets it to NULL.
+ \param event (in+out) the event
+ \mt not threadsafe (per event)
+ */
+void oclbuf_release_event( cl_event* event );
+
+/*!
+ \brief Releases a buffer
+ \details
+ Releases the OpenCL buffer and the host array allocated by this layer. The buffer must not be
+ mapped.
+ \param buf (in+out) the buffer
+ \mt not threadsafe (per buffer)
+ */
+void oclbuf_release( struct oclbuf* buf );
+
+
+#endif
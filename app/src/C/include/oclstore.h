@@ -0,0 +1,174 @@
+/*!
+ \file oclstore.h
+ \brief Header file for the reduced precision storage of the data items on the GPU
+ \details
+ The GPU kernels stream the features of the data items from global memory. For data items with
+ few features the kernels are bandwidth bound, therefore the data items can be stored on the
+ device with reduced precision:
+ <ul>
+ <li>OCLSTORE_FP32: unchanged (4 bytes per feature)</li>
+ <li>OCLSTORE_FP16: IEEE half precision, read with vload_half (2 bytes per feature)</li>
+ <li>OCLSTORE_INT8: affine quantization per feature, x = q * scale + offset
+ (1 byte per feature)</li>
+ </ul>
+ The conversion is done once before the upload, the kernels accumulate in single precision.
+ The kernel source selects the access with the build options returned by oclstore_options
+ (macros DSTORE, DATA_T and LOADF). For every mode an upper bound of the euclidean error of a
+ data item is known, that allows exact rechecks of borderline distances.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_OCLSTORE_H
+#define OPENCLAPP_OCLSTORE_H
+
+                             //! rescue definition of the OpenCL version
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+
+#include <CL/opencl.h>
+#include "oclbuffer.h"
+
+                              //! single precision storage
+#define OCLSTORE_FP32 0
+                              //! half precision storage
+#define OCLSTORE_FP16 1
+                              //! 8 bit quantized storage
+#define OCLSTORE_INT8 2
+
+
+/*!
+ \brief Kernel source preamble
+ \details
+ Defines DATA_T (type of the data items on the device) and LOADF(i,f) (reads element *i* of
+ the kernel argument *data*, *f* is the feature number of this element) for the storage mode
+ DSTORE. The kernel must have the arguments *data* and *qparam*.
+ */
+#define OCLSTORE_PREAMBLE \
+"                                                                         \n" \
+"#ifndef DSTORE                                                           \n" \
+"#define DSTORE 0                                                         \n" \
+"#endif                                                                   \n" \
+"                                                                         \n" \
+"#if DSTORE == 1                                                          \n" \
+"#define DATA_T half                                                      \n" \
+"#define LOADF(i,f) vload_half( (i), data )                               \n" \
+"#elif DSTORE == 2                                                        \n" \
+"#define DATA_T char                                                      \n" \
+"#define LOADF(i,f) ((float) data[(i)] * qparam[2*(f)] + qparam[2*(f)+1]) \n" \
+"#else                                                                    \n" \
+"#define DATA_T float                                                     \n" \
+"#define LOADF(i,f) data[(i)]                                             \n" \
+"#endif                                                                   \n" \
+"                                                                         \n"
+
+
+                              //! A struct that holds the data items in device format
+struct oclstore {
+                              //! storage mode (OCLSTORE_FP32, OCLSTORE_FP16 or OCLSTORE_INT8)
+  int mode;
+                              //! original data items
+  const cl_float* src;
+                              //! converted data items (== src for OCLSTORE_FP32)
+  void* host;
+                              //! size of the converted data items in bytes
+  size_t size;
+                              //! size of the original data items in bytes
+  size_t srcsize;
+                              //! scale and offset per feature (OCLSTORE_INT8 only, else NULL)
+  cl_float* qparam;
+                              //! number of features
+  int features;
+                              //! upper bound of the euclidean error of a single data item
+  cl_float maxerr;
+                              //! device buffer with the converted data items
+  struct oclbuf data_g;
+                              //! device buffer with the original data items (if needed)
+  struct oclbuf exact_g;
+                              //! device buffer with *qparam* (OCLSTORE_INT8 only, else NULL)
+  cl_mem qparam_g;
+};
+
+
+/*!
+ \brief Converts the data items
+ \details
+ Converts the data items to the storage mode. If the data items can not be represented in half
+ precision (absolute value > 65504), OCLSTORE_FP32 is used instead.
+ \param st (out) the storage struct to initialize
+ \param data (in) the data items (must stay valid until oclstore_free)
+ \param blen (in) number of data items
+ \param features (in) number of features per data item
+ \param mode (in) requested storage mode
+ \returns CL_SUCCESS or CL_OUT_OF_HOST_MEMORY
+ \mt fully threadsafe
+ */
+cl_int oclstore_convert( struct oclstore* st, const cl_float* data, int blen, int features,
+                         int mode );
+
+/*!
+ \brief Returns the build options for the kernel source
+ \param st (in) the storage struct
+ \returns the build options (defines DSTORE)
+ \mt fully threadsafe
+ */
+const char* oclstore_options( const struct oclstore* st );
+
+/*!
+ \brief Creates the device buffers
+ \details
+ Creates the buffer with the converted data items, the buffer with the quantization parameters
+ and (if *exact* is 1 and the data items have been converted) a second buffer with the original
+ data items for exact rechecks.
+ \param st (in+out) the storage struct
+ \param context (in) the OpenCL context
+ \param bufmode (in) OCLBUF_MAP or OCLBUF_COPY, optionally | OCLBUF_INPLACE (see oclbuffer.h)
+ \param exact (in) 1 = original data items are needed on the device
+ \returns CL_SUCCESS or an OpenCL error code
+ \mt not threadsafe (per struct)
+ */
+cl_int oclstore_create( struct oclstore* st, cl_context context, int bufmode, int exact );
+
+/*!
+ \brief Returns the device buffer with the original data items
+ \param st (in) the storage struct
+ \returns the buffer (the converted buffer for OCLSTORE_FP32)
+ \mt fully threadsafe
+ */
+cl_mem oclstore_exact( const struct oclstore* st );
+
+/*!
+ \brief Returns the range of squared distances that have to be rechecked
+ \details
+ If the squared distance calculated with the converted data items is in (lo, hi], the exact
+ squared distance may be on either side of *eps* squared. Below or equal *lo* it is certainly
+ inside, above *hi* it is certainly outside. The bounds include a margin for the rounding
+ of the single precision sums.
+ \param st (in) the storage struct
+ \param eps (in) search radius
+ \param lo (out) lower bound (<0 if no distance is certainly inside)
+ \param hi (out) upper bound
+ \mt fully threadsafe
+ */
+void oclstore_bounds( const struct oclstore* st, cl_float eps, cl_float* lo, cl_float* hi );
+
+/*!
+ \brief Releases the device buffers
+ \param st (in+out) the storage struct
+ \mt not threadsafe (per struct)
+ */
+void oclstore_release( struct oclstore* st );
+
+/*!
+ \brief Releases the converted data items
+ \param st (in+out) the storage struct
+ \mt not threadsafe (per struct)
+ */
+void oclstore_free( struct oclstore* st );
+
+
+#endif
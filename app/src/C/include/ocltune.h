@@ -0,0 +1,99 @@
+/*!
+ \file ocltune.h
+ \brief Header file for the work-group size autotuner
+ \details
+ Selects the local work size and the padding of the global work size for a kernel on a given
+ device. The first call for a kernel/device pair benchmarks a small set of candidates, the
+ fastest configuration is kept in memory and appended to a per-device config file (if a
+ directory has been set with ocltune_setdir). Later runs read the config file and start
+ immediately with the best configuration.
+ All kernels used with the autotuner must ignore work-items with a global id beyond the real
+ problem size, since the global work size may be padded.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_OCLTUNE_H
+#define OPENCLAPP_OCLTUNE_H
+
+                             //! rescue definition of the OpenCL version
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+
+#include <CL/opencl.h>
+
+                              //! maximum number of kernel/device pairs kept in memory
+#define OCLTUNE_MAXENTRIES 32
+                              //! maximum length of a kernel name (including '\0')
+#define OCLTUNE_MAXKNAME 32
+                              //! maximum length of a device key (including '\0')
+#define OCLTUNE_MAXDEVKEY 192
+                              //! maximum length of the config directory (including '\0')
+#define OCLTUNE_MAXDIR 512
+                              //! number of timed runs per candidate
+#define OCLTUNE_REPS 3
+
+
+                              //! A struct that holds a launch configuration
+struct ocltune_cfg {
+                              //! local work size (0 = let the driver decide)
+  size_t local;
+                              //! the global work size is padded to a multiple of this value
+  size_t pad;
+};
+
+
+/*!
+ \brief Sets the directory of the config files
+ \details
+ The config files are named *ocltune_<device>.cfg*. If no directory has been set, the results
+ are kept in memory only.
+ \param dir (in) the directory (must exist and be writable), NULL = no config files
+ \returns 0 = no error, -1 = path too long
+ \mt fully threadsafe
+ */
+int ocltune_setdir( const char* dir );
+
+/*!
+ \brief Returns the launch configuration for a kernel
+ \details
+ Looks up the configuration for the kernel on the device (in memory, then in the config file).
+ If there is none yet, the candidates are benchmarked with the problem size *n*: the driver
+ default with and without padding to the preferred work-group size multiple and all powers of
+ two of this multiple up to the maximum work-group size of the kernel. All kernel arguments
+ must be set and running the kernel must not have side effects that matter to the caller.
+ On any error the driver default (no local size, no padding) is returned.
+ \param commands (in) the OpenCL command queue
+ \param dev (in) the OpenCL device
+ \param kernel (in) the OpenCL kernel (arguments set)
+ \param kname (in) the name of the kernel
+ \param n (in) the real problem size (number of work-items needed)
+ \param cfg (out) the launch configuration
+ \mt fully threadsafe (if the kernel is not used concurrently)
+ */
+void ocltune_get( cl_command_queue commands, cl_device_id dev, cl_kernel kernel,
+                  const char* kname, size_t n, struct ocltune_cfg* cfg );
+
+/*!
+ \brief Returns the padded global work size
+ \param cfg (in) the launch configuration
+ \param n (in) the real problem size
+ \returns *n* rounded up to a multiple of the padding
+ \mt fully threadsafe
+ */
+size_t ocltune_global( const struct ocltune_cfg* cfg, size_t n );
+
+/*!
+ \brief Returns the local work size argument for clEnqueueNDRangeKernel
+ \param cfg (in) the launch configuration
+ \returns pointer to the local work size or NULL (driver decides)
+ \mt fully threadsafe
+ */
+const size_t* ocltune_local( const struct ocltune_cfg* cfg );
+
+
+#endif
@@ -15,6 +15,9 @@
 #ifndef OPENCLAPP_OCLWRAPPER_H
 #define OPENCLAPP_OCLWRAPPER_H
 
+#include <stddef.h>
+#include "agpudm.h"
+
                                         //! unknown architecture
 #define UNKNOWN -1
                                         //! arm-v7
@@ -146,4 +149,275 @@ JNIEXPORT jint JNICALL
 Java_com_example_dmocl_oclwrap_getArchitecture(JNIEnv *env, jclass clazz);
 
 
+/*!
+ \brief Sets the directory of the work-group size autotuner config files
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param s (in) the directory (must exist and be writable)
+ \return 0 = no error, -1 = path too long
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_setTuneDir(JNIEnv *env, jclass clazz, jstring s);
+
+
+/*!
+ \brief Sets the number of workers of the native thread pool
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param workers (in) number of workers (0 = stop the pool)
+ \return number of workers running
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_setPoolSize(JNIEnv *env, jclass clazz, jint workers);
+
+
+/*!
+ \brief Stops the native thread pool
+ \details
+ The pool is restarted automatically by the next multithreaded calculation.
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \mt fully threadsafe
+ */
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_oclwrap_shutdownPool(JNIEnv *env, jclass clazz);
+
+
+/*!
+ \brief Creates a job for the k-means and DBSCAN calculations
+ \details
+ The handle is passed to the calculations, another thread can cancel them with
+ Java_com_example_dmocl_oclwrap_cancelJob (see jobctl.h). A handle can be used for several
+ calculations.
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param timeoutms (in) time until the job expires (ms), <=0 = no deadline
+ \return handle of the job (>0), -1 = too many jobs
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_createJob(JNIEnv *env, jclass clazz, jlong timeoutms);
+
+
+/*!
+ \brief Cancels a job
+ \details
+ A job of the job scheduler that is still queued is removed from the queue.
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param job (in) handle of the job
+ \return 0 = no error, -1 = unknown handle
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_cancelJob(JNIEnv *env, jclass clazz, jint job);
+
+
+/*!
+ \brief Returns the state of a job
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param job (in) handle of the job
+ \return 0 = running, 1 = cancelled, 2 = deadline passed, -1 = unknown handle
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_jobStatus(JNIEnv *env, jclass clazz, jint job);
+
+
+/*!
+ \brief Releases a job
+ \details
+ The handle becomes invalid, calculations that are still running continue. A job of the job
+ scheduler that is still queued is cancelled.
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param job (in) handle of the job
+ \mt fully threadsafe
+ */
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_oclwrap_releaseJob(JNIEnv *env, jclass clazz, jint job);
+
+
+/*!
+ \brief Returns the state of a job submitted to the job scheduler
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param job (in) handle of the job
+ \return 0 = queued, 1 = running, 2 = finished, -42 = unknown handle
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_pollJob(JNIEnv *env, jclass clazz, jint job);
+
+
+/*!
+ \brief Fetches the result of a finished job of the job scheduler
+ \details
+ The job remains valid until it is released.
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param job (in) handle of the job
+ \param b (out) Array of cluster numbers (one per data item)
+ \param e (out) Array of long values: engine, cores, time in the queue (ns), time running (ns),
+ exclusive runtime of the engine (ns), algorithm (1 = k-means, 2 = DBSCAN); shorter arrays
+ receive the first values
+ \return result of the engine (see the submit methods), -40 = job could not be started, -41 =
+ not finished yet, -42 = unknown handle, -43 = b too short
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_fetchJob(JNIEnv *env, jclass clazz, jint job, jshortArray b,
+                                        jlongArray e);
+
+
+/*!
+ \brief Sets the limits of the job scheduler
+ \details
+ See jobsched_limits.
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param cores (in) number of cores, 0 = all online CPUs
+ \param memorymb (in) memory budget (MB), 0 = a quarter of the physical memory
+ \param gpus (in) number of jobs that may use the GPU at the same time (0 = no GPU, < 0 = one if
+ there is a GPU)
+ \mt fully threadsafe
+ */
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_oclwrap_setSchedLimits(JNIEnv *env, jclass clazz, jint cores,
+                                              jint memorymb, jint gpus);
+
+
+
+/*!
+ \brief Waits until a job of the job scheduler has finished
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param job (in) handle of the job
+ \param timeoutms (in) maximum time to wait (ms), 0 = no limit
+ \return 0 = queued, 1 = running (time is up), 2 = finished, -42 = unknown handle
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_waitJob(JNIEnv *env, jclass clazz, jint job, jlong timeoutms);
+
+
+
+/*!
+ \brief Generates Gaussian clusters as test data (see agpudm_generate)
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param clustersize (in) number of data items of the clusters
+ \param features (in) features per data item
+ \param seed (in) the seed
+ \param rf (out) the data items (sum of *clustersize* x *features* floats)
+ \return 0 = no error, -1 = invalid arguments, -2 = malloc error, -5 = no workers, -9 = *rf*
+ has the wrong length
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_createClusters(JNIEnv *env, jclass clazz, jintArray clustersize,
+                                              jint features, jlong seed, jfloatArray rf);
+
+/*!
+ \brief Generates Gaussian clusters into a direct buffer (see agpudm_generate)
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param clustersize (in) number of data items of the clusters
+ \param features (in) features per data item
+ \param seed (in) the seed
+ \param rf (out) the data items (java.nio.FloatBuffer, direct)
+ \return 0 = no error, -1 = invalid arguments, -2 = malloc error, -5 = no workers, -9 = *rf*
+ is not direct or has the wrong capacity
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_createClustersDirect(JNIEnv *env, jclass clazz,
+                                                    jintArray clustersize, jint features,
+                                                    jlong seed, jobject rf);
+
+
+
+/*!
+ \brief Starts the timeline tracer (see trace.h)
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param capacity (in) number of spans that are kept, <= 0 = default
+ \return 0 = no error, -1 = malloc error, -2 = capacity too large
+ \mt not threadsafe (no search may run)
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_traceStart(JNIEnv *env, jclass clazz, jint capacity);
+
+/*!
+ \brief Stops the timeline tracer, the spans are kept
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \mt fully threadsafe
+ */
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_oclwrap_traceStop(JNIEnv *env, jclass clazz);
+
+/*!
+ \brief Writes the recorded spans as Chrome trace_event JSON into a file
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \param file (in) the file (overwritten)
+ \return 0 = no error, -1 = malloc error, -2 = file could not be written
+ \mt fully threadsafe
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_traceWrite(JNIEnv *env, jclass clazz, jstring file);
+
+/*!
+ \brief Returns the recorded spans as Chrome trace_event JSON
+ \param env pointer to JNI environment
+ \param clazz reference to JNI class
+ \return the JSON (UTF-8), NULL = malloc error
+ \mt fully threadsafe
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_dmocl_oclwrap_traceDump(JNIEnv *env, jclass clazz);
+
+
+/*!
+ \brief Sets a Java object as completion function of a job
+ \details
+ Used by the submit methods of the engines. The method *void jobDone(int job, int result)* of
+ the object is called once when the job has finished, in a native thread that is attached to the
+ VM for the call. The object is kept alive by a global reference until then.
+ \param env pointer to JNI environment
+ \param cb (in) the object (com.example.dmocl.jobcallback), NULL = no completion function
+ \param done (out) the completion function for the submission (see agpudm.h)
+ \param arg (out) its argument
+ \return 0 = no error, -1 = malloc error or the object has no method jobDone
+ \mt fully threadsafe
+ */
+int oclwrap_setcallback( JNIEnv* env, jobject cb, agpudm_donefn* done, void** arg );
+
+/*!
+ \brief Frees the completion function of a job that could not be submitted
+ \param env pointer to JNI environment
+ \param arg (in) the argument returned by oclwrap_setcallback
+ \mt fully threadsafe
+ */
+void oclwrap_dropcallback( JNIEnv* env, void* arg );
+
+/*!
+ \brief Returns the memory of a direct NIO buffer
+ \details
+ Used by the zero copy methods of the engines. The buffer must be direct (allocateDirect, views
+ of it with the native byte order) and its start must be aligned to its element type; the memory
+ is not pinned, it stays valid as long as the buffer object is referenced.
+ \param env pointer to JNI environment
+ \param buf (in) the buffer (java.nio.FloatBuffer, ShortBuffer, ...)
+ \param elemsize (in) size of an element of the buffer in bytes
+ \param len (out) capacity of the buffer (elements)
+ \return start of the buffer, NULL = not a direct buffer or misaligned
+ \mt fully threadsafe
+ */
+void* oclwrap_direct( JNIEnv* env, jobject buf, size_t elemsize, jlong* len );
+
 #endif OPENCLAPP_OCLWRAPPER_H
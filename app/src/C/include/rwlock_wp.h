@@ -4,6 +4,10 @@
  \details
  Defines the struct needed for a writer preferred reader/writer lock.
  Read- and Writer locks can be acquired and released. A static initializer for the lock is provided.
+ The readers do not touch the mutex as long as no writer is waiting or active: acquiring and
+ releasing a reader lock is a single atomic increment (decrement) of *state* and a test of
+ the writer bit. Only if a writer is pending the readers fall back to the mutex and the
+ condition variable.
  \copyright Copyright Robert Fritze 2021
  \license MIT
  \version 1.0
@@ -16,17 +20,20 @@
 
 #include <pthread.h>
 
+                              //! Bit of *state* that is set while a writer is waiting or active
+#define RWLOCK_WRITER 0x40000000
+
                               //! A struct thats holds all necessary components for the lock
 struct rwlockwp {
-                              //! A mutex for the reader/writer lock
+                              //! A mutex for the reader/writer lock (slow path only)
   pthread_mutex_t g;
                               //! A condition variable for the reader/writer lock
   pthread_cond_t c;
-                              //! Number of writers waiting
+                              //! Number of writers waiting (mutex)
   int num_writers_waiting;
-                              //! Number of readers active
-  int num_reader_active;
-                              //! Number of writers active
+                              //! Number of readers active plus RWLOCK_WRITER (atomic access)
+  int state;
+                              //! Number of writers active (mutex)
   int writer_active;
 
 };
@@ -0,0 +1,369 @@
+/*!
+ \file threadpool.h
+ \brief Header file for the process wide native thread pool
+ \details
+ The multithreaded CPU engines do not create their own threads any more. They submit range
+ tasks (a function, an argument and a range of data items) to a single pool of worker threads
+ that is shared by all libraries of the process.
+ The pool is created lazily by the first call to threadpool_reserve and grows on demand, it can
+ be resized with threadpool_resize and stopped with threadpool_shutdown. A stopped pool is
+ restarted automatically by the next threadpool_reserve.
+ The tasks of a job are tracked with a completion handle (struct threadpool_job). The tasks are
+ provided by the caller and are not copied, therefore submitting a task does not allocate
+ memory. A task must stay valid (and must not be submitted again) until its job has completed.
+ On top of the pool a work-stealing scheduler (struct threadpool_sched) distributes a loop over
+ the data items among a number of participants. Every participant owns a range of data items
+ (its deque) and executes it in chunks from the bottom; a participant that runs out of work
+ steals the upper half of the largest remaining range. The chunks shrink with the remaining
+ range, the minimum chunk (grain) size adapts to the measured time per data item (a chunk
+ should take about THREADPOOL_GRAINNS).
+ On heterogeneous processors the placement policy (see cputopo.h) pins the workers to single
+ CPUs (fastest first) and lets every participant claim a share of the data items proportional to
+ the speed of the CPU it is running on.
+ The state of the participants (ranges and statistics) is padded to THREADPOOL_CACHELINE bytes so
+ that participants never write to the same cache line. With threadpool_sched_align the chunk
+ boundaries are rounded to cache lines of the output array of a loop, neighbouring chunks then
+ do not share a cache line of that array either (if the array has been allocated with
+ threadpool_alloc).
+ If the pool has enough workers that are not bound to other schedulers (and the processor has
+ more than one CPU), the participants of a scheduler stay resident on the workers from the first loop until the scheduler is destroyed.
+ Loops then start and end at a spin-then-park barrier (see barrier.h) instead of a round trip
+ through the task queue; this keeps the cost of short loops (one DBSCAN query) low.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_THREADPOOL_H
+#define OPENCLAPP_THREADPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include "barrier.h"
+#include "cputopo.h"
+
+                              //! maximum number of worker threads
+#define THREADPOOL_MAXWORKERS 64
+                              //! a participant takes 1/THREADPOOL_SPLIT of its range per chunk
+#define THREADPOOL_SPLIT 4
+                              //! targeted runtime of the smallest chunk (ns)
+#define THREADPOOL_GRAINNS 20000
+                              //! number of statistic values per participant (see threadpool_stats)
+#define THREADPOOL_NSTATS 4
+                              //! alignment of the per participant state (covers adjacent line prefetch)
+#define THREADPOOL_CACHELINE 128
+
+
+/*!
+ \brief Function of a range task
+ \param arg (in+out) the argument of the task
+ \param start (in) first data item
+ \param len (in) number of data items
+ */
+typedef void (*threadpool_fn)( void* arg, int start, int len );
+
+/*!
+ \brief Function of a loop executed by the work-stealing scheduler
+ \param arg (in+out) the argument of the loop
+ \param part (in) number of the participant that executes the chunk
+ \param start (in) first data item of the chunk
+ \param len (in) number of data items of the chunk
+ */
+typedef void (*threadpool_loopfn)( void* arg, int part, int start, int len );
+
+                              //! Completion handle of a job (a group of tasks)
+struct threadpool_job {
+                              //! number of tasks submitted but not yet finished (pool lock)
+  int pending;
+};
+
+                      //! A static initializer that can be used by assignment
+#define THREADPOOL_JOB_INITIALIZER { 0 }
+
+                              //! A range task
+struct threadpool_task {
+                              //! function to execute
+  threadpool_fn fn;
+                              //! argument of the function
+  void* arg;
+                              //! first data item
+  int start;
+                              //! number of data items
+  int len;
+                              //! job the task belongs to
+  struct threadpool_job* job;
+                              //! next task in the queue (used by the pool)
+  struct threadpool_task* next;
+};
+
+                              //! Range of data items owned by a participant of the scheduler
+struct threadpool_range {
+                              //! lock that protects *lo* and *hi*
+  pthread_mutex_t lock;
+                              //! first data item not yet taken
+  volatile int lo;
+                              //! end of the range (exclusive)
+  volatile int hi;
+} __attribute__((aligned(THREADPOOL_CACHELINE)));
+
+                              //! Statistics of a participant of the scheduler
+struct threadpool_stats {
+                              //! time spent executing chunks (ns)
+  long long busy;
+                              //! number of data items executed
+  long long items;
+                              //! number of chunks executed
+  long long chunks;
+                              //! number of successful steals
+  long long steals;
+} __attribute__((aligned(THREADPOOL_CACHELINE)));
+
+                              //! A work-stealing scheduler
+struct threadpool_sched {
+                              //! number of participants
+  int parts;
+                              //! 1 = *claimlock* initialized
+  int status;
+                              //! placement policy (CPUTOPO_NONE or CPUTOPO_PIN | CPUTOPO_WEIGHT)
+  int policy;
+                              //! lock that protects *cursor*
+  pthread_mutex_t claimlock;
+                              //! first data item not yet claimed by a participant
+  volatile int cursor;
+                              //! sum of the CPU speeds of the active participants
+  float wsum;
+                              //! minimum chunk size
+  int grain;
+                              //! chunk boundaries are multiples of *align* (except the last one)
+  int align;
+                              //! ranges of the participants
+  struct threadpool_range* ranges;
+                              //! statistics of the participants (summed up over all loops)
+  struct threadpool_stats* stats;
+                              //! one task per participant
+  struct threadpool_task* tasks;
+                              //! completion handle of the current loop
+  struct threadpool_job job;
+                              //! function of the current loop
+  threadpool_loopfn fn;
+                              //! argument of the current loop
+  void* arg;
+                              //! number of data items of the current loop
+  int n;
+                              //! busy time of all participants before the current loop
+  long long busy0;
+                              //! data items of all participants before the current loop
+  long long items0;
+                              //! number of resident participants (0 = one task per participant and loop)
+  int team;
+                              //! number of participants that execute the current loop
+  int active;
+                              //! 1 = the resident participants terminate
+  volatile int stop;
+                              //! barrier of the resident participants and the caller (start and end of a loop)
+  struct barrier gate;
+};
+
+
+/*!
+ \brief Allocates memory aligned to a cache line
+ \details
+ Used for the per participant state and the output arrays of the loops. The memory is released
+ with free.
+ \param size (in) number of bytes
+ \returns the memory, NULL = malloc error
+ \mt fully threadsafe
+ */
+void* threadpool_alloc( size_t size );
+
+/*!
+ \brief Makes sure that the pool has enough workers
+ \details
+ Starts the pool if it is not running and adds workers until there are at least *workers*
+ (limited to THREADPOOL_MAXWORKERS). The pool never shrinks here.
+ \param workers (in) number of workers needed
+ \returns number of workers running (may be less than requested if threads could not be
+ created), 0 = pool could not be started
+ \mt fully threadsafe
+ */
+int threadpool_reserve( int workers );
+
+/*!
+ \brief Sets the number of workers
+ \details
+ Adds or removes workers. Removed workers finish the tasks that are already queued before they
+ terminate; this function returns after they have been joined. Workers bound to the resident
+ participants of a scheduler terminate after the scheduler has been destroyed.
+ \param workers (in) number of workers (0 = stop the pool)
+ \returns number of workers running
+ \mt fully threadsafe
+ */
+int threadpool_resize( int workers );
+
+/*!
+ \brief Stops the pool
+ \details
+ Same as threadpool_resize(0). Should be called once before the process (or the application)
+ terminates. The queued tasks are finished first.
+ \mt fully threadsafe
+ */
+void threadpool_shutdown( void );
+
+/*!
+ \brief Sets the placement policy of the workers
+ \details
+ With CPUTOPO_PIN the workers pin themselves to single CPUs (worker *i* to the *i*-th fastest CPU)
+ before they execute their next task and measure the speed of their CPU once. Without it the
+ workers may run on all CPUs again. The policy applies to the whole pool, the last call wins.
+ \param policy (in) CPUTOPO_NONE or a combination of CPUTOPO_PIN and CPUTOPO_WEIGHT
+ \mt fully threadsafe
+ */
+void threadpool_setpolicy( int policy );
+
+/*!
+ \brief Returns the number of workers
+ \returns number of workers running
+ \mt fully threadsafe
+ */
+int threadpool_size( void );
+
+/*!
+ \brief Binds workers to resident tasks
+ \details
+ Reserves *workers* workers of the pool for tasks that do not return until they are told so
+ (the resident participants of a scheduler). Fails if fewer workers than that are not bound yet,
+ the resident tasks then could not all run at the same time.
+ \param workers (in) number of workers
+ \returns 1 = workers bound, 0 = not enough unbound workers
+ \mt fully threadsafe
+ */
+int threadpool_bind( int workers );
+
+/*!
+ \brief Releases workers bound with threadpool_bind
+ \param workers (in) number of workers
+ \mt fully threadsafe
+ */
+void threadpool_unbind( int workers );
+
+/*!
+ \brief Initializes a completion handle
+ \param job (out) the completion handle
+ \mt not threadsafe (per handle)
+ */
+void threadpool_job_init( struct threadpool_job* job );
+
+/*!
+ \brief Submits a range task
+ \details
+ Initializes the task and appends it to the queue of the pool. If the pool is not running the
+ task is executed immediately by the calling thread.
+ \param job (in+out) the completion handle
+ \param task (out) the task (memory provided by the caller)
+ \param fn (in) function to execute
+ \param arg (in) argument of the function
+ \param start (in) first data item
+ \param len (in) number of data items
+ \mt fully threadsafe
+ */
+void threadpool_submit( struct threadpool_job* job, struct threadpool_task* task,
+                        threadpool_fn fn, void* arg, int start, int len );
+
+/*!
+ \brief Tests if a job has completed
+ \param job (in) the completion handle
+ \returns 1 = all tasks finished, 0 = tasks pending
+ \mt fully threadsafe
+ */
+int threadpool_done( struct threadpool_job* job );
+
+/*!
+ \brief Waits until a job has completed
+ \param job (in) the completion handle
+ \mt fully threadsafe
+ */
+void threadpool_wait( struct threadpool_job* job );
+
+/*!
+ \brief Initializes a work-stealing scheduler
+ \details
+ Allocates the ranges, the statistics and the tasks of the participants. A scheduler can execute
+ any number of loops (one at a time); its statistics are summed up over all loops.
+ With CPUTOPO_WEIGHT the data items are not split in advance: every participant claims a share
+ proportional to the speed of its CPU when it starts and claims further chunks when its range is
+ empty, before it steals.
+ \param sched (out) the scheduler
+ \param parts (in) number of participants (usually the number of cores, >= 1)
+ \param policy (in) CPUTOPO_NONE or a combination of CPUTOPO_PIN and CPUTOPO_WEIGHT
+ \returns 0 = no error, -1 = malloc error, -2 = mutex could not be initialized
+ \mt not threadsafe (per scheduler)
+ */
+int threadpool_sched_init( struct threadpool_sched* sched, int parts, int policy );
+
+/*!
+ \brief Aligns the chunks to the cache lines of an output array
+ \details
+ From now on the chunk boundaries of the loops are multiples of the number of data items that
+ fit into a cache line of an array with *size* bytes per data item. The participants then do not
+ write to the same cache line of the array (if it starts at a cache line, see threadpool_alloc).
+ \param sched (in+out) the scheduler (no loop may be running)
+ \param size (in) bytes per data item of the output array, 0 = no alignment
+ \mt not threadsafe (per scheduler)
+ */
+void threadpool_sched_align( struct threadpool_sched* sched, int size );
+
+/*!
+ \brief Starts a loop on the scheduler
+ \details
+ Splits the data items 0 .. n-1 evenly among the participants and starts them. Loops that are
+ shorter than a few grain sizes use fewer participants. *fn* is called for disjoint chunks that
+ cover all data items exactly once, concurrently by different participants.
+ The first loop binds the participants to workers of the pool as resident tasks (if enough
+ unbound workers are available, see threadpool_bind, and there is more than one CPU); this and every further loop then starts
+ at the barrier of the scheduler. Otherwise one task per participant is submitted to the pool.
+ The call returns immediately (the first call with resident participants waits until they have
+ been started).
+ \param sched (in+out) the scheduler (no other loop may be running)
+ \param fn (in) function of the loop
+ \param arg (in) argument of the function
+ \param n (in) number of data items
+ \mt not threadsafe (per scheduler)
+ */
+void threadpool_sched_submit( struct threadpool_sched* sched, threadpool_loopfn fn, void* arg,
+                              int n );
+
+/*!
+ \brief Waits until the loop has finished
+ \details
+ Waits at the barrier of the scheduler (resident participants) or for the tasks. Adapts the grain size for the next loop to the time per data item measured.
+ \param sched (in+out) the scheduler
+ \mt not threadsafe (per scheduler)
+ */
+void threadpool_sched_wait( struct threadpool_sched* sched );
+
+/*!
+ \brief Copies the statistics of the participants
+ \details
+ Writes THREADPOOL_NSTATS values per participant: busy time (ns), data items, chunks and
+ successful steals.
+ \param sched (in) the scheduler (no loop may be running)
+ \param out (out) the values
+ \param cnt (in) number of values that fit into *out* (further participants are skipped)
+ \returns number of values written
+ \mt not threadsafe (per scheduler)
+ */
+int threadpool_sched_stats( const struct threadpool_sched* sched, long long* out, int cnt );
+
+/*!
+ \brief Releases a work-stealing scheduler
+ \details
+ Terminates the resident participants and unbinds their workers.
+ \param sched (in+out) the scheduler (no loop may be running)
+ \mt not threadsafe (per scheduler)
+ */
+void threadpool_sched_destroy( struct threadpool_sched* sched );
+
+
+#endif
@@ -0,0 +1,124 @@
+/*!
+ \file trace.h
+ \brief Header file for the timeline tracer
+ \details
+ The tracer records spans (name, category, start, duration, thread id and one numeric
+ argument) into a preallocated event buffer and exports them as Chrome trace_event JSON
+ ("complete" events, ph = X), which can be opened in chrome://tracing or in Perfetto. The
+ engines record the JNI entry, the set up (workers, OpenCL context, program build), every
+ iteration, every chunk of a worker and the OpenCL enqueue and wait calls, so that idle
+ workers and gaps of the GPU are visible on a timeline.
+ The tracer is off by default; a span then costs one relaxed load of a flag. While it is on a
+ span costs two reads of the monotonic clock, three atomic operations and a gettid call. Spans
+ that do not fit into the buffer are dropped and counted.
+ Names and categories are not copied, they must be string literals (or live as long as the
+ events).
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef OPENCLAPP_TRACE_H
+#define OPENCLAPP_TRACE_H
+
+                              //! default number of events of the buffer
+#define TRACE_DEFAULTEVENTS (1 << 16)
+                              //! maximum number of events of the buffer
+#define TRACE_MAXEVENTS (1 << 24)
+
+                              //! category: entry of a JNI method
+#define TRACE_JNI "jni"
+                              //! category: set up of the workers or of the OpenCL device
+#define TRACE_SETUP "setup"
+                              //! category: iterations and passes of the algorithms
+#define TRACE_ALGO "algorithm"
+                              //! category: chunks of the workers
+#define TRACE_WORKER "worker"
+                              //! category: OpenCL enqueue and wait calls
+#define TRACE_OPENCL "opencl"
+                              //! category: reads of streamed data items
+#define TRACE_IO "io"
+
+
+                              //! A span
+struct trace_event {
+                              //! name (string literal)
+  const char* name;
+                              //! category (string literal)
+  const char* cat;
+                              //! start (CLOCK_MONOTONIC in ns)
+  long long ts;
+                              //! duration (ns)
+  long long dur;
+                              //! argument (iteration, data items, ...)
+  long long arg;
+                              //! thread id (gettid)
+  int tid;
+                              //! 1 = complete (written last)
+  volatile int done;
+};
+
+
+/*!
+ \brief Starts the recording
+ \details
+ Clears the buffer (allocated with *capacity* events, a buffer that is large enough is reused)
+ and switches the tracer on. Calculations may run: spans that were begun before are dropped, the
+ buffer is replaced after the threads that are still writing have finished.
+ \param capacity (in) number of events, <= 0 = TRACE_DEFAULTEVENTS
+ \returns 0 = no error, -1 = malloc error, -2 = capacity > TRACE_MAXEVENTS
+ \mt threadsafe against the recording threads (must not run at the same time as another
+ trace_start, trace_json or trace_write)
+ */
+int trace_start( int capacity );
+
+/*!
+ \brief Stops the recording
+ \details
+ The events remain in the buffer until the next trace_start.
+ \mt fully threadsafe
+ */
+void trace_stop( void );
+
+/*!
+ \brief Starts a span
+ \returns start of the span (ns), 0 = the tracer is off
+ \mt fully threadsafe
+ */
+long long trace_begin( void );
+
+/*!
+ \brief Ends a span and records it
+ \param cat (in) the category (TRACE_JNI, ...)
+ \param name (in) the name
+ \param start (in) result of trace_begin (0 = nothing to do)
+ \param arg (in) argument of the span
+ \mt fully threadsafe
+ */
+void trace_end( const char* cat, const char* name, long long start, long long arg );
+
+/*!
+ \brief Exports the recorded spans as Chrome trace_event JSON
+ \details
+ The time stamps are relative to trace_start (in µs). Spans that are still being written are
+ left out. The number of dropped spans is reported in *otherData*.
+ \param buf (out) the JSON (NUL terminated, truncated to *len* - 1 characters), NULL = only
+ the length is returned
+ \param len (in) size of *buf*
+ \returns length of the complete JSON (without the NUL)
+ \mt fully threadsafe (the recording may continue, trace_start must not be called)
+ */
+long trace_json( char* buf, long len );
+
+/*!
+ \brief Writes the recorded spans as Chrome trace_event JSON into a file
+ \param file (in) the file (overwritten)
+ \returns 0 = no error, -1 = malloc error, -2 = file could not be written
+ \mt fully threadsafe (the recording may continue, trace_start must not be called)
+ */
+int trace_write( const char* file );
+
+
+#endif
@@ -1162,6 +1162,97 @@ clFinish(cl_command_queue command_queue) CL_API_SUFFIX__VERSION_1_0{
 }
 
 
+CL_API_ENTRY void * CL_API_CALL
+clEnqueueMapBuffer(cl_command_queue command_queue,
+                   cl_mem           buffer,
+                   cl_bool          blocking_map,
+                   cl_map_flags     map_flags,
+                   size_t           offset,
+                   size_t           size,
+                   cl_uint          num_events_in_wait_list,
+                   const cl_event * event_wait_list,
+                   cl_event *       event,
+                   cl_int *         errcode_ret) CL_API_SUFFIX__VERSION_1_0{
+
+  void* ret = NULL;
+  WRAPPERCLFUNCT( clEnqueueMapBuffer, ( command_queue, buffer, blocking_map, \
+    map_flags, offset, size, num_events_in_wait_list, event_wait_list, event, \
+    errcode_ret ), NULL )
+
+}
+
+
+CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueUnmapMemObject(cl_command_queue command_queue,
+                        cl_mem           memobj,
+                        void *           mapped_ptr,
+                        cl_uint          num_events_in_wait_list,
+                        const cl_event * event_wait_list,
+                        cl_event *       event) CL_API_SUFFIX__VERSION_1_0{
+
+  cl_int ret = CL_SUCCESS;
+  WRAPPERCLFUNCT( clEnqueueUnmapMemObject, ( command_queue, memobj, mapped_ptr, \
+    num_events_in_wait_list, event_wait_list, event ), CL_OUT_OF_RESOURCES )
+
+}
+
+
+CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueMarkerWithWaitList(cl_command_queue  command_queue,
+                            cl_uint           num_events_in_wait_list,
+                            const cl_event *  event_wait_list,
+                            cl_event *        event) CL_API_SUFFIX__VERSION_1_2{
+
+  cl_int ret = CL_SUCCESS;
+  WRAPPERCLFUNCT( clEnqueueMarkerWithWaitList, ( command_queue, num_events_in_wait_list, \
+    event_wait_list, event ), CL_OUT_OF_RESOURCES )
+
+}
+
+
+CL_API_ENTRY cl_int CL_API_CALL
+clWaitForEvents(cl_uint             num_events,
+                const cl_event *    event_list) CL_API_SUFFIX__VERSION_1_0{
+
+  cl_int ret = CL_SUCCESS;
+  WRAPPERCLFUNCT( clWaitForEvents, ( num_events, event_list ), CL_OUT_OF_RESOURCES )
+
+}
+
+
+CL_API_ENTRY cl_int CL_API_CALL
+clReleaseEvent(cl_event event) CL_API_SUFFIX__VERSION_1_0{
+
+  cl_int ret = CL_SUCCESS;
+  WRAPPERCLFUNCT( clReleaseEvent, ( event ), CL_OUT_OF_RESOURCES )
+
+}
+
+
+CL_API_ENTRY cl_int CL_API_CALL
+clFlush(cl_command_queue command_queue) CL_API_SUFFIX__VERSION_1_0{
+
+  cl_int ret = CL_SUCCESS;
+  WRAPPERCLFUNCT( clFlush, ( command_queue ), CL_OUT_OF_RESOURCES )
+
+}
+
+
+CL_API_ENTRY cl_int CL_API_CALL
+clGetKernelWorkGroupInfo(cl_kernel                  kernel,
+                         cl_device_id               device,
+                         cl_kernel_work_group_info  param_name,
+                         size_t                     param_value_size,
+                         void *                     param_value,
+                         size_t *                   param_value_size_ret) CL_API_SUFFIX__VERSION_1_0{
+
+  cl_int ret = CL_SUCCESS;
+  WRAPPERCLFUNCT( clGetKernelWorkGroupInfo, ( kernel, device, param_name, param_value_size, \
+    param_value, param_value_size_ret ), CL_OUT_OF_RESOURCES )
+
+}
+
+
                  // still some OpenCL functions left for implementation
 /*
 
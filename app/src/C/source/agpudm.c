@@ -0,0 +1,352 @@
+/*!
+ \file agpudm.c
+ \brief Contexts and jobs of the public C interface
+ \details
+ This file implements the contexts, the error descriptions and the job functions of agpudm.h
+ on top of the job control (jobctl.h) and the job scheduler (jobsched.h). The searches are
+ implemented next to their engines (kmeans_c.c, dbscan_c.c).
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "agpudm_core.h"
+#include "cputopo.h"
+#include "jobsched.h"
+#include "trace.h"
+#include <stdlib.h>
+
+
+
+// see header file for details
+void agpudm_config_default( struct agpudm_config* cfg ){
+
+  cfg->engine = AGPUDM_ENGINE_AUTO;
+  cfg->cores = 0;
+  cfg->policy = AGPUDM_POLICY_DEFAULT;
+  cfg->storage = AGPUDM_STORE_FP32;
+  cfg->timeoutms = 0;
+
+} // agpudm_config_default
+
+
+
+// see header file for details
+int agpudm_create( const struct agpudm_config* cfg, struct agpudm** ctx ){
+
+  int ret = AGPUDM_OK;
+
+  *ctx = NULL;
+
+  if ((cfg == NULL) || ((cfg->engine >= AGPUDM_ENGINE_AUTO) &&
+                        (cfg->engine <= AGPUDM_ENGINE_GPU) &&
+                        (cfg->policy >= AGPUDM_POLICY_DEFAULT) &&
+                        (cfg->policy <= AGPUDM_POLICY_HETERO) &&
+                        (cfg->storage >= AGPUDM_STORE_FP32) &&
+                        (cfg->storage <= AGPUDM_STORE_INT8))) {
+
+    struct agpudm* c = (struct agpudm*) malloc( sizeof(struct agpudm) );
+
+    if (c != NULL) {
+
+      if (cfg != NULL) {
+        c->cfg = *cfg;
+      } else {
+        agpudm_config_default( &c->cfg );
+      }
+
+      *ctx = c;
+
+    } else {
+      ret = AGPUDM_ENOMEM;
+    }
+
+  } else {
+    ret = AGPUDM_EINVAL;
+  }
+
+  return( ret );
+
+} // agpudm_create
+
+
+
+// see header file for details
+void agpudm_destroy( struct agpudm* ctx ){
+
+  free( ctx );
+
+} // agpudm_destroy
+
+
+
+// see header file for details
+void agpudm_get_config( const struct agpudm* ctx, struct agpudm_config* cfg ){
+
+  *cfg = ctx->cfg;
+
+} // agpudm_get_config
+
+
+
+// see header file for details
+const char* agpudm_strerror( int err ){
+
+  switch (err) {
+    case AGPUDM_OK:
+      return( "no error" );
+    case AGPUDM_EINVAL:
+      return( "invalid argument" );
+    case AGPUDM_ENOMEM:
+      return( "out of memory" );
+    case AGPUDM_ECANCELLED:
+      return( "cancelled or deadline passed" );
+    case AGPUDM_ENOJOB:
+      return( "unknown job" );
+    case AGPUDM_ENOSTART:
+      return( "could not be started" );
+    case AGPUDM_EOPENCL:
+      return( "OpenCL error" );
+    case AGPUDM_EPENDING:
+      return( "not finished" );
+    case AGPUDM_EENGINE:
+      return( "engine error" );
+    case AGPUDM_EIO:
+      return( "file error" );
+  }
+
+  return( "unknown error" );
+
+} // agpudm_strerror
+
+
+
+// see header file for details
+struct jobctl* agpudm_attach( const struct agpudm* ctx, int job, int group ){
+
+  if ((job == 0) && (ctx->cfg.timeoutms > 0)) {
+
+    int handle = jobctl_create( ctx->cfg.timeoutms );    // anonymous job with a deadline
+
+    if (handle < 0) {
+      return( NULL );
+    }
+
+    struct jobctl* j = jobctl_attach( handle, group );
+
+    jobctl_release( handle );                // freed when the call detaches
+
+    return( j );
+  }
+
+  return( jobctl_attach( job, group ) );
+
+} // agpudm_attach
+
+
+
+// see header file for details
+int agpudm_cores( const struct agpudm* ctx ){
+
+  if (ctx->cfg.cores > 0) {
+    return( ctx->cfg.cores );
+  }
+
+  return( cputopo_count() );
+
+} // agpudm_cores
+
+
+
+// see header file for details
+void agpudm_setresult( struct agpudm_result* res, int status, int code, int engine, int cores,
+                       long long elapsed ){
+
+  if (res != NULL) {
+    res->status = status;
+    res->code = code;
+    res->engine = engine;
+    res->cores = cores;
+    res->elapsed = elapsed;
+    res->queued = 0;
+    res->running = 0;
+  }
+
+} // agpudm_setresult
+
+
+
+// see header file for details
+void agpudm_clearstats( struct agpudm_stats* st ){
+
+  if (st != NULL) {
+    st->iterations = 0;
+    st->passes = 0;
+    st->distances = 0;
+    st->reassignments = 0;
+    st->clusters = 0;
+    st->core = 0;
+    st->border = 0;
+    st->noise = 0;
+  }
+
+} // agpudm_clearstats
+
+
+
+// see header file for details
+int agpudm_job_create( long long timeoutms ){
+
+  int ret = jobctl_create( timeoutms );
+
+  return( (ret > 0) ? ret : AGPUDM_ENOSTART );
+
+} // agpudm_job_create
+
+
+
+// see header file for details
+int agpudm_job_cancel( int job ){
+
+  return( (jobsched_cancel( job ) == 0) ? AGPUDM_OK : AGPUDM_ENOJOB );
+
+} // agpudm_job_cancel
+
+
+
+// see header file for details
+int agpudm_job_poll( int job ){
+
+  int ret = jobsched_poll( job );
+
+  return( (ret >= 0) ? ret : AGPUDM_ENOJOB );
+
+} // agpudm_job_poll
+
+
+
+// see header file for details
+int agpudm_job_wait( int job, long long timeoutms ){
+
+  int ret = jobsched_wait( job, timeoutms );
+
+  return( (ret >= 0) ? ret : AGPUDM_ENOJOB );
+
+} // agpudm_job_wait
+
+
+
+// see header file for details
+int agpudm_job_result( int job, const unsigned short** labels, int* n,
+                       struct agpudm_result* res ){
+
+  short code = 0;
+  long long info[JOBSCHED_NINFO];
+
+  int ret = jobsched_result( job, &code, labels, n, info, JOBSCHED_NINFO );
+
+  if (ret == JOBSCHED_EPENDING) {
+    return( AGPUDM_EPENDING );
+  }
+
+  if (ret != 0) {
+    return( AGPUDM_ENOJOB );
+  }
+
+  if (res != NULL) {
+
+    const int engine = (int) info[0];
+    int status = AGPUDM_ENOSTART;            // the job could not be started
+
+    if (code != JOBSCHED_ENOSTART) {
+      status = (info[5] == JOBCTL_KMEANS) ? kmeans_status( engine, code )
+                                          : dbscan_status( engine, code );
+    }
+
+    agpudm_setresult( res, status, code, engine, (int) info[1], info[4] );
+
+    res->queued = info[2];
+    res->running = info[3];
+  }
+
+  return( AGPUDM_OK );
+
+} // agpudm_job_result
+
+
+
+// see header file for details
+void agpudm_job_release( int job ){
+
+  jobsched_release( job );                   // also handles of agpudm_job_create
+
+} // agpudm_job_release
+
+
+
+// see header file for details
+void agpudm_cancel_all( int algorithm ){
+
+  jobctl_cancelgroup( (algorithm == AGPUDM_DBSCAN) ? JOBCTL_DBSCAN : JOBCTL_KMEANS );
+
+} // agpudm_cancel_all
+
+
+
+// see header file for details
+void agpudm_resume_all( int algorithm ){
+
+  jobctl_resumegroup( (algorithm == AGPUDM_DBSCAN) ? JOBCTL_DBSCAN : JOBCTL_KMEANS );
+
+} // agpudm_resume_all
+
+
+
+// see header file for details
+void agpudm_limits( int cores, long long memory, int gpus ){
+
+  jobsched_limits( cores, memory, gpus );
+
+} // agpudm_limits
+
+
+
+// see header file for details
+int agpudm_trace_start( int capacity ){
+
+  const int ret = trace_start( capacity );
+
+  return( (ret == 0) ? AGPUDM_OK : ((ret == -1) ? AGPUDM_ENOMEM : AGPUDM_EINVAL) );
+
+} // agpudm_trace_start
+
+
+
+// see header file for details
+void agpudm_trace_stop( void ){
+
+  trace_stop();
+
+} // agpudm_trace_stop
+
+
+
+// see header file for details
+long agpudm_trace_json( char* buf, long len ){
+
+  return( trace_json( buf, len ) );
+
+} // agpudm_trace_json
+
+
+
+// see header file for details
+int agpudm_trace_write( const char* file ){
+
+  const int ret = trace_write( file );
+
+  return( (ret == 0) ? AGPUDM_OK : ((ret == -1) ? AGPUDM_ENOMEM : AGPUDM_EIO) );
+
+} // agpudm_trace_write
@@ -0,0 +1,108 @@
+/*!
+ \file barrier.c
+ \brief A spin-then-park barrier
+ \details
+ This file implements a sense-reversing barrier. Arriving threads read the sense of the phase,
+ increment the counter and - unless they are the last thread - wait until the sense differs.
+ The sense cannot change before all threads of the phase have arrived, therefore a thread that
+ reads the sense on arrival always reads the sense of its own phase.
+ A thread parks only after it has announced itself in *sleepers*; the last thread flips the
+ sense before it reads *sleepers*. Both use sequentially consistent operations, so either the
+ parking thread sees the new sense or the last thread sees the sleeper (the futex call also
+ returns immediately if the sense has changed in between).
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef _GNU_SOURCE
+                              //! needed for syscall
+#define _GNU_SOURCE
+#endif
+
+#include "barrier.h"
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+
+/*!
+ \brief Tells the CPU that the thread is polling
+ \mt fully threadsafe
+ */
+void barrier_relax( void ){
+
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__( "pause" );
+#elif defined(__arm__) || defined(__aarch64__)
+  __asm__ __volatile__( "yield" );
+#endif
+
+} // barrier_relax
+
+
+
+// see header file for details
+void barrier_init( struct barrier* b, int parties ){
+
+  b->parties = (parties < 1) ? 1 : parties;
+  b->spin = (sysconf( _SC_NPROCESSORS_ONLN ) > 1) ? BARRIER_SPIN : 0;   // spinning needs a second CPU
+  b->count = 0;
+  b->sense = 0;
+  b->sleepers = 0;
+
+} // barrier_init
+
+
+
+// see header file for details
+int barrier_wait( struct barrier* b ){
+
+  const int sense = __atomic_load_n( &b->sense, __ATOMIC_ACQUIRE );   // sense of this phase
+
+                                       // last thread -> next phase
+  if (__atomic_add_fetch( &b->count, 1, __ATOMIC_ACQ_REL ) == b->parties) {
+
+    __atomic_store_n( &b->count, 0, __ATOMIC_RELAXED );         // published by the sense
+    __atomic_store_n( &b->sense, 1 - sense, __ATOMIC_SEQ_CST );
+
+    if (__atomic_load_n( &b->sleepers, __ATOMIC_SEQ_CST ) > 0) {  // anybody parked?
+      syscall( SYS_futex, &b->sense, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0 );
+    }
+
+    return( 1 );
+  }
+
+  int backoff = 1;                     // pause instructions between two polls
+
+  for (int i1 = 0; i1 < b->spin; i1++) {   // spin for a short time
+
+    if (__atomic_load_n( &b->sense, __ATOMIC_ACQUIRE ) != sense) {
+      return( 0 );
+    }
+
+    for (int i2 = 0; i2 < backoff; i2++) {
+      barrier_relax();
+    }
+
+    if (backoff < BARRIER_MAXBACKOFF) {
+      backoff *= 2;
+    }
+  }
+
+                                       // park until the sense has changed
+  __atomic_add_fetch( &b->sleepers, 1, __ATOMIC_SEQ_CST );
+
+  while (__atomic_load_n( &b->sense, __ATOMIC_SEQ_CST ) == sense) {
+    syscall( SYS_futex, &b->sense, FUTEX_WAIT_PRIVATE, sense, NULL, NULL, 0 );
+  }
+
+  __atomic_sub_fetch( &b->sleepers, 1, __ATOMIC_SEQ_CST );
+
+  return( 0 );
+
+} // barrier_wait
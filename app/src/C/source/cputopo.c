@@ -0,0 +1,349 @@
+/*!
+ \file cputopo.c
+ \brief CPU topology module
+ \details
+ This file implements the reading of the CPU capacities and frequency limits from sysfs, the
+ ranking of the CPUs, the calibration loop and the thread affinity.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef _GNU_SOURCE
+                              //! needed for sched_setaffinity, sched_getcpu and the CPU_* macros
+#define _GNU_SOURCE
+#endif
+
+#include "cputopo.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+
+                              //! makes sure that the topology is read once
+pthread_once_t topoonce = PTHREAD_ONCE_INIT;
+                              //! lock that protects *topomeas*
+pthread_mutex_t topolock = PTHREAD_MUTEX_INITIALIZER;
+                              //! number of CPUs found in the affinity mask (const after init)
+int topocnt = 1;
+                              //! CPU numbers ranked by speed (const after cputopo_init)
+int toporank[CPUTOPO_MAXCPUS];
+                              //! sysfs speed per CPU, 0 = offline or not allowed (const after init)
+float toposys[CPUTOPO_MAXCPUS];
+                              //! measured operations per ns per CPU number, 0 = not measured
+double topomeas[CPUTOPO_MAXCPUS];
+
+
+
+/*!
+ \brief Reads a number from a sysfs file
+ \param cpu (in) CPU number
+ \param name (in) file name relative to /sys/devices/system/cpu/cpuN/
+ \returns the number or -1 if the file does not exist or can not be read
+ \mt fully threadsafe
+ */
+long cputopo_read( int cpu, const char* name ){
+
+  char fname[128];
+  long val = -1;
+
+  snprintf( fname, sizeof(fname), "/sys/devices/system/cpu/cpu%d/%s", cpu, name );
+
+  FILE* f = fopen( fname, "r" );
+
+  if (f != NULL) {
+
+    if (fscanf( f, "%ld", &val ) != 1) {
+      val = -1;
+    }
+
+    fclose( f );
+  }
+
+  return( val );
+
+} // cputopo_read
+
+
+
+/*!
+ \brief Reads the topology (called once)
+ \mt called by pthread_once only
+ */
+void cputopo_load( void ){
+
+  float maxraw = 0;                          // fastest CPU
+  int cnt = 0;
+
+  cpu_set_t allowed;                         // CPUs the process may run on (main thread)
+
+  if (sched_getaffinity( getpid(), sizeof(allowed), &allowed ) != 0) {
+
+    CPU_ZERO( &allowed );                    // unknown -> all CPUs
+
+    for (int i1 = 0; i1 < CPUTOPO_MAXCPUS; i1++) {
+      CPU_SET( i1, &allowed );
+    }
+  }
+
+  for (int i1 = 0; i1 < CPUTOPO_MAXCPUS; i1++) {
+
+    toposys[i1] = 0;
+    topomeas[i1] = 0;
+
+    char dname[64];
+    snprintf( dname, sizeof(dname), "/sys/devices/system/cpu/cpu%d", i1 );
+
+    if ((access( dname, F_OK ) != 0) || (cputopo_read( i1, "online" ) == 0) ||
+        !CPU_ISSET( i1, &allowed )) {
+      continue;                              // not present, offline (cpu0 has no "online") or
+    }                                        // not in the affinity mask
+
+    const long capacity = cputopo_read( i1, "cpu_capacity" );
+    const long infomax = cputopo_read( i1, "cpufreq/cpuinfo_max_freq" );
+    const long scalmax = cputopo_read( i1, "cpufreq/scaling_max_freq" );
+
+    float raw = 1;                           // nothing known
+
+    if (capacity > 0) {
+
+      raw = (float) capacity;
+
+      if ((infomax > 0) && (scalmax > 0) && (scalmax < infomax)) {
+        raw *= (float) scalmax / (float) infomax;    // frequency currently limited
+      }
+
+    } else if (scalmax > 0) {
+      raw = (float) scalmax;
+    } else if (infomax > 0) {
+      raw = (float) infomax;
+    }
+
+    toposys[i1] = raw;
+
+    if (raw > maxraw) {
+      maxraw = raw;
+    }
+
+                                 // rank by speed (insertion sort, stable for equal speeds)
+    int i2 = cnt;
+
+    while ((i2 > 0) && (toposys[toporank[i2 - 1]] < raw)) {
+      toporank[i2] = toporank[i2 - 1];
+      i2--;
+    }
+
+    toporank[i2] = i1;
+    cnt++;
+  }
+
+  if (cnt == 0) {                            // no sysfs -> all CPUs of the mask equal
+
+    long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+    if (n < 1) {
+      n = 1;
+    } else if (n > CPUTOPO_MAXCPUS) {
+      n = CPUTOPO_MAXCPUS;
+    }
+
+    for (int i1 = 0; i1 < n; i1++) {
+      if (CPU_ISSET( i1, &allowed )) {
+        toposys[i1] = 1;
+        toporank[cnt++] = i1;
+      }
+    }
+
+    if (cnt == 0) {                          // mask beyond the online CPUs
+      toposys[0] = 1;
+      toporank[0] = 0;
+      cnt = 1;
+    }
+
+    maxraw = 1;
+  }
+
+  for (int i1 = 0; i1 < CPUTOPO_MAXCPUS; i1++) {     // normalize
+    toposys[i1] /= maxraw;
+  }
+
+  topocnt = cnt;
+
+} // cputopo_load
+
+
+
+// see header file for details
+int cputopo_init( void ){
+
+  pthread_once( &topoonce, &cputopo_load );
+
+  return( topocnt );
+
+} // cputopo_init
+
+
+
+// see header file for details
+int cputopo_count( void ){
+
+  return( cputopo_init() );
+
+} // cputopo_count
+
+
+
+// see header file for details
+int cputopo_cpu( int rank ){
+
+  const int cnt = cputopo_init();
+
+  if (rank < 0) {
+    rank = -rank;
+  }
+
+  return( toporank[rank % cnt] );
+
+} // cputopo_cpu
+
+
+
+// see header file for details
+float cputopo_speed( int cpu ){
+
+  const int cnt = cputopo_init();
+
+  if ((cpu < 0) || (cpu >= CPUTOPO_MAXCPUS) || (toposys[cpu] <= 0)) {
+    return( 1 );                             // unknown
+  }
+
+  float speed = toposys[cpu];                // not calibrated -> sysfs
+
+  pthread_mutex_lock( &topolock );
+
+  double scale = 0;                          // measured operations per ns per sysfs unit
+  int meas = 0;
+
+  for (int i1 = 0; i1 < cnt; i1++) {
+    if (topomeas[toporank[i1]] > 0) {
+      scale += topomeas[toporank[i1]] / toposys[toporank[i1]];
+      meas++;
+    }
+  }
+
+  if (meas > 0) {             // calibrated -> every CPU in measured operations per ns (CPUs
+                              // not calibrated yet estimated from sysfs on the same scale)
+    scale /= meas;
+
+    double best = 0;
+
+    for (int i1 = 0; i1 < cnt; i1++) {
+
+      const int c = toporank[i1];
+      const double est = (topomeas[c] > 0) ? topomeas[c] : toposys[c] * scale;
+
+      if (est > best) {
+        best = est;
+      }
+    }
+
+    const double est = (topomeas[cpu] > 0) ? topomeas[cpu] : toposys[cpu] * scale;
+
+    speed = (float) ((est < best) ? est / best : 1.0);
+  }
+
+  pthread_mutex_unlock( &topolock );
+
+  return( speed );
+
+} // cputopo_speed
+
+
+
+// see header file for details
+int cputopo_pin( int cpu ){
+
+  cpu_set_t set;
+
+  CPU_ZERO( &set );
+
+  if (cpu >= 0) {
+    CPU_SET( cpu, &set );                    // single CPU
+  } else {
+
+    const int cnt = cputopo_init();
+
+    for (int i1 = 0; i1 < cnt; i1++) {       // all CPUs found
+      CPU_SET( toporank[i1], &set );
+    }
+  }
+
+  if (sched_setaffinity( 0, sizeof(cpu_set_t), &set ) != 0) {    // 0 = calling thread
+    return( -1 );
+  }
+
+  return( 0 );
+
+} // cputopo_pin
+
+
+
+// see header file for details
+void cputopo_calibrate( int cpu ){
+
+  if ((cpu < 0) || (cpu >= CPUTOPO_MAXCPUS)) {
+    return;
+  }
+
+  const int ops = 250000;                    // operations per run
+  double best = 0;
+
+  for (int i1 = 0; i1 < 3; i1++) {
+
+    struct timespec start, finish;
+    volatile float sink;
+    float x = 1.0f;
+    float y = 0.5f;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    for (int i2 = 0; i2 < ops; i2++) {       // two dependency chains, like the distance loops
+      x = x * 0.9999999f + 1e-7f;
+      y = y * 0.9999998f + 2e-7f;
+    }
+
+    sink = x + y;
+    (void) sink;
+
+    clock_gettime( CLOCK_MONOTONIC, &finish );
+
+    const double t = (double) (finish.tv_sec - start.tv_sec) * 1e9 +
+                     (double) (finish.tv_nsec - start.tv_nsec);
+
+    if ((t > 0) && (ops / t > best)) {
+      best = ops / t;
+    }
+  }
+
+  pthread_mutex_lock( &topolock );
+
+  if (best > topomeas[cpu]) {                // keep the best result
+    topomeas[cpu] = best;
+  }
+
+  pthread_mutex_unlock( &topolock );
+
+} // cputopo_calibrate
+
+
+
+// see header file for details
+int cputopo_current( void ){
+
+  return( sched_getcpu() );
+
+} // cputopo_current
@@ -0,0 +1,340 @@
+/*!
+ \file datagen.c
+ \brief Parallel generator of Gaussian clusters
+ \details
+ Generates the test data of the app (see agpudm_generate) on the workers of the thread pool.
+ <ul>
+ <li>The random numbers come from the counter based generator Philox4x32-10: every data item
+ draws its numbers from the counter (number of the data item, block of features), keyed with
+ the seed. There is no state that the workers share or pass on, so the result does not depend
+ on the number of workers or on the chunks.</li>
+ <li>Normally distributed numbers are made with the Box-Muller transform (4 per Philox call).
+ </li>
+ <li>The data items are shuffled with a random permutation of their positions: position *j* of
+ the array holds data item *P(j)*, where *P* is a keyed Feistel network on the next power of four
+ (cycle walking for positions >= n). Every position is computed independently, the array is
+ written front to back and nothing is moved afterwards.</li>
+ </ul>
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "agpudm_core.h"
+#include "cputopo.h"
+#include "threadpool.h"
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+                              //! rounds of the Feistel network
+#define DATAGEN_ROUNDS 6
+                              //! counter domain: data items
+#define DATAGEN_ITEMS 0
+                              //! counter domain: cluster centers
+#define DATAGEN_CENTERS 1
+                              //! counter domain: spreads of the clusters
+#define DATAGEN_SPREADS 2
+                              //! counter domain: keys of the permutation
+#define DATAGEN_PERMUTE 3
+
+
+                              //! Parameters of the generator shared by the chunks
+struct datagen_pt {
+                              //! (out) the data items
+  float* data;
+                              //! (const) first data item of the clusters (clusters + 1 values)
+  const long long* first;
+                              //! (const) center and spread of the clusters (2 * features each)
+  const float* param;
+                              //! (const) number of clusters
+  int clusters;
+                              //! (const) features per data item
+  int features;
+                              //! (const) number of data items
+  int n;
+                              //! (const) half of the bits of the permutation domain
+  int half;
+                              //! (const) key of Philox
+  uint32_t key[2];
+                              //! (const) round keys of the permutation
+  uint32_t rkey[DATAGEN_ROUNDS];
+};
+
+
+
+/*!
+ \brief Philox4x32-10
+ \param ctr (in) the counter
+ \param key (in) the key
+ \param out (out) four random numbers
+ \mt fully threadsafe
+ */
+void datagen_philox( const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4] ){
+
+  uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  uint32_t k0 = key[0], k1 = key[1];
+
+  for (int i1 = 0; i1 < 10; i1++) {
+
+    const uint64_t p0 = (uint64_t) 0xD2511F53u * c0;
+    const uint64_t p1 = (uint64_t) 0xCD9E8D57u * c2;
+
+    c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+    c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t) p1;
+    c3 = (uint32_t) p0;
+
+    k0 += 0x9E3779B9u;                 // Weyl sequence of the key
+    k1 += 0xBB67AE85u;
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+
+} // datagen_philox
+
+
+
+/*!
+ \brief Draws four normally distributed numbers
+ \param key (in) key of Philox
+ \param c0 (in) first word of the counter (data item or cluster)
+ \param c1 (in) second word of the counter (block of four features)
+ \param domain (in) DATAGEN_ITEMS, _CENTERS or _SPREADS
+ \param out (out) four random numbers (mean 0, standard deviation 1)
+ \mt fully threadsafe
+ */
+void datagen_gauss( const uint32_t key[2], uint32_t c0, uint32_t c1, uint32_t domain,
+                    float out[4] ){
+
+  const uint32_t ctr[4] = { c0, c1, domain, 0 };
+  uint32_t u[4];
+
+  datagen_philox( ctr, key, u );
+
+  for (int i1 = 0; i1 < 4; i1 += 2) {
+
+    const float u1 = ((float) (u[i1] >> 8) + 1.0f) * (1.0f / 16777216.0f);   // (0,1], no log(0)
+    const float u2 = (float) (u[i1 + 1] >> 8) * (1.0f / 16777216.0f);       // [0,1)
+    const float r = sqrtf( -2.0f * logf( u1 ) );
+
+    out[i1] = r * cosf( 6.2831853f * u2 );
+    out[i1 + 1] = r * sinf( 6.2831853f * u2 );
+  }
+
+} // datagen_gauss
+
+
+
+/*!
+ \brief Maps a position of the array to the data item stored there
+ \details
+ Applies the Feistel network until the result is a valid data item (cycle walking). The network
+ is a bijection of [0, 4^half), so the mapping is a bijection of [0, n); it needs less than four
+ applications on average.
+ \param pt (in) the parameters
+ \param j (in) the position
+ \returns the data item
+ \mt fully threadsafe
+ */
+int datagen_permute( const struct datagen_pt* pt, int j ){
+
+  const uint32_t mask = (1u << pt->half) - 1;
+  uint32_t x = (uint32_t) j;
+
+  do {
+
+    uint32_t l = x >> pt->half;
+    uint32_t r = x & mask;
+
+    for (int i1 = 0; i1 < DATAGEN_ROUNDS; i1++) {
+
+      uint32_t f = r ^ pt->rkey[i1];   // round function: integer hash
+
+      f ^= f >> 16;
+      f *= 0x7FEB352Du;
+      f ^= f >> 15;
+      f *= 0x846CA68Bu;
+      f ^= f >> 16;
+
+      const uint32_t t = r;
+      r = l ^ (f & mask);
+      l = t;
+    }
+
+    x = (l << pt->half) | r;
+
+  } while (x >= (uint32_t) pt->n);
+
+  return( (int) x );
+
+} // datagen_permute
+
+
+
+/*!
+ \brief Chunk of the generator executed in parallel
+ \details
+ Fills the positions *start* .. *start* + *len* - 1 with the data items the permutation maps
+ them to.
+ \param arg (in) the parameters (struct datagen_pt)
+ \param part (in) number of the participant (not used)
+ \param start (in) first position
+ \param len (in) number of positions
+ */
+void datagen_thread( void* arg, int part, int start, int len ){
+
+  const struct datagen_pt* pt = (const struct datagen_pt*) arg;
+  const int features = pt->features;
+  float g[4];
+
+  (void) part;                         // the result does not depend on the participant
+
+  for (int j = start; j < start + len; j++) {
+
+    const int i = datagen_permute( pt, j );
+
+    int lo = 0;                        // cluster of the data item (binary search)
+    int hi = pt->clusters - 1;
+
+    while (lo < hi) {
+      const int mid = (lo + hi + 1) / 2;
+      if (pt->first[mid] <= i) lo = mid; else hi = mid - 1;
+    }
+
+    const float* fm = pt->param + (size_t) lo * 2 * features;   // center
+    const float* fd = fm + features;                            // spread
+    float* out = pt->data + (size_t) j * features;
+
+    for (int f = 0; f < features; f++) {
+
+      if ((f & 3) == 0) {
+        datagen_gauss( pt->key, (uint32_t) i, (uint32_t) (f >> 2), DATAGEN_ITEMS, g );
+      }
+
+      out[f] = fm[f] + g[f & 3] * fd[f];
+    }
+  }
+
+} // datagen_thread
+
+
+
+// see header file for details
+int agpudm_generate( const int* sizes, int clusters, int features, unsigned long long seed,
+                     int cores, float* data ){
+
+  long long n = 0;                     // number of data items
+
+  if ((sizes == NULL) || (data == NULL) || (clusters <= 0) || (features <= 0)) {
+    return( AGPUDM_EINVAL );
+  }
+
+  for (int i1 = 0; i1 < clusters; i1++) {
+    if (sizes[i1] < 0) {
+      return( AGPUDM_EINVAL );
+    }
+    n += sizes[i1];
+  }
+
+  if ((n <= 0) || (n > INT_MAX) || ((unsigned long long) n * features > SIZE_MAX / sizeof(float))) {
+    return( AGPUDM_EINVAL );
+  }
+
+  if (cores <= 0) {
+    cores = cputopo_count();
+  }
+
+  int ret = AGPUDM_OK;
+  struct datagen_pt pt;
+
+  pt.data = data;
+  pt.clusters = clusters;
+  pt.features = features;
+  pt.n = (int) n;
+  pt.key[0] = (uint32_t) seed;
+  pt.key[1] = (uint32_t) (seed >> 32);
+
+  pt.half = 1;                         // smallest power of four >= n
+  while ((1LL << (2 * pt.half)) < n) {
+    pt.half++;
+  }
+
+  uint32_t u[4];
+
+  for (int i1 = 0; i1 < DATAGEN_ROUNDS; i1++) {
+    const uint32_t ctr[4] = { (uint32_t) i1, 0, DATAGEN_PERMUTE, 0 };
+    datagen_philox( ctr, pt.key, u );
+    pt.rkey[i1] = u[0];
+  }
+
+  long long* first = (long long*) malloc( sizeof(long long) * (clusters + 1) );
+  float* param = (float*) malloc( sizeof(float) * 2 * features * clusters );
+
+  if ((first != NULL) && (param != NULL)) {
+
+    float g[4];
+
+    first[0] = 0;
+
+    for (int i1 = 0; i1 < clusters; i1++) {   // centers N(0,10) and spreads N(0,2.5)
+
+      first[i1 + 1] = first[i1] + sizes[i1];
+
+      for (int f = 0; f < features; f++) {
+
+        if ((f & 3) == 0) {
+          datagen_gauss( pt.key, (uint32_t) i1, (uint32_t) (f >> 2), DATAGEN_CENTERS, g );
+        }
+        param[(size_t) i1 * 2 * features + f] = g[f & 3] * 10;
+      }
+
+      for (int f = 0; f < features; f++) {
+
+        if ((f & 3) == 0) {
+          datagen_gauss( pt.key, (uint32_t) i1, (uint32_t) (f >> 2), DATAGEN_SPREADS, g );
+        }
+        param[(size_t) i1 * 2 * features + features + f] = g[f & 3] * 2.5f;
+      }
+    }
+
+    pt.first = first;
+    pt.param = param;
+
+    struct threadpool_sched sched;
+
+    if (threadpool_sched_init( &sched, cores, CPUTOPO_NONE ) == 0) {
+
+                              // chunks do not share cache lines of the data items
+      threadpool_sched_align( &sched, (int) sizeof(float) * features );
+
+      if (threadpool_reserve( cores ) > 0) {
+        threadpool_sched_submit( &sched, &datagen_thread, &pt, pt.n );
+        threadpool_sched_wait( &sched );
+      } else {
+        ret = AGPUDM_ENOSTART;
+      }
+
+      threadpool_sched_destroy( &sched );
+
+    } else {
+      ret = AGPUDM_ENOSTART;
+    }
+
+  } else {
+    ret = AGPUDM_ENOMEM;
+  }
+
+  free( first );
+  free( param );
+
+  return( ret );
+
+} // agpudm_generate
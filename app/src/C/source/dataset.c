@@ -0,0 +1,247 @@
+/*!
+ \file dataset.c
+ \brief Binary dataset files
+ \details
+ A dataset file holds the data items of a search in the format the engines use, so that it can
+ be mapped into memory and passed to them without copies. Layout (version 1, byte order of the
+ writer):
+ <table>
+ <tr><th>offset</th><th>size</th><th>content</th></tr>
+ <tr><td>0</td><td>8</td><td>magic "AGPUDMDS"</td></tr>
+ <tr><td>8</td><td>4</td><td>version (1)</td></tr>
+ <tr><td>12</td><td>4</td><td>type of the features (AGPUDM_DTYPE_FP32)</td></tr>
+ <tr><td>16</td><td>4</td><td>layout (AGPUDM_LAYOUT_ROWS: data item after data item)</td></tr>
+ <tr><td>20</td><td>4</td><td>features per data item</td></tr>
+ <tr><td>24</td><td>8</td><td>number of data items</td></tr>
+ <tr><td>32</td><td>8</td><td>offset of the data items (multiple of DATASET_ALIGN)</td></tr>
+ <tr><td>40</td><td>4</td><td>byte order mark 0x01020304</td></tr>
+ <tr><td>44</td><td>20</td><td>reserved (0)</td></tr>
+ </table>
+ The data items start at a page boundary: the mapping can back OpenCL buffers with
+ CL_MEM_USE_HOST_PTR, and the chunks of the workers do not share pages with the header.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef _FILE_OFFSET_BITS
+                              //! 64 bit file offsets on 32 bit platforms
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "agpudm_core.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+                              //! magic of a dataset file
+#define DATASET_MAGIC "AGPUDMDS"
+                              //! version of the format
+#define DATASET_VERSION 1
+                              //! byte order mark
+#define DATASET_BOM 0x01020304u
+                              //! alignment of the data items in the file (bytes)
+#define DATASET_ALIGN 4096
+
+
+                              //! The header of a dataset file (64 bytes)
+struct dataset_header {
+                              //! DATASET_MAGIC (not terminated)
+  char magic[8];
+                              //! DATASET_VERSION
+  uint32_t version;
+                              //! AGPUDM_DTYPE_...
+  uint32_t dtype;
+                              //! AGPUDM_LAYOUT_...
+  uint32_t layout;
+                              //! features per data item
+  uint32_t features;
+                              //! number of data items
+  uint64_t n;
+                              //! offset of the data items
+  uint64_t offset;
+                              //! DATASET_BOM
+  uint32_t bom;
+                              //! reserved (0)
+  uint32_t reserved[5];
+};
+
+
+
+/*!
+ \brief Writes a whole buffer into a file
+ \param fd (in) the file
+ \param buf (in) the buffer
+ \param len (in) number of bytes
+ \returns 0 = no error, -1 = write error
+ \mt fully threadsafe
+ */
+int dataset_writeall( int fd, const void* buf, size_t len ){
+
+  const char* p = (const char*) buf;
+
+  while (len > 0) {
+
+    const ssize_t w = write( fd, p, (len > (1 << 30)) ? (1 << 30) : len );   // bounded calls
+
+    if (w <= 0) {
+      return( -1 );
+    }
+
+    p += w;
+    len -= (size_t) w;
+  }
+
+  return( 0 );
+
+} // dataset_writeall
+
+
+
+// see header file for details
+int agpudm_dataset_write( const char* file, const float* data, long long n, int features ){
+
+  if ((file == NULL) || (data == NULL) || (n <= 0) || (features <= 0) ||
+      ((unsigned long long) n > SIZE_MAX / sizeof(float) / (unsigned long long) features)) {
+    return( AGPUDM_EINVAL );
+  }
+
+  char page[DATASET_ALIGN];            // header and padding up to the data items
+  struct dataset_header h;
+
+  memset( &h, 0, sizeof(h) );
+  memcpy( h.magic, DATASET_MAGIC, sizeof(h.magic) );
+  h.version = DATASET_VERSION;
+  h.dtype = AGPUDM_DTYPE_FP32;
+  h.layout = AGPUDM_LAYOUT_ROWS;
+  h.features = (uint32_t) features;
+  h.n = (uint64_t) n;
+  h.offset = DATASET_ALIGN;
+  h.bom = DATASET_BOM;
+
+  memset( page, 0, sizeof(page) );
+  memcpy( page, &h, sizeof(h) );
+
+  int ret = AGPUDM_EIO;
+
+  const int fd = open( file, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+
+  if (fd >= 0) {
+
+    if ((dataset_writeall( fd, page, sizeof(page) ) == 0) &&
+        (dataset_writeall( fd, data, sizeof(float) * (size_t) n * features ) == 0)) {
+      ret = AGPUDM_OK;
+    }
+
+    if (close( fd ) != 0) {
+      ret = AGPUDM_EIO;
+    }
+  }
+
+  return( ret );
+
+} // agpudm_dataset_write
+
+
+
+// see header file for details
+int agpudm_dataset_open( const char* file, struct agpudm_dataset* ds ){
+
+  if ((file == NULL) || (ds == NULL)) {
+    return( AGPUDM_EINVAL );
+  }
+
+  memset( ds, 0, sizeof(*ds) );
+
+  int ret = AGPUDM_EIO;
+
+  const int fd = open( file, O_RDONLY );
+
+  if (fd >= 0) {
+
+    struct stat st;
+    struct dataset_header h;
+
+    if ((fstat( fd, &st ) == 0) && (st.st_size >= DATASET_ALIGN) &&
+        ((unsigned long long) st.st_size <= SIZE_MAX) &&
+        (pread( fd, &h, sizeof(h), 0 ) == (ssize_t) sizeof(h)) &&
+        (memcmp( h.magic, DATASET_MAGIC, sizeof(h.magic) ) == 0) &&
+        (h.version == DATASET_VERSION) && (h.bom == DATASET_BOM) &&
+        (h.dtype == AGPUDM_DTYPE_FP32) && (h.layout == AGPUDM_LAYOUT_ROWS) &&
+        (h.features > 0) && (h.features <= INT32_MAX) && (h.n > 0) &&
+        (h.offset >= sizeof(h)) && ((h.offset % DATASET_ALIGN) == 0) &&
+        (h.offset <= (uint64_t) st.st_size) &&
+        (h.n <= ((uint64_t) st.st_size - h.offset) / sizeof(float) / h.features)) {
+
+                              // the whole file, the data items stay page aligned
+      void* map = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+
+      if (map != MAP_FAILED) {
+
+        ds->map = map;
+        ds->maplen = (long long) st.st_size;
+        ds->data = (const float*) ((const char*) map + h.offset);
+        ds->n = (long long) h.n;
+        ds->features = (int) h.features;
+        ds->dtype = (int) h.dtype;
+        ds->layout = (int) h.layout;
+        ret = AGPUDM_OK;
+      }
+    }
+
+    close( fd );                       // the mapping stays valid
+  }
+
+  return( ret );
+
+} // agpudm_dataset_open
+
+
+
+// see header file for details
+void agpudm_dataset_close( struct agpudm_dataset* ds ){
+
+  if ((ds != NULL) && (ds->map != NULL)) {
+    munmap( ds->map, (size_t) ds->maplen );
+    memset( ds, 0, sizeof(*ds) );
+  }
+
+} // agpudm_dataset_close
+
+
+
+// see header file for details
+const float* agpudm_dataset_reader( void* arg, long long start, int count, float* buf ){
+
+  const struct agpudm_dataset* ds = (const struct agpudm_dataset*) arg;
+
+  if ((ds == NULL) || (ds->map == NULL) || (start < 0) || (count <= 0) ||
+      (start + count > ds->n)) {
+    return( NULL );
+  }
+
+  const float* items = ds->data + start * ds->features;
+  const size_t len = sizeof(float) * (size_t) count * ds->features;
+
+                              // request the pages (asynchronous read of the file) ...
+  const uintptr_t page = (uintptr_t) items & ~((uintptr_t) sysconf( _SC_PAGESIZE ) - 1);
+  madvise( (void*) page, len + ((uintptr_t) items - page), MADV_WILLNEED );
+
+  volatile float sink = 0;    // ... and wait for them here instead of in the workers
+
+  for (size_t i1 = 0; i1 < len / sizeof(float); i1 += DATASET_ALIGN / sizeof(float)) {
+    sink += items[i1];
+  }
+
+  (void) sink;
+  (void) buf;
+
+  return( items );
+
+} // agpudm_dataset_reader
@@ -2,8 +2,9 @@
  \file dbscan_c.c
  \brief Source file for the C/C+GPU implementations of the DBSCAN algorithm
  \details
- This C source file contains three methods, that allow to perform single- or multithreaded CPU or
- GPU based DBSCAN cluster searches.
+ This C source file contains the single- or multithreaded CPU and GPU based DBSCAN cluster
+ searches and their functions of the public C interface (agpudm.h). It does not depend on JNI,
+ the JNI methods are in dbscan_jni.c.
  \copyright Copyright Robert Fritze 2021
  \license MIT
  \version 1.0
@@ -11,30 +12,30 @@
  \date 11.9.2021
  */
 
-#include <jni.h>
-#include "dbscan_c.h"
+#include "agpudm_core.h"
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
-#include <rwlock_wp.h>
 
-#include "oclwrapper.h"
                               //! User older APIs
 #define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 
 #include <CL/opencl.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include "oclbuffer.h"
+#include "ocltune.h"
+#include "oclstore.h"
+#include "threadpool.h"
+#include "jobctl.h"
+#include "jobsched.h"
+#include "trace.h"
 
 #define MAXVALUE ((short) 0xFFFF)       //!< Maximum value for 16 Bit short
 #define GPUTIMING                       //!< Define if exclusive GPU time should be measured
 
-                          //! a lock for premature abort of algorithms
-volatile struct rwlockwp abortcalc = RWLOCK_STATIC_INITIALIZER;
-volatile int doabort = 0;           //!< flag for premature abort of algorithms
-
-
 
 
 /*!
@@ -43,15 +44,23 @@ volatile int doabort = 0;           //!< flag for premature abort of algorithms
 
  <h3>__kernel void testdistance1</h3>
  (<br>
- &emsp;  global const float* data, <br>
+ &emsp;  global const DATA_T* data, <br>
  &emsp;  global unsigned short* b, <br>
  &emsp;  const int features, <br>
  &emsp;  const int cmpto, <br>
- &emsp;  const float epseps <br>
+ &emsp;  const float epseps, <br>
+ &emsp;  const int blen, <br>
+ &emsp;  global const float* exact, <br>
+ &emsp;  global const float* qparam, <br>
+ &emsp;  const float lo, <br>
+ &emsp;  const float hi <br>
  ) <br><br>
 
  Calculates the euclidean distance of each data item to a specific given data item.
  This method is called from the main loop.<br>
+ The distances are accumulated in single precision. If the data items are stored with reduced
+ precision, borderline distances are recomputed from the original data items, so the result
+ does not depend on the storage format.<br>
 
  <table>
   <tr>
@@ -60,9 +69,9 @@ volatile int doabort = 0;           //!< flag for premature abort of algorithms
     <th>description</th>
   </tr>
   <tr>
-    <td><em>global const float* data</em></td>
+    <td><em>global const DATA_T* data</em></td>
     <td>in</td>
-    <td>input data</td>
+    <td>input data (float, half or char, see oclstore.h)</td>
   </tr>
   <tr>
     <td><em>global unsigned short* b</em></td>
@@ -87,16 +96,42 @@ volatile int doabort = 0;           //!< flag for premature abort of algorithms
     <td>in</td>
     <td>square of the search radius</td>
   </tr>
+  <tr>
+    <td><em>const int blen</em></td>
+    <td>in</td>
+    <td>the number of data items (work-items beyond are padding)</td>
+  </tr>
+  <tr>
+    <td><em>global const float* exact</em></td>
+    <td>in</td>
+    <td>input data in single precision (reduced precision storage only)</td>
+  </tr>
+  <tr>
+    <td><em>global const float* qparam</em></td>
+    <td>in</td>
+    <td>scale and offset per feature (int8 storage only)</td>
+  </tr>
+  <tr>
+    <td><em>const float lo, hi</em></td>
+    <td>in</td>
+    <td>squared distances in (lo, hi] are rechecked with <em>exact</em>
+        (reduced precision storage only, see oclstore_bounds)</td>
+  </tr>
 </table>
 
 
  <h3>__kernel void testdistance2</h3>
  (<br>
- &emsp;  global const float* data, <br>
+ &emsp;  global const DATA_T* data, <br>
  &emsp;  global unsigned short* b, <br>
  &emsp;  const int features, <br>
  &emsp;  const int cmpto, <br>
- &emsp;  const float epseps <br>
+ &emsp;  const float epseps, <br>
+ &emsp;  const int blen, <br>
+ &emsp;  global const float* exact, <br>
+ &emsp;  global const float* qparam, <br>
+ &emsp;  const float lo, <br>
+ &emsp;  const float hi <br>
  ) <br><br>
 
  Calculates the euclidean distance of each data item to a specific given data item.
@@ -109,9 +144,9 @@ volatile int doabort = 0;           //!< flag for premature abort of algorithms
     <th>description</th>
   </tr>
   <tr>
-    <td><em>global const float* data</em></td>
+    <td><em>global const DATA_T* data</em></td>
     <td>in</td>
-    <td>input data</td>
+    <td>input data (float, half or char, see oclstore.h)</td>
   </tr>
   <tr>
     <td><em>global unsigned short* b</em></td>
@@ -136,29 +171,74 @@ volatile int doabort = 0;           //!< flag for premature abort of algorithms
     <td>in</td>
     <td>square of the search radius</td>
   </tr>
+  <tr>
+    <td><em>const int blen</em></td>
+    <td>in</td>
+    <td>the number of data items (work-items beyond are padding)</td>
+  </tr>
+  <tr>
+    <td><em>global const float* exact</em></td>
+    <td>in</td>
+    <td>input data in single precision (reduced precision storage only)</td>
+  </tr>
+  <tr>
+    <td><em>global const float* qparam</em></td>
+    <td>in</td>
+    <td>scale and offset per feature (int8 storage only)</td>
+  </tr>
+  <tr>
+    <td><em>const float lo, hi</em></td>
+    <td>in</td>
+    <td>squared distances in (lo, hi] are rechecked with <em>exact</em>
+        (reduced precision storage only, see oclstore_bounds)</td>
+  </tr>
 </table>
 
  */
-const char* clsource = \
+const char* dbscan_clsource = OCLSTORE_PREAMBLE \
 "                                                                         \n" \
 "                                                                         \n" \
 "  __kernel void testdistance1(                                           \n" \
 "                                                                         \n" \
-"    global const float* data,                                            \n" \
+"    global const DATA_T* data,                                           \n" \
 "    global unsigned short* b,                                            \n" \
 "    const int features,                                                  \n" \
 "    const int cmpto,                                                     \n" \
-"    const float epseps                                                   \n" \
+"    const float epseps,                                                  \n" \
+"    const int blen,                                                      \n" \
+"    global const float* exact,                                           \n" \
+"    global const float* qparam,                                          \n" \
+"    const float lo,                                                      \n" \
+"    const float hi                                                       \n" \
 "                                                                         \n" \
 "  ) {                                                                    \n" \
 "       size_t gid = get_global_id( 0 );                                  \n" \
 "                                                                         \n" \
+"       if (gid >= blen) {             // padded work-item                \n" \
+"         return;                                                         \n" \
+"       }                                                                 \n" \
+"                                                                         \n" \
 "       b[gid] &= 65535-6;             // Bits 2 und 3 löschen            \n" \
 "       float s = 0;                                                      \n" \
 "                                                                         \n" \
 "       for( int i1 = 0; i1 < features; i1++ ){                           \n" \
-"         s += pown( data[gid*features+i1] - data[cmpto*features+i1], 2 );\n" \
+"         s += pown( LOADF(gid*features+i1,i1) - LOADF(cmpto*features+i1,i1), 2 );\n" \
+"       }                                                                 \n" \
+"                                                                         \n" \
+"#if DSTORE != 0                                                          \n" \
+"       if ((s > lo) && (s <= hi)) {   // borderline -> exact recheck     \n" \
+"         s = 0;                                                          \n" \
+"                                                                         \n" \
+"         for( int i1 = 0; i1 < features; i1++ ){                         \n" \
+"           s += pown( exact[gid*features+i1] - exact[cmpto*features+i1], 2 );\n" \
+"         }                                                               \n" \
+"                                                                         \n" \
+"       } else if (s <= lo) {                                             \n" \
+"         s = 0;                       // certainly inside                \n" \
+"       } else {                                                          \n" \
+"         s = INFINITY;                // certainly outside               \n" \
 "       }                                                                 \n" \
+"#endif                                                                   \n" \
 "                                                                         \n" \
 "       if (s <= epseps) {                                                \n" \
 "                                                                         \n" \
@@ -172,22 +252,46 @@ const char* clsource = \
 "                                                                         \n" \
 "  __kernel void testdistance2(                                           \n" \
 "                                                                         \n" \
-"    global const float* data,                                            \n" \
+"    global const DATA_T* data,                                           \n" \
 "    global unsigned short* b,                                            \n" \
 "    const int features,                                                  \n" \
 "    const int cmpto,                                                     \n" \
-"    const float epseps                                                   \n" \
+"    const float epseps,                                                  \n" \
+"    const int blen,                                                      \n" \
+"    global const float* exact,                                           \n" \
+"    global const float* qparam,                                          \n" \
+"    const float lo,                                                      \n" \
+"    const float hi                                                       \n" \
 "                                                                         \n" \
 "  ) {                                                                    \n" \
 "                                                                         \n" \
 "       size_t gid = get_global_id( 0 );                                  \n" \
 "                                                                         \n" \
+"       if (gid >= blen) {             // padded work-item                \n" \
+"         return;                                                         \n" \
+"       }                                                                 \n" \
+"                                                                         \n" \
 "       b[gid] &= 65535-4;             // Bit 3 löschen                   \n" \
 "       float s = 0;                                                      \n" \
 "                                                                         \n" \
 "       for( int i1 = 0; i1 < features; i1++ ){                           \n" \
-"         s += pown( data[gid*features+i1] - data[cmpto*features+i1], 2 );\n" \
+"         s += pown( LOADF(gid*features+i1,i1) - LOADF(cmpto*features+i1,i1), 2 );\n" \
+"       }                                                                 \n" \
+"                                                                         \n" \
+"#if DSTORE != 0                                                          \n" \
+"       if ((s > lo) && (s <= hi)) {   // borderline -> exact recheck     \n" \
+"         s = 0;                                                          \n" \
+"                                                                         \n" \
+"         for( int i1 = 0; i1 < features; i1++ ){                         \n" \
+"           s += pown( exact[gid*features+i1] - exact[cmpto*features+i1], 2 );\n" \
+"         }                                                               \n" \
+"                                                                         \n" \
+"       } else if (s <= lo) {                                             \n" \
+"         s = 0;                       // certainly inside                \n" \
+"       } else {                                                          \n" \
+"         s = INFINITY;                // certainly outside               \n" \
 "       }                                                                 \n" \
+"#endif                                                                   \n" \
 "                                                                         \n" \
 "       if (s <= epseps) {                                                \n" \
 "                                                                         \n" \
@@ -201,6 +305,55 @@ const char* clsource = \
 
 
 
+/*!
+ \brief Counts one distance query of a DBSCAN search
+ \details
+ Called by all engines after the distances of all data items to one data item have been tested.
+ \param counters (in+out) the counters (NULL = nothing to do)
+ \param blen (in) number of data items
+ \param core (in) 1 = the data item has enough neighbours (core point), 0 = not
+ \mt fully threadsafe
+ */
+void dbscan_tally(struct agpudm_stats *counters, const int blen, const int core) {
+
+  if (counters != NULL) {
+    counters->distances += blen;
+    counters->core += core;
+  }
+
+} // dbscan_tally
+
+
+
+/*!
+ \brief Counts the kinds of points of a finished DBSCAN search
+ \details
+ Every core point has been counted by its query (see dbscan_tally), the other points of a
+ cluster are border points.
+ \param counters (in+out) the counters (NULL = nothing to do)
+ \param b (in) final cluster numbers (0 = noise)
+ \param blen (in) number of data items
+ \param clusters (in) number of clusters found
+ \mt fully threadsafe
+ */
+void dbscan_classify(struct agpudm_stats *counters, const unsigned short *b, const int blen,
+                     const int clusters) {
+
+  if (counters != NULL) {
+
+    counters->noise = 0;
+
+    for (int i1 = 0; i1 < blen; i1++) {
+      counters->noise += (b[i1] == 0) ? 1 : 0;
+    }
+
+    counters->border = blen - counters->core - counters->noise;
+    counters->clusters = clusters;
+  }
+
+} // dbscan_classify
+
+
 
 /*!
  \brief Expands a cluster found
@@ -215,11 +368,14 @@ const char* clsource = \
  \param kk (in) number of neighbours
  \param datalen (in) number of data items (datalen*features = number of floats in 'data')
  \param features (in) number of features
- \returns 0 = OK, <0 interrupt by flag
+ \param job (in+out) the job, tested once per distance query (NULL = never stops)
+ \param counters (in+out) counters of the search, NULL = not needed
+ \returns 0 = OK, <0 cancelled or deadline passed
  */
 int expandCluster(int key, const short clusternumber,
                   unsigned short *b, const float *data, const float epseps, const int kk,
-                  const int datalen, const int features) {
+                  const int datalen, const int features, struct jobctl *job,
+                  struct agpudm_stats *counters) {
 
 
   b[key] &= 7;            // clear bits 3-15
@@ -233,20 +389,29 @@ int expandCluster(int key, const short clusternumber,
     weiter = 1;               // suppose to quit loop
 
                                 // check if calculations should be aborted
-    rwlockwp_reader_acquire(&abortcalc);
-    if (doabort > 0) {
+    if (jobctl_check(job) != JOBCTL_RUNNING) {
       weiter = 2;
-      ret = -1;
+      ret = -30;
     }
-    rwlockwp_reader_release(&abortcalc);
 
     if (weiter == 1) {        // abort?
 
+      if (counters != NULL) {  // count passes
+        counters->passes++;
+      }
+
+      const long long tr = trace_begin();    // span of the pass
+
                        // iterate over all data items
       for (int i1 = 0; i1 < datalen; i1++) {
 
         if ((b[i1] & 3) == 2) {    // is distance reachable?
 
+          if (jobctl_check(job) != JOBCTL_RUNNING) {    // test once per distance query
+            ret = -30;
+            break;
+          }
+
           b[i1] |= 1;             // set visited
 
           int itemcounter2 = 0;      // count the data items inside radius
@@ -271,6 +436,8 @@ int expandCluster(int key, const short clusternumber,
             }
           }
 
+          dbscan_tally(counters, datalen, itemcounter2 >= kk);
+
                                       // enough data items in radius?
           if (itemcounter2 >= kk) {
 
@@ -296,6 +463,8 @@ int expandCluster(int key, const short clusternumber,
       }
 
                           // interrupt -> exit
+      trace_end(TRACE_ALGO, "dbscan pass", tr, clusternumber);
+
       if (ret < 0) {
         break;
       }
@@ -307,7 +476,6 @@ int expandCluster(int key, const short clusternumber,
 
 
 
-
 /*!
  \brief Performs a DBSCAN search on the CPU (one thread)
  \details
@@ -319,12 +487,14 @@ int expandCluster(int key, const short clusternumber,
  \param eps (in) search radius
  \param kk (in) number of neighbours
  \param features (in) number of features
- \returns >0 number of clusters found (0=only noise points), -1=permature abort,
- -256=too many clusters (number can not be stored with 12 bits)
+ \param job (in+out) the job, tested once per distance query (NULL = never stops)
+ \param counters (in+out) counters of the search, NULL = not needed
+ \returns >0 number of clusters found (0=only noise points), -30=premature abort (cancelled or
+ deadline passed), -256=too many clusters (number can not be stored with 12 bits)
  \mt fully threadsafe
  */
 short dbscan(unsigned short* b, const float* data, const int blen, const float eps, const int kk,
-             const int features) {
+             const int features, struct jobctl *job, struct agpudm_stats *counters) {
 
   short clusternumber = 0;    // initial cluster number (0=noise)
 
@@ -340,11 +510,9 @@ short dbscan(unsigned short* b, const float* data, const int blen, const float e
     if ((b[i1] & 1) == 0) {                         // visited?
 
                                       // check if algorithm should abort?
-      rwlockwp_reader_acquire(&abortcalc);
-      if (doabort > 0) {
-        clusternumber = -1;            // result
+      if (jobctl_check(job) != JOBCTL_RUNNING) {
+        clusternumber = -30;           // result
       }
-      rwlockwp_reader_release(&abortcalc);
 
       if (clusternumber < 0) {              // abort?
         break;
@@ -371,6 +539,8 @@ short dbscan(unsigned short* b, const float* data, const int blen, const float e
         }
       }
 
+      dbscan_tally(counters, blen, itemcounter >= kk);
+
       if (itemcounter < kk) {                   // not enough neighbours?
 
         b[i1] &= 7;                      // set noise (clear bits 3-15)
@@ -385,10 +555,11 @@ short dbscan(unsigned short* b, const float* data, const int blen, const float e
         clusternumber += 1;                // increment number
 
                                     // increase cluster to maximum size possible
-        int ret2 = expandCluster(i1, clusternumber, b, data, epseps, kk, blen, features);
+        int ret2 = expandCluster(i1, clusternumber, b, data, epseps, kk, blen, features, job,
+                                 counters);
 
         if (ret2 < 0) {                  // error during cluster expansion?
-          clusternumber = -1;              // signal error and exit
+          clusternumber = -30;             // signal error and exit
           break;
         }
       }
@@ -400,67 +571,108 @@ short dbscan(unsigned short* b, const float* data, const int blen, const float e
 
 
 
-//see header file
-JNIEXPORT jshort JNICALL
-Java_com_example_dmocl_dbscan_dbscan_1c
-  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features) {
+/*!
+ \brief Deletes the status bits of the cluster numbers
+ \details
+ Shifts the cluster numbers 3 bits to the right, afterwards *b* holds the final cluster numbers
+ (0 = noise).
+ \param b (in+out) cluster numbers + status bits
+ \param blen (in) number of data items
+ \mt fully threadsafe
+ */
+void dbscan_labels(unsigned short* b, const int blen) {
+
+  for (int i1 = 0; i1 < blen; i1++) {
+    b[i1] = (unsigned short) (b[i1] >> 3);
+  }
+
+} // dbscan_labels
 
-  short ret = -1;                   // return value
 
-                              // check architecture
-  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
 
-                                // get length of data array
-    jsize datalen = (*env)->GetArrayLength(env, rf);
-    jsize blen = (*env)->GetArrayLength(env, b);   // get number of data items
+/*!
+ \brief Performs one distance test on the GPU
+ \details
+ Returns the host mapped cluster number buffer to the device, tests the distance of all data
+ items to a given data item with the given kernel and maps the cluster number buffer again.
+ The three commands are chained with events and submitted together, the host waits only once.
+ \param commands (in) the OpenCL command queue
+ \param kernel (in) the OpenCL kernel (testdistance1 or testdistance2)
+ \param b_g (in+out) OpenCL cluster number buffer (must be mapped)
+ \param cmpto (in) the number of the data item the other data items are compared to
+ \param global_size (in) Global work size on the GPU (padded, see ocltune.h)
+ \param local_size (in) Local work size on the GPU (NULL = driver decides)
+ \returns 0 = no error, 1 = unmap failed, 2 = kernel argument could not be set,
+ 3 = kernel could not be enqueued, 4 = map failed
+ \mt fully threadsafe
+ */
+int querydistance_gpu(cl_command_queue commands, cl_kernel kernel, struct oclbuf *b_g,
+                      const int cmpto, const size_t* global_size, const size_t* local_size) {
 
-    if (features * blen == datalen) {   // these must match
+  cl_event unev = NULL;             // events of the three stages
+  cl_event kev = NULL;
+  cl_event mapev = NULL;
 
-                                      // get and pin data items
-      jfloat *condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+  int stage = 0;                    // stage that failed (0 = none)
 
-      if (condata != NULL) {              // error?
+                      // return cluster number buffer to device (non blocking)
+  cl_int err = oclbuf_enqueue_unmap(commands, b_g, 0, NULL, &unev);
 
-                                   // allocate memory for cluster number array
-        unsigned short *conb = (unsigned short *) malloc(sizeof(unsigned short) * blen);
+  if (err == CL_SUCCESS) {             // error?
 
-        if (conb != NULL) {            // malloc error
+    cl_int cmpto_g = cmpto;          // set data item to which to compare to
+                                // set as kernal argument
+    err = clSetKernelArg(kernel, 3, sizeof(cl_int), &cmpto_g);
 
-                               // call dbscan
-          ret = dbscan(conb, (float*) condata, blen, eps, kk, features);
+    if (err == CL_SUCCESS) {                  // error?
 
-          if (ret >= 0) {      // correct result?
+                                  // test distance (after the buffer is back on the device)
+      const long long tq = trace_begin();
+      err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, global_size, local_size, 1, &unev,
+                                   &kev);
+      trace_end(TRACE_OPENCL, "clEnqueueNDRangeKernel", tq, cmpto);
 
-                        // shift left 3 bits (delete status bits)
-            for (int i1 = 0; i1 < blen; i1++) {
-              conb[i1] = (short) (((unsigned short) conb[i1]) >> 3);
-            }
+      if (err == CL_SUCCESS) {           // error?
 
-                                // store cluster numbers
-            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
-          }
+                             // fetch results (after the kernel has finished)
+        if (oclbuf_enqueue_map(commands, b_g, CL_MAP_READ | CL_MAP_WRITE, CL_FALSE, 1, &kev,
+                               &mapev, &err) != NULL) {
 
-          free(conb);                  // free and clean up
+          clFlush(commands);                  // submit the whole chain at once
+
+                              // single wait for the whole chain
+          const long long tw = trace_begin();
+          if (clWaitForEvents(1, &mapev) != CL_SUCCESS) {
+            stage = 4;
+          }
+          trace_end(TRACE_OPENCL, "clWaitForEvents", tw, cmpto);
 
         } else {
-          ret = -105;
+          stage = 4;
         }
 
-        (*env)->ReleaseFloatArrayElements(env, rf, condata, JNI_ABORT);
-
       } else {
-        ret = -104;
+        stage = 3;
       }
+
     } else {
-      ret = -103;
+      stage = 2;
     }
+
   } else {
-    ret = -102;
+    stage = 1;
   }
 
-  return (ret);
+  if (stage > 0) {
+    clFinish(commands);              // nothing may be pending on error
+  }
+
+  oclbuf_release_event(&mapev);      // clean up
+  oclbuf_release_event(&kev);
+  oclbuf_release_event(&unev);
 
-}  // Java_com_example_dmocl_dbscan_dbscan_1c
+  return (stage);
+} // querydistance_gpu
 
 
 
@@ -470,28 +682,30 @@ Java_com_example_dmocl_dbscan_dbscan_1c
  This method expands a cluster found to the largest size possible using the GPU.
  \param key (in) data item number of the new cluster seed
  \param clusternumber (in) cluster number to assign to all members of the cluster
- \param b (out) Cluster number + status bits (Bit 0: data item classified, Bit 1: distance
- reachable from main loop, Bit 2: distance reachable from cluster expansion
- \param data (in) input data
- \param epseps (in) square of search radius
  \param kk (in) number of neighbours
- \param datalen (in) number of data items (datalen*features = number of floats in 'data')
- \param features (in) number of features
+ \param datalen (in) number of data items
  \param commands (in) the OpenCL command queue
  \param kernel_testdistance2 (in) the OpenCL kernel for the cluster expand part
- \param b_g (out) OpenCL cluster number buffer
- \param global_size (in) Global work size on the GPU
- \returns 0 = no error, <0 = error number
+ \param b_g (in+out) OpenCL cluster number buffer, mapped to the host. Cluster number + status bits
+ (Bit 0: data item classified, Bit 1: distance reachable from main loop, Bit 2: distance reachable
+ from cluster expansion
+ \param global_size (in) Global work size on the GPU (padded, see ocltune.h)
+ \param local_size (in) Local work size on the GPU (NULL = driver decides)
+ \param job (in+out) the job, tested once per distance query (NULL = never stops)
+ \param counters (in+out) counters of the search, NULL = not needed
+ \returns 0 = no error, -30 = cancelled or deadline passed, <0 = error number
  \mt fully threadsafe
  */
-short expandCluster_gpu(int key, const short clusternumber,
-                        unsigned short *b, const float *data, const float epseps, const int kk,
-                        const int datalen, const int features,
-                        cl_command_queue commands, cl_kernel kernel_testdistance2, cl_mem b_g,
-                        const size_t* global_size) {
+short expandCluster_gpu(int key, const short clusternumber, const int kk, const int datalen,
+                        cl_command_queue commands, cl_kernel kernel_testdistance2,
+                        struct oclbuf *b_g, const size_t* global_size,
+                        const size_t* local_size, struct jobctl *job,
+                        struct agpudm_stats *counters) {
 
   short ret = 0;                    // return value
 
+  cl_ushort *b = (cl_ushort *) b_g->mapped;      // host view of the cluster numbers
+
   b[key] &= 7;                       // clear bits 3-15
   b[key] |= (clusternumber << 3);       // set current cluster number
 
@@ -502,60 +716,41 @@ short expandCluster_gpu(int key, const short clusternumber,
     weiter = 1;                   // suppose that there are no new data items...
 
                              // test if calculations should be aborted
-    rwlockwp_reader_acquire(&abortcalc);
-    if (doabort > 0) {
+    if (jobctl_check(job) != JOBCTL_RUNNING) {
       weiter = 2;
-      ret = -1;
+      ret = -30;
     }
-    rwlockwp_reader_release(&abortcalc);
 
     if (weiter == 1) {              // abort?
 
+      if (counters != NULL) {       // count passes
+        counters->passes++;
+      }
+
+      const long long tr = trace_begin();    // span of the pass
+
                           // iterate over all data items
       for (int i1 = 0; i1 < datalen; i1++) {
 
         if ((b[i1] & 3) == 2) {    // if reachable but not yet visited...
 
-          b[i1] |= 1;                 // set visited
-
-                              // enqueue cluster number buffer
-          cl_int err = clEnqueueWriteBuffer(commands, b_g, CL_TRUE, 0, sizeof(cl_ushort) * datalen,
-                                            b, 0, NULL, NULL);
-
-          if (err != CL_SUCCESS) {             // error?
-            ret = -5;
-            break;
-          }
-
-          cl_int cmpto_g = i1;          // set data item to which to compare to
-                                      // set as kernal argument
-          err |= clSetKernelArg(kernel_testdistance2, 3, sizeof(cl_int), &cmpto_g);
-
-          if (err != CL_SUCCESS) {                  // error?
-            ret = -6;
+          if (jobctl_check(job) != JOBCTL_RUNNING) {    // test once per distance query
+            ret = -30;
             break;
           }
 
-                                        // test distance
-          err = clEnqueueNDRangeKernel(commands, kernel_testdistance2, 1, NULL, global_size, NULL,
-                                       0, NULL, NULL);
-
-          if (err != CL_SUCCESS) {           // error?
-            ret = -7;
-            break;
-          }
-
-          clFinish(commands);            // wait for kernel
+          b[i1] |= 1;                 // set visited
 
-                                  // fetch results
-          err = clEnqueueReadBuffer(commands, b_g, CL_TRUE, 0, sizeof(cl_ushort) * datalen, b, 0,
-                                    NULL, NULL);
+                                  // test distances on the GPU
+          int stage = querydistance_gpu(commands, kernel_testdistance2, b_g, i1, global_size,
+                                        local_size);
 
-          if (err != CL_SUCCESS) {            // error?
-            ret = -8;
+          if (stage > 0) {             // error?
+            ret = -4 - stage;
             break;
           }
 
+          b = (cl_ushort *) b_g->mapped;       // mapping may have moved
 
           int itemcounter2 = 0;              // holds number of neighbours
 
@@ -566,6 +761,8 @@ short expandCluster_gpu(int key, const short clusternumber,
 
           }
 
+          dbscan_tally(counters, datalen, itemcounter2 >= kk);
+
 
           if (itemcounter2 >= kk) {             // enough neighbours?
 
@@ -588,6 +785,8 @@ short expandCluster_gpu(int key, const short clusternumber,
         }
       }
 
+      trace_end(TRACE_ALGO, "dbscan pass", tr, clusternumber);
+
       if (ret < 0) {       // error -> quit
         break;
       }
@@ -614,124 +813,132 @@ short expandCluster_gpu(int key, const short clusternumber,
  \param device (in) the OpenCL device
  \param kernel_testdistance1 (in) the OpenCL kernel for the main loop
  \param kernel_testdistance2 (in) the OpenCL kernel for the cluster expand part
- \param data_g (in) OpenCL data buffer
- \param b_g (in) OpenCL cluster number buffer
+ \param st (in) data items in device format (see oclstore.h)
+ \param b_g (in) OpenCL cluster number buffer (see oclbuffer.h)
  \param start2 (out) Start time point for exculsive GPU timing
  \param finish2 (out) End time point for exculsive GPU timing
- \returns 0 = no error, <0 = error number
+ \param job (in+out) the job, tested once per distance query (NULL = never stops)
+ \param counters (in+out) counters of the search, NULL = not needed
+ \returns >=0 number of clusters found, -30 = cancelled or deadline passed, <0 = error number
  \mt fully threadsafe
  */
 short dbscan_gpu( cl_ushort* b, const cl_float* data, const int blen, const float eps, const int kk,
            const int features,
            cl_command_queue commands, cl_program program, cl_device_id device,
            cl_kernel kernel_testdistance1, cl_kernel kernel_testdistance2,
-           cl_mem data_g, cl_mem b_g, struct timespec *start2, struct timespec *finish2) {
+           const struct oclstore* st, struct oclbuf* b_g, struct timespec *start2,
+           struct timespec *finish2, struct jobctl *job, struct agpudm_stats *counters) {
 
   short clusternumber = 0;            // number of cluster found
 
                         // convert variables to cl-fromat
   const cl_float epseps = eps * eps;            // caclulate square radius
   const cl_int features_g = features;
-  size_t global_size = blen;
+  const cl_int blen_g = blen;
+  const cl_int cmpto_g = 0;
+  const cl_mem exact_g = oclstore_exact(st);   // single precision data items for rechecks
+  cl_float lo, hi;                             // range of borderline distances
+  oclstore_bounds(st, eps, &lo, &hi);
 
                               // set kernel arguments
-  cl_int err = clSetKernelArg(kernel_testdistance1, 0, sizeof(cl_mem), &data_g);
-  err |= clSetKernelArg(kernel_testdistance1, 1, sizeof(cl_mem), &b_g);
+  cl_int err = clSetKernelArg(kernel_testdistance1, 0, sizeof(cl_mem), &st->data_g.mem);
+  err |= clSetKernelArg(kernel_testdistance1, 1, sizeof(cl_mem), &b_g->mem);
   err |= clSetKernelArg(kernel_testdistance1, 2, sizeof(cl_int), &features_g);
+  err |= clSetKernelArg(kernel_testdistance1, 3, sizeof(cl_int), &cmpto_g);
   err |= clSetKernelArg(kernel_testdistance1, 4, sizeof(cl_float), &epseps);
+  err |= clSetKernelArg(kernel_testdistance1, 5, sizeof(cl_int), &blen_g);
+  err |= clSetKernelArg(kernel_testdistance1, 6, sizeof(cl_mem), &exact_g);
+  err |= clSetKernelArg(kernel_testdistance1, 7, sizeof(cl_mem), &st->qparam_g);
+  err |= clSetKernelArg(kernel_testdistance1, 8, sizeof(cl_float), &lo);
+  err |= clSetKernelArg(kernel_testdistance1, 9, sizeof(cl_float), &hi);
 
   if (err != CL_SUCCESS) {               // error?
     return (-20);
   }
 
                                      // set kernel arguments
-  err = clSetKernelArg(kernel_testdistance2, 0, sizeof(cl_mem), &data_g);
-  err |= clSetKernelArg(kernel_testdistance2, 1, sizeof(cl_mem), &b_g);
+  err = clSetKernelArg(kernel_testdistance2, 0, sizeof(cl_mem), &st->data_g.mem);
+  err |= clSetKernelArg(kernel_testdistance2, 1, sizeof(cl_mem), &b_g->mem);
   err |= clSetKernelArg(kernel_testdistance2, 2, sizeof(cl_int), &features_g);
+  err |= clSetKernelArg(kernel_testdistance2, 3, sizeof(cl_int), &cmpto_g);
   err |= clSetKernelArg(kernel_testdistance2, 4, sizeof(cl_float), &epseps);
+  err |= clSetKernelArg(kernel_testdistance2, 5, sizeof(cl_int), &blen_g);
+  err |= clSetKernelArg(kernel_testdistance2, 6, sizeof(cl_mem), &exact_g);
+  err |= clSetKernelArg(kernel_testdistance2, 7, sizeof(cl_mem), &st->qparam_g);
+  err |= clSetKernelArg(kernel_testdistance2, 8, sizeof(cl_float), &lo);
+  err |= clSetKernelArg(kernel_testdistance2, 9, sizeof(cl_float), &hi);
 
   if (err != CL_SUCCESS) {                   // error?
     return (-21);
   }
 
+                   // get (or tune) local and global work size, the buffer is initialized later
+  struct ocltune_cfg tcfg1, tcfg2;
+  ocltune_get(commands, device, kernel_testdistance1, "testdistance1", blen, &tcfg1);
+  ocltune_get(commands, device, kernel_testdistance2, "testdistance2", blen, &tcfg2);
+
+  const size_t global_size1 = ocltune_global(&tcfg1, blen);   // padded work sizes
+  const size_t global_size2 = ocltune_global(&tcfg2, blen);
+
 #ifdef GPUTIMING
                                       // get start time
   clock_gettime(CLOCK_REALTIME, start2);
 #endif
 
+                         // access the cluster number buffer on the host
+  cl_ushort *bm = (cl_ushort *) oclbuf_map(commands, b_g, CL_MAP_WRITE_INVALIDATE_REGION, &err);
+
+  if (bm == NULL) {                          // error?
+    clusternumber = -21;
+  } else {
+
                          // initialize the cluster number array
-  for (int i1 = 0; i1 < blen; i1++) {
-    b[i1] = 0;
+    for (int i1 = 0; i1 < blen; i1++) {
+      bm[i1] = 0;
+    }
   }
 
                                     // iterate over all data points
-  for (int i1 = 0; i1 < blen; i1++) {
+  for (int i1 = 0; (i1 < blen) && (clusternumber >= 0); i1++) {
 
-    if ((b[i1] & 1) == 0) {                       // visited ?
+    if ((bm[i1] & 1) == 0) {                       // visited ?
 
                                 // test if algorithm should abort
-      rwlockwp_reader_acquire(&abortcalc);
-      if (doabort > 0) {
-        clusternumber = -1;
+      if (jobctl_check(job) != JOBCTL_RUNNING) {
+        clusternumber = -30;
       }
-      rwlockwp_reader_release(&abortcalc);
 
       if (clusternumber < 0) {                 // terminate?
         break;
       }
 
-      b[i1] |= 1;                          // set visited bit
-
-                             // copy cluster number buffer
-      err = clEnqueueWriteBuffer(commands, b_g, CL_TRUE, 0, sizeof(cl_ushort) * blen, b, 0, NULL,
-                                 NULL);
-
-      if (err != CL_SUCCESS) {             // error?
-        clusternumber = -21;
-        break;
-      }
-
-      cl_int cmpto_g = i1;                // set data item number to which to compare
-                                        // set kernel arg
-      err |= clSetKernelArg(kernel_testdistance1, 3, sizeof(cl_int), &cmpto_g);
-
-      if (err != CL_SUCCESS) {               // error?
-        clusternumber = -22;
-        break;
-      }
+      bm[i1] |= 1;                          // set visited bit
 
                                      // perform distance test
-      err = clEnqueueNDRangeKernel(commands, kernel_testdistance1, 1, NULL, &global_size, NULL, 0,
-                                   NULL, NULL);
+      int stage = querydistance_gpu(commands, kernel_testdistance1, b_g, i1, &global_size1,
+                                    ocltune_local(&tcfg1));
 
-      if (err != CL_SUCCESS) {                // error?
-        clusternumber = -23;
+      if (stage > 0) {                // error?
+        clusternumber = -20 - stage;
         break;
       }
 
-      clFinish(commands);              // wait on results
-
-                              // get cluster numbers
-      err = clEnqueueReadBuffer(commands, b_g, CL_TRUE, 0, sizeof(cl_ushort) * blen, b, 0, NULL,
-                                NULL);
-
-      if (err != CL_SUCCESS) {                   // error?
-        clusternumber = -24;
-        break;
-      }
+      bm = (cl_ushort *) b_g->mapped;         // mapping may have moved
 
       int itemcounter = 0;               // holds number of neighbours
 
                                       // count all neighbours
       for (int i2 = 0; i2 < blen; i2++) {
 
-        itemcounter += (b[i2] >> 1) & 1;
+        itemcounter += (bm[i2] >> 1) & 1;
 
       }
 
+      dbscan_tally(counters, blen, itemcounter >= kk);
+
       if (itemcounter < kk) {           // enough?
 
-        b[i1] &= 7;                  // no -> mark as noise
+        bm[i1] &= 7;                  // no -> mark as noise
 
       } else {
 
@@ -745,18 +952,32 @@ short dbscan_gpu( cl_ushort* b, const cl_float* data, const int blen, const floa
         clusternumber += 1;                   // increment counter
 
                       // expand cluster
-        short rret = expandCluster_gpu(i1, clusternumber, b, data, epseps, kk, blen, features,
-                                       commands, kernel_testdistance2, b_g, &global_size);
+        short rret = expandCluster_gpu(i1, clusternumber, kk, blen, commands, kernel_testdistance2,
+                                       b_g, &global_size2, ocltune_local(&tcfg2), job, counters);
 
         if (rret < 0) {                   // error?
           clusternumber = rret;          // return
           break;
         }
 
+        bm = (cl_ushort *) b_g->mapped;       // mapping may have moved
       }
     }
   }
 
+  if (b_g->mapped != NULL) {            // still mapped?
+
+    if (b_g->mapped != b) {             // mapped memory -> copy cluster numbers
+      memcpy(b, b_g->mapped, sizeof(cl_ushort) * blen);
+    }
+
+    oclbuf_unmap(commands, b_g);        // return buffer to device
+  }
+
+  const long long tf = trace_begin();
+  clFinish(commands);                   // no command may be pending
+  trace_end(TRACE_OPENCL, "clFinish", tf, 0);
+
 #ifdef GPUTIMING
                    // second timepoint
   clock_gettime(CLOCK_REALTIME, finish2);
@@ -768,435 +989,392 @@ short dbscan_gpu( cl_ushort* b, const cl_float* data, const int blen, const floa
 
 
 
+/*!
+ \brief DBSCAN search on the first OpenCL device
+ \details
+ Selects the first device of the first platform, builds the program for the storage format,
+ creates the buffers and performs the search with dbscan_gpu. Used by the JNI methods and by
+ the job scheduler (see jobsched.h).
+ \param b (out) cluster numbers (blen values, 0 = noise)
+ \param data (in) input data
+ \param blen (in) number of data items (blen*features = number of floats in 'data')
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features
+ \param storage (in) storage of the data items on the device (OCLSTORE_FP32, _FP16 or _INT8)
+ \param inplace (in) 1 = the device works directly on *data* and *b* (CL_MEM_USE_HOST_PTR, also on
+ unified memory), 0 = the driver allocates the buffers on unified memory
+ \param job (in+out) the job
+ \param counters (in+out) counters of the search, NULL = not needed
+ \param elapsed (out) exclusive runtime in ns (only with GPUTIMING, NULL = not needed)
+ \returns >=0 number of clusters found, -30 = cancelled or deadline passed, -107 .. -121 =
+ OpenCL error while setting up the device, other negative values = error of dbscan_gpu
+ \mt fully threadsafe
+ */
+short dbscan_run_gpu(cl_ushort* b, const cl_float* data, const int blen, const float eps,
+                     const int kk, const int features, const int storage, const int inplace,
+                     struct jobctl* job, struct agpudm_stats* counters, long long* elapsed) {
 
-// see header file
-JNIEXPORT jshort JNICALL
-Java_com_example_dmocl_dbscan_dbscan_1c_1gpu
-  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
-   jlongArray e) {
-
-  struct timespec start2, finish2;                // hold two timepoints
+  struct timespec start2 = {0, 0}, finish2 = {0, 0};   // hold two timepoints
 
   short ret = -1;                                 // return variable
 
-                                       // architecture check
-  if ((sizeof(jshort) == sizeof(cl_ushort)) && (sizeof(jfloat) == sizeof(cl_float))) {
-
-    jsize datalen = (*env)->GetArrayLength(env, rf);        // get number of floats in data array
-    jsize blen = (*env)->GetArrayLength(env, b);            // get number of data items
-
-    if (features * blen == datalen) {                   // must match
-
-                                  // pin data items and get reference
-      jfloat *condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+  cl_uint numplatf;                  // holds number of platforms
+  cl_int err = clGetPlatformIDs(0, NULL, &numplatf);
+                               // get number of platforms
 
-      if (condata != NULL) {                         // error?
+  if (err == CL_SUCCESS) {                // error?
 
-                                // allocate array for cluster numbers
-        cl_ushort* conb = (cl_ushort*) malloc(sizeof(cl_ushort) * blen);
+    if (numplatf >= 1) {               // there must be at least one
 
-        if (conb != NULL) {                   // malloc error?
+      cl_platform_id platf;               // holds platform info
 
-          cl_uint numplatf;                  // holds number of platforms
-          cl_int err = clGetPlatformIDs(0, NULL, &numplatf);
-                                       // get number of platforms
+                                            // get platform info
+      err = clGetPlatformIDs(1, &platf, NULL);
 
-          if (err == CL_SUCCESS) {                // error?
+      if (err == CL_SUCCESS) {                // error?
 
-            if (numplatf >= 1) {               // there must be at least one
+        cl_uint numdevices;             // holds number of devices for platform #1
 
-              cl_platform_id platf;               // holds platform info
+                              //  get device info
+        err = clGetDeviceIDs(platf, CL_DEVICE_TYPE_ALL, 0, NULL, &numdevices);
 
-                                                    // get platform info
-              err = clGetPlatformIDs(1, &platf, NULL);
+        if (err == CL_SUCCESS) {            // error?
 
-              if (err == CL_SUCCESS) {                // error?
+          if (numdevices >= 1) {          // at least one device?
 
-                cl_uint numdevices;             // holds number of devices for platform #1
+            cl_device_id dev;           // stores device info
 
-                                      //  get device info
-                err = clGetDeviceIDs(platf, CL_DEVICE_TYPE_ALL, 0, NULL, &numdevices);
+                                                 // get device info for device #1
+            err = clGetDeviceIDs(platf, CL_DEVICE_TYPE_ALL, 1, &dev, NULL);
 
-                if (err == CL_SUCCESS) {            // error?
+            if (err == CL_SUCCESS) {               // error?
 
-                  if (numdevices >= 1) {          // at least one device?
 
-                    cl_device_id dev;           // stores device info
+                            // create a context with the specified
+                               // platform and device
+              const long long tc = trace_begin();
+              cl_context context = clCreateContext(NULL, 1, &dev, NULL, NULL, &err);
 
-                                                         // get device info for device #1
-                    err = clGetDeviceIDs(platf, CL_DEVICE_TYPE_ALL, 1, &dev, NULL);
+              if (context != NULL) {               // error?
 
-                    if (err == CL_SUCCESS) {               // error?
+                cl_command_queue commands;        // compute command queue
 
+                            // Create a (if possible out-of-order) command queue
+                commands = oclbuf_create_queue(context, dev, &err);
+                trace_end(TRACE_SETUP, "clCreateContext", tc, 0);
 
-                                    // create a context with the specified
-                                       // platform and device
-                      cl_context context = clCreateContext(NULL, 1, &dev, NULL, NULL, &err);
+                if (commands != NULL) {                    // error?
 
-                      if (context != NULL) {               // error?
+                                                           // create program
+                  cl_program program = clCreateProgramWithSource(context, 1, &dbscan_clsource,
+                                                                 NULL, &err);
 
-                        cl_command_queue commands;        // compute command queue
+                  if (program != NULL) {               // error?
 
-                                                            // Create a command queue
-                        commands = clCreateCommandQueue(context, dev, 0, &err);
+                    struct oclstore st;         // data items in device format
 
-                        if (commands != NULL) {                    // error?
+                               // convert data items (once, before the upload)
+                    err = oclstore_convert(&st, data, blen, features,
+                                           storage);
 
-                                                                   // create program
-                          cl_program program = clCreateProgramWithSource(context, 1, &clsource,
-                                                                         NULL, &err);
-
-                          if (program != NULL) {               // error?
-
-                                                               // build program
-                            err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-
-                            if (err == CL_SUCCESS) {                  // error?
-
-                              cl_kernel kernel_testdistance1;        // holds first kernel
-
-                                                                       // extract kernel #1
-                              kernel_testdistance1 = clCreateKernel(program, "testdistance1",
-                                                                    &err);
-
-                              if (err == CL_SUCCESS) {               // error?
-
-                                cl_kernel kernel_testdistance2;    // holds kernel #2
-
-                                                                       // extract kernel #2
-                                kernel_testdistance2 = clCreateKernel(program, "testdistance2",
-                                                                      &err);
+                    if (err == CL_SUCCESS) {
+                                         // build program for the storage format
+                      const long long tb = trace_begin();
+                      err = clBuildProgram(program, 0, NULL, oclstore_options(&st), NULL,
+                                           NULL);
+                      trace_end(TRACE_SETUP, "clBuildProgram", tb, 0);
+                    }
 
-                                if (err == CL_SUCCESS) {                // error?
+                    if (err == CL_SUCCESS) {                  // error?
 
+                      cl_kernel kernel_testdistance1;        // holds first kernel
 
-                                                    // create first buffer (for data items)
-                                  cl_mem data_g = clCreateBuffer(context,
-                                                                 CL_MEM_READ_ONLY |
-                                                                 CL_MEM_USE_HOST_PTR,
-                                                                 sizeof(cl_float) * datalen,
-                                                                 condata, &err);
+                                                               // extract kernel #1
+                      kernel_testdistance1 = clCreateKernel(program, "testdistance1",
+                                                            &err);
 
-                                  if (data_g != NULL) {                 // error?
+                      if (err == CL_SUCCESS) {               // error?
 
-                                                  // create second buffer (for cluster numbers)
-                                    cl_mem b_g = clCreateBuffer(context,
-                                                                CL_MEM_READ_WRITE |
-                                                                CL_MEM_USE_HOST_PTR,
-                                                                sizeof(cl_ushort) * blen, conb,
-                                                                &err);
+                        cl_kernel kernel_testdistance2;    // holds kernel #2
 
-                                    if (b_g != NULL) {              // error?
+                                                               // extract kernel #2
+                        kernel_testdistance2 = clCreateKernel(program, "testdistance2",
+                                                              &err);
 
-                                                  // call dbscan
-                                      ret = dbscan_gpu(conb, (cl_float *) condata, blen, eps, kk,
-                                                       features,
-                                                       commands, program, dev,
-                                                       kernel_testdistance1, kernel_testdistance2,
-                                                       data_g, b_g, &start2, &finish2);
+                        if (err == CL_SUCCESS) {                // error?
 
-                                      if (ret >= 0) {          // error?
-                                                       // no -> delete first three bits
-                                        for (int i1 = 0; i1 < blen; i1++) {
-                                          conb[i1] = conb[i1] >> 3;
-                                        }
 
-                                                         // copy results
-                                        (*env)->SetShortArrayRegion(env, b, 0, blen,
-                                                                    (jshort *) conb);
-                                      }
+                                      // zero copy buffers on unified memory?
+                          int bufmode = oclbuf_strategy(dev);
 
-                                      clReleaseMemObject(b_g);        // release buffer
+                                      // caller's arrays back the buffers?
+                          int hostmode = (inplace == 1) ? (bufmode | OCLBUF_INPLACE) : bufmode;
 
-                                    } else {
-                                      ret = -121;
-                                    }
+                          struct oclbuf b_g;          // buffer
 
-                                    clReleaseMemObject(data_g);          // release buffer
+               // create first buffer (for data items, exact copy for the rechecks)
+                          err = oclstore_create(&st, context, hostmode, 1);
 
-                                  } else {
-                                    ret = -120;
-                                  }
+                          if (err == CL_SUCCESS) {                 // error?
 
-                                  clReleaseKernel(kernel_testdistance2);    // release kernel
+                                          // create second buffer (for cluster numbers)
+                            err = oclbuf_create(&b_g, context, CL_MEM_READ_WRITE,
+                                                sizeof(cl_ushort) * blen,
+                                                (hostmode == OCLBUF_MAP) ? NULL : b,
+                                                hostmode);
 
-                                } else {
-                                  ret = -119;
-                                }
+                            if (err == CL_SUCCESS) {              // error?
 
-                                clReleaseKernel(kernel_testdistance1);    // release kernel
+                                          // call dbscan
+                              ret = dbscan_gpu(b, data, blen, eps, kk, features,
+                                               commands, program, dev,
+                                               kernel_testdistance1,
+                                               kernel_testdistance2,
+                                               &st, &b_g, &start2, &finish2, job, counters);
 
-                              } else {
-                                ret = -118;
+                              if (ret >= 0) {          // error?
+                                dbscan_labels(b, blen);    // no -> delete status bits
                               }
 
+                              oclbuf_release(&b_g);           // release buffer
+
                             } else {
-                              ret = -117;
+                              ret = -121;
                             }
 
-                            clReleaseProgram(program);            // release program
+                            oclstore_release(&st);             // release buffers
 
                           } else {
-                            ret = -116;
-
+                            ret = -120;
                           }
 
-                          clReleaseCommandQueue(commands);         // release command queue
+                          clReleaseKernel(kernel_testdistance2);    // release kernel
 
                         } else {
-                          ret = -115;
+                          ret = -119;
                         }
 
-                        clReleaseContext(context);                // release context
+                        clReleaseKernel(kernel_testdistance1);    // release kernel
 
                       } else {
-                        ret = -114;
-
+                        ret = -118;
                       }
+
                     } else {
-                      ret = -111;
+                      ret = -117;
                     }
+
+                    oclstore_free(&st);            // release converted data items
+
+                    clReleaseProgram(program);            // release program
+
                   } else {
+                    ret = -116;
 
-                    ret = -112;
                   }
+
+                  clReleaseCommandQueue(commands);         // release command queue
+
                 } else {
-                  ret = -110;
+                  ret = -115;
                 }
+
+                clReleaseContext(context);                // release context
+
               } else {
-                ret = -109;
+                ret = -114;
+
               }
             } else {
-              ret = -108;
+              ret = -111;
             }
           } else {
-            ret = -107;
-          }
-
-          free(conb);              // free cluster number buffer
 
+            ret = -112;
+          }
         } else {
-          ret = -105;
+          ret = -110;
         }
-
-        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
-                         // unpin data item array
-
       } else {
-        ret = -104;
+        ret = -109;
       }
     } else {
-      ret = -103;
+      ret = -108;
     }
   } else {
-    ret = -102;
+    ret = -107;
   }
 
 #ifdef GPUTIMING
                // calculate time elapsed
-  long long int elapsed2 = ((long long int) (finish2.tv_sec - start2.tv_sec)) * 1000000000L;
-  elapsed2 += (finish2.tv_nsec - start2.tv_nsec);
-
-            // pin array, store time and unpin array
-  jlong *edata = (*env)->GetLongArrayElements(env, e, NULL);
-  edata[0] = elapsed2;
-  (*env)->ReleaseLongArrayElements(env, e, edata, 0);
+  if (elapsed != NULL) {
+    *elapsed = ((long long) (finish2.tv_sec - start2.tv_sec)) * 1000000000LL +
+               (finish2.tv_nsec - start2.tv_nsec);
+  }
 #endif
 
-
   return (ret);
-}  // Java_com_example_dmocl_dbscan_dbscan_1c_1gpu
+
+} // dbscan_run_gpu
 
 
 
 /*!
- \brief Parameters for the DBSCAN thread
+ \brief Item counter of a participant
  \details
-This struct holds the parameters for each DBSCAN thread. (in) means parameters that are NOT changed
-by the thread but may be changed by the method that submits the job. (const) means that the value is
-never changed after setup. (out) attributes are changed by the threads.
-This struct is used by two threads (dbscanthread1 and dbscanthread2).
-This struct may be used only by one of these two threads. The caller has to take care that this
-struct is not used by both threads at the same time.
-Nevertheless, all (const) attributes are readonly after initialization and may be read at any time.
+ Padded to a cache line, the participants add their results without sharing a line.
  */
-struct dbscan_pt {
+struct dbscan_count {
 
-  unsigned short int status;         //!< (const) status (needed only for setup and destruction)
+  int n;                           //!< number of items within radius
 
-  int num;                            //!< (const) number of thread
-  unsigned short *b;               //!< (out) number of closest cluster center
-  float *data;                      //!< (const) input data
-  int blen;                         //!< (const) number of data items
-  float eps;                        //!< (const) radius
-  int kk;                           //!< (const) number of neighbours
-  int features;                      //!< (const) number of features per data item
-  int start;                        //!< (const) first data item
-  int len;                             //!< (const) last data item
+} __attribute__((aligned(THREADPOOL_CACHELINE)));   // dbscan_count
 
-  pthread_t thread1;                 //!< (const) holds the thread reference for the main loop thread
-  pthread_t thread2;             //!< (const) holds the thread reference for the cluster expand thread
-  sem_t sem1;                    //!< (in) semaphore to wait on (main loop thread)
-  sem_t semret1;                 //!< (in) results ready sempahore (main loop thread)
-  sem_t sem2;                   //!< (in) semaphore to wait on (cluster expand thread)
-  sem_t semret2;                    //!< (in) results ready sempahore (cluster expand thread)
 
-                             // variables for the main loop thread
-  pthread_mutex_t MUTEX_var1;             //!< (in) lock the access to cmpto1 and itemcounter1
-  volatile int cmpto1;                    //!< (in) data item number to which to compare all others
-  volatile int itemcounter1;              //!< (out) number of itmes within radius
 
-  pthread_mutex_t MUTEX_var2;             //!< (in) lock the access to cmpto2 and itemcounter2
-  volatile int cmpto2;                    //!< (in) data item number to which to compare all others
-  volatile int itemcounter2;              //!< (out) number of itmes within radius
+/*!
+ \brief Parameters for the DBSCAN chunks
+ \details
+This struct holds the parameters of the DBSCAN distance tests. (in) means parameters that are NOT
+changed by the chunks but may be changed by the method that submits the loop. (const) means that
+the value is never changed after setup. (out) attributes are changed by the chunks.
+The same struct is used for the main loop (dbscanthread1) and for the cluster expansion
+(dbscanthread2), one loop at a time. The submitting method must not access any (in) or (out)
+field while the loop is running; threadpool_sched_wait makes the results visible.
+ */
+struct dbscan_pt {
 
-  pthread_mutex_t MUTEX_fertig1;          //!< (in) locks the access to fertig1
-  volatile unsigned char fertig1;         //!< (in) 1=terminate thread
+  unsigned short *b;               //!< (out) number of closest cluster center
+  const float *data;                //!< (const) input data
+  float epseps;                     //!< (const) square radius
+  int features;                      //!< (const) number of features per data item
 
-  pthread_mutex_t MUTEX_fertig2;          //!< (in) locks the access to fertig2
-  volatile unsigned char fertig2;         //!< (in) 1=terminate thread
+  int cmpto;                    //!< (in) data item number to which to compare all others
+  struct dbscan_count *itemcounter;   //!< (out) number of itmes within radius (per participant)
 
 };   // dbscan_pt
 
 
 
-
 /*!
- \brief Distance test for cluster expansion
+ \brief Distance test for the main loop
  \details
  This method is designed to test in parallel the distance to a given point and mark the
  data items that are within a defined radius. This method is called from the main DBSCAN loop.
- The workload is parallelized over the data items. The first and
- the last data item to used are defined in the struct passed as  argument.
+ The workload is parallelized over the data items in chunks.
  \param arg (in+out) a pointer to the parameter struct
- \returns NULL
+ \param part (in) number of the participant
+ \param start (in) first data item
+ \param len (in) number of data items
  */
-void* dbscanthread1(void* arg) {
+void dbscanthread1(void* arg, int part, int start, int len) {
 
                              // cast arguments
   struct dbscan_pt *f = (struct dbscan_pt *) arg;
 
-  int weiter = 0;                            // loop condition
-  float epseps = f->eps * f->eps;              // square radius
-
-  while (weiter == 0) {                      // loop until externally aborted
-
-    sem_wait(&f->sem1);                        // wait on data
-
-    unsigned char temp;                          // test if finished
-    pthread_mutex_lock(&f->MUTEX_fertig1);
-    temp = f->fertig1;
-    pthread_mutex_unlock(&f->MUTEX_fertig1);
-
-    if (temp == 0) {                                 // do abort?
-
-      pthread_mutex_lock(&f->MUTEX_var1);          // lock access to struct
-
-      int itemcounter = 0;                           // counts the number of data items inside radius
+  int itemcounter = 0;                           // counts the number of data items inside radius
 
                                         // iterate over data items assigned
-      for (int i2 = f->start; i2 < f->start + f->len; i2++) {
-
+  for (int i2 = start; i2 < start + len; i2++) {
 
-        f->b[i2] &= MAXVALUE - 6;              // clear bits 2 and 3
 
-        float s = 0;                             // holds the euclidean distance
+    f->b[i2] &= MAXVALUE - 6;              // clear bits 2 and 3
 
-                                            // calculate distance
-        for (int i3 = 0; i3 < f->features; i3++) {
-          s += powf(f->data[i2 * f->features + i3] - f->data[f->cmpto1 * f->features + i3], 2);
-        }
+    float s = 0;                             // holds the euclidean distance
 
-        if (s <= epseps) {                                // inside radius
-
-          f->b[i2] |= 2;                          // set distance bit
-          itemcounter++;                              // step counter
-        }
-      }
-
-      f->itemcounter1 = itemcounter;                   // save number of items inside radius
+                                        // calculate distance
+    for (int i3 = 0; i3 < f->features; i3++) {
+      s += powf(f->data[i2 * f->features + i3] - f->data[f->cmpto * f->features + i3], 2);
+    }
 
-      pthread_mutex_unlock(&f->MUTEX_var1);    // unlock access to struct
+    if (s <= f->epseps) {                                // inside radius
 
-      sem_post(&f->semret1);                         // signal results ready
-    } else {
-      weiter = 1;                            // exit loop and terminate thread
+      f->b[i2] |= 2;                          // set distance bit
+      itemcounter++;                              // step counter
     }
   }
 
-  return (NULL);
+  f->itemcounter[part].n += itemcounter;          // add number of items inside radius
 
 }  // dbscanthread1
 
 
 
-
 /*!
  \brief Distance test for cluster expansion
  \details
  This method is designed to test in parallel the distance to a given point and mark the
  data items that are within a defined radius. This method is called during the
- cluster expansion. The workload is parallelized over the data items. The first and
- the last data item to used are defined in the struct passed as  argument.
+ cluster expansion. The workload is parallelized over the data items in chunks.
  \param arg (in+out) a pointer to the parameter struct
- \returns NULL
+ \param part (in) number of the participant
+ \param start (in) first data item
+ \param len (in) number of data items
  */
-void* dbscanthread2(void* arg) {
+void dbscanthread2(void* arg, int part, int start, int len) {
 
   struct dbscan_pt *f = (struct dbscan_pt *) arg;    // cast arguments
 
-  int weiter = 0;                        // loop condition variable
-  float epseps = f->eps * f->eps;            // calculate square radius
+  int itemcounter = 0;                     // items that are inside radius
 
-  while (weiter == 0) {               // continue until externally aborted
+                                // iterate over all assigned items
+  for (int i2 = start; i2 < start + len; i2++) {
 
-    sem_wait(&f->sem2);                      // wait on signal
+    f->b[i2] &= MAXVALUE - 4;     // clear bit 4
 
-    unsigned char temp;                        // check if thread should terminate
-    pthread_mutex_lock(&f->MUTEX_fertig2);
-    temp = f->fertig2;
-    pthread_mutex_unlock(&f->MUTEX_fertig2);
+    float s = 0;              // holds eulidean distance
 
-    if (temp == 0) {                       // do abort?
+    for (int i3 = 0; i3 < f->features; i3++) {
+      s += powf(f->data[i2 * f->features + i3] - f->data[f->cmpto * f->features + i3], 2);
+    }
 
-      pthread_mutex_lock(&f->MUTEX_var2);             // lock the variables of the struct
+    if (s <= f->epseps) {                // inside radius?
 
-      int itemcounter = 0;                     // items that are inside radius
+      f->b[i2] |= 4;                  // set distance bit
+      itemcounter++;                 // step counter
+    }
+  }
 
-                                    // iterate over all assigned items
-      for (int i2 = f->start; i2 < f->start + f->len; i2++) {
+  f->itemcounter[part].n += itemcounter;      // add result
 
-        f->b[i2] &= MAXVALUE - 4;     // clear bit 4
+}  // dbscanthread2
 
-        float s = 0;              // holds eulidean distance
 
-        for (int i3 = 0; i3 < f->features; i3++) {
-          s += powf(f->data[i2 * f->features + i3] - f->data[f->cmpto2 * f->features + i3], 2);
-        }
 
-        if (s <= epseps) {                // inside radius?
-
-          f->b[i2] |= 4;                  // set distance bit
-          itemcounter++;                 // step counter
-        }
-      }
+/*!
+ \brief Runs a distance test on the thread pool
+ \details
+ Distributes the distance test among the participants of the scheduler and waits until all data
+ items have been tested.
+ \param fn (in) dbscanthread1 (main loop) or dbscanthread2 (cluster expansion)
+ \param cmpto (in) data item number to which to compare all others
+ \param blen (in) number of data items
+ \param dbparam (in+out) the parameters of the distance test
+ \param sched (in+out) the scheduler
+ \returns number of data items within radius
+ */
+int dbscan_query(threadpool_loopfn fn, const int cmpto, const int blen,
+                 struct dbscan_pt *dbparam, struct threadpool_sched *sched) {
 
-      f->itemcounter2 = itemcounter;      // save result
+  dbparam->cmpto = cmpto;
 
-      pthread_mutex_unlock(&f->MUTEX_var2);         // unlock struct
+  for (int i2 = 0; i2 < sched->parts; i2++) {
+    dbparam->itemcounter[i2].n = 0;          // reset counters
+  }
 
+  threadpool_sched_submit(sched, fn, dbparam, blen);
+  threadpool_sched_wait(sched);            // wait until all data items are tested
 
-      sem_post(&f->semret2);             // signal that results are ready
+  int itemcounter = 0;                     // total item count
 
-    } else {
-      weiter = 1;                          // abort
-    }
+  for (int i2 = 0; i2 < sched->parts; i2++) {
+    itemcounter += dbparam->itemcounter[i2].n;  // add up items found
   }
 
-  return (NULL);
-
-}  // dbscanthread2
+  return (itemcounter);
 
+} // dbscan_query
 
 
 
@@ -1208,19 +1386,18 @@ void* dbscanthread2(void* arg) {
  \param clusternumber (in) number of current cluster
  \param b (out) Cluster number + status bits (Bit 0: data item classified, Bit 1: distance
     reachable from main loop, Bit 2: distance reachable from cluster expansion
- \param data (in) input data
- \param epseps (in) square search radius
  \param kk (in) number of neighbours
- \param datalen (in) number of data items (blen*features = number of floats in 'data')
- \param features (in) number of features
- \param cores (in) number of threads to be used (CPU may be oversubscribed)
- \param dbthreads (in) Array of structs (of length 'cores') that holds the thread infos
+ \param datalen (in) number of data items
+ \param dbparam (in+out) the parameters of the distance tests
+ \param sched (in+out) the scheduler (one participant per core, CPU may be oversubscribed)
+ \param job (in+out) the job, tested once per distance query (NULL = never stops)
+ \param counters (in+out) counters of the search, NULL = not needed
  \returns 0=OK, <0 error (premature abort)
  */
 short expandCluster_pthreads(int key, const short clusternumber,
-                             unsigned short *b, const float *data, const float epseps, const int kk,
-                             const int datalen, const int features,
-                             const int cores, struct dbscan_pt *dbthreads) {
+                             unsigned short *b, const int kk, const int datalen,
+                             struct dbscan_pt *dbparam, struct threadpool_sched *sched,
+                             struct jobctl *job, struct agpudm_stats *counters) {
 
   short ret = 0;              // return value
 
@@ -1236,39 +1413,38 @@ short expandCluster_pthreads(int key, const short clusternumber,
     weiter = 1;                    // assume that there are no new data items
 
                         // check if calculations should be aborted
-    rwlockwp_reader_acquire(&abortcalc);
-    if (doabort > 0) {
+    if (jobctl_check(job) != JOBCTL_RUNNING) {
       weiter = 2;
-      ret = -1;
+      ret = -30;
     }
-    rwlockwp_reader_release(&abortcalc);
 
     if (weiter == 1) {                    // abort?
+
+      if (counters != NULL) {             // count passes
+        counters->passes++;
+      }
+
+      const long long tr = trace_begin();    // span of the pass
+
                                     // iterate over data items
       for (int i1 = 0; i1 < datalen; i1++) {
 
 
         if ((b[i1] & 3) == 2) {             // has already been classified as cluster member?
 
+          if (jobctl_check(job) != JOBCTL_RUNNING) {    // test once per distance query
+            ret = -30;
+            break;
+          }
+
           b[i1] |= 1;                     // set visited bit
 
 
                                     // search for new cluster members
-          for (int i2 = 0; i2 < cores; i2++) {
-            pthread_mutex_lock(&dbthreads[i2].MUTEX_var2);
-            dbthreads[i2].cmpto2 = i1;
-            pthread_mutex_unlock(&dbthreads[i2].MUTEX_var2);
-            sem_post(&dbthreads[i2].sem2);
-          }
+          int itemcounter2 = dbscan_query(&dbscanthread2, i1, datalen, dbparam,
+                                          sched);
 
-          int itemcounter2 = 0;            // total item counter
-
-          for (int i2 = 0; i2 < cores; i2++) {
-            sem_wait(&dbthreads[i2].semret2);      // wait for threads to finish
-            pthread_mutex_lock(&dbthreads[i2].MUTEX_var2);
-            itemcounter2 += dbthreads[i2].itemcounter2;         // add up items found
-            pthread_mutex_unlock(&dbthreads[i2].MUTEX_var2);
-          }
+          dbscan_tally(counters, datalen, itemcounter2 >= kk);
 
 
           if (itemcounter2 >= kk) {               // enough items?
@@ -1292,6 +1468,8 @@ short expandCluster_pthreads(int key, const short clusternumber,
         }
       }
 
+      trace_end(TRACE_ALGO, "dbscan pass", tr, clusternumber);
+
       if (ret < 0) {              // abort?
         break;
       }
@@ -1303,32 +1481,28 @@ short expandCluster_pthreads(int key, const short clusternumber,
 
 
 
-
 /*!
  \brief Performs a DBSCAN search on the CPU (multithreaded)
  \details
  This method searches clusters with the DBSCAN method on the CPU with multiple threads
  \param b (out) Cluster number + status bits (Bit 0: data item classified, Bit 1: distance
     reachable from main loop, Bit 2: distance reachable from cluster expansion
- \param data (in) input data
- \param blen (in) number of data items (blen*features = number of floats in 'data')
- \param eps (in) search radius
+ \param blen (in) number of data items
  \param kk (in) number of neighbours
- \param features (in) number of features
- \param cores (in) number of threads to be used (CPU may be oversubscribed)
- \param dbthreads (in) Array of structs (of length 'cores') that holds the thread infos
- \returns >0 number of clusters found (0=only noise points), -1=permature abort,
- -256=too many clusters (number can not be stored with 12 bits)
+ \param dbparam (in+out) the parameters of the distance tests (data items, square radius)
+ \param sched (in+out) the scheduler (one participant per core, CPU may be oversubscribed)
+ \param job (in+out) the job, tested once per distance query (NULL = never stops)
+ \param counters (in+out) counters of the search, NULL = not needed
+ \returns >0 number of clusters found (0=only noise points), -30=premature abort (cancelled or
+ deadline passed), -256=too many clusters (number can not be stored with 12 bits)
  \mt fully threadsafe
  */
-short dbscan_pthreads(unsigned short *b, const float *data, const int blen, const float eps, const int kk,
-                const int features,
-                const int cores, struct dbscan_pt *dbthreads) {
+short dbscan_pthreads(unsigned short *b, const int blen, const int kk,
+                struct dbscan_pt *dbparam, struct threadpool_sched *sched, struct jobctl *job,
+                struct agpudm_stats *counters) {
 
   short clusternumber = 0;                // initial cluster number
 
-  const float epseps = eps * eps;         // get square of radius
-
   for (int i1 = 0; i1 < blen; i1++) {
     b[i1] = 0;                            // initialize cluster number array
   }
@@ -1339,11 +1513,9 @@ short dbscan_pthreads(unsigned short *b, const float *data, const int blen, cons
     if ((b[i1] & 1) == 0) {                           // visited?
 
                                   // check if calculations should be aborted
-      rwlockwp_reader_acquire(&abortcalc);
-      if (doabort > 0) {
-        clusternumber = -1;
+      if (jobctl_check(job) != JOBCTL_RUNNING) {
+        clusternumber = -30;
       }
-      rwlockwp_reader_release(&abortcalc);
 
       if (clusternumber < 0) {     // abort?
         break;
@@ -1351,23 +1523,10 @@ short dbscan_pthreads(unsigned short *b, const float *data, const int blen, cons
 
       b[i1] |= 1;                      // set visited-bit
 
-                        // start main loop threads
-      for (int i2 = 0; i2 < cores; i2++) {
-        pthread_mutex_lock(&dbthreads[i2].MUTEX_var1);
-        dbthreads[i2].cmpto1 = i1;
-        pthread_mutex_unlock(&dbthreads[i2].MUTEX_var1);
-        sem_post(&dbthreads[i2].sem1);
-      }
+                        // run main loop tasks
+      int itemcounter = dbscan_query(&dbscanthread1, i1, blen, dbparam, sched);
 
-      int itemcounter = 0;         // total item count
-
-                    // iterate over threads
-      for (int i2 = 0; i2 < cores; i2++) {
-        sem_wait(&dbthreads[i2].semret1);     // wait until finished
-        pthread_mutex_lock(&dbthreads[i2].MUTEX_var1);
-        itemcounter += dbthreads[i2].itemcounter1;    // add items clustered
-        pthread_mutex_unlock(&dbthreads[i2].MUTEX_var1);
-      }
+      dbscan_tally(counters, blen, itemcounter >= kk);
 
 
       if (itemcounter < kk) {             // not enough found?
@@ -1384,8 +1543,8 @@ short dbscan_pthreads(unsigned short *b, const float *data, const int blen, cons
         clusternumber += 1;                   // step cluster number
 
                                      // expand cluster
-        short ret2 = expandCluster_pthreads(i1, clusternumber, b, data, epseps, kk, blen, features,
-                                            cores, dbthreads);
+        short ret2 = expandCluster_pthreads(i1, clusternumber, b, kk, blen, dbparam, sched, job,
+                                            counters);
 
         if (ret2 < 0) {                        // error during expand cluster?
           clusternumber = ret2;               // yes -> quit
@@ -1399,302 +1558,397 @@ short dbscan_pthreads(unsigned short *b, const float *data, const int blen, cons
 } // dbscan_pthreads
 
 
-// see header file
-JNIEXPORT jshort JNICALL
-Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads
-  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
-   jint cores, jlongArray e) {
+
+/*!
+ \brief Multithreaded DBSCAN search on the workers of the thread pool
+ \details
+ Sets up the scheduler and the item counters, reserves the workers and performs the search with
+ dbscan_pthreads. Used by the JNI methods and by the job scheduler (see jobsched.h).
+ \param b (out) cluster numbers (blen values, 0 = noise; should start at a cache line, see
+ threadpool_alloc)
+ \param data (in) input data
+ \param blen (in) number of data items (blen*features = number of floats in 'data')
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features
+ \param cores (in) number of participants
+ \param policy (in) placement of the workers (CPUTOPO_NONE, _BIG, _LITTLE or _ALL)
+ \param job (in+out) the job
+ \param counters (in+out) counters of the search, NULL = not needed
+ \param stats (out) statistics of the participants (see threadpool_sched_stats), NULL = not
+ needed
+ \param slen (in) number of values that fit into *stats*
+ \param elapsed (out) exclusive runtime in ns (only with GPUTIMING, NULL = not needed)
+ \returns >=0 number of clusters found, -30 = cancelled or deadline passed, -107 = malloc error or
+ scheduler could not be set up, -108 = no workers, -256 = too many clusters
+ \mt fully threadsafe
+ */
+short dbscan_run_pthreads(unsigned short *b, const float *data, const int blen, const float eps,
+                          const int kk, const int features, const int cores, const int policy,
+                          struct jobctl *job, struct agpudm_stats *counters, long long *stats,
+                          const int slen, long long *elapsed) {
 
   short ret = -1;            // return value
 
-  struct timespec start2, finish2;          // time points
+  struct timespec start2 = {0, 0}, finish2 = {0, 0};          // time points
 
-                            // check architecture
-  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+                        //alloc memory for the item counters of the participants
+  struct dbscan_count *itemcounter =
+      (struct dbscan_count *) threadpool_alloc(sizeof(struct dbscan_count) * cores);
+  struct threadpool_sched sched;             // the scheduler
 
-                          // get number of data array entries
-    jsize datalen = (*env)->GetArrayLength(env, rf);
-    jsize blen = (*env)->GetArrayLength(env, b);   // get number of data items
+  if ((itemcounter != NULL) && (threadpool_sched_init(&sched, cores, policy) == 0)) {
 
-    if (features * blen == datalen) {           // must match
+                     // chunks do not share cache lines of the cluster numbers
+    threadpool_sched_align(&sched, sizeof(unsigned short));
 
-                                       // access and pin data items
-      jfloat *condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+    struct dbscan_pt dbparam;                 // parameters of the distance tests
 
-      if (condata != NULL) {             // error?
+    dbparam.b = b;                       // reference to cluster number array
+    dbparam.data = data;                // reference to data array
+    dbparam.epseps = eps * eps;          // square search radius
+    dbparam.features = features;        // feature count
+    dbparam.cmpto = -1;               // item to compare to
+    dbparam.itemcounter = itemcounter;       // item counters
 
-                               // allocate memory for cluster numbers
-        unsigned short *conb = (unsigned short *) malloc(sizeof(unsigned short) * blen);
+                              // workers of the thread pool available?
+    if (threadpool_reserve(cores) > 0) {
 
-        if (conb != NULL) {              // malloc error?
+      threadpool_setpolicy(policy);       // placement of the workers
 
-                                //alloc memory for threads
-          struct dbscan_pt *dbthreads = (struct dbscan_pt *) malloc(
-            sizeof(struct dbscan_pt) * cores);
+#ifdef GPUTIMING
+                                      // get time
+      clock_gettime(CLOCK_REALTIME, &start2);
+#endif
+                              // call DBSCAN
+      ret = dbscan_pthreads(b, blen, kk, &dbparam, &sched, job, counters);
 
-          if (dbthreads != NULL) {               // malloc error
+      if (ret >= 0) {               // error?
+        dbscan_labels(b, blen);      // delete status bits
+      }
 
-            int initsucc = 0;             // initialization successfull?
+#ifdef GPUTIMING
+                              // get time
+      clock_gettime(CLOCK_REALTIME, &finish2);
+#endif
 
-            int stepper = (blen / cores) + 1;    // approx. data items per core
-            int starter = 0;                    // start data item
-            int reminder = blen;                 // remaining data items
+    } else {
+      ret = -108;
+    }
 
-            for (int i1 = 0; i1 < cores; i1++) {    // iterate over threads
+                         // copy statistics of the workers (if requested)
+    if ((stats != NULL) && (slen > 0)) {
+      threadpool_sched_stats(&sched, stats, slen);
+    }
 
-              dbthreads[i1].status = 0;           // init status
+    threadpool_sched_destroy(&sched);
 
-              if (reminder < stepper) {      // only few data items remaining
-                stepper = reminder;
-              }
+  } else {
+    ret = -107;
+  }
 
-              if (initsucc == 0) {             // initialization so far successfull?
-
-                dbthreads[i1].num = i1;                 // thread number
-                dbthreads[i1].b = (unsigned short *) conb;   // reference to cluster number array
-                dbthreads[i1].data = condata;             // reference to data array
-                dbthreads[i1].blen = blen;               // number of data items
-                dbthreads[i1].eps = eps;                  // search radius
-                dbthreads[i1].kk = kk;                   // neighbours
-                dbthreads[i1].features = features;        // feature count
-                dbthreads[i1].start = starter;           // start data item
-                dbthreads[i1].len = stepper;              // number of data items
-
-                dbthreads[i1].fertig1 = 0;               // abort for first thread set
-                dbthreads[i1].fertig2 = 0;               // abort for second thread set
-                dbthreads[i1].itemcounter1 = 0;           // item counter for main loop
-                dbthreads[i1].itemcounter2 = 0;           // item counter for expand cluster
-                dbthreads[i1].cmpto1 = -1;               // item to compare to (main loop)
-                dbthreads[i1].cmpto2 = -1;               // item to compare to (expand cluster)
-
-                                          // try to initialize the main loop threads
-                if (pthread_mutex_init(&dbthreads[i1].MUTEX_var1, NULL) == 0) {
-                  dbthreads[i1].status |= 1;              // OK->set status
-                } else {
-                  initsucc = 1;                            // error
-                }
+  free(itemcounter);            // clean up and free
 
-                                // try to initialize the expand cluster threads
-                if (pthread_mutex_init(&dbthreads[i1].MUTEX_var2, NULL) == 0) {
-                  dbthreads[i1].status |= 2;            // OK -> set status
-                } else {
-                  initsucc = 1;                        // error
-                }
+#ifdef GPUTIMING
+                     // calculate time elapsed
+  if (elapsed != NULL) {
+    *elapsed = ((long long) (finish2.tv_sec - start2.tv_sec)) * 1000000000LL +
+               (finish2.tv_nsec - start2.tv_nsec);
+  }
+#endif
 
-                                   // initialize mutex for main loop
-                if (pthread_mutex_init(&dbthreads[i1].MUTEX_fertig1, NULL) == 0) {
-                  dbthreads[i1].status |= 4;
-                } else {
-                  initsucc = 1;
-                }
+  return (ret);
 
-                                  // initialize mutex for expand cluster
-                if (pthread_mutex_init(&dbthreads[i1].MUTEX_fertig2, NULL) == 0) {
-                  dbthreads[i1].status |= 8;
-                } else {
-                  initsucc = 1;
-                }
+} // dbscan_run_pthreads
 
-                                  // initialize wake up semaphore for main loop
-                if (sem_init(&dbthreads[i1].sem1, 0, 0) == 0) {
-                  dbthreads[i1].status |= 16;
-                } else {
-                  initsucc = 1;
-                }
 
-                                 // initialize finished semaphore for main loop
-                if (sem_init(&dbthreads[i1].semret1, 0, 0) == 0) {
-                  dbthreads[i1].status |= 32;
-                } else {
-                  initsucc = 1;
-                }
 
-                                   // initialize wake up semaphore for expand cluster
-                if (sem_init(&dbthreads[i1].sem2, 0, 0) == 0) {
-                  dbthreads[i1].status |= 64;
-                } else {
-                  initsucc = 1;
-                }
+/*!
+ \brief Runs a DBSCAN search on an engine
+ \details
+ Used by the job scheduler and by the public C interface. Afterwards *b* holds the final
+ cluster numbers.
+ \param b (out) cluster numbers (blen values, 0 = noise)
+ \param data (in) input data
+ \param blen (in) number of data items
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features
+ \param engine (in) JOBSCHED_SINGLE, JOBSCHED_PTHREADS or JOBSCHED_GPU
+ \param cores (in) number of participants of the multithreaded engine
+ \param policy (in) placement of the workers (see cputopo.h)
+ \param storage (in) storage of the data items on the GPU (see oclstore.h)
+ \param inplace (in) 1 = the GPU works directly on *data* and *b* (see dbscan_run_gpu)
+ \param job (in+out) the job
+ \param counters (out) counters of the search (cleared first), NULL = not needed
+ \param stats (out) statistics of the workers (see dbscan_run_pthreads), NULL = not needed
+ \param slen (in) number of values that fit into *stats*
+ \param elapsed (out) exclusive runtime (ns)
+ \returns result of the engine
+ \mt fully threadsafe
+ */
+short dbscan_engine(unsigned short *b, const float *data, const int blen, const float eps,
+                    const int kk, const int features, const int engine, const int cores,
+                    const int policy, const int storage, const int inplace, struct jobctl *job,
+                    struct agpudm_stats *counters, long long *stats, const int slen,
+                    long long *elapsed) {
+
+  short ret = -1;                             // return value
+
+  agpudm_clearstats(counters);
+
+  if (engine == JOBSCHED_GPU) {
+    ret = dbscan_run_gpu(b, data, blen, eps, kk, features, storage, inplace, job, counters,
+                         elapsed);
+  } else if (engine == JOBSCHED_PTHREADS) {
+    ret = dbscan_run_pthreads(b, data, blen, eps, kk, features, cores, policy, job, counters,
+                              stats, slen, elapsed);
+  } else {
 
-                                       // initialize finished semaphore for expand cluster
-                if (sem_init(&dbthreads[i1].semret2, 0, 0) == 0) {
-                  dbthreads[i1].status |= 128;
-                } else {
-                  initsucc = 1;
-                }
+    struct timespec start2, finish2;          // time points
 
+    clock_gettime(CLOCK_REALTIME, &start2);
 
-                            // all inits so far OK?
-                if ((dbthreads[i1].status & 255) == 255) {
+    ret = dbscan(b, data, blen, eps, kk, features, job, counters);
 
-                                  // create main loop threads
-                  if (pthread_create(&(dbthreads[i1].thread1), NULL, &dbscanthread1,
-                                     &dbthreads[i1]) == 0) {
-                    dbthreads[i1].status |= 256;   // set status
-                  } else {
-                    initsucc = 1;              // error
-                  }
-                }
+    if (ret >= 0) {
+      dbscan_labels(b, blen);                 // delete status bits
+    }
 
-                         // all inits so far OK?
-                if ((dbthreads[i1].status & 511) == 511) {
+    clock_gettime(CLOCK_REALTIME, &finish2);
 
-                               // create expand cluster threads
-                  if (pthread_create(&(dbthreads[i1].thread2), NULL, &dbscanthread2,
-                                     &dbthreads[i1]) == 0) {
-                    dbthreads[i1].status |= 512;
-                  } else {
-                    initsucc = 1;
-                  }
-                }
+    *elapsed = ((long long) (finish2.tv_sec - start2.tv_sec)) * 1000000000LL +
+               (finish2.tv_nsec - start2.tv_nsec);
+  }
 
-              }
+  if (ret >= 0) {                             // final cluster numbers?
+    dbscan_classify(counters, b, blen, ret);
+  }
 
-              starter += stepper;              // next data items
-              reminder -= stepper;           // remaining data items
-            }
+  return (ret);
 
-            if (initsucc == 0) {               // init OK?
+} // dbscan_engine
 
-#ifdef GPUTIMING
-                                              // get time
-              clock_gettime(CLOCK_REALTIME, &start2);
-#endif
-                                      // call DBSCAN
-              ret = dbscan_pthreads(conb, (float *) condata, blen, eps, kk, features,
-                                    cores, dbthreads);
 
-              if (ret >= 0) {               // error?
-                for (int i1 = 0; i1 < blen; i1++) {        // delete first three bits
-                  conb[i1] = (conb[i1] >> 3);
-                }
-                                        // copy results
-                (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
-              }
 
-#ifdef GPUTIMING
-                                      // call DBSCAN
-              clock_gettime(CLOCK_REALTIME, &finish2);
-#endif
+/*!
+ \brief Runs a DBSCAN job of the job scheduler
+ \details
+ Calls the engine granted by the scheduler (see jobsched_runfn). Afterwards *desc->b* holds the
+ final cluster numbers.
+ \param desc (in) the descriptor of the job (param = number of neighbours)
+ \param engine (in) JOBSCHED_SINGLE, JOBSCHED_PTHREADS or JOBSCHED_GPU
+ \param cores (in) number of participants of the multithreaded engine
+ \param job (in+out) the job
+ \param elapsed (out) exclusive runtime (ns)
+ \returns result of the engine, JOBSCHED_EFALLBACK = OpenCL error of the GPU engine (only if
+ the scheduler chose the engine)
+ \mt fully threadsafe
+ */
+short dbscan_jobrun(const struct jobsched_desc *desc, int engine, int cores, struct jobctl *job,
+                    long long *elapsed) {
 
-            } else {
-              ret = -108;
-            }
-                          // iterate over threads
-            for (int i1 = 0; i1 < cores; i1++) {
+  short code = dbscan_engine(desc->b, desc->data, desc->blen, desc->eps, desc->param,
+                             desc->features, engine, cores, desc->policy, desc->storage, 0, job,
+                             NULL, NULL, 0, elapsed);
 
-                           // destroy threads, mutexes, semaphores etc.
-              if ((dbthreads[i1].status & 256) > 0) {
+                        // GPU not usable -> the scheduler runs the job again on the workers
+  if ((engine == JOBSCHED_GPU) && (desc->engine == JOBSCHED_AUTO) &&
+      (dbscan_status(AGPUDM_ENGINE_GPU, code) == AGPUDM_EOPENCL)) {
+    code = JOBSCHED_EFALLBACK;
+  }
 
-                pthread_mutex_lock(&dbthreads[i1].MUTEX_fertig1);
-                dbthreads[i1].fertig1 = 1;
-                pthread_mutex_unlock(&dbthreads[i1].MUTEX_fertig1);
-                sem_post(&dbthreads[i1].sem1);
+  return (code);
 
-                pthread_join(dbthreads[i1].thread1, NULL);
-              }
+} // dbscan_jobrun
 
-              if ((dbthreads[i1].status & 512) > 0) {
 
-                pthread_mutex_lock(&dbthreads[i1].MUTEX_fertig2);
-                dbthreads[i1].fertig2 = 1;
-                pthread_mutex_unlock(&dbthreads[i1].MUTEX_fertig2);
-                sem_post(&dbthreads[i1].sem2);
 
-                pthread_join(dbthreads[i1].thread2, NULL);
-              }
+// see header file
+int dbscan_status(int engine, int code) {
 
+  if (code >= 0) {                       // number of clusters
+    return (AGPUDM_OK);
+  }
 
-              if ((dbthreads[i1].status & 16) > 0) {
-                sem_destroy(&dbthreads[i1].sem1);
-              }
+  if (code == -30) {                     // cancelled or deadline passed
+    return (AGPUDM_ECANCELLED);
+  }
 
-              if ((dbthreads[i1].status & 32) > 0) {
-                sem_destroy(&dbthreads[i1].semret1);
-              }
+  if (code == -122) {                    // job could not be attached
+    return (AGPUDM_ENOJOB);
+  }
 
-              if ((dbthreads[i1].status & 64) > 0) {
-                sem_destroy(&dbthreads[i1].sem2);
-              }
+  if (code == -256) {                    // too many clusters (on every engine)
+    return (AGPUDM_EENGINE);
+  }
 
-              if ((dbthreads[i1].status & 128) > 0) {
-                sem_destroy(&dbthreads[i1].semret2);
-              }
+  if (engine == AGPUDM_ENGINE_GPU) {     // set up or OpenCL call failed
+    return (AGPUDM_EOPENCL);
+  }
 
-              if ((dbthreads[i1].status & 1) > 0) {
-                pthread_mutex_destroy(&dbthreads[i1].MUTEX_var1);
-              }
+  if (code == -107) {                    // malloc error
+    return (AGPUDM_ENOMEM);
+  }
 
-              if ((dbthreads[i1].status & 2) > 0) {
-                pthread_mutex_destroy(&dbthreads[i1].MUTEX_var2);
-              }
+  if (code == -108) {                    // no workers
+    return (AGPUDM_ENOSTART);
+  }
 
-              if ((dbthreads[i1].status & 4) > 0) {
-                pthread_mutex_destroy(&dbthreads[i1].MUTEX_fertig1);
-              }
+  return (AGPUDM_EENGINE);
 
-              if ((dbthreads[i1].status & 8) > 0) {
-                pthread_mutex_destroy(&dbthreads[i1].MUTEX_fertig2);
-              }
+} // dbscan_status
 
-            }
 
-            free(dbthreads);            // clean up and free
 
-          } else {
-            ret = -107;
-          }
+// see header file
+int agpudm_dbscan(struct agpudm *ctx, const float *data, int n, int features,
+                  const struct agpudm_dbscan_params *p, int job, unsigned short *labels,
+                  struct agpudm_result *res) {
+
+  int ret = AGPUDM_OK;                   // return value
+
+  if ((ctx != NULL) && (data != NULL) && (labels != NULL) && (p != NULL) && (n > 0) &&
+      (features > 0) && (p->neighbours >= 0)) {
+
+                                 // attach to the job (deadline of the context)
+    struct jobctl *jobp = agpudm_attach(ctx, job, JOBCTL_DBSCAN);
+
+    if (jobp != NULL) {
 
-          free(conb);
+      int engine = ctx->cfg.engine;
+      int cores = agpudm_cores(ctx);
+      long long elapsed = 0;
+      short code = -1;
 
+      if ((engine == AGPUDM_ENGINE_AUTO) || (engine == AGPUDM_ENGINE_GPU)) {
+
+                                 // on the GPU, in place
+        code = dbscan_engine(labels, data, n, p->eps, p->neighbours, features, JOBSCHED_GPU, 1,
+                             ctx->cfg.policy, ctx->cfg.storage, 1, jobp,
+                             (res != NULL) ? res->stats : NULL, NULL, 0, &elapsed);
+
+        if ((engine == AGPUDM_ENGINE_AUTO) &&
+            (dbscan_status(AGPUDM_ENGINE_GPU, code) == AGPUDM_EOPENCL)) {
+          engine = AGPUDM_ENGINE_PTHREADS;   // GPU not usable -> workers
         } else {
-          ret = -105;
+          engine = AGPUDM_ENGINE_GPU;
         }
+      }
 
-        (*env)->ReleaseFloatArrayElements(env, rf, condata, JNI_ABORT);
-
-      } else {
-        ret = -104;
+      if (engine != AGPUDM_ENGINE_GPU) {
+        code = dbscan_engine(labels, data, n, p->eps, p->neighbours, features, engine, cores,
+                             ctx->cfg.policy, ctx->cfg.storage, 1, jobp,
+                             (res != NULL) ? res->stats : NULL,
+                             (res != NULL) ? res->workers : NULL,
+                             (res != NULL) ? res->wlen : 0, &elapsed);
       }
+
+      jobctl_detach(jobp);
+
+      ret = dbscan_status(engine, code);
+
+      agpudm_setresult(res, ret, code, engine, (engine == AGPUDM_ENGINE_PTHREADS) ? cores : 1,
+                       elapsed);
+
     } else {
-      ret = -103;
+      ret = (job != 0) ? AGPUDM_ENOJOB : AGPUDM_ENOSTART;
+      agpudm_setresult(res, ret, -122, ctx->cfg.engine, 0, 0);
     }
+
   } else {
-    ret = -102;
+    ret = AGPUDM_EINVAL;
+    agpudm_setresult(res, ret, -103, (ctx != NULL) ? ctx->cfg.engine : 0, 0, 0);
   }
 
-#ifdef GPUTIMING
-                             // calculate time elapsed
-  long long int elapsed2 = ((long long int) (finish2.tv_sec - start2.tv_sec)) * 1000000000L;
-  elapsed2 += (finish2.tv_nsec - start2.tv_nsec);
-
-              // pin array
-  jlong *edata = (*env)->GetLongArrayElements(env, e, NULL);
-  edata[0] = elapsed2;          // set first array element
-  (*env)->ReleaseLongArrayElements(env, e, edata, 0);   // unpin array
-#endif
-
   return (ret);
-} // Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads
 
+} // agpudm_dbscan
 
 
 
 // see header file
-JNIEXPORT void JNICALL
-Java_com_example_dmocl_dbscan_dbscanabort_1c(JNIEnv *env, jclass clazz) {
+int agpudm_dbscan_submit(struct agpudm *ctx, const float *data, int n, int features,
+                         const struct agpudm_dbscan_params *p, agpudm_donefn done, void *arg) {
+
+  int ret = 0;                           // return value
+
+  if ((ctx != NULL) && (data != NULL) && (p != NULL) && (n > 0) && (features > 0) &&
+      (p->neighbours >= 0)) {
+
+    float *copy = (float *) malloc(sizeof(float) * n * features);   // the only copy
+
+    if (copy != NULL) {                  // malloc error?
+      memcpy(copy, data, sizeof(float) * n * features);
+      ret = agpudm_dbscan_adopt(ctx, copy, n, features, p, done, arg);
+    } else {
+      ret = AGPUDM_ENOMEM;
+    }
+
+  } else {
+    ret = AGPUDM_EINVAL;
+  }
+
+  return (ret);
+
+} // agpudm_dbscan_submit
 
-  rwlockwp_writer_acquire(&abortcalc);
-  doabort = 1;                      // signal abort
-  rwlockwp_writer_release(&abortcalc);
 
-}
 
 // see header file
-JNIEXPORT void JNICALL
-Java_com_example_dmocl_dbscan_dbscanresume_1c(JNIEnv *env, jclass clazz) {
-  rwlockwp_writer_acquire(&abortcalc);
-  doabort = 0;                      // allow calculations
-  rwlockwp_writer_release(&abortcalc);
-}
+int agpudm_dbscan_adopt(struct agpudm *ctx, float *data, int n, int features,
+                        const struct agpudm_dbscan_params *p, agpudm_donefn done, void *arg) {
+
+  int ret = 0;                           // return value
+
+  if ((ctx != NULL) && (data != NULL) && (p != NULL) && (n > 0) && (features > 0) &&
+      (p->neighbours >= 0)) {
+
+    struct jobsched_desc desc;           // the job
+
+    desc.group = JOBCTL_DBSCAN;
+    desc.engine = ctx->cfg.engine;
+    desc.cores = ctx->cfg.cores;
+    desc.policy = ctx->cfg.policy;
+    desc.storage = ctx->cfg.storage;
+    desc.blen = n;
+    desc.features = features;
+    desc.eps = p->eps;
+    desc.param = p->neighbours;
+    desc.seed = 0;
+    desc.timeoutms = ctx->cfg.timeoutms;
+    desc.stopped = -30;                  // cancelled before it has started
+    desc.run = &dbscan_jobrun;
+    desc.done = done;
+    desc.donearg = arg;
+
+                      // the data items are taken over, the cluster numbers start at a cache line
+    desc.data = data;
+    desc.b = (unsigned short *) threadpool_alloc(sizeof(unsigned short) * n);
+
+    if (desc.b != NULL) {                // malloc error?
+
+      ret = jobsched_submit(&desc);
+
+      if (ret > 0) {                     // owned by the scheduler now
+        desc.data = NULL;
+        desc.b = NULL;
+      } else {
+        ret = (ret == JOBSCHED_EDESC) ? AGPUDM_EINVAL : AGPUDM_ENOSTART;
+      }
+
+    } else {
+      ret = AGPUDM_ENOMEM;
+    }
+
+    free(desc.data);
+    free(desc.b);
+
+  } else {
+    free(data);
+    ret = AGPUDM_EINVAL;
+  }
+
+  return (ret);
 
+} // agpudm_dbscan_adopt
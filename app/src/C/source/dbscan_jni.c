@@ -0,0 +1,624 @@
+/*!
+ \file dbscan_jni.c
+ \brief JNI methods of the DBSCAN algorithm
+ \details
+ This file adapts the Java methods of com.example.dmocl.dbscan (see dbscan_c.h) to the public
+ C interface (agpudm.h): it checks and pins the Java arrays, calls the search with a context
+ for the requested engine and copies the cluster numbers back. The searches themselves are in
+ dbscan_c.c.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include <jni.h>
+#include "dbscan_c.h"
+#include "agpudm.h"
+#include "oclwrapper.h"
+#include "threadpool.h"
+#include "jobsched.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define GPUTIMING                       //!< Define if exclusive GPU time should be measured
+#define DBSCAN_NSTATS 6                 //!< number of counters (dbscan_c_stats)
+
+
+
+/*!
+ \brief DBSCAN cluster search through the public C interface
+ \details
+ Creates a context for the engine, performs the search in place and returns the result code of
+ the engine (the values documented for the JNI methods).
+ \param b (out) Array of cluster numbers (blen values)
+ \param data (in) Array of data points
+ \param blen (in) number of data items
+ \param eps (in) search radius
+ \param kk (in) number of neighbours
+ \param features (in) number of features per data item
+ \param engine (in) AGPUDM_ENGINE_SINGLE, _PTHREADS or _GPU
+ \param cores (in) number of cores (multithreaded engine)
+ \param policy (in) placement of the workers
+ \param storage (in) storage of the data items on the GPU
+ \param job (in) handle of the job, 0 = none
+ \param stats (out) statistics of the workers, NULL = not needed
+ \param slen (in) number of values that fit into *stats*
+ \param counters (out) counters of the search, NULL = not needed
+ \param elapsed (out) exclusive runtime in ns
+ \returns result code of the engine
+ \mt fully threadsafe
+ */
+short dbscan_jnirun(unsigned short *b, const float *data, int blen, float eps, int kk,
+                    int features, int engine, int cores, int policy, int storage, int job,
+                    long long *stats, int slen, struct agpudm_stats *counters,
+                    long long *elapsed) {
+
+  const long long tr = trace_begin();    // span of the JNI call
+
+  struct agpudm_config cfg;              // configuration of the call
+  struct agpudm *ctx;                    // the context
+
+  agpudm_config_default(&cfg);
+  cfg.engine = engine;
+  cfg.cores = cores;
+  cfg.policy = policy;
+  cfg.storage = storage;
+
+  short ret = -105;                      // return value
+
+  if (agpudm_create(&cfg, &ctx) == AGPUDM_OK) {
+
+    struct agpudm_dbscan_params p;      // parameters of the search
+    struct agpudm_result res;           // details of the search
+
+    p.eps = eps;
+    p.neighbours = kk;
+    res.workers = stats;
+    res.wlen = slen;
+    res.stats = counters;
+
+    agpudm_dbscan(ctx, data, blen, features, &p, job, b, &res);
+
+    agpudm_destroy(ctx);
+
+    *elapsed = res.elapsed;
+    ret = (short) res.code;
+  }
+
+  trace_end(TRACE_JNI, "dbscan_jnirun", tr, engine);
+
+  return (ret);
+
+} // dbscan_jnirun
+
+
+
+//see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features) {
+
+  return (Java_com_example_dmocl_dbscan_dbscan_1c_1ex(env, jc, b, rf, eps, kk, features, 0));
+
+}  // Java_com_example_dmocl_dbscan_dbscan_1c
+
+
+
+//see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint job) {
+
+  short ret = -1;                   // return value
+
+  long long elapsed2 = 0;           // exclusive runtime (not returned)
+
+                              // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                                // get length of data array
+    jsize datalen = (*env)->GetArrayLength(env, rf);
+    jsize blen = (*env)->GetArrayLength(env, b);   // get number of data items
+
+    if (features * blen == datalen) {   // these must match
+
+                                      // get and pin data items
+      jfloat *condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {              // error?
+
+                                   // allocate memory for cluster number array
+        unsigned short *conb = (unsigned short *) malloc(sizeof(unsigned short) * blen);
+
+        if (conb != NULL) {            // malloc error
+
+                               // call dbscan (cluster numbers without status bits)
+          ret = dbscan_jnirun(conb, condata, blen, eps, kk, features, AGPUDM_ENGINE_SINGLE, 1,
+                              AGPUDM_POLICY_DEFAULT, AGPUDM_STORE_FP32, job, NULL, 0,
+                              NULL, &elapsed2);
+
+          if (ret >= 0) {      // correct result?
+                                // store cluster numbers
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+          }
+
+          free(conb);                  // free and clean up
+
+        } else {
+          ret = -105;
+        }
+
+        (*env)->ReleaseFloatArrayElements(env, rf, condata, JNI_ABORT);
+
+      } else {
+        ret = -104;
+      }
+    } else {
+      ret = -103;
+    }
+  } else {
+    ret = -102;
+  }
+
+  return (ret);
+
+}  // Java_com_example_dmocl_dbscan_dbscan_1c_1ex
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1gpu
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jlongArray e) {
+
+  return (Java_com_example_dmocl_dbscan_dbscan_1c_1gpu_1ex(env, jc, b, rf, eps, kk, features,
+                                                           AGPUDM_STORE_FP32, 0, e));
+
+}  // Java_com_example_dmocl_dbscan_dbscan_1c_1gpu
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1gpu_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint storage, jint job, jlongArray e) {
+
+  long long elapsed2 = 0;                         // exclusive runtime
+
+  short ret = -1;                                 // return variable
+
+                                       // architecture check
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+    jsize datalen = (*env)->GetArrayLength(env, rf);        // get number of floats in data array
+    jsize blen = (*env)->GetArrayLength(env, b);            // get number of data items
+
+    if (features * blen == datalen) {                   // must match
+
+                                  // pin data items and get reference
+      jfloat *condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {                         // error?
+
+                                // allocate array for cluster numbers
+        unsigned short *conb = (unsigned short *) malloc(sizeof(unsigned short) * blen);
+
+        if (conb != NULL) {                   // malloc error?
+
+                                              // call dbscan
+          ret = dbscan_jnirun(conb, condata, blen, eps, kk, features, AGPUDM_ENGINE_GPU, 1,
+                              AGPUDM_POLICY_DEFAULT, storage, job, NULL, 0, NULL,
+                              &elapsed2);
+
+          if (ret >= 0) {          // error?
+                                             // copy results
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+          }
+
+          free(conb);              // free cluster number buffer
+
+        } else {
+          ret = -105;
+        }
+
+        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
+                         // unpin data item array
+
+      } else {
+        ret = -104;
+      }
+    } else {
+      ret = -103;
+    }
+  } else {
+    ret = -102;
+  }
+
+#ifdef GPUTIMING
+            // store time
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+}  // Java_com_example_dmocl_dbscan_dbscan_1c_1gpu_1ex
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1gpu_1direct
+  (JNIEnv *env, jclass jc, jobject b, jobject rf, jfloat eps, jint kk, jint features,
+   jint storage, jint job, jlongArray e) {
+
+  long long elapsed2 = 0;                         // exclusive runtime
+
+  short ret = -1;                                 // return variable
+
+  jlong blen, datalen;                            // capacities of the buffers
+
+                                       // architecture check
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                                  // memory of the buffers (no copies)
+    unsigned short *dirb = (unsigned short *) oclwrap_direct(env, b, sizeof(unsigned short),
+                                                             &blen);
+    float *dirdata = (float *) oclwrap_direct(env, rf, sizeof(float), &datalen);
+
+    if ((dirb != NULL) && (dirdata != NULL)) {         // direct buffers?
+
+      if ((blen <= INT_MAX) && (features * blen == datalen)) {     // must match
+
+                                              // call dbscan, in place
+        ret = dbscan_jnirun(dirb, dirdata, (int) blen, eps, kk, features, AGPUDM_ENGINE_GPU, 1,
+                            AGPUDM_POLICY_DEFAULT, storage, job, NULL, 0, NULL,
+                            &elapsed2);
+
+      } else {
+        ret = -103;
+      }
+    } else {
+      ret = -104;
+    }
+  } else {
+    ret = -102;
+  }
+
+#ifdef GPUTIMING
+            // store time
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+}  // Java_com_example_dmocl_dbscan_dbscan_1c_1gpu_1direct
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint cores, jlongArray e) {
+
+  return (Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1ex(env, jc, b, rf, eps, kk, features,
+                                                                cores, AGPUDM_POLICY_DEFAULT, 0,
+                                                                e));
+
+} // Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint cores, jint policy, jint job, jlongArray e) {
+
+  short ret = -1;            // return value
+
+  long long elapsed2 = 0;                  // exclusive runtime
+
+                            // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                          // get number of data array entries
+    jsize datalen = (*env)->GetArrayLength(env, rf);
+    jsize blen = (*env)->GetArrayLength(env, b);   // get number of data items
+
+    if (features * blen == datalen) {           // must match
+
+                                       // access and pin data items
+      jfloat *condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {             // error?
+
+                   // allocate memory for cluster numbers (starts at a cache line)
+        unsigned short *conb = (unsigned short *) threadpool_alloc(sizeof(unsigned short) * blen);
+
+        if (conb != NULL) {              // malloc error?
+
+                                 // statistics of the workers requested?
+          jsize slen = (*env)->GetArrayLength(env, e);
+          jlong *sdata = (slen > 1) ? (*env)->GetLongArrayElements(env, e, NULL) : NULL;
+
+                                      // call DBSCAN
+          ret = dbscan_jnirun(conb, condata, blen, eps, kk, features, AGPUDM_ENGINE_PTHREADS,
+                              cores, policy, AGPUDM_STORE_FP32, job,
+                              (sdata != NULL) ? (long long *) &sdata[1] : NULL, slen - 1,
+                              NULL, &elapsed2);
+
+          if (sdata != NULL) {
+            (*env)->ReleaseLongArrayElements(env, e, sdata, 0);
+          }
+
+          if (ret >= 0) {               // error?
+                                        // copy results
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+          }
+
+          free(conb);
+
+        } else {
+          ret = -105;
+        }
+
+        (*env)->ReleaseFloatArrayElements(env, rf, condata, JNI_ABORT);
+
+      } else {
+        ret = -104;
+      }
+    } else {
+      ret = -103;
+    }
+  } else {
+    ret = -102;
+  }
+
+#ifdef GPUTIMING
+              // set first array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+} // Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1ex
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1stats
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint engine, jint cores, jint policy, jint storage, jint job, jlongArray e, jlongArray s) {
+
+  short ret = -1;            // return value
+
+  long long elapsed2 = 0;                  // exclusive runtime
+
+  struct agpudm_stats counters;            // counters of the search
+
+  memset(&counters, 0, sizeof(counters));
+
+                            // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                          // get number of data array entries
+    jsize datalen = (*env)->GetArrayLength(env, rf);
+    jsize blen = (*env)->GetArrayLength(env, b);   // get number of data items
+
+    if (features * blen == datalen) {           // must match
+
+                                       // access and pin data items
+      jfloat *condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {             // error?
+
+                   // allocate memory for cluster numbers (starts at a cache line)
+        unsigned short *conb = (unsigned short *) threadpool_alloc(sizeof(unsigned short) * blen);
+
+        if (conb != NULL) {              // malloc error?
+
+                                 // statistics of the workers requested?
+          jsize slen = (*env)->GetArrayLength(env, e);
+          jlong *sdata = (slen > 1) ? (*env)->GetLongArrayElements(env, e, NULL) : NULL;
+
+                                      // call DBSCAN
+          ret = dbscan_jnirun(conb, condata, blen, eps, kk, features, engine, cores, policy,
+                              storage, job, (sdata != NULL) ? (long long *) &sdata[1] : NULL,
+                              slen - 1, &counters, &elapsed2);
+
+          if (sdata != NULL) {
+            (*env)->ReleaseLongArrayElements(env, e, sdata, 0);
+          }
+
+          if (ret >= 0) {               // error?
+                                        // copy results
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+          }
+
+          free(conb);
+
+        } else {
+          ret = -105;
+        }
+
+        (*env)->ReleaseFloatArrayElements(env, rf, condata, JNI_ABORT);
+
+      } else {
+        ret = -104;
+      }
+    } else {
+      ret = -103;
+    }
+
+                               // copy the counters (as far as they fit)
+    const jlong cnt[DBSCAN_NSTATS] = { counters.passes, counters.distances, counters.clusters,
+                                       counters.core, counters.border, counters.noise };
+    jsize clen = (*env)->GetArrayLength(env, s);
+
+    (*env)->SetLongArrayRegion(env, s, 0, (clen < DBSCAN_NSTATS) ? clen : DBSCAN_NSTATS, cnt);
+
+  } else {
+    ret = -102;
+  }
+
+#ifdef GPUTIMING
+              // set first array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+} // Java_com_example_dmocl_dbscan_dbscan_1c_1stats
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1direct
+  (JNIEnv *env, jclass jc, jobject b, jobject rf, jfloat eps, jint kk, jint features,
+   jint cores, jint policy, jint job, jlongArray e) {
+
+  short ret = -1;            // return value
+
+  long long elapsed2 = 0;                  // exclusive runtime
+
+  jlong blen, datalen;                     // capacities of the buffers
+
+                            // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                          // memory of the buffers (no copies)
+    unsigned short *dirb = (unsigned short *) oclwrap_direct(env, b, sizeof(unsigned short),
+                                                             &blen);
+    float *dirdata = (float *) oclwrap_direct(env, rf, sizeof(float), &datalen);
+
+    if ((dirb != NULL) && (dirdata != NULL)) {       // direct buffers?
+
+      if ((blen <= INT_MAX) && (features * blen == datalen)) {   // must match
+
+                                 // statistics of the workers requested?
+        jsize slen = (*env)->GetArrayLength(env, e);
+        jlong *sdata = (slen > 1) ? (*env)->GetLongArrayElements(env, e, NULL) : NULL;
+
+                                      // call DBSCAN, in place
+        ret = dbscan_jnirun(dirb, dirdata, (int) blen, eps, kk, features, AGPUDM_ENGINE_PTHREADS,
+                            cores, policy, AGPUDM_STORE_FP32, job,
+                            (sdata != NULL) ? (long long *) &sdata[1] : NULL, slen - 1,
+                            NULL, &elapsed2);
+
+        if (sdata != NULL) {
+          (*env)->ReleaseLongArrayElements(env, e, sdata, 0);
+        }
+
+      } else {
+        ret = -103;
+      }
+    } else {
+      ret = -104;
+    }
+  } else {
+    ret = -102;
+  }
+
+#ifdef GPUTIMING
+              // set first array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+} // Java_com_example_dmocl_dbscan_dbscan_1c_1phtreads_1direct
+
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_dbscan_dbscan_1c_1submit
+  (JNIEnv *env, jclass jc, jfloatArray rf, jfloat eps, jint kk, jint features, jint engine,
+   jint cores, jint policy, jint storage, jlong timeoutms, jobject cb) {
+
+  jint ret = 0;                               // return value
+
+                          // get number of data array entries
+  jsize datalen = (*env)->GetArrayLength(env, rf);
+
+  if ((features > 0) && (datalen > 0) && (datalen % features == 0)) {   // whole data items?
+
+    struct agpudm_config cfg;               // configuration of the job
+    struct agpudm *ctx;                     // the context
+
+    agpudm_config_default(&cfg);
+    cfg.engine = engine;
+    cfg.cores = cores;
+    cfg.policy = policy;
+    cfg.storage = storage;
+    cfg.timeoutms = timeoutms;
+
+    ret = agpudm_create(&cfg, &ctx);
+
+    if (ret == AGPUDM_OK) {
+
+      agpudm_donefn done;                   // completion function (if any)
+      void *donearg;
+
+      if (oclwrap_setcallback(env, cb, &done, &donearg) == 0) {
+
+        struct agpudm_dbscan_params p;      // parameters of the search
+
+        p.eps = eps;
+        p.neighbours = kk;
+
+                      // the only copy of the data items, taken over by the submission
+        float *condata = (float *) malloc(sizeof(float) * datalen);
+
+        if (condata != NULL) {
+          (*env)->GetFloatArrayRegion(env, rf, 0, datalen, (jfloat *) condata);
+        }
+
+        ret = (condata != NULL) ? agpudm_dbscan_adopt(ctx, condata, datalen / features, features,
+                                                      &p, done, donearg)
+                                : AGPUDM_ENOMEM;
+
+        if (ret <= 0) {                     // not submitted -> error codes of the scheduler
+          oclwrap_dropcallback(env, donearg);
+          ret = (ret == AGPUDM_ENOMEM) ? -105 : (ret == AGPUDM_EINVAL) ? JOBSCHED_EDESC
+                                                                       : JOBSCHED_ENOSTART;
+        }
+
+      } else {
+        ret = -104;
+      }
+
+      agpudm_destroy(ctx);
+
+    } else {
+      ret = (ret == AGPUDM_ENOMEM) ? -105 : JOBSCHED_EDESC;
+    }
+
+  } else {
+    ret = -103;
+  }
+
+  return (ret);
+
+} // Java_com_example_dmocl_dbscan_dbscan_1c_1submit
+
+
+
+// see header file
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_dbscan_dbscanabort_1c(JNIEnv *env, jclass clazz) {
+
+  agpudm_cancel_all(AGPUDM_DBSCAN);      // cancel all running and new searches
+
+}
+
+// see header file
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_dbscan_dbscanresume_1c(JNIEnv *env, jclass clazz) {
+  agpudm_resume_all(AGPUDM_DBSCAN);      // allow calculations
+}
@@ -0,0 +1,313 @@
+/*!
+ \file jobctl.c
+ \brief Cancellation of single calculations
+ \details
+ This file implements the table of the jobs, the cancellation of single jobs and of groups and
+ the deadlines.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "jobctl.h"
+#include <pthread.h>
+#include <limits.h>
+#include <time.h>
+
+
+                              //! lock that protects the table (except *state*)
+pthread_mutex_t joblock = PTHREAD_MUTEX_INITIALIZER;
+                              //! the jobs
+struct jobctl jobtab[JOBCTL_MAXJOBS];
+                              //! sequence number of the last handle created (table lock)
+int jobseq = 0;
+                              //! groups that have been cancelled (table lock)
+int jobblocked = 0;
+
+
+
+/*!
+ \brief Returns the monotonic time
+ \returns time in ns
+ \mt fully threadsafe
+ */
+long long jobctl_now( void ){
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return( (long long) t.tv_sec * 1000000000LL + t.tv_nsec );
+
+} // jobctl_now
+
+
+
+/*!
+ \brief Finds the job of a handle
+ \param handle (in) handle of the job
+ \returns the job, NULL = unknown handle
+ \mt table lock must be held
+ */
+struct jobctl* jobctl_find( int handle ){
+
+  if (handle <= 0) {
+    return( NULL );
+  }
+
+  struct jobctl* job = &jobtab[(handle - 1) % JOBCTL_MAXJOBS];
+
+  if (job->handle != handle) {               // slot reused or free
+    return( NULL );
+  }
+
+  return( job );
+
+} // jobctl_find
+
+
+
+/*!
+ \brief Allocates a job
+ \param deadline (in) deadline (CLOCK_MONOTONIC in ns), 0 = none
+ \returns the job, NULL = too many jobs
+ \mt table lock must be held
+ */
+struct jobctl* jobctl_alloc( long long deadline ){
+
+  for (int i1 = 0; i1 < JOBCTL_MAXJOBS; i1++) {
+
+    if (jobtab[i1].handle == 0) {            // free slot?
+
+                                 // handles of a slot differ by multiples of JOBCTL_MAXJOBS
+      jobseq = (jobseq + 1) % (INT_MAX / JOBCTL_MAXJOBS - 1);
+
+      jobtab[i1].handle = i1 + 1 + jobseq * JOBCTL_MAXJOBS;
+      jobtab[i1].refs = 0;
+      jobtab[i1].autofree = 0;
+      jobtab[i1].groups = 0;
+      jobtab[i1].state = JOBCTL_RUNNING;
+      jobtab[i1].deadline = deadline;
+
+      return( &jobtab[i1] );
+    }
+  }
+
+  return( NULL );
+
+} // jobctl_alloc
+
+
+
+// see header file for details
+int jobctl_create( long long timeoutms ){
+
+  long long deadline = 0;
+
+  if (timeoutms > 0) {
+    deadline = jobctl_now() + timeoutms * 1000000LL;
+  }
+
+  pthread_mutex_lock( &joblock );
+
+  struct jobctl* job = jobctl_alloc( deadline );
+  const int handle = (job != NULL) ? job->handle : -1;
+
+  pthread_mutex_unlock( &joblock );
+
+  return( handle );
+
+} // jobctl_create
+
+
+
+// see header file for details
+int jobctl_cancel( int handle ){
+
+  int ret = -1;
+
+  pthread_mutex_lock( &joblock );
+
+  struct jobctl* job = jobctl_find( handle );
+
+  if (job != NULL) {
+
+    if (job->state == JOBCTL_RUNNING) {
+      job->state = JOBCTL_CANCELLED;
+    }
+
+    ret = 0;
+  }
+
+  pthread_mutex_unlock( &joblock );
+
+  return( ret );
+
+} // jobctl_cancel
+
+
+
+// see header file for details
+int jobctl_status( int handle ){
+
+  int ret = -1;
+
+  pthread_mutex_lock( &joblock );
+
+  struct jobctl* job = jobctl_find( handle );
+
+  if (job != NULL) {
+    ret = jobctl_check( job );               // also detects an expired deadline
+  }
+
+  pthread_mutex_unlock( &joblock );
+
+  return( ret );
+
+} // jobctl_status
+
+
+
+// see header file for details
+void jobctl_release( int handle ){
+
+  pthread_mutex_lock( &joblock );
+
+  struct jobctl* job = jobctl_find( handle );
+
+  if (job != NULL) {
+
+    if (job->refs == 0) {
+      job->handle = 0;                       // free slot
+    } else {
+      job->autofree = 1;                     // last calculation frees it
+    }
+  }
+
+  pthread_mutex_unlock( &joblock );
+
+} // jobctl_release
+
+
+
+// see header file for details
+struct jobctl* jobctl_attach( int handle, int group ){
+
+  pthread_mutex_lock( &joblock );
+
+  struct jobctl* job;
+
+  if (handle == 0) {
+
+    job = jobctl_alloc( 0 );                 // anonymous job
+
+    if (job != NULL) {
+      job->autofree = 1;
+    }
+
+  } else {
+
+    job = jobctl_find( handle );
+
+    if ((job != NULL) && (job->autofree == 1)) {
+      job = NULL;                            // already released
+    }
+  }
+
+  if (job != NULL) {
+
+    job->refs++;
+    job->groups |= group;
+
+    if (((jobblocked & group) != 0) && (job->state == JOBCTL_RUNNING)) {
+      job->state = JOBCTL_CANCELLED;         // group cancelled
+    }
+  }
+
+  pthread_mutex_unlock( &joblock );
+
+  return( job );
+
+} // jobctl_attach
+
+
+
+// see header file for details
+void jobctl_detach( struct jobctl* job ){
+
+  pthread_mutex_lock( &joblock );
+
+  job->refs--;
+
+  if (job->refs == 0) {
+
+    job->groups = 0;
+
+    if (job->autofree == 1) {
+      job->handle = 0;                       // free slot
+    }
+  }
+
+  pthread_mutex_unlock( &joblock );
+
+} // jobctl_detach
+
+
+
+// see header file for details
+int jobctl_check( struct jobctl* job ){
+
+  if (job == NULL) {
+    return( JOBCTL_RUNNING );
+  }
+
+  const int state = job->state;
+
+  if (state != JOBCTL_RUNNING) {
+    return( state );
+  }
+
+  if ((job->deadline > 0) && (jobctl_now() >= job->deadline)) {
+    job->state = JOBCTL_EXPIRED;             // no lock: both final states stop the job
+    return( JOBCTL_EXPIRED );
+  }
+
+  return( JOBCTL_RUNNING );
+
+} // jobctl_check
+
+
+
+// see header file for details
+void jobctl_cancelgroup( int group ){
+
+  pthread_mutex_lock( &joblock );
+
+  jobblocked |= group;
+
+  for (int i1 = 0; i1 < JOBCTL_MAXJOBS; i1++) {
+
+    if ((jobtab[i1].handle != 0) && ((jobtab[i1].groups & group) != 0) &&
+        (jobtab[i1].state == JOBCTL_RUNNING)) {
+      jobtab[i1].state = JOBCTL_CANCELLED;
+    }
+  }
+
+  pthread_mutex_unlock( &joblock );
+
+} // jobctl_cancelgroup
+
+
+
+// see header file for details
+void jobctl_resumegroup( int group ){
+
+  pthread_mutex_lock( &joblock );
+
+  jobblocked &= ~group;
+
+  pthread_mutex_unlock( &joblock );
+
+} // jobctl_resumegroup
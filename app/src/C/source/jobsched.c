@@ -0,0 +1,780 @@
+/*!
+ \file jobsched.c
+ \brief Concurrent job scheduler of the native engines
+ \details
+ This file implements the queue, the admission control and the runner threads of the job
+ scheduler. The records of the jobs are stored at the slot of their handle in the job control
+ table ((handle - 1) % JOBCTL_MAXJOBS), the slot cannot be reused before the scheduler releases
+ the handle. The queue is a list of slots linked by *next*.
+ Finished jobs with a completion function are collected in *schedpending* (a ring, in the order
+ the jobs finished) while the lock is held; every public function calls the collected completion
+ functions after it has released the lock (jobsched_notify). Only one thread at a time calls
+ them, so they run one after the other in the order the jobs finished.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#if !defined(_POSIX_C_SOURCE) || (_POSIX_C_SOURCE < 200112L)
+                              //! needed for sysconf
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "jobsched.h"
+#include "cputopo.h"
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+                             //! rescue definition of the OpenCL version
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+
+#include <CL/opencl.h>
+
+
+                              //! A pending call of a completion function
+struct jobsched_note {
+                              //! the completion function
+  jobsched_donefn done;
+                              //! handle of the job
+  int handle;
+                              //! result of the job
+  short result;
+                              //! argument of the completion function
+  void* arg;
+};
+
+                              //! A job of the scheduler
+struct jobsched_rec {
+                              //! handle of the job, 0 = record not used
+  int handle;
+                              //! JOBSCHED_QUEUED, JOBSCHED_RUNNING or JOBSCHED_DONE
+  int state;
+                              //! 1 = free the record when the job has finished
+  int released;
+                              //! engine granted
+  int engine;
+                              //! cores granted
+  int cores;
+                              //! memory estimate (bytes)
+  long long memory;
+                              //! result of the engine
+  short result;
+                              //! time of the submission, start and end (CLOCK_MONOTONIC in ns)
+  long long t[3];
+                              //! exclusive runtime of the engine (ns)
+  long long elapsed;
+                              //! next queued job (slot), -1 = end of the queue
+  int next;
+                              //! the job control of the job (attached while the job exists)
+  struct jobctl* job;
+                              //! the descriptor
+  struct jobsched_desc desc;
+};
+
+
+                              //! lock that protects the records, the queue and the resources
+pthread_mutex_t schedlock = PTHREAD_MUTEX_INITIALIZER;
+                              //! signalled when a job has finished
+pthread_cond_t schedcond = PTHREAD_COND_INITIALIZER;
+                              //! the jobs (indexed by the slot of their handle)
+struct jobsched_rec schedtab[JOBCTL_MAXJOBS];
+                              //! first and last queued job (slot), -1 = queue empty
+int schedhead = -1, schedtail = -1;
+                              //! number of running jobs
+int schedrunning = 0;
+                              //! cores, memory and GPU slots in use
+int schedcores = 0, schedgpus = 0;
+                              //! memory in use (bytes)
+long long schedmemory = 0;
+                              //! limits (cores: 0 = not set yet, GPU slots: < 0 = not probed yet)
+int limcores = 0, limgpus = -1;
+                              //! 1 = the GPU slots come from the probe (not from jobsched_limits)
+int schedprobed = 0;
+                              //! memory budget (bytes, 0 = not set yet)
+long long limmemory = 0;
+                              //! completion functions to call (ring, at most one per job)
+struct jobsched_note schedpending[JOBCTL_MAXJOBS];
+                              //! first and number of the completion functions to call
+int schedpendfirst = 0, schedpendcnt = 0;
+                              //! 1 = a thread is calling the completion functions
+int schednotifying = 0;
+
+
+
+/*!
+ \brief Returns the monotonic time
+ \returns time in ns
+ \mt fully threadsafe
+ */
+long long jobsched_now( void ){
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return( (long long) t.tv_sec * 1000000000LL + t.tv_nsec );
+
+} // jobsched_now
+
+
+
+/*!
+ \brief Looks for a GPU
+ \details
+ Probes the first OpenCL platform, the one the GPU engines use.
+ \returns 1 = the platform has a GPU device, 0 = no GPU device, -1 = OpenCL not loaded yet or no
+ platform
+ \mt fully threadsafe
+ */
+int jobsched_probegpu( void ){
+
+  cl_platform_id platf;
+  cl_uint numplatf = 0, numdevices = 0;
+
+  if ((clGetPlatformIDs( 1, &platf, &numplatf ) != CL_SUCCESS) || (numplatf < 1)) {
+    return( -1 );
+  }
+
+  if ((clGetDeviceIDs( platf, CL_DEVICE_TYPE_GPU, 0, NULL, &numdevices ) != CL_SUCCESS) ||
+      (numdevices < 1)) {
+    return( 0 );
+  }
+
+  return( 1 );
+
+} // jobsched_probegpu
+
+
+
+/*!
+ \brief Sets the default limits (if not set yet)
+ \details
+ The GPU slots are probed once, also if OpenCL has not been loaded yet (no GPU); jobsched_reprobe
+ probes again.
+ \mt scheduler lock must be held
+ */
+void jobsched_defaults( void ){
+
+  if (limcores <= 0) {
+    limcores = cputopo_count();
+  }
+
+  if (limgpus < 0) {                       // one slot if there is a GPU
+    limgpus = (jobsched_probegpu() > 0) ? 1 : 0;
+    schedprobed = 1;
+  }
+
+  if (limmemory <= 0) {
+                              // a quarter of the physical memory
+    limmemory = (long long) sysconf( _SC_PHYS_PAGES ) * sysconf( _SC_PAGESIZE ) / 4;
+
+    if (limmemory <= 0) {
+      limmemory = 1LL << 30;
+    }
+  }
+
+} // jobsched_defaults
+
+
+
+/*!
+ \brief Finds the record of a handle
+ \param handle (in) handle of the job
+ \returns the record, NULL = unknown handle
+ \mt scheduler lock must be held
+ */
+struct jobsched_rec* jobsched_find( int handle ){
+
+  if (handle <= 0) {
+    return( NULL );
+  }
+
+  struct jobsched_rec* rec = &schedtab[(handle - 1) % JOBCTL_MAXJOBS];
+
+  if (rec->handle != handle) {
+    return( NULL );
+  }
+
+  return( rec );
+
+} // jobsched_find
+
+
+
+/*!
+ \brief Estimates the number of cores a multithreaded job needs
+ \param desc (in) the descriptor
+ \returns number of cores (1 .. limcores)
+ \mt scheduler lock must be held
+ */
+int jobsched_needcores( const struct jobsched_desc* desc ){
+
+  int cores = desc->cores;
+
+  if (cores <= 0) {
+                              // distance calculations (k-means: per cycle, DBSCAN: all queries)
+    double work = (double) desc->blen * desc->features;
+
+    work *= (desc->group == JOBCTL_DBSCAN) ? (double) desc->blen : (double) desc->param;
+
+    cores = (int) (work / (double) JOBSCHED_COREWORK) + 1;
+  }
+
+  if (cores > limcores) {
+    cores = limcores;
+  }
+
+  return( cores );
+
+} // jobsched_needcores
+
+
+
+/*!
+ \brief Removes a job from the queue
+ \param slot (in) slot of the job
+ \mt scheduler lock must be held
+ */
+void jobsched_dequeue( int slot ){
+
+  int prev = -1;
+
+  for (int i1 = schedhead; i1 != -1; i1 = schedtab[i1].next) {
+
+    if (i1 == slot) {
+
+      if (prev == -1) {
+        schedhead = schedtab[i1].next;
+      } else {
+        schedtab[prev].next = schedtab[i1].next;
+      }
+
+      if (schedtail == slot) {
+        schedtail = prev;
+      }
+
+      schedtab[i1].next = -1;
+
+      return;
+    }
+
+    prev = i1;
+  }
+
+} // jobsched_dequeue
+
+
+
+/*!
+ \brief Puts a job back at the head of the queue
+ \param slot (in) slot of the job (not queued)
+ \mt scheduler lock must be held
+ */
+void jobsched_requeue( int slot ){
+
+  schedtab[slot].next = schedhead;
+  schedhead = slot;
+
+  if (schedtail == -1) {
+    schedtail = slot;
+  }
+
+} // jobsched_requeue
+
+
+
+/*!
+ \brief Frees a record
+ \param rec (in+out) the record (job finished)
+ \mt scheduler lock must be held
+ */
+void jobsched_free( struct jobsched_rec* rec ){
+
+  free( rec->desc.b );
+  rec->desc.b = NULL;
+
+  jobctl_detach( rec->job );
+  jobctl_release( rec->handle );
+
+  rec->handle = 0;
+
+} // jobsched_free
+
+
+
+/*!
+ \brief Marks a job as finished
+ \details
+ Frees the data items and, if the job has been released, the record.
+ \param rec (in+out) the record (not queued any more)
+ \param result (in) result of the job
+ \mt scheduler lock must be held
+ */
+void jobsched_finish( struct jobsched_rec* rec, short result ){
+
+  rec->t[2] = jobsched_now();
+
+  if (rec->state == JOBSCHED_QUEUED) {     // never started
+    rec->t[1] = rec->t[2];
+  }
+
+  rec->state = JOBSCHED_DONE;
+  rec->result = result;
+
+  if ((rec->desc.done != NULL) && (schedpendcnt < JOBCTL_MAXJOBS)) {   // notify the submitter
+
+    struct jobsched_note* note = &schedpending[(schedpendfirst + schedpendcnt) % JOBCTL_MAXJOBS];
+
+    note->done = rec->desc.done;
+    note->handle = rec->handle;
+    note->result = result;
+    note->arg = rec->desc.donearg;
+    schedpendcnt++;
+  }
+
+  pthread_cond_broadcast( &schedcond );    // wake up jobsched_wait
+
+  free( rec->desc.data );
+  rec->desc.data = NULL;
+
+  if (rec->released == 1) {
+    jobsched_free( rec );
+  }
+
+} // jobsched_finish
+
+
+
+/*!
+ \brief Calls the collected completion functions
+ \details
+ If another thread is calling them already, it also calls the ones collected now.
+ \mt scheduler lock must NOT be held
+ */
+void jobsched_notify( void ){
+
+  struct jobsched_note note;
+
+  pthread_mutex_lock( &schedlock );
+
+  if (schednotifying == 0) {               // one notifying thread at a time
+
+    schednotifying = 1;
+
+    while (schedpendcnt > 0) {
+
+      note = schedpending[schedpendfirst]; // in the order the jobs finished
+
+      schedpendfirst = (schedpendfirst + 1) % JOBCTL_MAXJOBS;
+      schedpendcnt--;
+
+      pthread_mutex_unlock( &schedlock );
+
+      note.done( note.handle, note.result, note.arg );
+
+      pthread_mutex_lock( &schedlock );
+    }
+
+    schednotifying = 0;
+  }
+
+  pthread_mutex_unlock( &schedlock );
+
+} // jobsched_notify
+
+
+
+void jobsched_dispatch( void );
+
+/*!
+ \brief Runner thread of a job
+ \param arg (in+out) the record
+ \returns NULL
+ \mt fully threadsafe
+ */
+void* jobsched_runner( void* arg ){
+
+  struct jobsched_rec* rec = (struct jobsched_rec*) arg;
+
+  long long elapsed = 0;
+
+                              // run the engine (the record is not changed while running)
+  short result = rec->desc.run( &rec->desc, rec->engine, rec->cores, rec->job, &elapsed );
+
+  pthread_mutex_lock( &schedlock );
+
+  rec->elapsed = elapsed;
+
+                              // return the resources
+  schedrunning--;
+  schedcores -= rec->cores;
+  schedmemory -= rec->memory;
+
+  if (rec->engine == JOBSCHED_GPU) {
+    schedgpus--;
+  }
+
+  if ((result == JOBSCHED_EFALLBACK) && (rec->desc.engine == JOBSCHED_AUTO)) {
+
+    rec->desc.engine = JOBSCHED_PTHREADS;  // GPU not usable -> workers, before all other jobs
+    rec->state = JOBSCHED_QUEUED;
+
+    jobsched_requeue( (rec->handle - 1) % JOBCTL_MAXJOBS );
+
+  } else {
+    jobsched_finish( rec, result );
+  }
+
+  jobsched_dispatch();                     // start the next jobs
+
+  pthread_mutex_unlock( &schedlock );
+
+  jobsched_notify();
+
+  return( NULL );
+
+} // jobsched_runner
+
+
+
+/*!
+ \brief Starts the jobs at the head of the queue as long as the resources allow it
+ \mt scheduler lock must be held
+ */
+void jobsched_dispatch( void ){
+
+  jobsched_defaults();
+
+  while (schedhead != -1) {
+
+    struct jobsched_rec* rec = &schedtab[schedhead];
+
+                              // cancelled or expired in the queue -> do not start
+    if (jobctl_check( rec->job ) != JOBCTL_RUNNING) {
+      jobsched_dequeue( schedhead );
+      jobsched_finish( rec, rec->desc.stopped );
+      continue;
+    }
+
+    int engine = rec->desc.engine;
+
+    if (engine == JOBSCHED_AUTO) {
+      engine = (schedgpus < limgpus) ? JOBSCHED_GPU : JOBSCHED_PTHREADS;
+    }
+
+    const int cores = (engine == JOBSCHED_PTHREADS) ? jobsched_needcores( &rec->desc ) : 1;
+
+                              // data items and cluster numbers, copies on the device
+    long long memory = ((long long) rec->desc.blen * rec->desc.features * sizeof(float) +
+                        (long long) rec->desc.blen * sizeof(unsigned short)) *
+                       ((engine == JOBSCHED_GPU) ? 2 : 1);
+
+    if ((schedrunning > 0) &&
+        ((schedcores + cores > limcores) || (schedmemory + memory > limmemory) ||
+         ((engine == JOBSCHED_GPU) && (schedgpus >= limgpus)))) {
+      break;                               // head of the queue waits (no overtaking)
+    }
+
+    jobsched_dequeue( schedhead );
+
+    rec->engine = engine;
+    rec->cores = cores;
+    rec->memory = memory;
+    rec->state = JOBSCHED_RUNNING;
+    rec->t[1] = jobsched_now();
+
+                              // workers for all running multithreaded jobs, not only this one
+    if (engine == JOBSCHED_PTHREADS) {
+      threadpool_reserve( schedcores + cores );
+    }
+
+    pthread_attr_t attr;
+    pthread_t th;
+
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+
+    if (pthread_create( &th, &attr, &jobsched_runner, rec ) == 0) {
+
+      schedrunning++;
+      schedcores += cores;
+      schedmemory += memory;
+
+      if (engine == JOBSCHED_GPU) {
+        schedgpus++;
+      }
+
+    } else {
+      jobsched_finish( rec, JOBSCHED_ENOSTART );
+    }
+
+    pthread_attr_destroy( &attr );
+  }
+
+} // jobsched_dispatch
+
+
+
+// see header file for details
+int jobsched_submit( const struct jobsched_desc* desc ){
+
+  if ((desc->data == NULL) || (desc->b == NULL) || (desc->run == NULL) || (desc->blen <= 0) ||
+      (desc->features <= 0) || (desc->engine < JOBSCHED_AUTO) || (desc->engine > JOBSCHED_GPU)) {
+    return( JOBSCHED_EDESC );
+  }
+
+  const int handle = jobctl_create( desc->timeoutms );
+
+  if (handle <= 0) {
+    return( JOBSCHED_ENOSTART );
+  }
+
+  struct jobctl* job = jobctl_attach( handle, desc->group );
+
+  if (job == NULL) {
+    jobctl_release( handle );
+    return( JOBSCHED_ENOSTART );
+  }
+
+  pthread_mutex_lock( &schedlock );
+
+  const int slot = (handle - 1) % JOBCTL_MAXJOBS;
+  struct jobsched_rec* rec = &schedtab[slot];
+
+  rec->handle = handle;
+  rec->state = JOBSCHED_QUEUED;
+  rec->released = 0;
+  rec->engine = desc->engine;
+  rec->cores = 0;
+  rec->memory = 0;
+  rec->result = 0;
+  rec->t[0] = rec->t[1] = rec->t[2] = jobsched_now();
+  rec->elapsed = 0;
+  rec->next = -1;
+  rec->job = job;
+  rec->desc = *desc;
+
+  if (schedtail == -1) {                   // append to the queue
+    schedhead = slot;
+  } else {
+    schedtab[schedtail].next = slot;
+  }
+
+  schedtail = slot;
+
+  jobsched_dispatch();
+
+  pthread_mutex_unlock( &schedlock );
+
+  jobsched_notify();
+
+  return( handle );
+
+} // jobsched_submit
+
+
+
+// see header file for details
+int jobsched_poll( int handle ){
+
+  pthread_mutex_lock( &schedlock );
+
+  struct jobsched_rec* rec = jobsched_find( handle );
+  const int ret = (rec != NULL) ? rec->state : JOBSCHED_EUNKNOWN;
+
+  pthread_mutex_unlock( &schedlock );
+
+  return( ret );
+
+} // jobsched_poll
+
+
+
+// see header file for details
+int jobsched_wait( int handle, long long timeoutms ){
+
+  struct timespec until;
+
+  clock_gettime( CLOCK_REALTIME, &until );       // the clock of the condition variable
+
+  if (timeoutms > 0) {
+    until.tv_sec += timeoutms / 1000;
+    until.tv_nsec += (timeoutms % 1000) * 1000000L;
+
+    if (until.tv_nsec >= 1000000000L) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000L;
+    }
+  }
+
+  pthread_mutex_lock( &schedlock );
+
+  struct jobsched_rec* rec = jobsched_find( handle );
+
+  while ((rec != NULL) && (rec->state != JOBSCHED_DONE)) {
+
+    if (timeoutms > 0) {
+      if (pthread_cond_timedwait( &schedcond, &schedlock, &until ) != 0) {
+        break;                                   // time is up
+      }
+    } else {
+      pthread_cond_wait( &schedcond, &schedlock );
+    }
+
+    rec = jobsched_find( handle );               // may have been released meanwhile
+  }
+
+  const int ret = (rec != NULL) ? rec->state : JOBSCHED_EUNKNOWN;
+
+  pthread_mutex_unlock( &schedlock );
+
+  return( ret );
+
+} // jobsched_wait
+
+
+
+// see header file for details
+int jobsched_result( int handle, short* result, const unsigned short** b, int* blen,
+                     long long* info, int ilen ){
+
+  int ret = 0;
+
+  pthread_mutex_lock( &schedlock );
+
+  struct jobsched_rec* rec = jobsched_find( handle );
+
+  if (rec == NULL) {
+    ret = JOBSCHED_EUNKNOWN;
+  } else if (rec->state != JOBSCHED_DONE) {
+    ret = JOBSCHED_EPENDING;
+  } else {
+
+    *result = rec->result;
+    *b = rec->desc.b;
+    *blen = rec->desc.blen;
+
+    const long long v[JOBSCHED_NINFO] = { rec->engine, rec->cores, rec->t[1] - rec->t[0],
+                                          rec->t[2] - rec->t[1], rec->elapsed,
+                                          rec->desc.group };
+
+    for (int i1 = 0; (info != NULL) && (i1 < ilen) && (i1 < JOBSCHED_NINFO); i1++) {
+      info[i1] = v[i1];
+    }
+  }
+
+  pthread_mutex_unlock( &schedlock );
+
+  return( ret );
+
+} // jobsched_result
+
+
+
+// see header file for details
+int jobsched_cancel( int handle ){
+
+  int ret = 0;
+
+  pthread_mutex_lock( &schedlock );
+
+  struct jobsched_rec* rec = jobsched_find( handle );
+
+  if (rec == NULL) {
+                                           // job created with jobctl_create?
+    ret = (jobctl_cancel( handle ) == 0) ? 0 : JOBSCHED_EUNKNOWN;
+  } else {
+
+    jobctl_cancel( handle );
+
+    if (rec->state == JOBSCHED_QUEUED) {   // not started -> remove from the queue
+      jobsched_dequeue( (handle - 1) % JOBCTL_MAXJOBS );
+      jobsched_finish( rec, rec->desc.stopped );
+      jobsched_dispatch();                 // the job may have blocked the queue
+    }
+  }
+
+  pthread_mutex_unlock( &schedlock );
+
+  jobsched_notify();
+
+  return( ret );
+
+} // jobsched_cancel
+
+
+
+// see header file for details
+void jobsched_release( int handle ){
+
+  pthread_mutex_lock( &schedlock );
+
+  struct jobsched_rec* rec = jobsched_find( handle );
+
+  if (rec == NULL) {
+    jobctl_release( handle );              // job created with jobctl_create
+  } else {
+
+    rec->released = 1;
+
+    if (rec->state == JOBSCHED_QUEUED) {
+      jobsched_dequeue( (handle - 1) % JOBCTL_MAXJOBS );
+      jobsched_finish( rec, rec->desc.stopped );     // frees the record
+      jobsched_dispatch();
+    } else if (rec->state == JOBSCHED_DONE) {
+      jobsched_free( rec );
+    }
+  }
+
+  pthread_mutex_unlock( &schedlock );
+
+  jobsched_notify();
+
+} // jobsched_release
+
+
+
+// see header file for details
+void jobsched_limits( int cores, long long memory, int gpus ){
+
+  pthread_mutex_lock( &schedlock );
+
+  limcores = cores;
+  limmemory = memory;
+  limgpus = (gpus >= 0) ? gpus : -1;
+  schedprobed = 0;
+
+  jobsched_defaults();
+  jobsched_dispatch();                     // more jobs may fit now
+
+  pthread_mutex_unlock( &schedlock );
+
+  jobsched_notify();
+
+} // jobsched_limits
+
+
+
+// see header file for details
+void jobsched_reprobe( void ){
+
+  pthread_mutex_lock( &schedlock );
+
+  if (schedprobed == 1) {                  // not set with jobsched_limits?
+    limgpus = -1;
+    jobsched_defaults();
+    jobsched_dispatch();                   // a GPU job may fit now
+  }
+
+  pthread_mutex_unlock( &schedlock );
+
+  jobsched_notify();
+
+} // jobsched_reprobe
@@ -2,8 +2,9 @@
  \file kmeans_c.c
  \brief Source file for the C/C+GPU implementations of the Kmeans algorithm
  \details
- This header file contains three method prototypes, that allow to perform single- or multithreaded CPU or
- GPU based Kmeans cluster searches.
+ This file contains the single- or multithreaded CPU and GPU based Kmeans cluster searches and
+ their functions of the public C interface (agpudm.h). It does not depend on JNI, the JNI methods
+ are in kmeans_jni.c.
  \copyright Copyright Robert Fritze 2021
  \license MIT
  \version 1.0
@@ -11,48 +12,69 @@
  \date 11.9.2021
  */
 
-#include <jni.h>
-#include "kmeans_c.h"
+#include "agpudm_core.h"
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
-#include "oclwrapper.h"
 
                                 //! use older OpenCL APIS
 #define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 
 #include <CL/opencl.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdint.h>
+#include <limits.h>
 #include <time.h>
 #include <string.h>
-#include <rwlock_wp.h>
+#include "oclbuffer.h"
+#include "ocltune.h"
+#include "oclstore.h"
+#include "threadpool.h"
+#include "jobctl.h"
+#include "jobsched.h"
+#include "trace.h"
 
                                //! Define if detailed timing for the GPU should be made
 #define GPUTIMING
 
-                               //! A reader writer lock for premature abort
-volatile struct rwlockwp abortcalckm = RWLOCK_STATIC_INITIALIZER;
-                               //! 1=abort, access with *abortcalckm*
-volatile int doabort = 0;
-
 /*!
- \brief Kmeans OpenCL kernel
+ \brief Kmeans OpenCL kernels
  \details
  <h3>__kernel void testdistance</h3>
  (<br>
- &emsp;  global const float* data, <br>
+ &emsp;  global const DATA_T* data, <br>
  &emsp;  global unsigned short* b, <br>
  &emsp;  constant const float* clucent, <br>
  &emsp;  const int features, <br>
- &emsp;  const int cluno  <br>
+ &emsp;  const int cluno,  <br>
+ &emsp;  const int blen,  <br>
+ &emsp;  global const float* qparam  <br>
  ) <br><br>
 
  calculates for each data item
  the eucledean distance to all cluster centers
  and saves the number of the cluster center with the smallest distance. <br>
 
+ <h3>__kernel void testdistance_tiled</h3>
+ (<br>
+ &emsp;  global const DATA_T* data, <br>
+ &emsp;  global unsigned short* b, <br>
+ &emsp;  global const float* clucent, <br>
+ &emsp;  const int features, <br>
+ &emsp;  const int cluno,  <br>
+ &emsp;  const int blen,  <br>
+ &emsp;  global const float* qparam,  <br>
+ &emsp;  local float* tile,  <br>
+ &emsp;  const int tilecent  <br>
+ ) <br><br>
+
+ same as <em>testdistance</em>, but the cluster centers are loaded cooperatively in tiles of
+ <em>tilecent</em> centers into local memory. Used if the cluster centers do not fit into
+ constant memory. <br>
+
+ The data items are stored as DATA_T and read with LOADF (see oclstore.h), the distances are
+ always accumulated in single precision. <br>
+
  <table>
   <tr>
     <th>parameter</th>
@@ -60,9 +82,9 @@ volatile int doabort = 0;
     <th>description</th>
   </tr>
   <tr>
-    <td><em>global const float* data</em></td>
+    <td><em>global const DATA_T* data</em></td>
     <td>in</td>
-    <td>input data</td>
+    <td>input data (float, half or char, see oclstore.h)</td>
   </tr>
   <tr>
     <td><em>global unsigned short* b</em></td>
@@ -84,23 +106,49 @@ volatile int doabort = 0;
     <td>in</td>
     <td>the number of clusters to search for</td>
   </tr>
+  <tr>
+    <td><em>const int blen</em> </td>
+    <td>in</td>
+    <td>the number of data items (work-items beyond are padding)</td>
+  </tr>
+  <tr>
+    <td><em>global const float* qparam</em> </td>
+    <td>in</td>
+    <td>scale and offset per feature (int8 storage only)</td>
+  </tr>
+  <tr>
+    <td><em>local float* tile</em> </td>
+    <td>-</td>
+    <td>local memory for <em>tilecent*features</em> floats (tiled only)</td>
+  </tr>
+  <tr>
+    <td><em>const int tilecent</em> </td>
+    <td>in</td>
+    <td>the number of cluster centers per tile (tiled only)</td>
+  </tr>
 </table>
 
  */
-const char* clsource = \
+const char* kmeans_clsource = OCLSTORE_PREAMBLE \
 "                                                                         \n" \
 "                                                                         \n" \
 "  __kernel void testdistance(                                            \n" \
 "                                                                         \n" \
-"    global const float* data,                                            \n" \
+"    global const DATA_T* data,                                           \n" \
 "    global unsigned short* b,                                            \n" \
 "    constant const float* clucent,                                       \n" \
 "    const int features,                                                  \n" \
-"    const int cluno                                                      \n" \
+"    const int cluno,                                                     \n" \
+"    const int blen,                                                      \n" \
+"    global const float* qparam                                           \n" \
 "                                                                         \n" \
 "  ) {                                                                    \n" \
 "      size_t gid = get_global_id( 0 );                                   \n" \
 "                                                                         \n" \
+"      if (gid >= blen) {              // padded work-item                \n" \
+"        return;                                                          \n" \
+"      }                                                                  \n" \
+"                                                                         \n" \
 "      float noxi = INFINITY;                                             \n" \
 "                                                                         \n" \
 "      for( unsigned short i2=0; i2<cluno; i2++ ){                        \n" \
@@ -108,7 +156,7 @@ const char* clsource = \
 "        float noxi2 = 0;                                                 \n" \
 "                                                                         \n" \
 "        for( int i3=0; i3<features; i3++ ){                              \n" \
-"          noxi2 += pown( clucent[i2*features+i3] - data[gid*features+i3], 2 ); \n" \
+"          noxi2 += pown( clucent[i2*features+i3] - LOADF(gid*features+i3,i3), 2 ); \n" \
 "        }                                                                \n" \
 "                                                                         \n" \
 "        if (noxi2<noxi){                                                 \n" \
@@ -118,6 +166,63 @@ const char* clsource = \
 "      }                                                                  \n" \
 "    }                                                                    \n" \
 "                                                                         \n" \
+"                                                                         \n" \
+"                                                                         \n" \
+"  __kernel void testdistance_tiled(                                      \n" \
+"                                                                         \n" \
+"    global const DATA_T* data,                                           \n" \
+"    global unsigned short* b,                                            \n" \
+"    global const float* clucent,                                         \n" \
+"    const int features,                                                  \n" \
+"    const int cluno,                                                     \n" \
+"    const int blen,                                                      \n" \
+"    global const float* qparam,                                          \n" \
+"    local float* tile,                                                   \n" \
+"    const int tilecent                                                   \n" \
+"                                                                         \n" \
+"  ) {                                                                    \n" \
+"      size_t gid = get_global_id( 0 );                                   \n" \
+"      int lid = get_local_id( 0 );                                       \n" \
+"      int lsz = get_local_size( 0 );                                     \n" \
+"                                                                         \n" \
+"      float noxi = INFINITY;                                             \n" \
+"      int found = -1;                                                    \n" \
+"                                                                         \n" \
+"      for( int t0=0; t0<cluno; t0+=tilecent ){   // iterate over tiles   \n" \
+"                                                                         \n" \
+"        int tn = min( tilecent, cluno-t0 );                              \n" \
+"                                                                         \n" \
+"        barrier( CLK_LOCAL_MEM_FENCE );     // last tile processed       \n" \
+"                                                                         \n" \
+"        for( int i1=lid; i1<tn*features; i1+=lsz ){   // load tile       \n" \
+"          tile[i1] = clucent[t0*features+i1];                            \n" \
+"        }                                                                \n" \
+"                                                                         \n" \
+"        barrier( CLK_LOCAL_MEM_FENCE );     // tile loaded               \n" \
+"                                                                         \n" \
+"        if (gid < blen) {              // padded work-items only load    \n" \
+"                                                                         \n" \
+"          for( int i2=0; i2<tn; i2++ ){                                  \n" \
+"                                                                         \n" \
+"            float noxi2 = 0;                                             \n" \
+"                                                                         \n" \
+"            for( int i3=0; i3<features; i3++ ){                          \n" \
+"              noxi2 += pown( tile[i2*features+i3] - LOADF(gid*features+i3,i3), 2 ); \n" \
+"            }                                                            \n" \
+"                                                                         \n" \
+"            if (noxi2<noxi){                                             \n" \
+"              noxi = noxi2;                                              \n" \
+"              found = t0+i2;                                             \n" \
+"            }                                                            \n" \
+"          }                                                              \n" \
+"        }                                                                \n" \
+"      }                                                                  \n" \
+"                                                                         \n" \
+"      if ((gid < blen) && (found >= 0)) {                                \n" \
+"        b[gid] = found;                                                  \n" \
+"      }                                                                  \n" \
+"    }                                                                    \n" \
+"                                                                         \n" \
 "                                                                         \n";
 
 
@@ -131,22 +236,395 @@ const char* clsource = \
  \details
  Generates uniformly distributed random numbers [0,limit]
  \param limit (in) the maximum random number desired
+ \param state (in+out) state of the generator (see rand_r)
  \returns a random number form a uniform distribution over [0,limit]
  \mt fully threadsafe
  */
-int rand_lim(int limit) {
+int rand_lim(int limit, unsigned int *state) {
 
   int divisor = RAND_MAX / (limit + 1);   // devisor
   int retval;                             // return value
 
   do {
-    retval = rand() / divisor;            // create random number
+    retval = rand_r(state) / divisor;     // create random number
   } while (retval > limit);               // wait until inside [0,limit]
 
   return retval;
 } // randlim
 
 
+
+/*!
+ \brief Selects the initial cluster centers
+ \details
+ Copies randomly chosen data items into the cluster centers. The same seed gives the same
+ centers, so a search can be repeated exactly.
+ \param clucent (out) Array of cluster centers (cluno * features values)
+ \param data (in) Array of data points
+ \param blen (in) number of data items in data
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param seed (in) seed of the random numbers, 0 = taken from the clock
+ \mt fully threadsafe
+ */
+void kmeans_seed(float *clucent, const float *data, const int blen, const int cluno,
+                 const int features, const unsigned int seed) {
+
+  unsigned int state = (seed != 0) ? seed : (unsigned int) time(NULL);
+
+                                       // iterate over all cluster centers
+  for (int i1 = 0; i1 < cluno; i1++) {
+
+                                      // select a point randomly
+    int cluxi = rand_lim(blen - 1, &state);
+
+                         // copy data point as new cluster center
+    for (int i2 = 0; i2 < features; i2++) {
+      clucent[features * i1 + i2] = data[cluxi * features + i2];
+    }
+  }
+
+} // kmeans_seed
+
+
+
+/*!
+ \brief Sets the initial cluster centers of a search
+ \details
+ A warm start copies the cluster centers of an earlier search, otherwise the centers are
+ selected by kmeans_seed.
+ \param clucent (out) Array of cluster centers (cluno * features values)
+ \param init (in) initial cluster centers (cluno * features values), NULL = kmeans_seed
+ \param data (in) Array of data points
+ \param blen (in) number of data items in data
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param seed (in) seed of the random numbers, 0 = taken from the clock
+ \mt fully threadsafe
+ */
+void kmeans_start(float *clucent, const float *init, const float *data, const int blen,
+                  const int cluno, const int features, const unsigned int seed) {
+
+  if (init != NULL) {                    // warm start
+    memcpy(clucent, init, sizeof(float) * features * cluno);
+  } else {
+    kmeans_seed(clucent, data, blen, cluno, features, seed);
+  }
+
+} // kmeans_start
+
+
+
+/*!
+ \brief Counts one iteration of a k-means search
+ \details
+ Called once per completed iteration by all engines, after the new cluster centers have been
+ calculated.
+ \param counters (in+out) the counters (NULL = nothing to do)
+ \param cycle (in) number of the iteration (0 = first)
+ \param displacement (in) displacement of the cluster centers in this iteration
+ \param moved (in) data items that changed their cluster in this iteration (ignored in the first
+ iteration, every data item gets its first cluster there)
+ \param clusize (in) size of the clusters in this iteration
+ \param blen (in) number of data items
+ \param cluno (in) number of clusters
+ \mt fully threadsafe
+ */
+void kmeans_tally(struct agpudm_stats *counters, const int cycle, const float displacement,
+                  int moved, const int *clusize, const int blen, const int cluno) {
+
+  if (counters != NULL) {
+
+    if (cycle == 0) {                    // first assignment of all data items
+      moved = blen;
+    }
+
+    if (cycle < counters->ilen) {        // per-iteration values requested?
+
+      if (counters->displacement != NULL) {
+        counters->displacement[cycle] = displacement;
+      }
+
+      if (counters->moved != NULL) {
+        counters->moved[cycle] = moved;
+      }
+    }
+
+    counters->iterations = cycle + 1;
+    counters->distances += (long long) blen * cluno;
+    counters->reassignments += moved;
+    counters->clusters = 0;
+
+    for (int i1 = 0; i1 < cluno; i1++) {   // empty clusters have no center
+      counters->clusters += (clusize[i1] > 0) ? 1 : 0;
+    }
+  }
+
+} // kmeans_tally
+
+
+
+/*!
+ \brief Assigns data items to their closest cluster center (mini-batch k-means)
+ \details
+ Implemented by every engine (see kmeans_assign_cpu and kmeans_assign_gpu), called by
+ kmeans_minibatch for the batches and for the final assignment of all data items.
+ \param arg (in+out) the engine
+ \param items (in) the data items (count * features values)
+ \param count (in) number of data items (at most the pass length given to kmeans_minibatch)
+ \param b (out) cluster numbers of the data items
+ \param clucent (in) the cluster centers
+ \returns 0 = no error, <0 = error number of the engine
+ */
+typedef short (*kmeans_assignfn)(void *arg, const float *items, int count, unsigned short *b,
+                                 float *clucent);
+
+
+
+/*!
+ \brief Returns the number of data items per batch
+ \param mb (in) parameters of the mini-batch search
+ \param blen (in) number of data items
+ \returns data items per batch (1 .. blen)
+ \mt fully threadsafe
+ */
+int kmeans_mbsize(const struct agpudm_minibatch_params *mb, const int blen) {
+
+  const int batch = (mb->batch > 0) ? mb->batch : AGPUDM_MINIBATCH_BATCH;
+
+  return ((batch < blen) ? batch : blen);
+
+} // kmeans_mbsize
+
+
+
+/*!
+ \brief Moves the cluster centers towards the data items of a batch
+ \details
+ Update of Sculley (Web-scale k-means clustering, 2010): every data item pulls its cluster
+ center with the learning rate 1 / (data items the center has seen so far), so a center is the
+ running mean of its data items and its steps become smaller as it settles.
+ \param clucent (in+out) the cluster centers
+ \param seen (in+out) data items seen per cluster center
+ \param items (in) the data items of the batch
+ \param b (in) cluster numbers of the data items
+ \param count (in) number of data items
+ \param features (in) number of features per data item
+ \returns inertia of the batch (squared distances of the data items to their center before it
+ moves towards them)
+ \mt fully threadsafe
+ */
+double kmeans_mbupdate(float *clucent, long long *seen, const float *items,
+                       const unsigned short *b, const int count, const int features) {
+
+  double inertia = 0;                    // return value
+
+  for (int i1 = 0; i1 < count; i1++) {
+
+    float *c = clucent + b[i1] * features;              // center of the data item
+    const float *x = items + (size_t) i1 * features;
+    const float eta = 1.0f / (float) ++seen[b[i1]];     // learning rate of the center
+    float dist2 = 0;
+
+    for (int i2 = 0; i2 < features; i2++) {
+      const float d = x[i2] - c[i2];
+      dist2 += d * d;
+      c[i2] += eta * d;
+    }
+
+    inertia += dist2;
+  }
+
+  return (inertia);
+
+} // kmeans_mbupdate
+
+
+
+/*!
+ \brief Mini-batch k-means cluster search
+ \details
+ Shared by all engines, the engine only assigns the data items to the cluster centers (see
+ kmeans_assignfn). Every batch draws *batch* random data items (with replacement), assigns them
+ and moves the centers towards them (kmeans_mbupdate). The search stops after *batches* batches,
+ if the displacement of the centers in a batch is <= eps or if the inertia per data item,
+ smoothed over the batches (exponential average, weight of a batch 2 / (plateau + 1), at least
+ 2 * batch / (blen + 1) like scikit-learn), has not reached a new minimum for *plateau* batches. Finally all data items are
+ assigned in passes of *passlen* data items.
+ \param b (out) Array of cluster numbers
+ \param data (in) Array of data points
+ \param blen (in) number of data items in data
+ \param eps (in) maximum cluster center displacement of a batch
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param clucent (out) the cluster centers (cluno * features values)
+ \param mb (in) parameters of the mini-batch search
+ \param passlen (in) data items per call of *assign* in the final assignment
+ \param seed (in) seed of the initial cluster centers and of the batches, 0 = taken from the clock
+ \param assign (in) assignment of the engine
+ \param arg (in+out) argument of *assign*
+ \param job (in+out) the job, tested once per batch and pass (NULL = never stops)
+ \param counters (in+out) counters (see kmeans_tally, a batch is an iteration), NULL = not needed
+ \returns 0 = no error, -30 = cancelled or deadline passed, -2 = malloc error, <0 = error number
+ of *assign*
+ \mt fully threadsafe
+ */
+short kmeans_minibatch(unsigned short *b, const float *data, const int blen, const float eps,
+                       const int cluno, const int features, float *clucent,
+                       const struct agpudm_minibatch_params *mb, const int passlen,
+                       const unsigned int seed, kmeans_assignfn assign, void *arg,
+                       struct jobctl *job, struct agpudm_stats *counters) {
+
+  short ret = 0;                         // return value
+
+  const int batch = kmeans_mbsize(mb, blen);
+  const int batches = (mb->batches > 0) ? mb->batches : AGPUDM_MINIBATCH_BATCHES;
+  const int plateau = (mb->plateau > 0) ? mb->plateau : AGPUDM_MINIBATCH_PLATEAU;
+
+                                 // data items and cluster numbers of a batch
+  float *items = (float *) malloc(sizeof(float) * features * batch);
+  unsigned short *bb = (unsigned short *) calloc(batch, sizeof(unsigned short));
+
+                                 // cluster centers before the batch, data items seen per center
+  float *oldclucent = (float *) malloc(sizeof(float) * features * cluno);
+  long long *seen = (long long *) calloc(cluno, sizeof(long long));
+  int *clusize = (int *) malloc(sizeof(int) * cluno);
+
+  if ((items != NULL) && (bb != NULL) && (oldclucent != NULL) && (seen != NULL) &&
+      (clusize != NULL)) {               // malloc error?
+
+                               // random data items as initial cluster centers
+    kmeans_seed(clucent, data, blen, cluno, features, seed);
+
+                               // the batches use other random numbers than the centers
+    unsigned int state = ((seed != 0) ? seed : (unsigned int) time(NULL)) ^ 0x9E3779B9u;
+
+                               // weight of a batch in the smoothed inertia: a window of about
+                               // *plateau* batches, more if the batches cover much of the data
+    const double alpha = (2.0 * batch / (blen + 1.0) > 2.0 / (plateau + 1.0)) ?
+                         ((2.0 * batch / (blen + 1.0) < 1.0) ? 2.0 * batch / (blen + 1.0) : 1.0) :
+                         2.0 / (plateau + 1.0);
+    double smooth = 0;                   // smoothed inertia per data item
+    double best = INFINITY;              // its minimum
+    int stale = 0;                       // batches since the minimum
+
+    for (int cycles = 0; cycles < batches; cycles++) {
+
+      const long long tr = trace_begin();    // span of the batch
+
+                                  // cancelled or deadline passed?
+      if (jobctl_check(job) != JOBCTL_RUNNING) {
+        ret = -30;
+        break;
+      }
+
+                                  // draw the batch
+      for (int i1 = 0; i1 < batch; i1++) {
+        const int xi = rand_lim(blen - 1, &state);
+        memcpy(items + (size_t) i1 * features, data + (size_t) xi * features,
+               sizeof(float) * features);
+      }
+
+      ret = assign(arg, items, batch, bb, clucent);
+
+      if (ret != 0) {
+        break;
+      }
+                                  // chunks may have been skipped
+      if (jobctl_check(job) != JOBCTL_RUNNING) {
+        ret = -30;
+        break;
+      }
+
+      memcpy(oldclucent, clucent, sizeof(float) * features * cluno);
+
+      const double inertia = kmeans_mbupdate(clucent, seen, items, bb, batch, features) / batch;
+
+      float newdist = 0;                 // calculate cluster center displacement
+
+      for (int i1 = 0; i1 < cluno; i1++) {
+
+        float newdist2 = 0;
+
+        for (int i2 = 0; i2 < features; i2++) {
+          newdist2 += powf(oldclucent[i1 * features + i2] - clucent[i1 * features + i2], 2);
+        }
+
+        newdist += sqrt(newdist2);
+        clusize[i1] = 0;
+      }
+
+      for (int i1 = 0; i1 < batch; i1++) {   // members of the clusters in the batch
+        clusize[bb[i1]]++;
+      }
+
+      kmeans_tally(counters, cycles, newdist, 0, clusize, batch, cluno);
+
+      smooth = (cycles == 0) ? inertia : smooth * (1.0 - alpha) + inertia * alpha;
+
+      if (smooth < best) {               // new minimum?
+        best = smooth;
+        stale = 0;
+      } else {
+        stale++;
+      }
+
+      trace_end(TRACE_ALGO, "kmeans batch", tr, cycles);
+
+                                  // check loop conditions
+      if ((newdist <= eps) || (stale >= plateau)) {
+        break;
+      }
+    }
+
+    const long long tr = trace_begin();      // span of the final assignment
+
+                                  // assign all data items
+    for (int i1 = 0; (i1 < blen) && (ret == 0); i1 += passlen) {
+
+      ret = assign(arg, data + (size_t) i1 * features, (blen - i1 < passlen) ? blen - i1 : passlen,
+                   b + i1, clucent);
+
+      if ((ret == 0) && (jobctl_check(job) != JOBCTL_RUNNING)) {
+        ret = -30;
+      }
+    }
+
+    trace_end(TRACE_ALGO, "kmeans assignment", tr, blen);
+
+    if ((ret == 0) && (counters != NULL)) {
+
+      for (int i1 = 0; i1 < cluno; i1++) {
+        clusize[i1] = 0;
+      }
+
+      for (int i1 = 0; i1 < blen; i1++) {
+        clusize[b[i1]]++;
+      }
+
+      counters->distances += (long long) blen * cluno;
+      counters->clusters = 0;
+
+      for (int i1 = 0; i1 < cluno; i1++) {   // non-empty clusters of the result
+        counters->clusters += (clusize[i1] > 0) ? 1 : 0;
+      }
+    }
+
+  } else {
+    ret = -2;
+  }
+
+  free(clusize);                         // free used memory
+  free(seen);
+  free(oldclucent);
+  free(bb);
+  free(items);
+
+  return (ret);
+
+} // kmeans_minibatch
+
+
 /*!
  \brief Kmeans cluster search
  \details
@@ -157,16 +635,20 @@ int rand_lim(int limit) {
  \param eps (in) maximum cluster center displacement
  \param cluno (in) number of clusters to search for
  \param features (in) number of features per data item
- \returns 0 = no error, <0 = error number
+ \param seed (in) seed of the initial cluster centers, 0 = taken from the clock
+ \param init (in) initial cluster centers (see kmeans_start), NULL = selected with *seed*
+ \param centers (out) final cluster centers (cluno * features values), NULL = not needed
+ \param job (in+out) the job, tested every JOBCTL_STRIDE data items (NULL = never stops)
+ \param counters (in+out) counters of the iterations (see kmeans_tally), NULL = not needed
+ \returns 0 = no error, -30 = cancelled or deadline passed, <0 = error number
  \mt fully threadsafe
  */
 short kmeans(unsigned short *b, const float *data, const int blen, const float eps, const int cluno,
-             const int features) {
+             const int features, const unsigned int seed, const float *init, float *centers,
+             struct jobctl *job, struct agpudm_stats *counters) {
 
   short ret = 0;                         // return value
 
-  srand((unsigned int) time(NULL));          // initialize random generator
-
                                  // alloc memory for cluster centers
   float *clucent = (float *) malloc(sizeof(float) * features * cluno);
 
@@ -182,17 +664,8 @@ short kmeans(unsigned short *b, const float *data, const int blen, const float e
 
       if (clusize != NULL) {                     // malloc error?
 
-                                       // iterate over all cluster centers
-        for (int i1 = 0; i1 < cluno; i1++) {
-
-                                      // select a point randomly
-          int cluxi = rand_lim(blen - 1);
-
-                         // copy data point as new cluster center
-          for (int i2 = 0; i2 < features; i2++) {
-            clucent[features * i1 + i2] = data[cluxi * features + i2];
-          }
-        }
+                               // random data items (or warm start) as initial cluster centers
+        kmeans_start(clucent, init, data, blen, cluno, features, seed);
 
 
         int weiter = 0;                // loop abort condition
@@ -202,9 +675,18 @@ short kmeans(unsigned short *b, const float *data, const int blen, const float e
                                       // not been reached or cluster center displacement
                                       // has become very small
 
+          const long long tr = trace_begin();   // span of the cycle
+          int moved = 0;               // data items that changed their cluster
+
                                        // iterate over all data items
           for (int i1 = 0; i1 < blen; i1 += 1) {
 
+                                      // test the job now and then
+            if (((i1 & (JOBCTL_STRIDE - 1)) == 0) && (jobctl_check(job) != JOBCTL_RUNNING)) {
+              break;
+            }
+
+            const unsigned short old = b[i1];   // cluster of the last cycle
             float noxi = INFINITY;        // assign initial minimum distance
 
                                            // iterate over all cluster centers
@@ -224,6 +706,14 @@ short kmeans(unsigned short *b, const float *data, const int blen, const float e
                 b[i1] = i2;                // distance is smaller
               }
             }
+
+            moved += (b[i1] != old) ? 1 : 0;
+          }
+
+                                          // cancelled or deadline passed?
+          if (jobctl_check(job) != JOBCTL_RUNNING) {
+            ret = -30;
+            break;
           }
 
                                           // now update the cluster centers
@@ -246,7 +736,9 @@ short kmeans(unsigned short *b, const float *data, const int blen, const float e
                                          // find midpoint of cluster center
           for (int i1 = 0; i1 < cluno; i1++) {
             for (int i2 = 0; i2 < features; i2++) {
-              newclucent[i1 * features + i2] /= (float) clusize[i1];
+              newclucent[i1 * features + i2] = (clusize[i1] > 0) ?
+                newclucent[i1 * features + i2] / (float) clusize[i1] :
+                clucent[i1 * features + i2];          // empty cluster keeps its center
             }
           }
 
@@ -264,11 +756,16 @@ short kmeans(unsigned short *b, const float *data, const int blen, const float e
 
             newdist += sqrt(newdist2);          // calculate euclidean distance
           }
+
+          kmeans_tally(counters, cycles, newdist, moved, clusize, blen, cluno);
+
                                          // check loop conditions
           if ((newdist <= eps) || (cycles > MAXCYCLES)) {
             weiter = -1;
           }
 
+          trace_end(TRACE_ALGO, "kmeans cycle", tr, cycles);
+
           cycles++;                        // cound cycles
 
                                    // copy cluster centers
@@ -276,6 +773,10 @@ short kmeans(unsigned short *b, const float *data, const int blen, const float e
 
         }
 
+        if ((ret == 0) && (centers != NULL)) {   // final cluster centers requested?
+          memcpy(centers, clucent, sizeof(float) * features * cluno);
+        }
+
         free(clusize);            // free used memory
       } else {
         ret = -3;
@@ -297,65 +798,63 @@ short kmeans(unsigned short *b, const float *data, const int blen, const float e
 
 
 
-// see header file
-JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c
-  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features) {
-
-  short ret = 0;                  // return value
+/*!
+ \brief Selects the kmeans kernel for a device
+ \details
+ The cluster centers are passed in constant memory as long as they fit into
+ CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE. Otherwise the tiled kernel is used, each tile gets at most
+ half of the local memory of the device (the other half is left for the driver and for a
+ second work-group per compute unit).
+ \param dev (in) the OpenCL device
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \returns 0 = constant memory kernel, >0 = tiled kernel with this number of centers per tile,
+ <0 = device can not be queried or a single center does not fit into local memory
+ \mt fully threadsafe
+ */
+int kmeans_tilecent(cl_device_id dev, const int cluno, const int features) {
 
-                  // check for architecture compartibility
-  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+  cl_ulong constsize = 0;                       // size of constant memory
+  cl_ulong localsize = 0;                       // size of local memory
 
-                    // get number of data items*features
-    jsize datalen = (*env)->GetArrayLength(env, rf);
-                     // get number of data items
-    jsize blen = (*env)->GetArrayLength(env, b);
+  cl_int err = clGetDeviceInfo(dev, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, sizeof(cl_ulong),
+                               &constsize, NULL);
+  err |= clGetDeviceInfo(dev, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localsize, NULL);
 
-    if (features * blen == datalen) {   // must correspond
+  if (err != CL_SUCCESS) {                     // error?
+    return (-1);
+  }
 
-                                 // get array data
-      jfloat* condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+  const cl_ulong centsize = sizeof(cl_float) * features;   // bytes per cluster center
 
-      if (condata != NULL) {
+  if (centsize * cluno <= constsize) {          // fits into constant memory?
+    return (0);
+  }
 
-                                  // allocate buffer for the cluster assignment
-        unsigned short *conb = (unsigned short *) malloc(sizeof(unsigned short) * blen);
+  cl_ulong tilecent = (localsize / 2) / centsize;   // centers per tile
 
-        if (conb != NULL) {              // malloc error
+  if (tilecent == 0) {                          // not even one center fits
+    return (-2);
+  }
 
-                                           // perform kmeans search
-          kmeans(conb, condata, blen, eps, kk, features);
+  if (tilecent > (cl_ulong) cluno) {
+    tilecent = cluno;
+  }
 
-                             // copy result
-          (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+  return ((int) tilecent);
 
-          free(conb);                   // clean
-
-        } else {
-          ret = -5;
-        }
-
-        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
-
-      } else {
-        ret = -4;
-      }
-    } else {
-      ret = -3;
-    }
-  } else {
-    ret = -2;
-  }
-
-  return (ret);
-} // Java_com_example_dmocl_kmeans_kmeans_1c
+} // kmeans_tilecent
 
 
 
 /*!
  \brief kmeans cluster search on the GPU
  \details
- Performs a Kmeans cluster search on the GPU
+ Performs a Kmeans cluster search on the GPU. All commands are enqueued non-blocking with event
+ dependencies, the cycles alternate between two buffer sets. The overlap is small: the host
+ clears the new cluster centers while the kernel is running, and it does not wait for the
+ release (unmap) of the cluster assignment of a cycle. The upload of a cycle cannot overlap with
+ the readback of the previous one, the new cluster centers are computed from it.
  \param b (out) Array of cluster numbers
  \param data (in) Array of data points
  \param blen (in) number of data items in data
@@ -365,37 +864,61 @@ JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c
  \param commands (in) the OpenCL command queue
  \param program (in) the OpenCL program
  \param device (in) the OpenCL device
- \param kernel_testdistance (in) the OpenCL kernel
- \param data_g (in) OpenCL data buffer
- \param b_g (in) OpenCL cluster number buffer
- \param clucent_g (in) OpenCL cluster center buffer
- \returns 0 = no error, <0 = error number
+ \param kernel_testdistance (in) the OpenCL kernel (testdistance or testdistance_tiled)
+ \param tilecent (in) 0 = kernel testdistance, >0 = kernel testdistance_tiled with this number of
+ cluster centers per tile (see kmeans_tilecent)
+ \param st (in) data items in device format (see oclstore.h)
+ \param b_g (in) two OpenCL cluster number buffers (see oclbuffer.h)
+ \param clucent_g (in) two OpenCL cluster center buffers (see oclbuffer.h)
+ \param seed (in) seed of the initial cluster centers, 0 = taken from the clock
+ \param init (in) initial cluster centers (see kmeans_start), NULL = selected with *seed*
+ \param centers (out) final cluster centers (cluno * features values), NULL = not needed
+ \param job (in+out) the job, tested once per cycle (NULL = never stops)
+ \param counters (in+out) counters of the iterations (see kmeans_tally), NULL = not needed; the
+ reassignments are counted on the host with a copy of the last cluster assignment
+ \returns 0 = no error, -30 = cancelled or deadline passed, <0 = error number
  \mt fully threadsafe
  */
 short kmeans_gpu(cl_ushort *b, const cl_float *data, const int blen, const float eps, const int cluno,
            const int features,
            cl_command_queue commands, cl_program program, cl_device_id device,
-           cl_kernel kernel_testdistance, cl_mem data_g, cl_mem b_g, cl_mem clucent_g) {
+           cl_kernel kernel_testdistance, const int tilecent, const struct oclstore* st,
+           struct oclbuf* b_g, struct oclbuf* clucent_g, const unsigned int seed,
+           const float* init, float* centers, struct jobctl* job,
+           struct agpudm_stats* counters) {
 
   short ret = 0;                                 // return value
 
                                         // copy values to OpenCL data types
   const cl_int features_g = features;               // copy features
-  const size_t global_size = blen;                  // copy data array length
+  const cl_int blen_g = blen;                       // copy data array length
   const cl_int cluno_g = cluno;                     // copy cluster count
 
                                                     // set the kernal arguments
-  cl_int err = clSetKernelArg(kernel_testdistance, 0, sizeof(cl_mem), &data_g);
-  err |= clSetKernelArg(kernel_testdistance, 1, sizeof(cl_mem), &b_g);
-  err |= clSetKernelArg(kernel_testdistance, 2, sizeof(cl_mem), &clucent_g);
+  cl_int err = clSetKernelArg(kernel_testdistance, 0, sizeof(cl_mem), &st->data_g.mem);
+  err |= clSetKernelArg(kernel_testdistance, 1, sizeof(cl_mem), &b_g[0].mem);
+  err |= clSetKernelArg(kernel_testdistance, 2, sizeof(cl_mem), &clucent_g[0].mem);
   err |= clSetKernelArg(kernel_testdistance, 3, sizeof(cl_int), &features_g);
   err |= clSetKernelArg(kernel_testdistance, 4, sizeof(cl_int), &cluno_g);
+  err |= clSetKernelArg(kernel_testdistance, 5, sizeof(cl_int), &blen_g);
+  err |= clSetKernelArg(kernel_testdistance, 6, sizeof(cl_mem), &st->qparam_g);
+
+  if (tilecent > 0) {                        // tiled kernel?
+
+    const cl_int tilecent_g = tilecent;      // local memory for one tile
+    err |= clSetKernelArg(kernel_testdistance, 7, sizeof(cl_float) * tilecent * features, NULL);
+    err |= clSetKernelArg(kernel_testdistance, 8, sizeof(cl_int), &tilecent_g);
+  }
 
   if (err != CL_SUCCESS) {                   // error?
     return (-4);
   }
 
-  srand((unsigned int) time(NULL));             // initialize random generator
+  struct ocltune_cfg tcfg;               // get (or tune) local and global work size
+  ocltune_get(commands, device, kernel_testdistance,
+              (tilecent > 0) ? "testdistance_tiled" : "testdistance", blen, &tcfg);
+
+  const size_t global_size = ocltune_global(&tcfg, blen);   // padded data array length
 
                                     // allocate memory for the cluster centers
   cl_float *clucent = (cl_float *) malloc(sizeof(cl_float) * features * cluno);
@@ -410,44 +933,106 @@ short kmeans_gpu(cl_ushort *b, const cl_float *data, const int blen, const float
                                      // allocate buffer for the cluster member cound
       int *clusize = malloc(sizeof(int) * cluno);
 
-      if (clusize != NULL) {                          // malloc error?
+                                     // last cluster assignment (counters only)
+      cl_ushort *prev = (counters != NULL) ? (cl_ushort *) malloc(sizeof(cl_ushort) * blen) : NULL;
 
-                                      // iterate over cluster centers
-        for (int i1 = 0; i1 < cluno; i1++) {
-
-                                    // get random initial cluster center point
-          int cluxi = rand_lim(blen - 1);
+      if ((clusize != NULL) && ((counters == NULL) || (prev != NULL))) {   // malloc error?
 
-                                    // copy new random cluster center point
-          for (int i2 = 0; i2 < features; i2++) {
-            clucent[features * i1 + i2] = data[cluxi * features + i2];
-          }
-        }
+                               // random data items (or warm start) as initial cluster centers
+        kmeans_start(clucent, init, data, blen, cluno, features, seed);
 
 
         int weiter = 0;                    // loop abort condition
         int cycles = 0;                   // counts the cycles
 
+                           // events per buffer set: upload, kernel and release of the
+                           // cluster assignment
+        cl_event upev[2] = { NULL, NULL };
+        cl_event kev[2] = { NULL, NULL };
+        cl_event unev[2] = { NULL, NULL };
+
         while (weiter >= 0) {           // loop as long as cluster center displacement is
                                        // sufficiently large or maximum cycle count has not been reached
 
-                                        // copy data to GPU
-          err = clEnqueueWriteBuffer(commands, clucent_g, CL_TRUE, 0,
-                                     sizeof(cl_float) * features * cluno, clucent, 0, NULL, NULL);
+          const long long tr = trace_begin();    // span of the cycle
+
+                                  // cancelled or deadline passed?
+          if (jobctl_check(job) != JOBCTL_RUNNING) {
+            ret = -30;
+            break;
+          }
+
+          const int cur = cycles & 1;     // buffer set used in this cycle
+
+                        // copy cluster centers to GPU (the kernel two cycles ago must be done)
+          cl_float *clum = (cl_float *) oclbuf_enqueue_map(commands, &clucent_g[cur],
+                                                           CL_MAP_WRITE_INVALIDATE_REGION, CL_TRUE,
+                                                           (kev[cur] != NULL) ? 1 : 0, &kev[cur],
+                                                           NULL, &err);
+
+          if (clum == NULL) {                 // success?
+            ret = -6;
+            break;
+          }
+
+          memcpy(clum, clucent, sizeof(cl_float) * features * cluno);
+
+          oclbuf_release_event(&kev[cur]);            // events of the old cycle are not needed any more
+          oclbuf_release_event(&upev[cur]);
+
+                                  // non blocking upload, the kernel waits for it
+          err = oclbuf_enqueue_unmap(commands, &clucent_g[cur], 0, NULL, &upev[cur]);
 
           if (err != CL_SUCCESS) {            // success?
             ret = -6;
             break;
           }
+
+                                  // select buffer set
+          err = clSetKernelArg(kernel_testdistance, 1, sizeof(cl_mem), &b_g[cur].mem);
+          err |= clSetKernelArg(kernel_testdistance, 2, sizeof(cl_mem), &clucent_g[cur].mem);
+
+          if (err != CL_SUCCESS) {            // success?
+            ret = -4;
+            break;
+          }
+
+          cl_event kwait[2];              // kernel waits for the upload and for the release
+          cl_uint nkwait = 0;             // of the cluster assignment two cycles ago
+
+          kwait[nkwait++] = upev[cur];
+
+          if (unev[cur] != NULL) {
+            kwait[nkwait++] = unev[cur];
+          }
                                            // enqueue kernel
-          err = clEnqueueNDRangeKernel(commands, kernel_testdistance, 1, NULL, &global_size, NULL,
-                                       0, NULL, NULL);
+          const long long tq = trace_begin();
+          err = clEnqueueNDRangeKernel(commands, kernel_testdistance, 1, NULL, &global_size,
+                                       ocltune_local(&tcfg), nkwait, kwait, &kev[cur]);
+          trace_end(TRACE_OPENCL, "clEnqueueNDRangeKernel", tq, (long long) global_size);
 
           if (err != CL_SUCCESS) {           // success?
             ret = -7;
             break;
           }
 
+          oclbuf_release_event(&unev[cur]);
+
+          cl_event rdev = NULL;          // signals that the cluster assignment is available
+
+                              // enqueue access to the new cluster assignment
+          cl_ushort *bm = (cl_ushort *) oclbuf_enqueue_map(commands, &b_g[cur], CL_MAP_READ,
+                                                           CL_FALSE, 1, &kev[cur], &rdev, &err);
+
+                                     // error?
+          if (bm == NULL) {
+            oclbuf_release_event(&rdev);
+            ret = -8;
+            break;
+          }
+
+          clFlush(commands);             // start device, host work overlaps from here
+
                               // initialize array with new cluster centers
           for (int i1 = 0; i1 < cluno; i1++) {
 
@@ -458,15 +1043,13 @@ short kmeans_gpu(cl_ushort *b, const cl_float *data, const int blen, const float
             clusize[i1] = 0;
           }
 
-                        // wait until GPU has finished calculations
-          clFinish(commands);
-
-                             // read new cluster assignment
-          err = clEnqueueReadBuffer(commands, b_g, CL_TRUE, 0, sizeof(cl_ushort) * blen, b, 0, NULL,
-                                    NULL);
+          const long long tw = trace_begin();
+          err = clWaitForEvents(1, &rdev);      // wait until GPU has finished
+          trace_end(TRACE_OPENCL, "clWaitForEvents", tw, cycles);
+          oclbuf_release_event(&rdev);
 
-                                     // error?
-          if (err != CL_SUCCESS) {
+          if (err != CL_SUCCESS) {       // error? -> release the mapped cluster assignment
+            oclbuf_enqueue_unmap(commands, &b_g[cur], 0, NULL, NULL);
             ret = -8;
             break;
           }
@@ -474,15 +1057,17 @@ short kmeans_gpu(cl_ushort *b, const cl_float *data, const int blen, const float
                                  // calculate new midpoints (cluster centers)
           for (int i1 = 0; i1 < blen; i1++) {
             for (int i2 = 0; i2 < features; i2++) {
-              newclucent[b[i1] * features + i2] += data[i1 * features + i2];
+              newclucent[bm[i1] * features + i2] += data[i1 * features + i2];
             }
-            clusize[b[i1]]++;           // count cluster members
+            clusize[bm[i1]]++;           // count cluster members
           }
 
                              // divide by number of cluster members
           for (int i1 = 0; i1 < cluno; i1++) {
             for (int i2 = 0; i2 < features; i2++) {
-              newclucent[i1 * features + i2] /= (cl_float) clusize[i1];
+              newclucent[i1 * features + i2] = (clusize[i1] > 0) ?
+                newclucent[i1 * features + i2] / (cl_float) clusize[i1] :
+                clucent[i1 * features + i2];          // empty cluster keeps its center
             }
           }
 
@@ -501,22 +1086,64 @@ short kmeans_gpu(cl_ushort *b, const cl_float *data, const int blen, const float
             newdist += sqrt(newdist2);
           }
 
+          int moved = 0;                // data items that changed their cluster
+
+          if (prev != NULL) {
+            for (int i1 = 0; i1 < blen; i1++) {
+              moved += (bm[i1] != prev[i1]) ? 1 : 0;
+            }
+
+            memcpy(prev, bm, sizeof(cl_ushort) * blen);
+          }
+
+          kmeans_tally(counters, cycles, newdist, moved, clusize, blen, cluno);
+
                            // check loop conditions
           if ((newdist <= eps) || (cycles>MAXCYCLES)) {
             weiter = -1;
+
+            if (bm != b) {             // other memory -> copy final cluster assignment
+              memcpy(b, bm, sizeof(cl_ushort) * blen);
+            }
+          }
+
+                       // release cluster assignment, the next cycle does not wait for it
+          err = oclbuf_enqueue_unmap(commands, &b_g[cur], 0, NULL, &unev[cur]);
+
+          if (err != CL_SUCCESS) {       // error?
+            ret = -9;
+            break;
           }
 
                           // copy new cluster centers
           memcpy(clucent, newclucent, sizeof(cl_float) * features * cluno);
 
+          trace_end(TRACE_ALGO, "kmeans cycle", tr, cycles);
+
           cycles++;                    // count cycles
         }
 
-        free(clusize);                   // clean
+        const long long tf = trace_begin();
+        clFinish(commands);              // wait for outstanding commands
+        trace_end(TRACE_OPENCL, "clFinish", tf, cycles);
+
+        for (int i1 = 0; i1 < 2; i1++) {    // release events
+          oclbuf_release_event(&upev[i1]);
+          oclbuf_release_event(&kev[i1]);
+          oclbuf_release_event(&unev[i1]);
+        }
+
+        if ((ret == 0) && (centers != NULL)) {   // final cluster centers requested?
+          memcpy(centers, clucent, sizeof(cl_float) * features * cluno);
+        }
+
       } else {
         ret = -3;
       }
 
+      free(prev);                        // clean
+      free(clusize);
+
       free(newclucent);
     } else {
       ret = -2;
@@ -533,364 +1160,735 @@ short kmeans_gpu(cl_ushort *b, const cl_float *data, const int blen, const float
 
 
 
-// see header file
-JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1gpu
-  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
-   jlongArray e) {
+/*!
+ \brief The GPU of a mini-batch k-means search
+ */
+struct kmeans_mbgpu {
 
+  cl_command_queue commands;          //!< the OpenCL command queue
+  cl_kernel kernel;                   //!< testdistance or testdistance_tiled (arguments set)
+  struct ocltune_cfg tcfg;            //!< launch configuration of the kernel
+  struct oclbuf *data_g;              //!< data items of a pass (float, pass length)
+  struct oclbuf *b_g;                 //!< cluster numbers of a pass
+  struct oclbuf *clucent_g;           //!< cluster centers
+  int cluno;                          //!< number of clusters
+  int features;                       //!< number of features per data item
 
-  struct timespec start2, finish2;     // for calculation of exclusive runtime
+};  // struct kmeans_mbgpu
 
-  short ret = 0;                          // return value
 
-                  // check architecture
-  if ((sizeof(jshort) == sizeof(cl_ushort)) && (sizeof(jfloat) == sizeof(cl_float))) {
 
-                    // get data array and data item length
-    jsize datalen = (*env)->GetArrayLength(env, rf);
-    jsize blen = (*env)->GetArrayLength(env, b);
+/*!
+ \brief Assigns data items to their closest cluster center on the GPU
+ \details
+ Uploads the data items and the cluster centers, runs the kernel testdistance on them and reads
+ the cluster numbers back (see kmeans_assignfn). Every step waits for the device.
+ \param arg (in+out) the GPU (struct kmeans_mbgpu)
+ \param items (in) the data items
+ \param count (in) number of data items (at most the size of the buffers)
+ \param b (out) cluster numbers of the data items
+ \param clucent (in) the cluster centers
+ \returns 0 = no error, -4 = kernel argument, -6 = upload, -7 = kernel, -8 = download failed
+ \mt not threadsafe (per GPU)
+ */
+short kmeans_assign_gpu(void *arg, const float *items, int count, unsigned short *b,
+                        float *clucent) {
 
-    if (features * blen == datalen) {             // must match
+  struct kmeans_mbgpu *g = (struct kmeans_mbgpu *) arg;   // access the GPU
 
-                            // copy data items
-      jfloat* condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+  cl_int err = CL_SUCCESS;
 
-      if (condata != NULL) {             // error?
+                                  // upload the data items
+  cl_float *dm = (cl_float *) oclbuf_map(g->commands, g->data_g, CL_MAP_WRITE_INVALIDATE_REGION,
+                                         &err);
 
-                         // allocate array for cluster assignment
-        cl_ushort *conb = (cl_ushort *) malloc(sizeof(cl_ushort) * blen);
+  if (dm == NULL) {
+    return (-6);
+  }
 
-        if (conb != NULL) {              // malloc error
+  memcpy(dm, items, sizeof(cl_float) * g->features * count);
 
-          cl_uint numplatf;                 // holds platform number
+  if (oclbuf_unmap(g->commands, g->data_g) != CL_SUCCESS) {
+    return (-6);
+  }
+                                  // upload the cluster centers
+  cl_float *clum = (cl_float *) oclbuf_map(g->commands, g->clucent_g,
+                                           CL_MAP_WRITE_INVALIDATE_REGION, &err);
 
-                                            // get number of platforms
-          cl_int err = clGetPlatformIDs(0, NULL, &numplatf);
+  if (clum == NULL) {
+    return (-6);
+  }
 
-          if (err == CL_SUCCESS) {             // error?
+  memcpy(clum, clucent, sizeof(cl_float) * g->features * g->cluno);
 
-            if (numplatf >= 1) {           // there mus be at least one
+  if (oclbuf_unmap(g->commands, g->clucent_g) != CL_SUCCESS) {
+    return (-6);
+  }
 
-                                             // yes -> select first
-              cl_platform_id platf;          // platform data
+  const cl_int count_g = count;         // work-items beyond are padding
 
-                                           // get all platforms
-              err = clGetPlatformIDs(1, &platf, NULL);
+  if (clSetKernelArg(g->kernel, 5, sizeof(cl_int), &count_g) != CL_SUCCESS) {
+    return (-4);
+  }
 
-              if (err == CL_SUCCESS) {      // error?
+  const size_t global_size = ocltune_global(&g->tcfg, count);
+  cl_event kev = NULL;
 
-                cl_uint numdevices;           // device info
+  const long long tq = trace_begin();
+  err = clEnqueueNDRangeKernel(g->commands, g->kernel, 1, NULL, &global_size,
+                               ocltune_local(&g->tcfg), 0, NULL, &kev);
+  trace_end(TRACE_OPENCL, "clEnqueueNDRangeKernel", tq, (long long) global_size);
 
-                                      // get number of devices
-                err = clGetDeviceIDs(platf, CL_DEVICE_TYPE_ALL, 0, NULL, &numdevices);
+  if (err == CL_SUCCESS) {
+    const long long tw = trace_begin();
+    err = clWaitForEvents(1, &kev);      // wait until GPU has finished
+    trace_end(TRACE_OPENCL, "clWaitForEvents", tw, count);
+  }
 
-                if (err == CL_SUCCESS) {       // error?
+  oclbuf_release_event(&kev);
 
-                  if (numdevices >= 1) {       // there must be at least one device
+  if (err != CL_SUCCESS) {
+    return (-7);
+  }
+                                  // download the cluster numbers
+  cl_ushort *bm = (cl_ushort *) oclbuf_map(g->commands, g->b_g, CL_MAP_READ, &err);
 
-                    cl_device_id dev;           // get device info
+  if (bm == NULL) {
+    return (-8);
+  }
 
-                    err = clGetDeviceIDs(platf, CL_DEVICE_TYPE_ALL, 1, &dev, NULL);
+  memcpy(b, bm, sizeof(cl_ushort) * count);
 
-                    if (err == CL_SUCCESS) {       // error?
-                                                   // select first device
+  if (oclbuf_unmap(g->commands, g->b_g) != CL_SUCCESS) {
+    return (-8);
+  }
 
+  return (0);
 
-                      // create a context with the specified
-                      // platform and device
-                      cl_context context = clCreateContext(NULL, 1, &dev, NULL, NULL, &err);
+} // kmeans_assign_gpu
 
-                      if (context != NULL) {           // context error?
 
-                        cl_command_queue commands;        // compute command queue
 
-                                                        // Create a command queue
-                        commands = clCreateCommandQueue(context, dev, 0, &err);
+/*!
+ \brief Mini-batch k-means cluster search on the GPU
+ \details
+ Runs kmeans_minibatch with the kernel testdistance as assignment. The device buffers hold one
+ batch (float): the batches and the passes of the final assignment are uploaded one after the
+ other.
+ \param b (out) Array of cluster numbers
+ \param data (in) Array of data points
+ \param blen (in) number of data items in data
+ \param eps (in) maximum cluster center displacement of a batch
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param commands (in) the OpenCL command queue
+ \param device (in) the OpenCL device
+ \param kernel_testdistance (in) the OpenCL kernel (testdistance or testdistance_tiled)
+ \param tilecent (in) 0 = kernel testdistance, >0 = kernel testdistance_tiled with this number of
+ cluster centers per tile (see kmeans_tilecent)
+ \param st (in) buffer of the data items of a batch (OCLSTORE_FP32, see oclstore.h)
+ \param b_g (in) OpenCL cluster number buffer of a batch (see oclbuffer.h)
+ \param clucent_g (in) OpenCL cluster center buffer (see oclbuffer.h)
+ \param mb (in) parameters of the mini-batch search
+ \param seed (in) seed of the initial cluster centers and of the batches, 0 = taken from the clock
+ \param job (in+out) the job, tested once per batch (NULL = never stops)
+ \param counters (in+out) counters of the batches (see kmeans_minibatch), NULL = not needed
+ \returns 0 = no error, -30 = cancelled or deadline passed, <0 = error number
+ \mt fully threadsafe
+ */
+short kmeans_gpu_minibatch(cl_ushort *b, const cl_float *data, const int blen, const float eps,
+                           const int cluno, const int features, cl_command_queue commands,
+                           cl_device_id device, cl_kernel kernel_testdistance,
+                           const int tilecent, struct oclstore *st, struct oclbuf *b_g,
+                           struct oclbuf *clucent_g, const struct agpudm_minibatch_params *mb,
+                           const unsigned int seed, struct jobctl *job,
+                           struct agpudm_stats *counters) {
 
-                        if (commands != NULL) {             // error?
+  short ret = 0;                                 // return value
 
-                                                      // create program
-                          cl_program program = clCreateProgramWithSource(context, 1, &clsource,
-                                                                         NULL, &err);
+  const int batch = kmeans_mbsize(mb, blen);     // size of the buffers
 
-                          if (program != NULL) {             // error?
+                                        // copy values to OpenCL data types
+  const cl_int features_g = features;
+  const cl_int blen_g = batch;
+  const cl_int cluno_g = cluno;
+
+                                        // set the kernel arguments
+  cl_int err = clSetKernelArg(kernel_testdistance, 0, sizeof(cl_mem), &st->data_g.mem);
+  err |= clSetKernelArg(kernel_testdistance, 1, sizeof(cl_mem), &b_g->mem);
+  err |= clSetKernelArg(kernel_testdistance, 2, sizeof(cl_mem), &clucent_g->mem);
+  err |= clSetKernelArg(kernel_testdistance, 3, sizeof(cl_int), &features_g);
+  err |= clSetKernelArg(kernel_testdistance, 4, sizeof(cl_int), &cluno_g);
+  err |= clSetKernelArg(kernel_testdistance, 5, sizeof(cl_int), &blen_g);
+  err |= clSetKernelArg(kernel_testdistance, 6, sizeof(cl_mem), &st->qparam_g);
 
-                                                       // build program
-                            err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+  if (tilecent > 0) {                        // tiled kernel?
 
-                            if (err == CL_SUCCESS) {             // error?
+    const cl_int tilecent_g = tilecent;      // local memory for one tile
+    err |= clSetKernelArg(kernel_testdistance, 7, sizeof(cl_float) * tilecent * features, NULL);
+    err |= clSetKernelArg(kernel_testdistance, 8, sizeof(cl_int), &tilecent_g);
+  }
 
-                              cl_kernel kernel_testdistance;    // holds kernel
+  if (err != CL_SUCCESS) {                   // error?
+    return (-4);
+  }
 
-                                                       // extract kernel
-                              kernel_testdistance = clCreateKernel(program, "testdistance", &err);
+  struct kmeans_mbgpu g;                     // the GPU
 
-                              if (err == CL_SUCCESS) {           // error?
+  g.commands = commands;
+  g.kernel = kernel_testdistance;
+  g.data_g = &st->data_g;
+  g.b_g = b_g;
+  g.clucent_g = clucent_g;
+  g.cluno = cluno;
+  g.features = features;
 
+                                        // get (or tune) local and global work size
+  ocltune_get(commands, device, kernel_testdistance,
+              (tilecent > 0) ? "testdistance_tiled" : "testdistance", batch, &g.tcfg);
 
-                                                       // create first buffer
-                                cl_mem data_g = clCreateBuffer(context,
-                                                               CL_MEM_READ_ONLY |
-                                                               CL_MEM_USE_HOST_PTR,
-                                                               sizeof(cl_float) * datalen, condata,
-                                                               &err);
+                                    // allocate memory for the cluster centers
+  cl_float *clucent = (cl_float *) malloc(sizeof(cl_float) * features * cluno);
 
-                                if (data_g != NULL) {              // error?
+  if (clucent != NULL) {                     // malloc error?
 
-                                                          // create second buffer
-                                  cl_mem b_g = clCreateBuffer(context,
-                                                              CL_MEM_READ_WRITE |
-                                                              CL_MEM_USE_HOST_PTR,
-                                                              sizeof(cl_ushort) * blen, conb, &err);
+    ret = kmeans_minibatch(b, data, blen, eps, cluno, features, clucent, mb, batch, seed,
+                           &kmeans_assign_gpu, &g, job, counters);
 
-                                  if (b_g != NULL) {             // error?
+    free(clucent);
+  } else {
+    ret = -1;
+  }
 
-                                                             // create third buffer
-                                    cl_mem clucent_g = clCreateBuffer(context,
-                                                                      CL_MEM_READ_ONLY,
-                                                                      sizeof(cl_float) * features *
-                                                                      cluno, NULL, &err);
+  return (ret);
 
-                                    if (clucent_g != NULL) {   // error
+} // kmeans_gpu_minibatch
 
-#ifdef GPUTIMING
-                                             // measure start time
-                                      clock_gettime(CLOCK_REALTIME, &start2);
-#endif
 
-                                                   // perform kmeans on the GPU
-                                      ret = kmeans_gpu(conb, (cl_float*) condata, blen, eps, cluno, features,
-                                                       commands, program, dev, kernel_testdistance,
-                                                       data_g, b_g, clucent_g);
 
+/*!
+ \brief Kmeans cluster search on the first OpenCL device
+ \details
+ Selects the first device of the first platform, builds the program for the storage format,
+ creates the buffers and performs the search with kmeans_gpu (or kmeans_gpu_minibatch). Used by
+ the JNI methods and by the job scheduler (see jobsched.h).
+ \param b (out) Array of cluster numbers (blen values)
+ \param data (in) Array of data points
+ \param blen (in) number of data items in data
+ \param eps (in) maximum cluster center displacement
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param storage (in) storage of the data items on the device (OCLSTORE_FP32, _FP16 or _INT8)
+ \param inplace (in) 1 = the device works directly on *data* and *b* (CL_MEM_USE_HOST_PTR, also on
+ unified memory), 0 = the driver allocates the buffers on unified memory
+ \param seed (in) seed of the initial cluster centers, 0 = taken from the clock
+ \param mb (in) parameters of a mini-batch search, NULL = Lloyd iterations; the buffers then hold
+ one batch in single precision (*storage* and *inplace* do not apply)
+ \param init (in) initial cluster centers of the Lloyd iterations, NULL = selected with *seed*
+ \param centers (out) final cluster centers of the Lloyd iterations, NULL = not needed
+ \param job (in+out) the job
+ \param counters (in+out) counters of the iterations, NULL = not needed
+ \param elapsed (out) exclusive runtime in ns (only with GPUTIMING, NULL = not needed)
+ \returns 0 = no error, -30 = cancelled or deadline passed, -7 .. -20 = OpenCL error while
+ setting up the device, -21 = malloc error, other negative values = error of kmeans_gpu
+ \mt fully threadsafe
+ */
+short kmeans_run_gpu(cl_ushort *b, const cl_float *data, const int blen, const float eps,
+                     const int cluno, const int features, const int storage, const int inplace,
+                     const unsigned int seed, const struct agpudm_minibatch_params *mb,
+                     const float *init, float *centers, struct jobctl *job,
+                     struct agpudm_stats *counters, long long *elapsed) {
 
-                                               // store results
-                                      (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort*) conb);
+  struct timespec start2 = {0, 0}, finish2 = {0, 0};   // for calculation of exclusive runtime
 
-#ifdef GPUTIMING
-                                                    // measure time
-                                      clock_gettime(CLOCK_REALTIME, &finish2);
-#endif
+  short ret = 0;                          // return value
+
+                                    // data items of the buffers (mini-batch: one batch)
+  const int len = (mb != NULL) ? kmeans_mbsize(mb, blen) : blen;
 
-                                                     // release data and clean up
-                                      clReleaseMemObject(clucent_g);
+                                    // host memory of the batches (mini-batch only)
+  cl_float *batch = (mb != NULL) ? (cl_float *) malloc(sizeof(cl_float) * features * len) : NULL;
 
-                                    } else {
+  if ((mb != NULL) && (batch == NULL)) {   // malloc error?
+    return (-21);
+  }
 
-                                      ret = -20;
-                                    }
+  cl_uint numplatf;                 // holds platform number
 
+                                    // get number of platforms
+  cl_int err = clGetPlatformIDs(0, NULL, &numplatf);
 
-                                    clReleaseMemObject(b_g);
+  if (err == CL_SUCCESS) {             // error?
 
-                                  } else {
+    if (numplatf >= 1) {           // there mus be at least one
 
-                                    ret = -19;
-                                  }
+                                     // yes -> select first
+      cl_platform_id platf;          // platform data
 
+                                   // get all platforms
+      err = clGetPlatformIDs(1, &platf, NULL);
 
-                                  clReleaseMemObject(data_g);
+      if (err == CL_SUCCESS) {      // error?
 
-                                } else {
+        cl_uint numdevices;           // device info
 
-                                  ret = -18;
-                                }
+                              // get number of devices
+        err = clGetDeviceIDs(platf, CL_DEVICE_TYPE_ALL, 0, NULL, &numdevices);
 
-                                clReleaseKernel(kernel_testdistance);
+        if (err == CL_SUCCESS) {       // error?
 
-                              } else {
+          if (numdevices >= 1) {       // there must be at least one device
+
+            cl_device_id dev;           // get device info
+
+            err = clGetDeviceIDs(platf, CL_DEVICE_TYPE_ALL, 1, &dev, NULL);
+
+            if (err == CL_SUCCESS) {       // error?
+                                           // select first device
+
+
+              // create a context with the specified
+              // platform and device
+              const long long tc = trace_begin();
+              cl_context context = clCreateContext(NULL, 1, &dev, NULL, NULL, &err);
+
+              if (context != NULL) {           // context error?
+
+                cl_command_queue commands;        // compute command queue
+
+                                // Create a (if possible out-of-order) command queue
+                commands = oclbuf_create_queue(context, dev, &err);
+                trace_end(TRACE_SETUP, "clCreateContext", tc, 0);
+
+                if (commands != NULL) {             // error?
+
+                                              // create program
+                  cl_program program = clCreateProgramWithSource(context, 1, &kmeans_clsource,
+                                                                 NULL, &err);
+
+                  if (program != NULL) {             // error?
+
+                    struct oclstore st;         // data items in device format
+
+                               // convert data items (once, before the upload)
+                    err = oclstore_convert(&st, (mb != NULL) ? batch : data, len, features,
+                                           (mb != NULL) ? OCLSTORE_FP32 : storage);
+
+                    if (err == CL_SUCCESS) {
+                                         // build program for the storage format
+                      const long long tb = trace_begin();
+                      err = clBuildProgram(program, 0, NULL, oclstore_options(&st), NULL,
+                                           NULL);
+                      trace_end(TRACE_SETUP, "clBuildProgram", tb, 0);
+                    }
+
+                    if (err == CL_SUCCESS) {             // error?
+
+                      cl_kernel kernel_testdistance = NULL;    // holds kernel
+
+                           // cluster centers too large for constant memory?
+                      int tilecent = kmeans_tilecent(dev, cluno, features);
 
-                                ret = -16;
+                      if (tilecent >= 0) {
+
+                                               // extract kernel
+                        kernel_testdistance = clCreateKernel(program,
+                                                             (tilecent > 0) ?
+                                                             "testdistance_tiled" :
+                                                             "testdistance", &err);
+                      } else {
+                        err = CL_OUT_OF_RESOURCES;
+                      }
+
+                      if (err == CL_SUCCESS) {           // error?
+
+
+                                      // zero copy buffers on unified memory?
+                        int bufmode = oclbuf_strategy(dev);
+
+                                      // caller's arrays back the buffers?
+                        int hostmode = ((inplace == 1) && (mb == NULL)) ?
+                                       (bufmode | OCLBUF_INPLACE) : bufmode;
+
+                        struct oclbuf b_g[2], clucent_g[2];  // buffers (two sets)
+
+                                         // create first buffer (data items)
+                        err = oclstore_create(&st, context, hostmode, 0);
+
+                        if (err == CL_SUCCESS) {              // error?
+
+                                          // create second buffer (two sets)
+                          err = oclbuf_create(&b_g[0], context, CL_MEM_READ_WRITE,
+                                              sizeof(cl_ushort) * len,
+                                              ((hostmode == OCLBUF_MAP) || (mb != NULL)) ?
+                                              NULL : b, hostmode);
+
+                          if (err == CL_SUCCESS) {
+                            err = oclbuf_create(&b_g[1], context, CL_MEM_READ_WRITE,
+                                                sizeof(cl_ushort) * len, NULL, bufmode);
+
+                            if (err != CL_SUCCESS) {
+                              oclbuf_release(&b_g[0]);
+                            }
+                          }
+
+                          if (err == CL_SUCCESS) {             // error?
+
+                                           // create third buffer (two sets)
+                            err = oclbuf_create(&clucent_g[0], context, CL_MEM_READ_ONLY,
+                                                sizeof(cl_float) * features * cluno,
+                                                NULL, bufmode);
+
+                            if (err == CL_SUCCESS) {
+                              err = oclbuf_create(&clucent_g[1], context,
+                                                  CL_MEM_READ_ONLY,
+                                                  sizeof(cl_float) * features * cluno,
+                                                  NULL, bufmode);
+
+                              if (err != CL_SUCCESS) {
+                                oclbuf_release(&clucent_g[0]);
                               }
+                            }
 
-                            } else {
+                            if (err == CL_SUCCESS) {   // error
+
+#ifdef GPUTIMING
+                                     // measure start time
+                              clock_gettime(CLOCK_REALTIME, &start2);
+#endif
+
+                                           // perform kmeans on the GPU
+                              if (mb != NULL) {
+                                ret = kmeans_gpu_minibatch(b, data, blen, eps, cluno,
+                                                           features, commands, dev,
+                                                           kernel_testdistance, tilecent,
+                                                           &st, &b_g[0], &clucent_g[0], mb,
+                                                           seed, job, counters);
+                              } else {
+                                ret = kmeans_gpu(b, data, blen, eps, cluno, features,
+                                                 commands, program, dev,
+                                                 kernel_testdistance, tilecent, &st, b_g,
+                                                 clucent_g, seed, init, centers, job,
+                                                 counters);
+                              }
+
+#ifdef GPUTIMING
+                                            // measure time
+                              clock_gettime(CLOCK_REALTIME, &finish2);
+#endif
 
+                                             // release data and clean up
+                              oclbuf_release(&clucent_g[1]);
+                              oclbuf_release(&clucent_g[0]);
 
-                              ret = -16;
+                            } else {
 
+                              ret = -20;
                             }
 
-                            clReleaseProgram(program);
 
-                          } else {
+                            oclbuf_release(&b_g[1]);
+                            oclbuf_release(&b_g[0]);
 
-                            ret = -15;
+                          } else {
 
+                            ret = -19;
                           }
 
-                          clReleaseCommandQueue(commands);
+
+                          oclstore_release(&st);
 
                         } else {
 
-                          ret = -15;
+                          ret = -18;
                         }
 
-                        clReleaseContext(context);
+                        clReleaseKernel(kernel_testdistance);
 
                       } else {
-                        ret = -14;
+
+                        ret = -16;
                       }
+
                     } else {
-                      ret = -11;
+
+
+                      ret = -16;
+
                     }
+
+                    oclstore_free(&st);            // release converted data items
+
+                    clReleaseProgram(program);
+
                   } else {
-                    ret = -12;
+
+                    ret = -15;
+
                   }
+
+                  clReleaseCommandQueue(commands);
+
                 } else {
-                  ret = -10;
+
+                  ret = -15;
                 }
+
+                clReleaseContext(context);
+
               } else {
-                ret = -9;
+                ret = -14;
               }
             } else {
-              ret = -8;
+              ret = -11;
             }
           } else {
-            ret = -7;
+            ret = -12;
           }
-
-          free(conb);
-
         } else {
-          ret = -6;
+          ret = -10;
         }
-
-        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
-
       } else {
-        ret = -5;
+        ret = -9;
       }
     } else {
-      ret = -4;
+      ret = -8;
     }
   } else {
-    ret = -3;
+    ret = -7;
   }
 
+  free(batch);                      // host memory of the batches
+
 #ifdef GPUTIMING
                        // caluclate time elapsed
-  long long int elapsed2 = ((long long int) (finish2.tv_sec - start2.tv_sec)) * 1000000000L;
-  elapsed2 += (finish2.tv_nsec - start2.tv_nsec);
-
-                           // store as first (and unique) array element
-                           // array has to be pinned
-  jlong *edata = (*env)->GetLongArrayElements(env, e, NULL);
-  edata[0] = elapsed2;
-  (*env)->ReleaseLongArrayElements(env, e, edata, 0);    // "unpin"
+  if (elapsed != NULL) {
+    *elapsed = ((long long) (finish2.tv_sec - start2.tv_sec)) * 1000000000LL +
+               (finish2.tv_nsec - start2.tv_nsec);
+  }
 #endif
 
   return (ret);
 
-} // Java_com_example_dmocl_kmeans_kmeans_1c_1gpu
+} // kmeans_run_gpu
 
 
 
 /*!
- \brief Parameters for the kmeans thread
+ \brief Reassignment counter of a participant
  \details
-This struct holds the parameters for each kmeans thread. (in) means parameters that are NOT changed
-by the thread but may be changed by the method that submits the job. (const) means that the value is
-never changed after setup. (out) attributes are changed by the thread. 
+ Padded to a cache line, the participants add their results without sharing a line.
+ */
+struct kmeans_count {
+
+  int n;                           //!< data items that changed their cluster
+
+} __attribute__((aligned(THREADPOOL_CACHELINE)));   // kmeans_count
+
+
+
+/*!
+ \brief Parameters for the kmeans tasks
+ \details
+This struct holds the parameters that are shared by all kmeans tasks of a job. (in) means parameters
+that are NOT changed by the tasks but may be changed by the method that submits the job. (const)
+means that the value is never changed after setup. (out) attributes are changed by the tasks.
 The submitting method must not write access any (in) or (out) field while the calculations are running.
 The submitting method may read access all (in) while the calculations are running.
  */
 struct kmeans_pt {
 
-  unsigned short int status;          //!< (const) status (needed only for setup and destruction)
-  int num;                            //!< (const) number of thread      
   unsigned short *b;                  //!< (out) number of closest cluster center
-  float *data;                        //!< (const) input data
+  const float *data;                  //!< (const) input data
   volatile float *clucent;            //!< (in) cluster centers
-  int blen;                           //!< (const) number of data items 
-  int cluno;                          //!< (const) number of clusters  
+  int blen;                           //!< (const) number of data items
+  int cluno;                          //!< (const) number of clusters
   int features;                       //!< (const) number of features per data item
-  int start;                          //!< (const) first data item
-  int len;                            //!< (const) last data item
-  volatile unsigned char fertig;      //!< (in) 1=quit loop
-
-  pthread_t thread;                   //!< (const) reference to the thread
-  sem_t sem;                          //!< (const) semaphore used for start
-  sem_t semret;                       //!< (const) semaphore for notification that results are ready
+  struct jobctl *job;                 //!< (const) the job (tested every JOBCTL_STRIDE data items)
+  struct kmeans_count *moved;         //!< (out) reassigned data items (per participant)
 
 };  // struct kmeans_pt
 
 
 /*!
- \brief thread for calculating kmeans in parallel
+ \brief chunk of the kmeans search executed in parallel
  \details
- One or more threads perform a kmeans search in parallel. The thread calculates the distances
-to the cluster centers and saves the number of the cluster center with the smallest distance.
-Two semaphores are used. The first is acquired by this thread and released by the method that
-submits the calculations. The second semaphore is acquired by the method that submits the job
-and released by this thread 
+ The work-stealing scheduler executes the kmeans search in chunks on the workers of the thread
+pool. A chunk calculates the distances of its data items to the cluster centers and saves the
+number of the cluster center with the smallest distance. The rest of a chunk of a cancelled job is
+skipped.
  \param arg (in+out) A pointer to the struct with the parameters
- \returns NULL
+ \param part (in) number of the participant
+ \param start (in) first data item
+ \param len (in) number of data items
  */
-void* kmthread(void *arg) {
+void kmthread(void *arg, int part, int start, int len) {
 
   struct kmeans_pt *f = (struct kmeans_pt *) arg;   // access parameters
 
-  int weiter =  0;                                  // loop abort condition
-
-  while (weiter == 0) {                             // continue?
-
-    sem_wait(&f->sem);                               // wait on semaphore
+  int moved = 0;                                  // data items that changed their cluster
 
-    if (f->fertig == 0) {                            // exit loop?
+  for (int i1 = start; i1 < start + len; i1++) {    // iterate over lines assigned
 
-      for (int i1 = f->start; i1 < f->start + f->len; i1++) { // iterate over lines assigned
+                            // cancelled or deadline passed? (tested every JOBCTL_STRIDE items)
+    if ((((i1 - start) & (JOBCTL_STRIDE - 1)) == 0) && (jobctl_check(f->job) != JOBCTL_RUNNING)) {
+      break;
+    }
 
-        float noxi = INFINITY;                        // initial smallest distance
+    const unsigned short old = f->b[i1];          // cluster of the last cycle
+    float noxi = INFINITY;                        // initial smallest distance
 
-        for (short i2 = 0; i2 < f->cluno; i2++) {    // iterate over cluster centers
+    for (short i2 = 0; i2 < f->cluno; i2++) {    // iterate over cluster centers
 
-          float noxi2 = 0;                         // for distance
-   
-                     // iterate over features and calculate euclidean distance  
-          for (int i3 = 0; i3 < f->features; i3++) {
-            noxi2 += powf(f->clucent[i2 * f->features + i3] - f->data[i1 * f->features + i3], 2);
-          }
+      float noxi2 = 0;                         // for distance
 
-          if (noxi2 < noxi) {          // new distance smaller?
-            noxi = noxi2;            // yes save distance and cluster center number
-            f->b[i1] = i2;
-          }
-        }
+                 // iterate over features and calculate euclidean distance
+      for (int i3 = 0; i3 < f->features; i3++) {
+        noxi2 += powf(f->clucent[i2 * f->features + i3] - f->data[i1 * f->features + i3], 2);
       }
 
-      sem_post(&f->semret);                 // notify that results are ready
+      if (noxi2 < noxi) {          // new distance smaller?
+        noxi = noxi2;            // yes save distance and cluster center number
+        f->b[i1] = i2;
+      }
+    }
 
-    } else {
-      weiter = 1;                          // quit loop and thread
-    }    
+    moved += (f->b[i1] != old) ? 1 : 0;
   }
 
-  return (NULL);
+  f->moved[part].n += moved;                      // add result
 
 }  // kmthread
 
 
 
+/*!
+ \brief The CPU of a mini-batch k-means search
+ */
+struct kmeans_mbcpu {
+
+  struct kmeans_pt *kmparam;          //!< parameters of the chunks (moved: one per participant)
+  struct threadpool_sched *sched;     //!< the scheduler, NULL = calling thread only
+
+};  // struct kmeans_mbcpu
+
+
+
+/*!
+ \brief Assigns data items to their closest cluster center on the CPU
+ \details
+ Runs kmthread on the data items: on the workers of the thread pool or, without scheduler, in
+ the calling thread (see kmeans_assignfn). Chunks of a cancelled job are skipped, the caller
+ tests the job.
+ \param arg (in+out) the CPU (struct kmeans_mbcpu)
+ \param items (in) the data items
+ \param count (in) number of data items
+ \param b (out) cluster numbers of the data items
+ \param clucent (in) the cluster centers
+ \returns 0
+ \mt not threadsafe (per CPU)
+ */
+short kmeans_assign_cpu(void *arg, const float *items, int count, unsigned short *b,
+                        float *clucent) {
+
+  struct kmeans_mbcpu *c = (struct kmeans_mbcpu *) arg;   // access the CPU
+
+  c->kmparam->b = b;
+  c->kmparam->data = items;
+  c->kmparam->blen = count;
+  c->kmparam->clucent = clucent;
+
+  if (c->sched != NULL) {                         // on the workers
+    threadpool_sched_submit(c->sched, &kmthread, c->kmparam, count);
+    threadpool_sched_wait(c->sched);
+  } else {
+    kmthread(c->kmparam, 0, 0, count);
+  }
+
+  return (0);
+
+}  // kmeans_assign_cpu
+
+
+
+/*!
+ \brief Mini-batch k-means cluster search on the CPU (one thread)
+ \details
+ Runs kmeans_minibatch with kmthread in the calling thread as assignment.
+ \param b (out) Array of cluster numbers
+ \param data (in) Array of data points
+ \param blen (in) number of data items in data
+ \param eps (in) maximum cluster center displacement of a batch
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param mb (in) parameters of the mini-batch search
+ \param seed (in) seed of the initial cluster centers and of the batches, 0 = taken from the clock
+ \param job (in+out) the job
+ \param counters (in+out) counters of the batches (see kmeans_minibatch), NULL = not needed
+ \returns 0 = no error, -30 = cancelled or deadline passed, <0 = error number
+ \mt fully threadsafe
+ */
+short kmeans_single_minibatch(unsigned short *b, const float *data, const int blen,
+                              const float eps, const int cluno, const int features,
+                              const struct agpudm_minibatch_params *mb, const unsigned int seed,
+                              struct jobctl *job, struct agpudm_stats *counters) {
+
+  short ret = 0;                              // return value
+
+  struct kmeans_count moved;                  // reassignments (not used)
+  struct kmeans_pt kmparam;                   // parameters of kmthread
+  struct kmeans_mbcpu c = { &kmparam, NULL };
+
+  kmparam.cluno = cluno;
+  kmparam.features = features;
+  kmparam.job = job;
+  kmparam.moved = &moved;
+  moved.n = 0;
+
+                                 // allocate memory for the cluster centers
+  float *clucent = (float *) malloc(sizeof(float) * features * cluno);
+
+  if (clucent != NULL) {               // malloc error?
+
+    ret = kmeans_minibatch(b, data, blen, eps, cluno, features, clucent, mb, blen, seed,
+                           &kmeans_assign_cpu, &c, job, counters);
+
+    free(clucent);
+  } else {
+    ret = -1;
+  }
+
+  return (ret);
+
+}  // kmeans_single_minibatch
+
 
 
 /*!
  \brief Perform multithreaded Kmeans cluster search
  \details
-   Performs a multithreaded Kmeans cluster search on the CPU
+   Performs a multithreaded Kmeans cluster search on the CPU. The distance calculations are
+ distributed by the work-stealing scheduler among the workers of the thread pool.
  \param b (out) Array of cluster numbers
  \param data (in) Array of data points
  \param clucent (out) Array of cluster centers
  \param blen (in) number of data items in data
  \param cluno (in) number of clusters to search for
  \param features (in) number of features per data item
- \param cores (in) number of threads to be used (CPU can be oversubscribed)
- \param kmthreads (in) pointer to the threads (array must contain 'cores' elements)
+ \param kmparam (in) pointer to the parameters shared by the chunks
+ \param sched (in+out) the scheduler (one participant per core, CPU can be oversubscribed)
  \param eps (in) maximum cluster center displacement
- \returns 0=algorithm finished correctly, <0 error occurred
+ \param seed (in) seed of the initial cluster centers, 0 = taken from the clock
+ \param init (in) initial cluster centers (see kmeans_start), NULL = selected with *seed*
+ \param counters (in+out) counters of the iterations (see kmeans_tally), NULL = not needed
+ \returns 0=algorithm finished correctly, -30 = cancelled or deadline passed (the job is
+ kmparam->job), <0 error occurred
  */
 short kmeans_pthreads(unsigned short* b, const float* data, float* clucent,
                       const int blen, const int cluno, const int features,
-                      const int cores, struct kmeans_pt* kmthreads, const float eps) {
+                      struct kmeans_pt* kmparam, struct threadpool_sched* sched,
+                      const float eps, const unsigned int seed, const float* init,
+                      struct agpudm_stats* counters) {
 
   short ret = 0;                      // return value
 
@@ -904,29 +1902,24 @@ short kmeans_pthreads(unsigned short* b, const float* data, float* clucent,
 
     if (clusize != NULL) {            // malloc error?
 
-                             // iterate over cluster centers
-      for (int i1 = 0; i1 < cluno; i1++) {
-
-                             // create random number
-        int cluxi = rand_lim(blen - 1);
-
-                              // copy cluster center
-        for (int i2 = 0; i2 < features; i2++) {
-          clucent[features * i1 + i2] = data[cluxi * features + i2];
-        }
-      }
+                             // random data items as initial cluster centers
+      kmeans_start(clucent, init, data, blen, cluno, features, seed);
 
       int weiter = 0;              // loop break condition
       int cycles = 0;              // cycle counter
 
       while (weiter >= 0) {        // loop until cluster centers do not move any more
 
-                                  // iterate over cores
-        for (int i1 = 0; i1 < cores; i1++) {
-          sem_post(&kmthreads[i1].sem);    // wake up all threads
+        const long long tr = trace_begin();    // span of the cycle
+
+        for (int i1 = 0; i1 < sched->parts; i1++) {
+          kmparam->moved[i1].n = 0;             // reset counters
         }
 
-                          // while threads are calculating -> reset cluster centers
+                                  // start the distance calculations
+        threadpool_sched_submit(sched, &kmthread, kmparam, blen);
+
+                          // while workers are calculating -> reset cluster centers
         for (int i1 = 0; i1 < cluno; i1++) {
 
           for (int i2 = 0; i2 < features; i2++) {
@@ -936,9 +1929,13 @@ short kmeans_pthreads(unsigned short* b, const float* data, float* clucent,
           clusize[i1] = 0;         // ... and cluster size
         }
 
-                          // wait until threads have finished
-        for (int i1 = 0; i1 < cores; i1++) {
-          sem_wait(&kmthreads[i1].semret);
+                          // wait until workers have finished
+        threadpool_sched_wait(sched);
+
+                          // cancelled or deadline passed (chunks may have been skipped)?
+        if (jobctl_check(kmparam->job) != JOBCTL_RUNNING) {
+          ret = -30;
+          break;
         }
 
                          // calculate new cluster centers
@@ -952,7 +1949,9 @@ short kmeans_pthreads(unsigned short* b, const float* data, float* clucent,
                // iterate of cluster centers and features and divide by number of cluster members
         for (int i1 = 0; i1 < cluno; i1++) {
           for (int i2 = 0; i2 < features; i2++) {
-            newclucent[i1 * features + i2] /= (float) clusize[i1];
+            newclucent[i1 * features + i2] = (clusize[i1] > 0) ?
+              newclucent[i1 * features + i2] / (float) clusize[i1] :
+              clucent[i1 * features + i2];          // empty cluster keeps its center
           }
         }
 
@@ -971,6 +1970,14 @@ short kmeans_pthreads(unsigned short* b, const float* data, float* clucent,
           newdist += sqrt(newdist2);
         }
 
+        int moved = 0;                  // data items that changed their cluster
+
+        for (int i1 = 0; i1 < sched->parts; i1++) {
+          moved += kmparam->moved[i1].n;
+        }
+
+        kmeans_tally(counters, cycles, newdist, moved, clusize, blen, cluno);
+
                         // check abort conditions
         if ((newdist <= eps) || (cycles > MAXCYCLES)){
           weiter = -1;
@@ -979,6 +1986,8 @@ short kmeans_pthreads(unsigned short* b, const float* data, float* clucent,
                        // copy cluster centers
         memcpy(clucent, newclucent, sizeof(float) * features * cluno);
 
+        trace_end(TRACE_ALGO, "kmeans cycle", tr, cycles);
+
         cycles++;         // increment cycle counter
 
       }
@@ -999,223 +2008,539 @@ short kmeans_pthreads(unsigned short* b, const float* data, float* clucent,
 
 
 
-// see header file
-JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads
-  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
-   jint cores, jlongArray e ) {
+/*!
+ \brief Multithreaded Kmeans cluster search on the workers of the thread pool
+ \details
+ Sets up the scheduler, reserves the workers and performs the search with kmeans_pthreads (or
+ kmeans_minibatch with kmeans_assign_cpu). Used by the JNI methods and by the job scheduler (see
+ jobsched.h).
+ \param b (out) Array of cluster numbers (blen values, should start at a cache line, see
+ threadpool_alloc)
+ \param data (in) Array of data points
+ \param blen (in) number of data items in data
+ \param eps (in) maximum cluster center displacement
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param cores (in) number of participants
+ \param policy (in) placement of the workers (CPUTOPO_NONE, _BIG, _LITTLE or _ALL)
+ \param seed (in) seed of the initial cluster centers, 0 = taken from the clock
+ \param mb (in) parameters of a mini-batch search, NULL = Lloyd iterations
+ \param init (in) initial cluster centers of the Lloyd iterations, NULL = selected with *seed*
+ \param centers (out) final cluster centers, NULL = not needed
+ \param job (in+out) the job
+ \param counters (in+out) counters of the iterations, NULL = not needed
+ \param stats (out) statistics of the participants (see threadpool_sched_stats), NULL = not
+ needed
+ \param slen (in) number of values that fit into *stats*
+ \param elapsed (out) exclusive runtime in ns (only with GPUTIMING, NULL = not needed)
+ \returns 0 = no error, -30 = cancelled or deadline passed, -7 = scheduler could not be set up,
+ -8 = no workers, -9 = malloc error, other negative values = error of kmeans_pthreads
+ \mt fully threadsafe
+ */
+short kmeans_run_pthreads(unsigned short *b, const float *data, const int blen, const float eps,
+                          const int cluno, const int features, const int cores, const int policy,
+                          const unsigned int seed, const struct agpudm_minibatch_params *mb,
+                          const float *init, float *centers, struct jobctl *job,
+                          struct agpudm_stats *counters, long long *stats, const int slen,
+                          long long *elapsed) {
 
   short ret = 0;                              // return value
 
-  struct timespec start2, finish2;       // two timepoints
+  struct timespec start2 = {0, 0}, finish2 = {0, 0};       // two timepoints
 
+                                 // allocate memory for the cluster centers
+  float *clucent = (float *) malloc(sizeof(float) * features * cluno);
 
-                              // check architecture
-  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+  if (clucent != NULL) {               // malloc error?
 
-                               // get the number of data array entries
-    jsize datalen = (*env)->GetArrayLength(env, rf);
-    jsize blen = (*env)->GetArrayLength(env, b);  // get the number of data elements
+                     // set up the scheduler
+    struct threadpool_sched sched;
 
-    if (features * blen == datalen) {   // ...these must match
+    if (threadpool_sched_init(&sched, cores, policy) == 0) {            // malloc error?
 
-                                   // get float array elements and pin array
-      jfloat* condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+                     // chunks do not share cache lines of the cluster center numbers
+      threadpool_sched_align(&sched, sizeof(unsigned short));
 
-      if (condata != NULL) {     // error?
+      struct kmeans_pt kmparam;           // parameters shared by the chunks
 
-                          // allocate memory for the cluster center numbers
-        unsigned short *conb = (unsigned short *) malloc(sizeof(unsigned short) * blen);
+      kmparam.b = b;          // reference to cluster number array
+      kmparam.data = data;      // reference to data items
+      kmparam.blen = blen;     // number of data items
+      kmparam.cluno = cluno;    // number of clusters to search for
+      kmparam.features = features;    // number of features
+      kmparam.clucent = clucent;    // reference to cluster center
+      kmparam.job = job;            // the job
 
-        if (conb != NULL) {                // malloc error?
+                              // reassignment counters of the participants
+      kmparam.moved = (struct kmeans_count *) threadpool_alloc(sizeof(struct kmeans_count) *
+                                                               sched.parts);
 
-                                 // allocate memory for the cluster centers
-          float *clucent = (float *) malloc(sizeof(float) * features * cluno);
+      if (kmparam.moved == NULL) {        // malloc error?
+        ret = -9;
 
-          if (clucent != NULL) {               // malloc error?
+                              // workers of the thread pool available?
+      } else if (threadpool_reserve(cores) > 0) {
 
-                             // allocate memory for the threads
-            struct kmeans_pt *kmthreads = (struct kmeans_pt *) malloc(
-              sizeof(struct kmeans_pt) * cores);
+        threadpool_setpolicy(policy);       // placement of the workers
 
-            if (kmthreads != NULL) {            // malloc error?
+#ifdef GPUTIMING
+                               // get time
+        clock_gettime(CLOCK_REALTIME, &start2);
+#endif
+                         // perform calculations
+        if (mb != NULL) {
 
-              int initsucc = 0;           // 1 = thread initialization was not successfull
+          struct kmeans_mbcpu c = { &kmparam, &sched };   // batches on the workers
 
-              int stepper = (blen / cores) + 1;        // caluclate data items per thread
-              int starter = 0;                    // start with item #0
-              int reminder = blen;               // data items left
+          ret = kmeans_minibatch(b, data, blen, eps, cluno, features, clucent, mb, blen, seed,
+                                 &kmeans_assign_cpu, &c, job, counters);
+        } else {
+          ret = kmeans_pthreads(b, data, clucent, blen, cluno, features, &kmparam, &sched, eps,
+                                seed, init, counters);
+        }
 
-                                      // iterate over cores
-              for (int i1 = 0; i1 < cores; i1++) {
+        if ((ret == 0) && (centers != NULL)) {   // final cluster centers requested?
+          memcpy(centers, clucent, sizeof(float) * features * cluno);
+        }
 
-                kmthreads[i1].status = 0;          // init status
+#ifdef GPUTIMING
+                         // get time
+        clock_gettime(CLOCK_REALTIME, &finish2);
+#endif
 
-                if (reminder < stepper) {          // only few left?
-                  stepper = reminder;          // assign the remaining ones to the thread
-                }
+      } else {
+        ret = -8;
+      }
 
-                if (initsucc == 0) {                // successfully so far?
+                         // copy statistics of the workers (if requested)
+      if ((stats != NULL) && (slen > 0)) {
+        threadpool_sched_stats(&sched, stats, slen);
+      }
 
-                                            // initialize the thread arguments
-                  kmthreads[i1].num = i1;         // thread number
-                  kmthreads[i1].b = conb;       // reference to cluster number array
-                  kmthreads[i1].data = condata;   // reference to data items
-                  kmthreads[i1].blen = blen;     // number of data items
-                  kmthreads[i1].cluno = cluno;    // number of clusters to search for
-                  kmthreads[i1].features = features;    // number of features
-                  kmthreads[i1].start = starter;     // start data element
-                  kmthreads[i1].len = stepper;      // number of elements for the thread
-                  kmthreads[i1].clucent = clucent;    // reference to cluster center
-                  kmthreads[i1].fertig = 0;        // stop condition
+      free(kmparam.moved);
+      threadpool_sched_destroy(&sched);            // free and clean up
 
+    } else {
+      ret = -7;
+    }
 
-                                              // initialize first semaphore
-                  if (sem_init(&kmthreads[i1].sem, 0, 0) == 0) {
-                    kmthreads[i1].status |= 1;     // OK -> set status
-                  } else {
-                    initsucc = 1;                    // abort
-                  }
+    free(clucent);
 
-                                             // initialize second semaphore
-                  if ((kmthreads[i1].status & 1) == 1) {
-                    if (sem_init(&kmthreads[i1].semret, 0, 0) == 0) {
-                      kmthreads[i1].status |= 2;     // OK -> set status
-                    } else {
-                      initsucc = 1;                 // abort
-                    }
-                  }
+  } else {
+    ret = -9;
+  }
 
-                                // both semaphores initialized?
-                  if ((kmthreads[i1].status & 3) == 3) {
+#ifdef GPUTIMING
+                  // calculate elapsed time
+  if (elapsed != NULL) {
+    *elapsed = ((long long) (finish2.tv_sec - start2.tv_sec)) * 1000000000LL +
+               (finish2.tv_nsec - start2.tv_nsec);
+  }
+#endif
 
-                                  // yes -> create thread
-                    if (
-                      pthread_create(&(kmthreads[i1].thread), NULL, &kmthread, &kmthreads[i1]) ==
-                      0) {
-                      kmthreads[i1].status |= 4;   // OK -> set status
-                    } else {
-                      initsucc = 1;                 // error -> abort
-                    }
-                  }
+  return (ret);
 
-                }
+}  // kmeans_run_pthreads
 
-                starter += stepper;               // step data elements
-                reminder -= stepper;
-              }
 
-                                      // threads created successfully?
-              if (initsucc == 0) {
 
-#ifdef GPUTIMING
-                                       // get time
-                clock_gettime(CLOCK_REALTIME, &start2);
-#endif
-                                 // perform calculations
-                ret = kmeans_pthreads(conb, condata, clucent, blen, cluno, features, cores,
-                                      kmthreads, eps);
+/*!
+ \brief Runs a k-means search on an engine
+ \details
+ Used by the job scheduler and by the public C interface.
+ \param b (out) Array of cluster numbers (blen values)
+ \param data (in) Array of data points
+ \param blen (in) number of data items
+ \param eps (in) maximum cluster center displacement
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param engine (in) JOBSCHED_SINGLE, JOBSCHED_PTHREADS or JOBSCHED_GPU
+ \param cores (in) number of participants of the multithreaded engine
+ \param policy (in) placement of the workers (see cputopo.h)
+ \param storage (in) storage of the data items on the GPU (see oclstore.h)
+ \param inplace (in) 1 = the GPU works directly on *data* and *b* (see kmeans_run_gpu)
+ \param seed (in) seed of the initial cluster centers, 0 = taken from the clock
+ \param mb (in) parameters of a mini-batch search, NULL = Lloyd iterations
+ \param init (in) initial cluster centers of the Lloyd iterations (cluno * features values), NULL =
+ selected with *seed*
+ \param centers (out) final cluster centers of the Lloyd iterations, NULL = not needed
+ \param job (in+out) the job
+ \param counters (out) counters of the iterations (cleared first), NULL = not needed
+ \param stats (out) statistics of the workers (see kmeans_run_pthreads), NULL = not needed
+ \param slen (in) number of values that fit into *stats*
+ \param elapsed (out) exclusive runtime (ns)
+ \returns result of the engine
+ \mt fully threadsafe
+ */
+short kmeans_engine(unsigned short *b, const float *data, const int blen, const float eps,
+                    const int cluno, const int features, const int engine, const int cores,
+                    const int policy, const int storage, const int inplace,
+                    const unsigned int seed, const struct agpudm_minibatch_params *mb,
+                    const float *init, float *centers, struct jobctl *job,
+                    struct agpudm_stats *counters, long long *stats, const int slen,
+                    long long *elapsed) {
 
-                                // copy results
-                (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+  short ret = 0;                              // return value
 
-#ifdef GPUTIMING
-                                 // get time
-                clock_gettime(CLOCK_REALTIME, &finish2);
-#endif
+  agpudm_clearstats(counters);
 
-              } else {
-                ret = -8;
-              }
+  if (engine == JOBSCHED_GPU) {
+    ret = kmeans_run_gpu(b, data, blen, eps, cluno, features, storage, inplace, seed, mb, init,
+                         centers, job, counters, elapsed);
+  } else if (engine == JOBSCHED_PTHREADS) {
+    ret = kmeans_run_pthreads(b, data, blen, eps, cluno, features, cores, policy, seed, mb, init,
+                              centers, job, counters, stats, slen, elapsed);
+  } else {
 
-                            // iterate over cores
-              for (int i1 = 0; i1 < cores; i1++) {
+    struct timespec start2, finish2;       // two timepoints
 
-                                  // first semaphore initialized?
-                if ((kmthreads[i1].status & 4) > 0) {
+    clock_gettime(CLOCK_REALTIME, &start2);
 
-                               // yes -> signal abort
-                  kmthreads[i1].fertig = 1;
-                  sem_post(&kmthreads[i1].sem);    // weak up
+    if (mb != NULL) {
+      ret = kmeans_single_minibatch(b, data, blen, eps, cluno, features, mb, seed, job,
+                                    counters);
+    } else {
+      ret = kmeans(b, data, blen, eps, cluno, features, seed, init, centers, job, counters);
+    }
 
-                                   // wait until finished
-                  pthread_join(kmthreads[i1].thread, NULL);
+    clock_gettime(CLOCK_REALTIME, &finish2);
 
-                }
+    *elapsed = ((long long) (finish2.tv_sec - start2.tv_sec)) * 1000000000LL +
+               (finish2.tv_nsec - start2.tv_nsec);
+  }
 
-                             // second semaphore initialized
-                if ((kmthreads[i1].status & 2) > 0) {
-                  sem_destroy(&kmthreads[i1].semret);   // yes -> destroy
-                }
+  return (ret);
 
-                              // first semaphore initialized
-                if ((kmthreads[i1].status & 1) > 0) {
-                  sem_destroy(&kmthreads[i1].sem);    // yes -> destroy
-                }
-              }
+}  // kmeans_engine
 
-              free(kmthreads);            // free and clean up
 
-            } else {
-              ret = -7;
-            }
 
-            free(clucent);
+/*!
+ \brief Runs a k-means job of the job scheduler
+ \details
+ Calls the engine granted by the scheduler (see jobsched_runfn).
+ \param desc (in) the descriptor of the job (param = number of clusters)
+ \param engine (in) JOBSCHED_SINGLE, JOBSCHED_PTHREADS or JOBSCHED_GPU
+ \param cores (in) number of participants of the multithreaded engine
+ \param job (in+out) the job
+ \param elapsed (out) exclusive runtime (ns)
+ \returns result of the engine, JOBSCHED_EFALLBACK = OpenCL error of the GPU engine (only if
+ the scheduler chose the engine)
+ \mt fully threadsafe
+ */
+short kmeans_jobrun(const struct jobsched_desc *desc, int engine, int cores, struct jobctl *job,
+                    long long *elapsed) {
 
-          } else {
-            ret = -9;
-          }
+  short code = kmeans_engine(desc->b, desc->data, desc->blen, desc->eps, desc->param,
+                             desc->features, engine, cores, desc->policy, desc->storage, 0,
+                             desc->seed, NULL, NULL, NULL, job, NULL, NULL, 0, elapsed);
+
+                        // GPU not usable -> the scheduler runs the job again on the workers
+  if ((engine == JOBSCHED_GPU) && (desc->engine == JOBSCHED_AUTO) &&
+      (kmeans_status(AGPUDM_ENGINE_GPU, code) == AGPUDM_EOPENCL)) {
+    code = JOBSCHED_EFALLBACK;
+  }
+
+  return (code);
+
+}  // kmeans_jobrun
+
+
+
+// see header file
+int kmeans_status(int engine, int code) {
+
+  if (code == 0) {
+    return (AGPUDM_OK);
+  }
+
+  if (code == -30) {                     // cancelled or deadline passed
+    return (AGPUDM_ECANCELLED);
+  }
+
+  if (code == -31) {                     // job could not be attached
+    return (AGPUDM_ENOJOB);
+  }
+
+  if (engine == AGPUDM_ENGINE_GPU) {     // set up or OpenCL call failed
+    return (AGPUDM_EOPENCL);
+  }
+
+  if ((engine == AGPUDM_ENGINE_PTHREADS) && ((code == -7) || (code == -8))) {
+    return (AGPUDM_ENOSTART);            // scheduler or workers
+  }
+
+  if ((code >= -3) || (code == -9)) {    // malloc errors
+    return (AGPUDM_ENOMEM);
+  }
+
+  return (AGPUDM_EENGINE);
+
+}  // kmeans_status
+
+
+
+/*!
+ \brief Inertia of a cluster assignment
+ \param data (in) Array of data points
+ \param b (in) Array of cluster numbers
+ \param blen (in) number of data items in data
+ \param clucent (in) Array of cluster centers
+ \param features (in) number of features per data item
+ \returns sum of the squared distances of the data items to their cluster center
+ \mt fully threadsafe
+ */
+double kmeans_inertia(const float *data, const unsigned short *b, const int blen,
+                      const float *clucent, const int features) {
+
+  double inertia = 0;                    // return value
+
+  for (int i1 = 0; i1 < blen; i1++) {
+
+    const float *c = &clucent[b[i1] * features];   // center of the data item
+    double dist2 = 0;
+
+    for (int i2 = 0; i2 < features; i2++) {
+      const double d = (double) data[(size_t) i1 * features + i2] - c[i2];
+      dist2 += d * d;
+    }
+
+    inertia += dist2;
+  }
+
+  return (inertia);
+
+}  // kmeans_inertia
+
+
+
+/*!
+ \brief Synchronous k-means search of the public C interface
+ \details
+ Common part of agpudm_kmeans, agpudm_kmeans_minibatch and agpudm_kmeans_warm: checks the
+ arguments, attaches to the job and runs the engine of the context (AGPUDM_ENGINE_AUTO: the GPU
+ first, the workers if the GPU can not be used).
+ \param ctx (in) the context
+ \param data (in) the data items (n x features floats)
+ \param n (in) number of data items
+ \param features (in) number of features per data item
+ \param p (in) the parameters
+ \param mb (in) parameters of a mini-batch search, NULL = Lloyd iterations
+ \param init (in) initial cluster centers of the Lloyd iterations, NULL = selected with p->seed
+ \param job (in) handle of a job, 0 = none
+ \param labels (out) n cluster numbers
+ \param centers (out) final cluster centers of the Lloyd iterations, NULL = not needed
+ \param inertia (out) inertia of the final assignment (Lloyd iterations), NULL = not needed
+ \param res (in+out) details of the call, NULL = not needed
+ \returns AGPUDM_OK or an error code
+ \mt fully threadsafe
+ */
+int kmeans_call(struct agpudm *ctx, const float *data, int n, int features,
+                const struct agpudm_kmeans_params *p, const struct agpudm_minibatch_params *mb,
+                const float *init, int job, unsigned short *labels, float *centers,
+                double *inertia, struct agpudm_result *res) {
+
+  int ret = AGPUDM_OK;                   // return value
+
+  if ((ctx != NULL) && (data != NULL) && (labels != NULL) && (p != NULL) && (n > 0) &&
+      (features > 0) && (p->clusters > 0) && (p->clusters <= 0xFFFF)) {
+
+                                 // attach to the job (deadline of the context)
+    struct jobctl *jobp = agpudm_attach(ctx, job, JOBCTL_KMEANS);
+
+                                 // the inertia needs the final cluster centers
+    float *clucent = ((inertia != NULL) && (centers == NULL)) ?
+                     (float *) malloc(sizeof(float) * features * p->clusters) : centers;
+
+    if ((jobp != NULL) && (inertia != NULL) && (clucent == NULL)) {   // malloc error?
+      ret = AGPUDM_ENOMEM;
+      jobctl_detach(jobp);
+      agpudm_setresult(res, ret, -9, ctx->cfg.engine, 0, 0);
+
+    } else if (jobp != NULL) {
 
-          free(conb);
+      int engine = ctx->cfg.engine;
+      int cores = agpudm_cores(ctx);
+      long long elapsed = 0;
+      short code = 0;
 
+      if ((engine == AGPUDM_ENGINE_AUTO) || (engine == AGPUDM_ENGINE_GPU)) {
+
+                                 // on the GPU, in place
+        code = kmeans_engine(labels, data, n, p->eps, p->clusters, features, JOBSCHED_GPU, 1,
+                             ctx->cfg.policy, ctx->cfg.storage, 1, p->seed, mb, init, clucent,
+                             jobp, (res != NULL) ? res->stats : NULL, NULL, 0, &elapsed);
+
+        if ((engine == AGPUDM_ENGINE_AUTO) &&
+            (kmeans_status(AGPUDM_ENGINE_GPU, code) == AGPUDM_EOPENCL)) {
+          engine = AGPUDM_ENGINE_PTHREADS;   // GPU not usable -> workers
         } else {
-          ret = -6;
+          engine = AGPUDM_ENGINE_GPU;
         }
+      }
+
+      if (engine != AGPUDM_ENGINE_GPU) {
+        code = kmeans_engine(labels, data, n, p->eps, p->clusters, features, engine, cores,
+                             ctx->cfg.policy, ctx->cfg.storage, 1, p->seed, mb, init, clucent,
+                             jobp, (res != NULL) ? res->stats : NULL,
+                             (res != NULL) ? res->workers : NULL,
+                             (res != NULL) ? res->wlen : 0, &elapsed);
+      }
 
-                            // unpin data elements
-        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
+      jobctl_detach(jobp);
 
-      } else {
-        ret = -5;
+      ret = kmeans_status(engine, code);
+
+      if ((ret == AGPUDM_OK) && (inertia != NULL)) {   // on the host, the engines do not sum up
+        *inertia = kmeans_inertia(data, labels, n, clucent, features);
       }
 
+      agpudm_setresult(res, ret, code, engine, (engine == AGPUDM_ENGINE_PTHREADS) ? cores : 1,
+                       elapsed);
+
     } else {
-      ret = -4;
+      ret = (job != 0) ? AGPUDM_ENOJOB : AGPUDM_ENOSTART;
+      agpudm_setresult(res, ret, -31, ctx->cfg.engine, 0, 0);
     }
+
+    if (clucent != centers) {
+      free(clucent);
+    }
+
   } else {
-    ret = -3;
+    ret = AGPUDM_EINVAL;
+    agpudm_setresult(res, ret, -4, (ctx != NULL) ? ctx->cfg.engine : 0, 0, 0);
   }
 
-#ifdef GPUTIMING
-                  // calculate elapsed time
-  long long int elapsed2 = ((long long int) (finish2.tv_sec - start2.tv_sec)) * 1000000000L;
-  elapsed2 += (finish2.tv_nsec - start2.tv_nsec);
-
-            // lock array
-  jlong *edata = (*env)->GetLongArrayElements(env, e, NULL);
-  edata[0] = elapsed2;            // set first (and single) array element
-                     // unlock array
-  (*env)->ReleaseLongArrayElements(env, e, edata, 0);
-#endif
-
   return (ret);
-}  // Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads
 
+}  // kmeans_call
 
 
 
 // see header file
-JNIEXPORT void JNICALL
-Java_com_example_dmocl_kmeans_kmabort_1c(JNIEnv *env, jclass clazz) {
-  rwlockwp_writer_acquire(&abortcalckm);   // acquire writer lock
-  doabort = 1;                              // signal to abort
-  rwlockwp_writer_release(&abortcalckm);   // release writer lock
-}
+int agpudm_kmeans(struct agpudm *ctx, const float *data, int n, int features,
+                  const struct agpudm_kmeans_params *p, int job, unsigned short *labels,
+                  struct agpudm_result *res) {
+
+  return (kmeans_call(ctx, data, n, features, p, NULL, NULL, job, labels, NULL, NULL, res));
+
+}  // agpudm_kmeans
+
+
 
 // see header file
-JNIEXPORT void JNICALL
-Java_com_example_dmocl_kmeans_kmresume_1c(JNIEnv *env, jclass clazz) {
-  rwlockwp_writer_acquire(&abortcalckm);  // acquire writer lock
-  doabort = 0;                            // signal to resume
-  rwlockwp_writer_release(&abortcalckm);  // relese writer lock
-}
+int agpudm_kmeans_minibatch(struct agpudm *ctx, const float *data, int n, int features,
+                            const struct agpudm_kmeans_params *p,
+                            const struct agpudm_minibatch_params *mb, int job,
+                            unsigned short *labels, struct agpudm_result *res) {
+
+  if (mb == NULL) {                      // the other arguments are checked by kmeans_call
+    agpudm_setresult(res, AGPUDM_EINVAL, -4, (ctx != NULL) ? ctx->cfg.engine : 0, 0, 0);
+    return (AGPUDM_EINVAL);
+  }
+
+  return (kmeans_call(ctx, data, n, features, p, mb, NULL, job, labels, NULL, NULL, res));
+
+}  // agpudm_kmeans_minibatch
+
+
+
+// see header file
+int agpudm_kmeans_warm(struct agpudm *ctx, const float *data, int n, int features,
+                       const struct agpudm_kmeans_params *p, const float *init, int job,
+                       unsigned short *labels, float *centers, double *inertia,
+                       struct agpudm_result *res) {
+
+  return (kmeans_call(ctx, data, n, features, p, NULL, init, job, labels, centers, inertia,
+                      res));
+
+}  // agpudm_kmeans_warm
+
+
+
+// see header file
+int agpudm_kmeans_submit(struct agpudm *ctx, const float *data, int n, int features,
+                         const struct agpudm_kmeans_params *p, agpudm_donefn done, void *arg) {
+
+  int ret = 0;                           // return value
+
+  if ((ctx != NULL) && (data != NULL) && (p != NULL) && (n > 0) && (features > 0) &&
+      (p->clusters > 0) && (p->clusters <= 0xFFFF)) {
+
+    float *copy = (float *) malloc(sizeof(float) * n * features);   // the only copy
+
+    if (copy != NULL) {                  // malloc error?
+      memcpy(copy, data, sizeof(float) * n * features);
+      ret = agpudm_kmeans_adopt(ctx, copy, n, features, p, done, arg);
+    } else {
+      ret = AGPUDM_ENOMEM;
+    }
+
+  } else {
+    ret = AGPUDM_EINVAL;
+  }
+
+  return (ret);
+
+}  // agpudm_kmeans_submit
+
+
+
+// see header file
+int agpudm_kmeans_adopt(struct agpudm *ctx, float *data, int n, int features,
+                        const struct agpudm_kmeans_params *p, agpudm_donefn done, void *arg) {
+
+  int ret = 0;                           // return value
+
+  if ((ctx != NULL) && (data != NULL) && (p != NULL) && (n > 0) && (features > 0) &&
+      (p->clusters > 0) && (p->clusters <= 0xFFFF)) {
+
+    struct jobsched_desc desc;           // the job
+
+    desc.group = JOBCTL_KMEANS;
+    desc.engine = ctx->cfg.engine;
+    desc.cores = ctx->cfg.cores;
+    desc.policy = ctx->cfg.policy;
+    desc.storage = ctx->cfg.storage;
+    desc.blen = n;
+    desc.features = features;
+    desc.eps = p->eps;
+    desc.param = p->clusters;
+    desc.seed = p->seed;
+    desc.timeoutms = ctx->cfg.timeoutms;
+    desc.stopped = -30;                  // cancelled before it has started
+    desc.run = &kmeans_jobrun;
+    desc.done = done;
+    desc.donearg = arg;
+
+                      // the data items are taken over, the cluster numbers start at a cache line
+    desc.data = data;
+    desc.b = (unsigned short *) threadpool_alloc(sizeof(unsigned short) * n);
+
+    if (desc.b != NULL) {                // malloc error?
+
+      ret = jobsched_submit(&desc);
+
+      if (ret > 0) {                     // owned by the scheduler now
+        desc.data = NULL;
+        desc.b = NULL;
+      } else {
+        ret = (ret == JOBSCHED_EDESC) ? AGPUDM_EINVAL : AGPUDM_ENOSTART;
+      }
+
+    } else {
+      ret = AGPUDM_ENOMEM;
+    }
+
+    free(desc.data);
+    free(desc.b);
+
+  } else {
+    free(data);
+    ret = AGPUDM_EINVAL;
+  }
+
+  return (ret);
 
+}  // agpudm_kmeans_adopt
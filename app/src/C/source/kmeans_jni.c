@@ -0,0 +1,788 @@
+/*!
+ \file kmeans_jni.c
+ \brief JNI methods of the Kmeans algorithm
+ \details
+ This file adapts the Java methods of com.example.dmocl.kmeans (see kmeans_c.h) to the public
+ C interface (agpudm.h): it checks and pins the Java arrays, calls the search with a context
+ for the requested engine and copies the cluster numbers back. The searches themselves are in
+ kmeans_c.c.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include <jni.h>
+#include "kmeans_c.h"
+#include "agpudm.h"
+#include "oclwrapper.h"
+#include "threadpool.h"
+#include "jobsched.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+                               //! Define if detailed timing for the GPU should be made
+#define GPUTIMING
+
+                               //! counters ahead of the per-iteration values (kmeans_c_stats)
+#define KMEANS_NSTATS 4
+
+
+
+/*!
+ \brief Kmeans cluster search through the public C interface
+ \details
+ Creates a context for the engine, performs the search in place and returns the result code of
+ the engine (the values documented for the JNI methods).
+ \param b (out) Array of cluster numbers (blen values)
+ \param data (in) Array of data points
+ \param blen (in) number of data items
+ \param eps (in) maximum cluster center displacement
+ \param cluno (in) number of clusters to search for
+ \param features (in) number of features per data item
+ \param engine (in) AGPUDM_ENGINE_SINGLE, _PTHREADS or _GPU
+ \param cores (in) number of cores (multithreaded engine)
+ \param policy (in) placement of the workers
+ \param storage (in) storage of the data items on the GPU
+ \param job (in) handle of the job, 0 = none
+ \param stats (out) statistics of the workers, NULL = not needed
+ \param slen (in) number of values that fit into *stats*
+ \param counters (out) counters of the iterations, NULL = not needed
+ \param init (in) initial cluster centers (see agpudm_kmeans_warm), NULL = from the clock
+ \param centers (out) final cluster centers, NULL = not needed
+ \param inertia (out) inertia of the final cluster assignment, NULL = not needed
+ \param elapsed (out) exclusive runtime in ns
+ \param enomem (in) result code if the context can not be created
+ \returns result code of the engine
+ \mt fully threadsafe
+ */
+short kmeans_jnirun(unsigned short *b, const float *data, int blen, float eps, int cluno,
+                    int features, int engine, int cores, int policy, int storage, int job,
+                    long long *stats, int slen, struct agpudm_stats *counters,
+                    const float *init, float *centers, double *inertia, long long *elapsed,
+                    short enomem) {
+
+  const long long tr = trace_begin();    // span of the JNI call
+
+  struct agpudm_config cfg;              // configuration of the call
+  struct agpudm *ctx;                    // the context
+
+  agpudm_config_default(&cfg);
+  cfg.engine = engine;
+  cfg.cores = cores;
+  cfg.policy = policy;
+  cfg.storage = storage;
+
+  short ret = enomem;                    // return value
+
+  if (agpudm_create(&cfg, &ctx) == AGPUDM_OK) {
+
+    struct agpudm_kmeans_params p;      // parameters of the search
+    struct agpudm_result res;           // details of the search
+
+    p.clusters = cluno;
+    p.eps = eps;
+    p.seed = 0;                         // initial centers from the clock
+    res.workers = stats;
+    res.wlen = slen;
+    res.stats = counters;
+
+    agpudm_kmeans_warm(ctx, data, blen, features, &p, init, job, b, centers, inertia, &res);
+
+    agpudm_destroy(ctx);
+
+    *elapsed = res.elapsed;
+    ret = (short) res.code;
+  }
+
+  trace_end(TRACE_JNI, "kmeans_jnirun", tr, engine);
+
+  return (ret);
+
+} // kmeans_jnirun
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features) {
+
+  return (Java_com_example_dmocl_kmeans_kmeans_1c_1ex(env, jc, b, rf, eps, kk, features, 0));
+
+} // Java_com_example_dmocl_kmeans_kmeans_1c
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint kk, jint features,
+   jint job) {
+
+  short ret = 0;                  // return value
+
+  long long elapsed2 = 0;         // exclusive runtime (not returned)
+
+                  // check for architecture compartibility
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                    // get number of data items*features
+    jsize datalen = (*env)->GetArrayLength(env, rf);
+                     // get number of data items
+    jsize blen = (*env)->GetArrayLength(env, b);
+
+    if (features * blen == datalen) {   // must correspond
+
+                                 // get array data
+      jfloat* condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {
+
+                                  // allocate buffer for the cluster assignment
+        unsigned short *conb = (unsigned short *) malloc(sizeof(unsigned short) * blen);
+
+        if (conb != NULL) {              // malloc error
+
+                                           // perform kmeans search
+          ret = kmeans_jnirun(conb, condata, blen, eps, kk, features, AGPUDM_ENGINE_SINGLE, 1,
+                              AGPUDM_POLICY_DEFAULT, AGPUDM_STORE_FP32, job, NULL, 0,
+                              NULL, NULL, NULL, NULL, &elapsed2, -5);
+
+          if (ret != -31) {
+                             // copy result
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+          }
+
+          free(conb);                   // clean
+
+        } else {
+          ret = -5;
+        }
+
+        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
+
+      } else {
+        ret = -4;
+      }
+    } else {
+      ret = -3;
+    }
+  } else {
+    ret = -2;
+  }
+
+  return (ret);
+} // Java_com_example_dmocl_kmeans_kmeans_1c_1ex
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1gpu
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jlongArray e) {
+
+  return (Java_com_example_dmocl_kmeans_kmeans_1c_1gpu_1ex(env, jc, b, rf, eps, cluno, features,
+                                                           AGPUDM_STORE_FP32, 0, e));
+
+} // Java_com_example_dmocl_kmeans_kmeans_1c_1gpu
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1gpu_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint storage, jint job, jlongArray e) {
+
+
+  long long elapsed2 = 0;                 // exclusive runtime
+
+  short ret = 0;                          // return value
+
+                  // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                    // get data array and data item length
+    jsize datalen = (*env)->GetArrayLength(env, rf);
+    jsize blen = (*env)->GetArrayLength(env, b);
+
+    if (features * blen == datalen) {             // must match
+
+                            // copy data items
+      jfloat* condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {             // error?
+
+                         // allocate array for cluster assignment
+        unsigned short *conb = (unsigned short *) malloc(sizeof(unsigned short) * blen);
+
+        if (conb != NULL) {              // malloc error
+
+                                 // perform kmeans on the GPU
+          ret = kmeans_jnirun(conb, condata, blen, eps, cluno, features, AGPUDM_ENGINE_GPU, 1,
+                              AGPUDM_POLICY_DEFAULT, storage, job, NULL, 0, NULL,
+                              NULL, NULL, NULL, &elapsed2, -6);
+
+          if ((ret == 0) || (ret == -30)) {
+                                 // store results
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort*) conb);
+          }
+
+          free(conb);
+
+        } else {
+          ret = -6;
+        }
+
+        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
+
+      } else {
+        ret = -5;
+      }
+    } else {
+      ret = -4;
+    }
+  } else {
+    ret = -3;
+  }
+
+#ifdef GPUTIMING
+                           // store as first (and unique) array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+
+} // Java_com_example_dmocl_kmeans_kmeans_1c_1gpu_1ex
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1gpu_1direct
+  (JNIEnv *env, jclass jc, jobject b, jobject rf, jfloat eps, jint cluno, jint features,
+   jint storage, jint job, jlongArray e) {
+
+  long long elapsed2 = 0;                 // exclusive runtime
+
+  short ret = 0;                          // return value
+
+  jlong blen, datalen;                    // capacities of the buffers
+
+                  // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                    // memory of the buffers (no copies)
+    unsigned short *dirb = (unsigned short *) oclwrap_direct(env, b, sizeof(unsigned short),
+                                                             &blen);
+    float *dirdata = (float *) oclwrap_direct(env, rf, sizeof(float), &datalen);
+
+    if ((dirb != NULL) && (dirdata != NULL)) {       // direct buffers?
+
+      if ((blen <= INT_MAX) && (features * blen == datalen)) {  // must match
+
+                                 // perform kmeans on the GPU, in place
+        ret = kmeans_jnirun(dirb, dirdata, (int) blen, eps, cluno, features, AGPUDM_ENGINE_GPU,
+                            1, AGPUDM_POLICY_DEFAULT, storage, job, NULL, 0, NULL,
+                            NULL, NULL, NULL, &elapsed2, -6);
+
+      } else {
+        ret = -4;
+      }
+    } else {
+      ret = -5;
+    }
+  } else {
+    ret = -3;
+  }
+
+#ifdef GPUTIMING
+                           // store as first (and unique) array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+
+} // Java_com_example_dmocl_kmeans_kmeans_1c_1gpu_1direct
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint cores, jlongArray e ) {
+
+  return (Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1ex(env, jc, b, rf, eps, cluno,
+                                                                features, cores,
+                                                                AGPUDM_POLICY_DEFAULT, 0, e));
+
+}  // Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1ex
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint cores, jint policy, jint job, jlongArray e ) {
+
+  short ret = 0;                              // return value
+
+  long long elapsed2 = 0;                // exclusive runtime
+
+
+                              // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                               // get the number of data array entries
+    jsize datalen = (*env)->GetArrayLength(env, rf);
+    jsize blen = (*env)->GetArrayLength(env, b);  // get the number of data elements
+
+    if (features * blen == datalen) {   // ...these must match
+
+                                   // get float array elements and pin array
+      jfloat* condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {     // error?
+
+                 // allocate memory for the cluster center numbers (starts at a cache line)
+        unsigned short *conb = (unsigned short *) threadpool_alloc(sizeof(unsigned short) * blen);
+
+        if (conb != NULL) {                // malloc error?
+
+                                 // statistics of the workers requested?
+          jsize slen = (*env)->GetArrayLength(env, e);
+          jlong *sdata = (slen > 1) ? (*env)->GetLongArrayElements(env, e, NULL) : NULL;
+
+                                 // perform calculations
+          ret = kmeans_jnirun(conb, condata, blen, eps, cluno, features,
+                              AGPUDM_ENGINE_PTHREADS, cores, policy, AGPUDM_STORE_FP32, job,
+                              (sdata != NULL) ? (long long *) &sdata[1] : NULL, slen - 1,
+                              NULL, NULL, NULL, NULL, &elapsed2, -9);
+
+          if (sdata != NULL) {
+            (*env)->ReleaseLongArrayElements(env, e, sdata, 0);
+          }
+
+          if ((ret == 0) || (ret == -30)) {
+                                // copy results
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+          }
+
+          free(conb);
+
+        } else {
+          ret = -6;
+        }
+
+                            // unpin data elements
+        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
+
+      } else {
+        ret = -5;
+      }
+
+    } else {
+      ret = -4;
+    }
+  } else {
+    ret = -3;
+  }
+
+#ifdef GPUTIMING
+                     // set first (and single) array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+}  // Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1ex
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1direct
+  (JNIEnv *env, jclass jc, jobject b, jobject rf, jfloat eps, jint cluno, jint features,
+   jint cores, jint policy, jint job, jlongArray e ) {
+
+  short ret = 0;                              // return value
+
+  long long elapsed2 = 0;                // exclusive runtime
+
+  jlong blen, datalen;                   // capacities of the buffers
+
+                              // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                               // memory of the buffers (no copies)
+    unsigned short *dirb = (unsigned short *) oclwrap_direct(env, b, sizeof(unsigned short),
+                                                             &blen);
+    float *dirdata = (float *) oclwrap_direct(env, rf, sizeof(float), &datalen);
+
+    if ((dirb != NULL) && (dirdata != NULL)) {   // direct buffers?
+
+      if ((blen <= INT_MAX) && (features * blen == datalen)) {  // ...must match
+
+                                 // statistics of the workers requested?
+        jsize slen = (*env)->GetArrayLength(env, e);
+        jlong *sdata = (slen > 1) ? (*env)->GetLongArrayElements(env, e, NULL) : NULL;
+
+                                 // perform calculations, in place
+        ret = kmeans_jnirun(dirb, dirdata, (int) blen, eps, cluno, features,
+                            AGPUDM_ENGINE_PTHREADS, cores, policy, AGPUDM_STORE_FP32, job,
+                            (sdata != NULL) ? (long long *) &sdata[1] : NULL, slen - 1,
+                            NULL, NULL, NULL, NULL, &elapsed2, -9);
+
+        if (sdata != NULL) {
+          (*env)->ReleaseLongArrayElements(env, e, sdata, 0);
+        }
+
+      } else {
+        ret = -4;
+      }
+    } else {
+      ret = -5;
+    }
+  } else {
+    ret = -3;
+  }
+
+#ifdef GPUTIMING
+                     // set first array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+}  // Java_com_example_dmocl_kmeans_kmeans_1c_1phtreads_1direct
+
+
+
+/*!
+ \brief Copies the counters of a k-means search into a Java array
+ \details
+ Layout see Java_com_example_dmocl_kmeans_kmeans_1c_1stats.
+ \param s (out) the elements of the Java array
+ \param clen (in) length of the Java array
+ \param counters (in) the counters
+ \mt fully threadsafe
+ */
+void kmeans_jnistats(jlong *s, jsize clen, const struct agpudm_stats *counters) {
+
+  const jlong head[KMEANS_NSTATS] = { counters->iterations, counters->distances,
+                                      counters->reassignments, counters->clusters };
+
+  for (int i1 = 0; (i1 < KMEANS_NSTATS) && (i1 < clen); i1++) {
+    s[i1] = head[i1];
+  }
+
+                                // per-iteration values (as far as recorded)
+  for (int i1 = 0; (i1 < counters->ilen) && (i1 < counters->iterations); i1++) {
+
+    union {
+      float f;
+      jint i;
+    } disp;                      // bits of the displacement (Float.intBitsToFloat)
+
+    disp.f = counters->displacement[i1];
+
+    s[KMEANS_NSTATS + 2 * i1] = counters->moved[i1];
+    s[KMEANS_NSTATS + 2 * i1 + 1] = disp.i;
+  }
+
+} // kmeans_jnistats
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1stats
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint engine, jint cores, jint policy, jint storage, jint job, jlongArray e, jlongArray s) {
+
+  short ret = 0;                              // return value
+
+  long long elapsed2 = 0;                // exclusive runtime
+
+  struct agpudm_stats counters;          // counters of the search
+
+  memset(&counters, 0, sizeof(counters));
+
+                              // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                               // get the number of data array entries
+    jsize datalen = (*env)->GetArrayLength(env, rf);
+    jsize blen = (*env)->GetArrayLength(env, b);  // get the number of data elements
+    jsize clen = (*env)->GetArrayLength(env, s);  // number of counters requested
+
+                               // room for per-iteration values?
+    counters.ilen = (clen > KMEANS_NSTATS) ? (clen - KMEANS_NSTATS) / 2 : 0;
+
+    if (counters.ilen > 0) {
+      counters.displacement = (float *) malloc(sizeof(float) * counters.ilen);
+      counters.moved = (int *) malloc(sizeof(int) * counters.ilen);
+    }
+
+    if (features * blen != datalen) {   // ...these must match
+      ret = -4;
+
+    } else if ((counters.ilen > 0) &&
+               ((counters.displacement == NULL) || (counters.moved == NULL))) {
+      ret = -6;
+
+    } else {
+
+                                   // get float array elements and pin array
+      jfloat* condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {     // error?
+
+                 // allocate memory for the cluster center numbers (starts at a cache line)
+        unsigned short *conb = (unsigned short *) threadpool_alloc(sizeof(unsigned short) * blen);
+
+        if (conb != NULL) {                // malloc error?
+
+                                 // statistics of the workers requested?
+          jsize slen = (*env)->GetArrayLength(env, e);
+          jlong *sdata = (slen > 1) ? (*env)->GetLongArrayElements(env, e, NULL) : NULL;
+
+                                 // perform calculations
+          ret = kmeans_jnirun(conb, condata, blen, eps, cluno, features, engine, cores, policy,
+                              storage, job, (sdata != NULL) ? (long long *) &sdata[1] : NULL,
+                              slen - 1, &counters, NULL, NULL, NULL, &elapsed2, -9);
+
+          if (sdata != NULL) {
+            (*env)->ReleaseLongArrayElements(env, e, sdata, 0);
+          }
+
+          if ((ret == 0) || (ret == -30)) {
+                                // copy results
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+          }
+
+          free(conb);
+
+        } else {
+          ret = -6;
+        }
+
+                            // unpin data elements
+        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
+
+      } else {
+        ret = -5;
+      }
+    }
+
+                               // copy the counters
+    jlong *cdata = (clen > 0) ? (*env)->GetLongArrayElements(env, s, NULL) : NULL;
+
+    if (cdata != NULL) {
+      kmeans_jnistats(cdata, clen, &counters);
+      (*env)->ReleaseLongArrayElements(env, s, cdata, 0);
+    }
+
+    free(counters.displacement);
+    free(counters.moved);
+
+  } else {
+    ret = -3;
+  }
+
+#ifdef GPUTIMING
+                     // set first array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+}  // Java_com_example_dmocl_kmeans_kmeans_1c_1stats
+
+
+
+// see header file
+JNIEXPORT jshort JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1warm
+  (JNIEnv *env, jclass jc, jshortArray b, jfloatArray rf, jfloat eps, jint cluno, jint features,
+   jint engine, jint cores, jint policy, jint storage, jint job, jfloatArray init, jfloatArray c,
+   jdoubleArray in, jlongArray e) {
+
+  short ret = 0;                              // return value
+
+  long long elapsed2 = 0;                // exclusive runtime
+
+                              // check architecture
+  if ((sizeof(jshort) == sizeof(unsigned short)) && (sizeof(jfloat) == sizeof(float))) {
+
+                               // get the number of data array entries
+    jsize datalen = (*env)->GetArrayLength(env, rf);
+    jsize blen = (*env)->GetArrayLength(env, b);  // get the number of data elements
+    jsize clen = cluno * features;                // values of the cluster centers
+
+                               // ...these must match (the arrays of the centers are optional)
+    if ((features * blen == datalen) && (clen > 0) &&
+        ((init == NULL) || ((*env)->GetArrayLength(env, init) == clen)) &&
+        ((c == NULL) || ((*env)->GetArrayLength(env, c) == clen)) &&
+        ((in == NULL) || ((*env)->GetArrayLength(env, in) >= 1))) {
+
+                                   // get float array elements and pin array
+      jfloat* condata = (*env)->GetFloatArrayElements(env, rf, NULL);
+
+      if (condata != NULL) {     // error?
+
+                 // allocate memory for the cluster center numbers (starts at a cache line)
+        unsigned short *conb = (unsigned short *) threadpool_alloc(sizeof(unsigned short) * blen);
+
+                                 // copies of the initial and the final cluster centers
+        float *coninit = (init != NULL) ? (float *) malloc(sizeof(float) * clen) : NULL;
+        float *concent = (c != NULL) ? (float *) malloc(sizeof(float) * clen) : NULL;
+
+        if ((conb != NULL) && ((init == NULL) || (coninit != NULL)) &&
+            ((c == NULL) || (concent != NULL))) {      // malloc error?
+
+          if (coninit != NULL) {
+            (*env)->GetFloatArrayRegion(env, init, 0, clen, (jfloat *) coninit);
+          }
+
+                                 // statistics of the workers requested?
+          jsize slen = (*env)->GetArrayLength(env, e);
+          jlong *sdata = (slen > 1) ? (*env)->GetLongArrayElements(env, e, NULL) : NULL;
+
+          double inertia = 0;            // inertia of the final assignment
+
+                                 // perform calculations
+          ret = kmeans_jnirun(conb, condata, blen, eps, cluno, features, engine, cores, policy,
+                              storage, job, (sdata != NULL) ? (long long *) &sdata[1] : NULL,
+                              slen - 1, NULL, coninit, concent, (in != NULL) ? &inertia : NULL,
+                              &elapsed2, -9);
+
+          if (sdata != NULL) {
+            (*env)->ReleaseLongArrayElements(env, e, sdata, 0);
+          }
+
+          if ((ret == 0) || (ret == -30)) {
+                                // copy results
+            (*env)->SetShortArrayRegion(env, b, 0, blen, (jshort *) conb);
+          }
+
+          if (ret == 0) {       // centers and inertia of a finished search only
+            if (concent != NULL) {
+              (*env)->SetFloatArrayRegion(env, c, 0, clen, (jfloat *) concent);
+            }
+            if (in != NULL) {
+              (*env)->SetDoubleArrayRegion(env, in, 0, 1, (jdouble *) &inertia);
+            }
+          }
+
+        } else {
+          ret = -6;
+        }
+
+        free(concent);
+        free(coninit);
+        free(conb);
+
+                            // unpin data elements
+        (*env)->ReleaseFloatArrayElements( env, rf, condata, JNI_ABORT );
+
+      } else {
+        ret = -5;
+      }
+
+    } else {
+      ret = -4;
+    }
+  } else {
+    ret = -3;
+  }
+
+#ifdef GPUTIMING
+                     // set first array element
+  (*env)->SetLongArrayRegion(env, e, 0, 1, (jlong *) &elapsed2);
+#endif
+
+  return (ret);
+}  // Java_com_example_dmocl_kmeans_kmeans_1c_1warm
+
+
+
+// see header file
+JNIEXPORT jint JNICALL Java_com_example_dmocl_kmeans_kmeans_1c_1submit
+  (JNIEnv *env, jclass jc, jfloatArray rf, jfloat eps, jint cluno, jint features, jint engine,
+   jint cores, jint policy, jint storage, jlong timeoutms, jobject cb) {
+
+  jint ret = 0;                               // return value
+
+                               // get the number of data array entries
+  jsize datalen = (*env)->GetArrayLength(env, rf);
+
+  if ((features > 0) && (datalen > 0) && (datalen % features == 0)) {   // whole data items?
+
+    struct agpudm_config cfg;               // configuration of the job
+    struct agpudm *ctx;                     // the context
+
+    agpudm_config_default(&cfg);
+    cfg.engine = engine;
+    cfg.cores = cores;
+    cfg.policy = policy;
+    cfg.storage = storage;
+    cfg.timeoutms = timeoutms;
+
+    ret = agpudm_create(&cfg, &ctx);
+
+    if (ret == AGPUDM_OK) {
+
+      agpudm_donefn done;                   // completion function (if any)
+      void *donearg;
+
+      if (oclwrap_setcallback(env, cb, &done, &donearg) == 0) {
+
+        struct agpudm_kmeans_params p;      // parameters of the search
+
+        p.clusters = cluno;
+        p.eps = eps;
+        p.seed = 0;                       // initial centers from the clock
+
+                      // the only copy of the data items, taken over by the submission
+        float *condata = (float *) malloc(sizeof(float) * datalen);
+
+        if (condata != NULL) {
+          (*env)->GetFloatArrayRegion(env, rf, 0, datalen, (jfloat *) condata);
+        }
+
+        ret = (condata != NULL) ? agpudm_kmeans_adopt(ctx, condata, datalen / features, features,
+                                                      &p, done, donearg)
+                                : AGPUDM_ENOMEM;
+
+        if (ret <= 0) {                     // not submitted -> error codes of the scheduler
+          oclwrap_dropcallback(env, donearg);
+          ret = (ret == AGPUDM_ENOMEM) ? -6 : (ret == AGPUDM_EINVAL) ? JOBSCHED_EDESC
+                                                                     : JOBSCHED_ENOSTART;
+        }
+
+      } else {
+        ret = -5;
+      }
+
+      agpudm_destroy(ctx);
+
+    } else {
+      ret = (ret == AGPUDM_ENOMEM) ? -6 : JOBSCHED_EDESC;
+    }
+
+  } else {
+    ret = -4;
+  }
+
+  return (ret);
+
+}  // Java_com_example_dmocl_kmeans_kmeans_1c_1submit
+
+
+
+// see header file
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_kmeans_kmabort_1c(JNIEnv *env, jclass clazz) {
+  agpudm_cancel_all(AGPUDM_KMEANS);        // cancel all running and new searches
+}
+
+// see header file
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_kmeans_kmresume_1c(JNIEnv *env, jclass clazz) {
+  agpudm_resume_all(AGPUDM_KMEANS);      // allow new searches
+}
@@ -0,0 +1,631 @@
+/*!
+ \file kmstream.c
+ \brief Streaming k-means search
+ \details
+ Lloyd iterations over data items that are not resident (see agpudm_kmeans_stream). The data
+ items are read chunk by chunk in a fixed order, every pass from the first chunk again:
+ <ul>
+ <li>A read-ahead thread calls the reader for the next chunks while the workers process the
+ current one. It fills a ring of *prefetch* slots (one chunk each) and waits when the ring is
+ full.</li>
+ <li>The workers of the thread pool (work-stealing scheduler) assign the data items of a chunk
+ to their closest cluster center and add them to the sums of their participant (double, padded
+ to cache lines), so the chunk needs no synchronization apart from the end of the loop.</li>
+ <li>After a pass the sums are combined into the new cluster centers. The pass that follows
+ convergence only calculates the cluster numbers and hands them to the receiver.</li>
+ </ul>
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "agpudm_core.h"
+#include "jobctl.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+                              //! maximum number of cycles (as in kmeans_c.c)
+#define KMSTREAM_MAXCYCLES 100000
+
+
+                              //! The read-ahead ring
+struct kmstream_ring {
+                              //! protects the counters and the slots
+  pthread_mutex_t lock;
+                              //! signals a new chunk or a free slot
+  pthread_cond_t cond;
+                              //! memory of the slots (prefetch x chunk x features floats)
+  float* mem;
+                              //! data items of the slots (returned by the reader)
+  const float** items;
+                              //! first data item of the slots
+  long long* start;
+                              //! number of data items of the slots
+  int* count;
+                              //! number of slots
+  int slots;
+                              //! chunks read (sequence number of the next chunk)
+  long long produced;
+                              //! chunks processed
+  long long consumed;
+                              //! 1 = the reader has failed
+  int error;
+                              //! 1 = the search has ended, the thread must stop
+  int stop;
+                              //! (const) the reader
+  agpudm_readfn read;
+                              //! (const) argument of the reader
+  void* readarg;
+                              //! (const) number of data items
+  long long n;
+                              //! (const) data items per chunk
+  int chunk;
+                              //! (const) features per data item
+  int features;
+};
+
+                              //! Parameters of the loop over a chunk
+struct kmstream_pt {
+                              //! (const) data items of the chunk
+  const float* items;
+                              //! (out) cluster numbers of the chunk, NULL = not needed
+  unsigned short* labels;
+                              //! (const) the cluster centers
+  const float* clucent;
+                              //! (out) sums of the participants (see kmstream_sums)
+  char* sums;
+                              //! (const) bytes per participant in *sums*
+  size_t stride;
+                              //! (const) number of clusters
+  int cluno;
+                              //! (const) features per data item
+  int features;
+};
+
+
+
+/*!
+ \brief Returns the sums of a participant
+ \details
+ Per participant: *cluno* x *features* sums (double) followed by *cluno* cluster sizes.
+ \param pt (in) the parameters
+ \param part (in) number of the participant
+ \param size (out) the cluster sizes
+ \returns the sums
+ \mt fully threadsafe
+ */
+double* kmstream_sums( const struct kmstream_pt* pt, int part, long long** size ){
+
+  double* sum = (double*) (pt->sums + pt->stride * part);
+
+  *size = (long long*) (sum + (size_t) pt->cluno * pt->features);
+
+  return( sum );
+
+} // kmstream_sums
+
+
+
+/*!
+ \brief Chunk of the loop executed in parallel
+ \details
+ Assigns the data items to their closest cluster center and adds them to the sums of the
+ participant.
+ \param arg (in+out) the parameters (struct kmstream_pt)
+ \param part (in) number of the participant
+ \param start (in) first data item of the chunk
+ \param len (in) number of data items
+ */
+void kmstream_thread( void* arg, int part, int start, int len ){
+
+  const struct kmstream_pt* pt = (const struct kmstream_pt*) arg;
+  const int features = pt->features;
+
+  long long* size;
+  double* sum = kmstream_sums( pt, part, &size );
+
+  for (int i1 = start; i1 < start + len; i1++) {
+
+    const float* x = pt->items + (size_t) i1 * features;
+    float best = INFINITY;
+    int bi = 0;
+
+    for (int i2 = 0; i2 < pt->cluno; i2++) {
+
+      const float* c = pt->clucent + (size_t) i2 * features;
+      float d = 0;
+
+      for (int i3 = 0; i3 < features; i3++) {
+        d += (c[i3] - x[i3]) * (c[i3] - x[i3]);
+      }
+
+      if (d < best) {
+        best = d;
+        bi = i2;
+      }
+    }
+
+    for (int i3 = 0; i3 < features; i3++) {
+      sum[(size_t) bi * features + i3] += x[i3];
+    }
+    size[bi]++;
+
+    if (pt->labels != NULL) {
+      pt->labels[i1] = (unsigned short) bi;
+    }
+  }
+
+} // kmstream_thread
+
+
+
+/*!
+ \brief The read-ahead thread
+ \details
+ Reads the chunks in order (after the last chunk the first one again) into the free slots of
+ the ring until the search stops it or the reader fails.
+ \param arg (in+out) the ring
+ \returns NULL
+ */
+void* kmstream_reader( void* arg ){
+
+  struct kmstream_ring* r = (struct kmstream_ring*) arg;
+  const long long nchunks = (r->n + r->chunk - 1) / r->chunk;
+
+  for (long long seq = 0; ; seq++) {
+
+    pthread_mutex_lock( &r->lock );
+
+    while ((r->stop == 0) && (r->produced - r->consumed >= r->slots)) {   // ring full
+      pthread_cond_wait( &r->cond, &r->lock );
+    }
+
+    const int stop = r->stop;
+
+    pthread_mutex_unlock( &r->lock );
+
+    if (stop != 0) {
+      break;
+    }
+
+    const int slot = (int) (seq % r->slots);
+    const long long start = (seq % nchunks) * r->chunk;
+    const int count = (int) ((r->n - start < r->chunk) ? r->n - start : r->chunk);
+
+    const long long tr = trace_begin();
+    const float* items = r->read( r->readarg, start, count,
+                                  r->mem + (size_t) slot * r->chunk * r->features );
+    trace_end( TRACE_IO, "read chunk", tr, start );
+
+    pthread_mutex_lock( &r->lock );
+
+    r->items[slot] = items;
+    r->start[slot] = start;
+    r->count[slot] = count;
+
+    if (items == NULL) {
+      r->error = 1;
+    } else {
+      r->produced++;
+    }
+
+    pthread_cond_broadcast( &r->cond );
+    pthread_mutex_unlock( &r->lock );
+
+    if (items == NULL) {
+      break;
+    }
+  }
+
+  return( NULL );
+
+} // kmstream_reader
+
+
+
+/*!
+ \brief Waits for the next chunk of the ring
+ \param r (in+out) the ring
+ \returns the slot of the chunk, -1 = the reader has failed
+ \mt the thread of the search
+ */
+int kmstream_take( struct kmstream_ring* r ){
+
+  int slot = -1;
+
+  pthread_mutex_lock( &r->lock );
+
+  while ((r->error == 0) && (r->produced == r->consumed)) {
+    pthread_cond_wait( &r->cond, &r->lock );
+  }
+
+  if (r->produced > r->consumed) {     // chunks read before an error are still valid
+    slot = (int) (r->consumed % r->slots);
+  }
+
+  pthread_mutex_unlock( &r->lock );
+
+  return( slot );
+
+} // kmstream_take
+
+
+
+/*!
+ \brief Releases the slot of the processed chunk
+ \param r (in+out) the ring
+ \mt the thread of the search
+ */
+void kmstream_release( struct kmstream_ring* r ){
+
+  pthread_mutex_lock( &r->lock );
+  r->consumed++;
+  pthread_cond_broadcast( &r->cond );
+  pthread_mutex_unlock( &r->lock );
+
+} // kmstream_release
+
+
+
+/*!
+ \brief Selects the initial cluster centers
+ \details
+ Reads the data items kmeans_seed would select for the same seed (n <= RAND_MAX, otherwise two
+ random numbers per data item).
+ \param r (in) the ring (reader, no read-ahead yet)
+ \param clucent (out) the cluster centers
+ \param cluno (in) number of clusters
+ \param seed (in) the seed, 0 = taken from the clock
+ \returns 0 = no error, -10 = read error
+ \mt the thread of the search
+ */
+int kmstream_seed( struct kmstream_ring* r, float* clucent, int cluno, unsigned int seed ){
+
+  unsigned int state = (seed != 0) ? seed : (unsigned int) time( NULL );
+
+  for (int i1 = 0; i1 < cluno; i1++) {
+
+    long long cluxi;
+
+    if (r->n - 1 <= RAND_MAX) {
+      cluxi = rand_lim( (int) (r->n - 1), &state );
+    } else {
+      const long long hi = rand_r( &state );
+      cluxi = ((hi << 31) ^ rand_r( &state )) % r->n;
+    }
+
+    const float* x = r->read( r->readarg, cluxi, 1, r->mem );
+
+    if (x == NULL) {
+      return( -10 );
+    }
+
+    memcpy( clucent + (size_t) i1 * r->features, x, sizeof(float) * r->features );
+  }
+
+  return( 0 );
+
+} // kmstream_seed
+
+
+
+/*!
+ \brief Lloyd iterations over the chunks of the ring
+ \param r (in+out) the ring (read-ahead thread running)
+ \param sched (in+out) the scheduler
+ \param pt (in+out) parameters of the loop (sums allocated)
+ \param clucent (in+out) the cluster centers
+ \param lab (out) cluster numbers of a chunk (chunk values), NULL = no receiver
+ \param s (in) the receiver of the cluster numbers
+ \param eps (in) maximum displacement of the cluster centers
+ \param job (in) the job
+ \param counters (in+out) counters of the search, NULL = not needed
+ \returns 0 = no error, -10 = read error, -11 = receiver failed, -30 = cancelled
+ \mt the thread of the search
+ */
+short kmstream_run( struct kmstream_ring* r, struct threadpool_sched* sched,
+                    struct kmstream_pt* pt, float* clucent, unsigned short* lab,
+                    const struct agpudm_stream_params* s, float eps, struct jobctl* job,
+                    struct agpudm_stats* counters ){
+
+  const int cluno = pt->cluno;
+  const int features = pt->features;
+  const long long nchunks = (r->n + r->chunk - 1) / r->chunk;
+
+  short ret = 0;
+  int final = 0;                       // 1 = pass of the cluster numbers
+
+  for (int cycles = 0; ret == 0; cycles++) {
+
+    const long long tr = trace_begin();
+
+    memset( pt->sums, 0, pt->stride * sched->parts );
+    pt->labels = (final != 0) ? lab : NULL;
+
+    for (long long c = 0; (c < nchunks) && (ret == 0); c++) {
+
+      const int slot = kmstream_take( r );
+
+      if (slot < 0) {
+        ret = -10;
+        break;
+      }
+
+      pt->items = r->items[slot];
+
+      threadpool_sched_submit( sched, &kmstream_thread, pt, r->count[slot] );
+      threadpool_sched_wait( sched );
+
+      if ((final != 0) && (s->labels( s->labelarg, r->start[slot], r->count[slot], lab ) != 0)) {
+        ret = -11;
+      }
+
+      kmstream_release( r );
+
+      if (jobctl_check( job ) != JOBCTL_RUNNING) {  // cancelled or deadline passed?
+        ret = -30;
+      }
+    }
+
+    if ((ret != 0) || (final != 0)) {
+      break;
+    }
+
+    long long* size0;
+    double* sum0 = kmstream_sums( pt, 0, &size0 );
+
+    for (int p = 1; p < sched->parts; p++) {   // combine the participants
+
+      long long* size;
+      const double* sum = kmstream_sums( pt, p, &size );
+
+      for (size_t i1 = 0; i1 < (size_t) cluno * features; i1++) {
+        sum0[i1] += sum[i1];
+      }
+      for (int i1 = 0; i1 < cluno; i1++) {
+        size0[i1] += size[i1];
+      }
+    }
+
+    float newdist = 0;                 // displacement of the cluster centers
+    int nonempty = 0;
+
+    for (int i1 = 0; i1 < cluno; i1++) {
+
+      if (size0[i1] == 0) {            // empty cluster: keeps its center
+        continue;
+      }
+
+      float newdist2 = 0;
+
+      for (int i2 = 0; i2 < features; i2++) {
+        const float v = (float) (sum0[(size_t) i1 * features + i2] / (double) size0[i1]);
+        const float d = clucent[(size_t) i1 * features + i2] - v;
+        newdist2 += d * d;
+        clucent[(size_t) i1 * features + i2] = v;
+      }
+
+      newdist += sqrtf( newdist2 );
+      nonempty++;
+    }
+
+    if (counters != NULL) {
+      counters->iterations++;
+      counters->distances += r->n * cluno;
+      counters->clusters = nonempty;
+      if ((counters->displacement != NULL) && (cycles < counters->ilen)) {
+        counters->displacement[cycles] = newdist;
+      }
+      if ((counters->moved != NULL) && (cycles < counters->ilen)) {
+        counters->moved[cycles] = 0;   // not counted (no label array)
+      }
+    }
+
+    trace_end( TRACE_ALGO, "kmeans stream cycle", tr, cycles );
+
+    if ((newdist <= eps) || (cycles > KMSTREAM_MAXCYCLES)) {
+      if (lab == NULL) {
+        break;
+      }
+      final = 1;                       // one more pass for the cluster numbers
+    }
+  }
+
+  return( ret );
+
+} // kmstream_run
+
+
+
+/*!
+ \brief Translates the result code of the streaming search
+ \param code (in) result code of kmstream_run or of the set up
+ \returns AGPUDM_OK or an error code
+ \mt fully threadsafe
+ */
+int kmstream_status( int code ){
+
+  switch (code) {
+    case 0:
+      return( AGPUDM_OK );
+    case -30:
+      return( AGPUDM_ECANCELLED );
+    case -7:
+    case -8:
+      return( AGPUDM_ENOSTART );
+    case -9:
+      return( AGPUDM_ENOMEM );
+    case -10:
+    case -11:
+      return( AGPUDM_EIO );
+  }
+
+  return( AGPUDM_EENGINE );
+
+} // kmstream_status
+
+
+
+// see header file for details
+int agpudm_kmeans_stream( struct agpudm* ctx, long long n, int features,
+                          const struct agpudm_kmeans_params* p,
+                          const struct agpudm_stream_params* s, int job, float* centers,
+                          struct agpudm_result* res ){
+
+  if ((ctx == NULL) || (p == NULL) || (s == NULL) || (s->read == NULL) || (n <= 0) ||
+      (features <= 0) || (p->clusters <= 0) || (p->clusters > 0xFFFF)) {
+    agpudm_setresult( res, AGPUDM_EINVAL, -4, (ctx != NULL) ? ctx->cfg.engine : 0, 0, 0 );
+    return( AGPUDM_EINVAL );
+  }
+
+  const int chunk = (int) ((s->chunk > 0) ? ((s->chunk < n) ? s->chunk : n) :
+                           ((AGPUDM_STREAM_CHUNK < n) ? AGPUDM_STREAM_CHUNK : n));
+  const int slots = (s->prefetch > 0) ? s->prefetch : AGPUDM_STREAM_PREFETCH;
+  const int engine = (ctx->cfg.engine == AGPUDM_ENGINE_SINGLE) ? AGPUDM_ENGINE_SINGLE :
+                     AGPUDM_ENGINE_PTHREADS;
+  const int cores = (engine == AGPUDM_ENGINE_SINGLE) ? 1 : agpudm_cores( ctx );
+
+  if ((size_t) chunk * features > SIZE_MAX / sizeof(float) / slots) {
+    agpudm_setresult( res, AGPUDM_EINVAL, -4, engine, 0, 0 );
+    return( AGPUDM_EINVAL );
+  }
+
+  struct jobctl* jobp = agpudm_attach( ctx, job, JOBCTL_KMEANS );
+
+  if (jobp == NULL) {
+    const int err = (job != 0) ? AGPUDM_ENOJOB : AGPUDM_ENOSTART;
+    agpudm_setresult( res, err, -31, engine, 0, 0 );
+    return( err );
+  }
+
+  struct agpudm_stats* counters = (res != NULL) ? res->stats : NULL;
+  agpudm_clearstats( counters );
+
+  struct timespec t0, t1;
+  clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+  short code = 0;
+
+  struct kmstream_ring r;
+  struct kmstream_pt pt;
+
+  memset( &r, 0, sizeof(r) );
+  r.read = s->read;
+  r.readarg = s->readarg;
+  r.n = n;
+  r.chunk = chunk;
+  r.features = features;
+  r.slots = slots;
+  r.mem = (float*) threadpool_alloc( sizeof(float) * (size_t) chunk * features * slots );
+  r.items = (const float**) malloc( sizeof(const float*) * slots );
+  r.start = (long long*) malloc( sizeof(long long) * slots );
+  r.count = (int*) malloc( sizeof(int) * slots );
+
+  float* clucent = (float*) malloc( sizeof(float) * (size_t) p->clusters * features );
+  unsigned short* lab = (s->labels != NULL) ?
+                        (unsigned short*) threadpool_alloc( sizeof(unsigned short) * chunk ) :
+                        NULL;
+
+  pt.cluno = p->clusters;
+  pt.features = features;
+  pt.clucent = clucent;
+  pt.stride = sizeof(double) * (size_t) p->clusters * features +
+              sizeof(long long) * (size_t) p->clusters;
+  pt.stride = (pt.stride + THREADPOOL_CACHELINE - 1) / THREADPOOL_CACHELINE *
+              THREADPOOL_CACHELINE;                    // participants on own cache lines
+  pt.sums = NULL;
+
+  if ((r.mem == NULL) || (r.items == NULL) || (r.start == NULL) || (r.count == NULL) ||
+      (clucent == NULL) || ((s->labels != NULL) && (lab == NULL))) {
+    code = -9;
+  } else {
+    code = kmstream_seed( &r, clucent, p->clusters, p->seed );
+  }
+
+  struct threadpool_sched sched;
+
+  if (code == 0) {
+
+    if (threadpool_sched_init( &sched, cores, ctx->cfg.policy ) == 0) {
+
+      threadpool_sched_align( &sched, sizeof(unsigned short) );   // cluster numbers
+
+      pt.sums = (char*) threadpool_alloc( pt.stride * sched.parts );
+
+      if (pt.sums == NULL) {
+        code = -9;
+      } else if (threadpool_reserve( cores ) <= 0) {
+        code = -8;
+      } else {
+
+        threadpool_setpolicy( ctx->cfg.policy );
+
+        pthread_t reader;
+
+        pthread_mutex_init( &r.lock, NULL );
+        pthread_cond_init( &r.cond, NULL );
+
+        if (pthread_create( &reader, NULL, &kmstream_reader, &r ) == 0) {
+
+          code = kmstream_run( &r, &sched, &pt, clucent, lab, s, p->eps, jobp, counters );
+
+          pthread_mutex_lock( &r.lock );         // stop the read-ahead
+          r.stop = 1;
+          pthread_cond_broadcast( &r.cond );
+          pthread_mutex_unlock( &r.lock );
+
+          pthread_join( reader, NULL );
+
+        } else {
+          code = -8;
+        }
+
+        pthread_cond_destroy( &r.cond );
+        pthread_mutex_destroy( &r.lock );
+      }
+
+                         // statistics of the workers (if requested)
+      if ((res != NULL) && (res->workers != NULL) && (res->wlen > 0)) {
+        threadpool_sched_stats( &sched, res->workers, res->wlen );
+      }
+
+      threadpool_sched_destroy( &sched );
+
+    } else {
+      code = -7;
+    }
+  }
+
+  if ((code == 0) && (centers != NULL)) {
+    memcpy( centers, clucent, sizeof(float) * (size_t) p->clusters * features );
+  }
+
+  free( pt.sums );
+  free( lab );
+  free( clucent );
+  free( r.count );
+  free( r.start );
+  free( r.items );
+  free( r.mem );
+
+  jobctl_detach( jobp );
+
+  clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+  const int ret = kmstream_status( code );
+
+  agpudm_setresult( res, ret, code, engine, cores,
+                    (t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec) );
+
+  return( ret );
+
+} // agpudm_kmeans_stream
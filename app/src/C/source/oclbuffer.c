@@ -0,0 +1,278 @@
+/*!
+ \file oclbuffer.c
+ \brief OpenCL buffer strategy layer
+ \details
+ This file implements the zero copy (map/unmap) and the explicit copy (read/write) strategy
+ for OpenCL buffers. The strategy is selected per device; the GPU engines access their buffers
+ only through this layer. All transfers can be enqueued non-blocking with event dependencies,
+ so that they also work on out-of-order command queues.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "oclbuffer.h"
+#include <stdlib.h>
+
+
+// see header file for details
+int oclbuf_strategy( cl_device_id dev ){
+
+  cl_bool unified = CL_FALSE;                // host and device share their memory?
+
+  cl_int err = clGetDeviceInfo( dev, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool),
+                                &unified, NULL );
+
+  if ((err == CL_SUCCESS) && (unified == CL_TRUE)) {
+    return( OCLBUF_MAP );                    // yes -> map driver allocated memory
+  }
+
+  return( OCLBUF_COPY );                     // no (or unknown) -> explicit copies
+
+} // oclbuf_strategy
+
+
+
+// see header file for details
+cl_int oclbuf_create( struct oclbuf* buf, cl_context context, cl_mem_flags flags, size_t size,
+                      void* host, int mode ){
+
+  cl_int err = CL_SUCCESS;
+
+  const int inplace = mode & OCLBUF_INPLACE;      // host array backs the buffer?
+  mode &= ~OCLBUF_INPLACE;
+
+  buf->mem = NULL;                           // initialize struct
+  buf->host = NULL;
+  buf->size = size;
+  buf->mode = mode;
+  buf->ownhost = 0;
+  buf->mapflags = 0;
+  buf->mapped = NULL;
+
+  if ((mode == OCLBUF_MAP) && (inplace != 0) && (host != NULL)) {
+
+                                 // the device works on the host array, the mappings return it
+    buf->mem = clCreateBuffer( context, flags | CL_MEM_USE_HOST_PTR, size, host, &err );
+
+  } else if (mode == OCLBUF_MAP) {
+
+                                 // let the driver allocate host accessible memory
+    flags |= CL_MEM_ALLOC_HOST_PTR;
+
+    if (host != NULL) {
+      flags |= CL_MEM_COPY_HOST_PTR;         // copy initial content once
+    }
+
+    buf->mem = clCreateBuffer( context, flags, size, host, &err );
+
+  } else {
+
+    if (host != NULL) {
+                                 // the host array backs the buffer
+      buf->mem = clCreateBuffer( context, flags | CL_MEM_USE_HOST_PTR, size, host, &err );
+      buf->host = host;
+
+    } else {
+                                 // device buffer + host array for the copies
+      buf->host = malloc( size );
+
+      if (buf->host != NULL) {
+        buf->ownhost = 1;
+        buf->mem = clCreateBuffer( context, flags, size, NULL, &err );
+      } else {
+        err = CL_OUT_OF_HOST_MEMORY;
+      }
+    }
+  }
+
+  if (buf->mem == NULL) {                    // error?
+
+    if (err == CL_SUCCESS) {
+      err = CL_OUT_OF_RESOURCES;             // library not loaded
+    }
+
+    if (buf->ownhost == 1) {                 // clean up
+      free( buf->host );
+      buf->host = NULL;
+      buf->ownhost = 0;
+    }
+  }
+
+  return( err );
+
+} // oclbuf_create
+
+
+
+// see header file for details
+void* oclbuf_enqueue_map( cl_command_queue commands, struct oclbuf* buf, cl_map_flags flags,
+                          cl_bool blocking, cl_uint nwait, const cl_event* wait, cl_event* event,
+                          cl_int* err ){
+
+  *err = CL_SUCCESS;
+
+  if (buf->mode == OCLBUF_MAP) {
+
+                                 // map the buffer
+    buf->mapped = clEnqueueMapBuffer( commands, buf->mem, blocking, flags, 0, buf->size, nwait,
+                                      wait, event, err );
+
+    if ((buf->mapped == NULL) && (*err == CL_SUCCESS)) {
+      *err = CL_OUT_OF_RESOURCES;            // library not loaded
+    }
+
+  } else {
+
+    if ((flags & CL_MAP_READ) != 0) {        // fetch content from device
+      *err = clEnqueueReadBuffer( commands, buf->mem, blocking, 0, buf->size, buf->host, nwait,
+                                  wait, event );
+
+    } else if (event != NULL) {              // nothing to copy, but caller needs an event
+      *err = clEnqueueMarkerWithWaitList( commands, nwait, wait, event );
+
+      if ((*err == CL_SUCCESS) && (blocking == CL_TRUE)) {
+        *err = clWaitForEvents( 1, event );
+      }
+
+    } else if ((nwait > 0) && (blocking == CL_TRUE)) {
+      *err = clWaitForEvents( nwait, wait ); // device must not use the buffer any more
+    }
+
+    if (*err == CL_SUCCESS) {
+      buf->mapped = buf->host;
+    } else {
+      buf->mapped = NULL;
+    }
+  }
+
+  if (buf->mapped != NULL) {
+    buf->mapflags = flags;                   // remember access for unmap
+  }
+
+  return( buf->mapped );
+
+} // oclbuf_enqueue_map
+
+
+
+// see header file for details
+void* oclbuf_map( cl_command_queue commands, struct oclbuf* buf, cl_map_flags flags,
+                  cl_int* err ){
+
+  return( oclbuf_enqueue_map( commands, buf, flags, CL_TRUE, 0, NULL, NULL, err ) );
+
+} // oclbuf_map
+
+
+
+// see header file for details
+cl_int oclbuf_enqueue_unmap( cl_command_queue commands, struct oclbuf* buf, cl_uint nwait,
+                             const cl_event* wait, cl_event* event ){
+
+  cl_int err = CL_SUCCESS;
+
+  if (buf->mapped != NULL) {                 // mapped at all?
+
+    if (buf->mode == OCLBUF_MAP) {
+
+      err = clEnqueueUnmapMemObject( commands, buf->mem, buf->mapped, nwait, wait, event );
+
+    } else {
+                                 // write back if the host may have changed the content
+      if ((buf->mapflags & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION)) != 0) {
+        err = clEnqueueWriteBuffer( commands, buf->mem, CL_FALSE, 0, buf->size, buf->host,
+                                    nwait, wait, event );
+
+      } else if (event != NULL) {            // nothing to copy, but caller needs an event
+        err = clEnqueueMarkerWithWaitList( commands, nwait, wait, event );
+      }
+    }
+
+    buf->mapped = NULL;
+    buf->mapflags = 0;
+
+  } else if (event != NULL) {                // not mapped, but caller needs an event
+    err = clEnqueueMarkerWithWaitList( commands, nwait, wait, event );
+  }
+
+  return( err );
+
+} // oclbuf_enqueue_unmap
+
+
+
+// see header file for details
+cl_int oclbuf_unmap( cl_command_queue commands, struct oclbuf* buf ){
+
+  cl_event ev = NULL;                        // wait until the device has the content
+
+  cl_int err = oclbuf_enqueue_unmap( commands, buf, 0, NULL, &ev );
+
+  if (err == CL_SUCCESS) {
+    err = clWaitForEvents( 1, &ev );
+  }
+
+  oclbuf_release_event( &ev );
+
+  return( err );
+
+} // oclbuf_unmap
+
+
+
+// see header file for details
+cl_command_queue oclbuf_create_queue( cl_context context, cl_device_id dev, cl_int* err ){
+
+  cl_command_queue_properties qprop = 0;     // properties supported by the device
+  cl_command_queue commands = NULL;
+
+  *err = clGetDeviceInfo( dev, CL_DEVICE_QUEUE_PROPERTIES, sizeof(cl_command_queue_properties),
+                          &qprop, NULL );
+
+  if ((*err == CL_SUCCESS) && ((qprop & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0)) {
+
+                                 // try an out-of-order queue first
+    commands = clCreateCommandQueue( context, dev, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, err );
+  }
+
+  if (commands == NULL) {                    // not supported -> in-order queue
+    commands = clCreateCommandQueue( context, dev, 0, err );
+  }
+
+  return( commands );
+
+} // oclbuf_create_queue
+
+
+
+// see header file for details
+void oclbuf_release_event( cl_event* event ){
+
+  if (*event != NULL) {
+    clReleaseEvent( *event );
+    *event = NULL;
+  }
+
+} // oclbuf_release_event
+
+
+
+// see header file for details
+void oclbuf_release( struct oclbuf* buf ){
+
+  if (buf->mem != NULL) {
+    clReleaseMemObject( buf->mem );          // release OpenCL buffer
+    buf->mem = NULL;
+  }
+
+  if (buf->ownhost == 1) {                   // release own host array
+    free( buf->host );
+    buf->ownhost = 0;
+  }
+
+  buf->host = NULL;
+
+} // oclbuf_release
@@ -0,0 +1,341 @@
+/*!
+ \file oclstore.c
+ \brief Reduced precision storage of the data items on the GPU
+ \details
+ This file implements the conversion of the data items to half precision and to 8 bit
+ quantized values, the error bounds of the conversions and the device buffers.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "oclstore.h"
+#include <stdlib.h>
+#include <math.h>
+
+
+                              //! largest value that can be represented in half precision
+#define HALFMAX 65504.0f
+
+
+/*!
+ \brief Converts a float to half precision
+ \details
+ Rounds to the nearest half precision value. Values beyond the half precision range become
+ infinity.
+ \param f (in) the value
+ \returns the value in half precision
+ \mt fully threadsafe
+ */
+cl_half oclstore_tohalf( cl_float f ){
+
+  union { cl_float f; cl_uint u; } v;        // access to the bits
+  v.f = f;
+
+  cl_uint sign = (v.u >> 16) & 0x8000;       // sign bit at half position
+  cl_uint absu = v.u & 0x7fffffff;           // bits of the absolute value
+
+  if (absu >= 0x7f800000) {                  // infinity or nan?
+    return( (cl_half) (sign | 0x7c00 | ((absu > 0x7f800000) ? 0x200 : 0)) );
+  }
+
+  if (absu >= 0x477ff000) {                  // rounds beyond 65504 -> infinity
+    return( (cl_half) (sign | 0x7c00) );
+  }
+
+  if (absu < 0x38800000) {                   // below 2^-14 -> subnormal half
+                                 // subnormal unit is 2^-24 (1024 = smallest normal)
+    const cl_float a = fabsf( f ) * 16777216.0f;    // exact
+    cl_uint q = (cl_uint) a;
+    const cl_float r = a - (cl_float) q;
+
+    if ((r > 0.5f) || ((r == 0.5f) && ((q & 1) != 0))) {
+      q++;                                   // round to nearest even
+    }
+
+    return( (cl_half) (sign | q) );
+  }
+
+                                 // rebias the exponent (127 -> 15) and drop 13 mantissa bits
+  cl_uint h = (absu - 0x38000000) >> 13;
+  cl_uint rem = absu & 0x1fff;
+
+  if ((rem > 0x1000) || ((rem == 0x1000) && ((h & 1) != 0))) {
+    h++;                                     // round to nearest even (carry is correct)
+  }
+
+  return( (cl_half) (sign | h) );
+
+} // oclstore_tohalf
+
+
+
+// see header file for details
+cl_int oclstore_convert( struct oclstore* st, const cl_float* data, int blen, int features,
+                         int mode ){
+
+  const size_t n = (size_t) blen * features;     // number of floats
+
+  st->mode = OCLSTORE_FP32;                  // initialize struct
+  st->src = data;
+  st->host = (void*) data;
+  st->size = sizeof(cl_float) * n;
+  st->srcsize = sizeof(cl_float) * n;
+  st->qparam = NULL;
+  st->features = features;
+  st->maxerr = 0;
+  st->data_g.mem = NULL;
+  st->exact_g.mem = NULL;
+  st->qparam_g = NULL;
+
+  if ((mode != OCLSTORE_FP16) && (mode != OCLSTORE_INT8)) {
+    return( CL_SUCCESS );                    // single precision -> nothing to do
+  }
+
+  cl_float* fmin = (cl_float*) malloc( sizeof(cl_float) * 2 * features );   // range per feature
+
+  if (fmin == NULL) {                        // malloc error?
+    return( CL_OUT_OF_HOST_MEMORY );
+  }
+
+  cl_float* fmax = fmin + features;
+
+  for (int i2 = 0; i2 < features; i2++) {    // initialize range
+    fmin[i2] = INFINITY;
+    fmax[i2] = -INFINITY;
+  }
+
+  for (size_t i1 = 0; i1 < n; i1++) {        // determine range of each feature
+
+    const int i2 = (int) (i1 % features);
+
+    if (data[i1] < fmin[i2]) {
+      fmin[i2] = data[i1];
+    }
+
+    if (data[i1] > fmax[i2]) {
+      fmax[i2] = data[i1];
+    }
+  }
+
+  double err2 = 0;                           // sum of the squared errors per feature
+
+  if (mode == OCLSTORE_FP16) {
+
+    int fits = 1;                            // representable in half precision?
+
+    for (int i2 = 0; i2 < features; i2++) {
+
+      const cl_float maxabs = fmaxf( fabsf( fmin[i2] ), fabsf( fmax[i2] ) );
+
+      if (!(maxabs <= HALFMAX)) {            // also catches nan
+        fits = 0;
+      }
+                                 // relative rounding error 2^-11, absolute 2^-25 (subnormal)
+      const double e = maxabs * (1.0 / 2048.0) + (1.0 / 33554432.0);
+      err2 += e * e;
+    }
+
+    if (fits == 1) {
+
+      cl_half* h = (cl_half*) malloc( sizeof(cl_half) * n );
+
+      if (h == NULL) {                       // malloc error?
+        free( fmin );
+        return( CL_OUT_OF_HOST_MEMORY );
+      }
+
+      for (size_t i1 = 0; i1 < n; i1++) {    // convert
+        h[i1] = oclstore_tohalf( data[i1] );
+      }
+
+      st->mode = OCLSTORE_FP16;
+      st->host = h;
+      st->size = sizeof(cl_half) * n;
+    }
+
+  } else {
+
+    cl_float* qp = (cl_float*) malloc( sizeof(cl_float) * 2 * features );
+    cl_char* q = (cl_char*) malloc( sizeof(cl_char) * n );
+
+    if ((qp == NULL) || (q == NULL)) {       // malloc error?
+      free( qp );
+      free( q );
+      free( fmin );
+      return( CL_OUT_OF_HOST_MEMORY );
+    }
+
+    for (int i2 = 0; i2 < features; i2++) {
+
+      cl_float scale = (fmax[i2] - fmin[i2]) / 255.0f;   // 256 steps over the range
+
+      if (!(scale > 0)) {                    // constant feature
+        scale = 0;
+      }
+                                 // x = (q + 128) * scale + min = q * scale + offset
+      qp[2 * i2] = scale;
+      qp[2 * i2 + 1] = fmin[i2] + 128.0f * scale;
+
+                                 // half a step plus the rounding of the dequantization
+      const cl_float maxabs = fmaxf( fabsf( fmin[i2] ), fabsf( fmax[i2] ) );
+      const double e = 0.5 * scale + (maxabs + 256.0 * scale) * (1.0 / 1048576.0);
+      err2 += e * e;
+    }
+
+    for (size_t i1 = 0; i1 < n; i1++) {     // quantize
+
+      const int i2 = (int) (i1 % features);
+      int qi = 0;
+
+      if (qp[2 * i2] > 0) {
+        qi = (int) floorf( (data[i1] - fmin[i2]) / qp[2 * i2] + 0.5f );
+      }
+
+      if (qi < 0) {                          // clamp
+        qi = 0;
+      } else if (qi > 255) {
+        qi = 255;
+      }
+
+      q[i1] = (cl_char) (qi - 128);
+    }
+
+    st->mode = OCLSTORE_INT8;
+    st->host = q;
+    st->size = sizeof(cl_char) * n;
+    st->qparam = qp;
+  }
+
+  if (st->mode != OCLSTORE_FP32) {           // converted?
+    st->maxerr = (cl_float) (sqrt( err2 ) * (1.0 + 1e-5));
+  }
+
+  free( fmin );
+
+  return( CL_SUCCESS );
+
+} // oclstore_convert
+
+
+
+// see header file for details
+const char* oclstore_options( const struct oclstore* st ){
+
+  if (st->mode == OCLSTORE_FP16) {
+    return( "-D DSTORE=1" );
+  }
+
+  if (st->mode == OCLSTORE_INT8) {
+    return( "-D DSTORE=2" );
+  }
+
+  return( "-D DSTORE=0" );
+
+} // oclstore_options
+
+
+
+// see header file for details
+cl_int oclstore_create( struct oclstore* st, cl_context context, int bufmode, int exact ){
+
+                                 // converted data items
+  cl_int err = oclbuf_create( &st->data_g, context, CL_MEM_READ_ONLY, st->size, st->host,
+                              bufmode );
+
+  if ((err == CL_SUCCESS) && (exact == 1) && (st->mode != OCLSTORE_FP32)) {
+
+                                 // original data items for the rechecks
+    err = oclbuf_create( &st->exact_g, context, CL_MEM_READ_ONLY, st->srcsize,
+                         (void*) st->src, bufmode );
+  }
+
+  if ((err == CL_SUCCESS) && (st->qparam != NULL)) {
+
+                                 // quantization parameters
+    st->qparam_g = clCreateBuffer( context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                   sizeof(cl_float) * 2 * st->features, st->qparam, &err );
+
+    if ((st->qparam_g == NULL) && (err == CL_SUCCESS)) {
+      err = CL_OUT_OF_RESOURCES;             // library not loaded
+    }
+  }
+
+  if (err != CL_SUCCESS) {                   // clean up
+    oclstore_release( st );
+  }
+
+  return( err );
+
+} // oclstore_create
+
+
+
+// see header file for details
+cl_mem oclstore_exact( const struct oclstore* st ){
+
+  if (st->exact_g.mem != NULL) {
+    return( st->exact_g.mem );
+  }
+
+  return( st->data_g.mem );
+
+} // oclstore_exact
+
+
+
+// see header file for details
+void oclstore_bounds( const struct oclstore* st, cl_float eps, cl_float* lo, cl_float* hi ){
+
+                                 // the difference of two items is off by at most 2*maxerr
+  const cl_float e = 2.0f * st->maxerr;
+                                 // rounding of the single precision sums
+  const cl_float slack = 1e-5f * (1 + st->features);
+
+  *hi = (eps + e) * (eps + e) * (1.0f + slack);
+
+  if (eps > e) {
+    *lo = (eps - e) * (eps - e) * (1.0f - slack);
+  } else {
+    *lo = -1;                                // nothing is certainly inside
+  }
+
+} // oclstore_bounds
+
+
+
+// see header file for details
+void oclstore_release( struct oclstore* st ){
+
+  if (st->qparam_g != NULL) {
+    clReleaseMemObject( st->qparam_g );
+    st->qparam_g = NULL;
+  }
+
+  if (st->exact_g.mem != NULL) {
+    oclbuf_release( &st->exact_g );
+  }
+
+  if (st->data_g.mem != NULL) {
+    oclbuf_release( &st->data_g );
+  }
+
+} // oclstore_release
+
+
+
+// see header file for details
+void oclstore_free( struct oclstore* st ){
+
+  if (st->host != (void*) st->src) {         // converted copy?
+    free( st->host );
+  }
+
+  free( st->qparam );
+
+  st->host = (void*) st->src;
+  st->qparam = NULL;
+
+} // oclstore_free
@@ -0,0 +1,452 @@
+/*!
+ \file ocltune.c
+ \brief Work-group size autotuner
+ \details
+ This file implements the benchmark of the launch configurations, the in-memory table of the
+ tuned configurations and the per-device config files.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#include "ocltune.h"
+#include <rwlock_wp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+                              //! An entry of the in-memory table
+struct ocltune_entry {
+                              //! device key (name and driver version)
+  char devkey[OCLTUNE_MAXDEVKEY];
+                              //! kernel name
+  char kname[OCLTUNE_MAXKNAME];
+                              //! tuned configuration
+  struct ocltune_cfg cfg;
+};
+
+                              //! lock that protects the table and the directory
+volatile struct rwlockwp tunelock = RWLOCK_STATIC_INITIALIZER;
+                              //! in-memory table, access with *tunelock*
+struct ocltune_entry tunetab[OCLTUNE_MAXENTRIES];
+                              //! number of entries used, access with *tunelock*
+int tunecnt = 0;
+                              //! directory of the config files ("" = none), access with *tunelock*
+char tunedir[OCLTUNE_MAXDIR] = "";
+
+
+
+/*!
+ \brief Queries a string of a device
+ \details
+ Queries the length first, so that strings longer than *len* are truncated instead of failing
+ with CL_INVALID_VALUE.
+ \param dev (in) the OpenCL device
+ \param param (in) the string to query (CL_DEVICE_NAME, ...)
+ \param str (out) the string (terminated, truncated to *len* - 1 characters)
+ \param len (in) size of *str*
+ \returns 0 = no error, -1 = device could not be queried or malloc error
+ \mt fully threadsafe
+ */
+int ocltune_devstr( cl_device_id dev, cl_device_info param, char* str, size_t len ){
+
+  size_t size = 0;                           // length of the string (with the NUL)
+
+  if ((clGetDeviceInfo( dev, param, 0, NULL, &size ) != CL_SUCCESS) || (size == 0)) {
+    return( -1 );
+  }
+
+  char* full = (char*) malloc( size );
+
+  if (full == NULL) {                        // malloc error?
+    return( -1 );
+  }
+
+  int ret = -1;
+
+  if (clGetDeviceInfo( dev, param, size, full, NULL ) == CL_SUCCESS) {
+    full[size - 1] = '\0';
+    snprintf( str, len, "%s", full );
+    ret = 0;
+  }
+
+  free( full );
+
+  return( ret );
+
+} // ocltune_devstr
+
+
+
+/*!
+ \brief Builds the device key
+ \details
+ The key consists of the device name and the driver version, truncated to 2/3 and 1/3 of
+ OCLTUNE_MAXDEVKEY (127 and 63 characters). All characters that must not appear in a file name
+ are replaced by '_'.
+ \param dev (in) the OpenCL device
+ \param key (out) the key (OCLTUNE_MAXDEVKEY characters)
+ \returns 0 = no error, -1 = device could not be queried
+ \mt fully threadsafe
+ */
+int ocltune_devkey( cl_device_id dev, char* key ){
+
+  char name[OCLTUNE_MAXDEVKEY];
+  char driver[OCLTUNE_MAXDEVKEY];
+
+  if ((ocltune_devstr( dev, CL_DEVICE_NAME, name, sizeof(name) ) != 0) ||
+      (ocltune_devstr( dev, CL_DRIVER_VERSION, driver, sizeof(driver) ) != 0)) {
+    return( -1 );                            // error?
+  }
+
+                                 // 2/3 for the name, 1/3 for the driver version
+  snprintf( key, OCLTUNE_MAXDEVKEY, "%.*s_%.*s", OCLTUNE_MAXDEVKEY * 2 / 3 - 1, name,
+            OCLTUNE_MAXDEVKEY / 3 - 1, driver );
+
+  for (int i1 = 0; key[i1] != '\0'; i1++) {  // replace special characters
+
+    char c = key[i1];
+
+    if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+          ((c >= '0') && (c <= '9')) || (c == '.') || (c == '-'))) {
+      key[i1] = '_';
+    }
+  }
+
+  return( 0 );
+
+} // ocltune_devkey
+
+
+
+/*!
+ \brief Looks up a configuration in the in-memory table
+ \param devkey (in) the device key
+ \param kname (in) the kernel name
+ \param cfg (out) the configuration (if found)
+ \returns 1 = found, 0 = not found
+ \mt caller must hold *tunelock*
+ */
+int ocltune_lookup( const char* devkey, const char* kname, struct ocltune_cfg* cfg ){
+
+  for (int i1 = tunecnt - 1; i1 >= 0; i1--) {   // latest entry wins
+
+    if ((strcmp( tunetab[i1].devkey, devkey ) == 0) &&
+        (strcmp( tunetab[i1].kname, kname ) == 0)) {
+
+      *cfg = tunetab[i1].cfg;
+      return( 1 );
+    }
+  }
+
+  return( 0 );
+
+} // ocltune_lookup
+
+
+
+/*!
+ \brief Stores a configuration in the in-memory table
+ \details
+ An existing entry is replaced. If the table is full, the configuration is not stored.
+ \param devkey (in) the device key
+ \param kname (in) the kernel name
+ \param cfg (in) the configuration
+ \mt caller must hold the writer lock of *tunelock*
+ */
+void ocltune_store( const char* devkey, const char* kname, const struct ocltune_cfg* cfg ){
+
+  int i1 = 0;
+
+  while ((i1 < tunecnt) && ((strcmp( tunetab[i1].devkey, devkey ) != 0) ||
+                            (strcmp( tunetab[i1].kname, kname ) != 0))) {
+    i1++;
+  }
+
+  if (i1 < OCLTUNE_MAXENTRIES) {             // space left?
+
+    strncpy( tunetab[i1].devkey, devkey, OCLTUNE_MAXDEVKEY - 1 );
+    tunetab[i1].devkey[OCLTUNE_MAXDEVKEY - 1] = '\0';
+    strncpy( tunetab[i1].kname, kname, OCLTUNE_MAXKNAME - 1 );
+    tunetab[i1].kname[OCLTUNE_MAXKNAME - 1] = '\0';
+    tunetab[i1].cfg = *cfg;
+
+    if (i1 == tunecnt) {                     // new entry?
+      tunecnt++;
+    }
+  }
+
+} // ocltune_store
+
+
+
+/*!
+ \brief Builds the name of the config file of a device
+ \param devkey (in) the device key
+ \param fname (out) the file name (OCLTUNE_MAXDIR + OCLTUNE_MAXDEVKEY + 16 characters)
+ \returns 0 = no error, -1 = no directory set
+ \mt caller must hold *tunelock*
+ */
+int ocltune_fname( const char* devkey, char* fname ){
+
+  if (tunedir[0] == '\0') {                  // directory set?
+    return( -1 );
+  }
+
+  snprintf( fname, OCLTUNE_MAXDIR + OCLTUNE_MAXDEVKEY + 16, "%s/ocltune_%s.cfg", tunedir, devkey );
+
+  return( 0 );
+
+} // ocltune_fname
+
+
+
+/*!
+ \brief Reads the config file of a device into the in-memory table
+ \details
+ Every line of the file holds the kernel name, the local work size and the padding. Later
+ lines replace earlier lines of the same kernel.
+ \param devkey (in) the device key
+ \mt caller must hold the writer lock of *tunelock*
+ */
+void ocltune_load( const char* devkey ){
+
+  char fname[OCLTUNE_MAXDIR + OCLTUNE_MAXDEVKEY + 16];
+
+  if (ocltune_fname( devkey, fname ) == 0) {
+
+    FILE* f = fopen( fname, "r" );
+
+    if (f != NULL) {                         // file exists?
+
+      char kname[OCLTUNE_MAXKNAME];
+      unsigned long local;
+      unsigned long pad;
+
+                                 // read all lines
+      while (fscanf( f, "%31s %lu %lu", kname, &local, &pad ) == 3) {
+
+        if (pad >= 1) {                      // plausible?
+
+          struct ocltune_cfg cfg;
+          cfg.local = (size_t) local;
+          cfg.pad = (size_t) pad;
+
+          ocltune_store( devkey, kname, &cfg );
+        }
+      }
+
+      fclose( f );
+    }
+  }
+
+} // ocltune_load
+
+
+
+/*!
+ \brief Appends a configuration to the config file of a device
+ \param devkey (in) the device key
+ \param kname (in) the kernel name
+ \param cfg (in) the configuration
+ \mt caller must hold the writer lock of *tunelock*
+ */
+void ocltune_save( const char* devkey, const char* kname, const struct ocltune_cfg* cfg ){
+
+  char fname[OCLTUNE_MAXDIR + OCLTUNE_MAXDEVKEY + 16];
+
+  if (ocltune_fname( devkey, fname ) == 0) {
+
+    FILE* f = fopen( fname, "a" );
+
+    if (f != NULL) {
+      fprintf( f, "%s %lu %lu\n", kname, (unsigned long) cfg->local, (unsigned long) cfg->pad );
+      fclose( f );
+    }
+  }
+
+} // ocltune_save
+
+
+
+/*!
+ \brief Measures the runtime of a launch configuration
+ \details
+ Runs the kernel once to warm up and returns the shortest of OCLTUNE_REPS timed runs.
+ \param commands (in) the OpenCL command queue
+ \param kernel (in) the OpenCL kernel (arguments set)
+ \param n (in) the real problem size
+ \param cfg (in) the configuration
+ \returns runtime in nanoseconds or -1 if the configuration can not be used
+ \mt fully threadsafe (if the kernel is not used concurrently)
+ */
+long long ocltune_bench( cl_command_queue commands, cl_kernel kernel, size_t n,
+                         const struct ocltune_cfg* cfg ){
+
+  const size_t global_size = ocltune_global( cfg, n );
+  long long best = -1;
+
+  for (int i1 = -1; i1 < OCLTUNE_REPS; i1++) {    // first run = warm up
+
+    struct timespec start, finish;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    cl_int err = clEnqueueNDRangeKernel( commands, kernel, 1, NULL, &global_size,
+                                         ocltune_local( cfg ), 0, NULL, NULL );
+
+    if (err == CL_SUCCESS) {
+      err = clFinish( commands );
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &finish );
+
+    if (err != CL_SUCCESS) {                 // configuration not usable?
+      return( -1 );
+    }
+
+    long long t = (finish.tv_sec - start.tv_sec) * 1000000000LL +
+                  (finish.tv_nsec - start.tv_nsec);
+
+    if ((i1 >= 0) && ((best < 0) || (t < best))) {
+      best = t;
+    }
+  }
+
+  return( best );
+
+} // ocltune_bench
+
+
+
+// see header file for details
+int ocltune_setdir( const char* dir ){
+
+  int ret = 0;
+
+  rwlockwp_writer_acquire( &tunelock );
+
+  if (dir == NULL) {
+    tunedir[0] = '\0';                       // no config files
+  } else if (strlen( dir ) < OCLTUNE_MAXDIR) {
+    strcpy( tunedir, dir );
+  } else {
+    ret = -1;                                // too long
+  }
+
+  rwlockwp_writer_release( &tunelock );
+
+  return( ret );
+
+} // ocltune_setdir
+
+
+
+// see header file for details
+void ocltune_get( cl_command_queue commands, cl_device_id dev, cl_kernel kernel,
+                  const char* kname, size_t n, struct ocltune_cfg* cfg ){
+
+  char devkey[OCLTUNE_MAXDEVKEY];
+
+  cfg->local = 0;                            // driver default
+  cfg->pad = 1;
+
+  if ((n == 0) || (ocltune_devkey( dev, devkey ) != 0)) {
+    return;
+  }
+
+  rwlockwp_reader_acquire( &tunelock );     // already known?
+  int found = ocltune_lookup( devkey, kname, cfg );
+  rwlockwp_reader_release( &tunelock );
+
+  if (found == 0) {
+                                 // try the config file
+    rwlockwp_writer_acquire( &tunelock );
+
+    found = ocltune_lookup( devkey, kname, cfg );
+
+    if (found == 0) {
+      ocltune_load( devkey );
+      found = ocltune_lookup( devkey, kname, cfg );
+    }
+
+    rwlockwp_writer_release( &tunelock );
+  }
+
+  if (found == 1) {
+    return;
+  }
+
+  size_t maxwg = 0;                          // limits of the kernel on the device
+  size_t pref = 0;
+
+  cl_int err = clGetKernelWorkGroupInfo( kernel, dev, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t),
+                                         &maxwg, NULL );
+  err |= clGetKernelWorkGroupInfo( kernel, dev, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+                                   sizeof(size_t), &pref, NULL );
+
+  if ((err != CL_SUCCESS) || (maxwg == 0)) {     // error?
+    return;
+  }
+
+  if ((pref == 0) || (pref > maxwg)) {
+    pref = 1;
+  }
+
+  struct ocltune_cfg cand;                   // candidate
+  struct ocltune_cfg best = *cfg;            // driver default first
+  long long besttime = ocltune_bench( commands, kernel, n, &best );
+
+  for (size_t local = 0; local <= maxwg; local = (local == 0) ? pref : local * 2) {
+
+    cand.local = local;                      // 0 = driver default, padded
+    cand.pad = (local == 0) ? pref : local;
+
+    if ((cand.pad == 1) || ((local > n) && (local > pref))) {
+      continue;                              // already tested or too large
+    }
+
+    long long t = ocltune_bench( commands, kernel, n, &cand );
+
+    if ((t >= 0) && ((besttime < 0) || (t < besttime))) {
+      best = cand;
+      besttime = t;
+    }
+  }
+
+  *cfg = best;
+
+  if (besttime >= 0) {                       // keep result
+    rwlockwp_writer_acquire( &tunelock );
+    ocltune_store( devkey, kname, cfg );
+    ocltune_save( devkey, kname, cfg );
+    rwlockwp_writer_release( &tunelock );
+  }
+
+} // ocltune_get
+
+
+
+// see header file for details
+size_t ocltune_global( const struct ocltune_cfg* cfg, size_t n ){
+
+  return( ((n + cfg->pad - 1) / cfg->pad) * cfg->pad );
+
+} // ocltune_global
+
+
+
+// see header file for details
+const size_t* ocltune_local( const struct ocltune_cfg* cfg ){
+
+  if (cfg->local == 0) {
+    return( NULL );
+  }
+
+  return( &cfg->local );
+
+} // ocltune_local
@@ -23,16 +23,39 @@ const int clpat = __clang_patchlevel__;
 #else
                                           //! 0=CLANG has not been used
 const char isclang = 0;
+                                          //! no clang version (e.g. gcc on Linux)
+const int clmaj = -1;
+                                          //! no clang version
+const int clmin = -1;
+                                          //! no clang version
+const int clpat = -1;
 #endif
 
 
 #include <jni.h>
 #include "oclwrapper.h"
 #include "AndroidOpenCL.h"
+#include "ocltune.h"
+#include "threadpool.h"
+#include "jobctl.h"
+#include "jobsched.h"
+#include "trace.h"
 #include "CL/cl.h"
 #include "CL/cl_platform.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+
+
+                                          //! A Java completion function of a job
+struct oclwrap_cb {
+                                          //! the VM
+  JavaVM* vm;
+                                          //! the object (global reference)
+  jobject obj;
+                                          //! the method jobDone(int, int)
+  jmethodID mid;
+};
 
 
 #ifdef __arm__
@@ -100,7 +123,13 @@ JNIEXPORT jint JNICALL
 Java_com_example_dmocl_oclwrap_loadOpenCL(JNIEnv *env, jobject thiz, jstring s ) {
 
     const char* c = (*env)->GetStringUTFChars( env, s, NULL );    // convert JAVA-String to C-string
-    return( loadOpenCL( c ) );                    // try to load library
+    jint ret = loadOpenCL( c );                   // try to load library
+
+    if (ret == 0) {
+      jobsched_reprobe();                         // the GPU slots of the scheduler
+    }
+
+    return( ret );
 }
 
 
@@ -109,6 +138,7 @@ JNIEXPORT void JNICALL
 Java_com_example_dmocl_oclwrap_unloadOpenCL(JNIEnv *env, jobject thiz) {
 
     unloadOpenCL();                 // unload library
+    jobsched_reprobe();             // no GPU slots any more
 
 }
 
@@ -362,3 +392,413 @@ Java_com_example_dmocl_oclwrap_getArchitecture(JNIEnv *env, jclass clazz) {
   return( TARGETARCH );
 }
 
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_setTuneDir(JNIEnv *env, jclass clazz, jstring s) {
+
+  const char* c = (*env)->GetStringUTFChars( env, s, NULL );    // convert JAVA-String to C-string
+
+  jint ret = ocltune_setdir( c );                 // set directory
+
+  (*env)->ReleaseStringUTFChars( env, s, c );
+
+  return( ret );
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_setPoolSize(JNIEnv *env, jclass clazz, jint workers) {
+
+  return( threadpool_resize( workers ) );
+}
+
+
+// see header file
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_oclwrap_shutdownPool(JNIEnv *env, jclass clazz) {
+
+  threadpool_shutdown();                          // finish queued tasks and join the workers
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_createJob(JNIEnv *env, jclass clazz, jlong timeoutms) {
+
+  return( jobctl_create( timeoutms ) );
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_cancelJob(JNIEnv *env, jclass clazz, jint job) {
+
+  return( (jobsched_cancel( job ) == 0) ? 0 : -1 );   // also jobs created with createJob
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_jobStatus(JNIEnv *env, jclass clazz, jint job) {
+
+  return( jobctl_status( job ) );
+}
+
+
+// see header file
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_oclwrap_releaseJob(JNIEnv *env, jclass clazz, jint job) {
+
+  jobsched_release( job );                        // running calculations continue
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_pollJob(JNIEnv *env, jclass clazz, jint job) {
+
+  return( jobsched_poll( job ) );
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_fetchJob(JNIEnv *env, jclass clazz, jint job, jshortArray b,
+                                        jlongArray e) {
+
+  short result = 0;
+  const unsigned short* conb = NULL;
+  int blen = 0;
+  long long info[JOBSCHED_NINFO];
+
+                                        // get the result (valid until the job is released)
+  jint ret = jobsched_result( job, &result, &conb, &blen, info, JOBSCHED_NINFO );
+
+  if (ret == 0) {
+
+    if ((*env)->GetArrayLength( env, b ) >= blen) {
+
+      (*env)->SetShortArrayRegion( env, b, 0, blen, (const jshort*) conb );
+
+      jsize elen = (*env)->GetArrayLength( env, e );
+
+      (*env)->SetLongArrayRegion( env, e, 0, (elen < JOBSCHED_NINFO) ? elen : JOBSCHED_NINFO,
+                                  (const jlong*) info );
+
+      ret = result;
+
+    } else {
+      ret = JOBSCHED_EDESC;
+    }
+  }
+
+  return( ret );
+}
+
+
+// see header file
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_oclwrap_setSchedLimits(JNIEnv *env, jclass clazz, jint cores,
+                                              jint memorymb, jint gpus) {
+
+  jobsched_limits( cores, (long long) memorymb * 1024 * 1024, gpus );
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_waitJob(JNIEnv *env, jclass clazz, jint job, jlong timeoutms) {
+
+  return( jobsched_wait( job, timeoutms ) );
+}
+
+
+
+/*!
+ \brief Generates Gaussian clusters into memory of the caller
+ \param env pointer to JNI environment
+ \param clustersize (in) number of data items of the clusters
+ \param features (in) features per data item
+ \param seed (in) the seed
+ \param rf (out) the data items
+ \param len (in) number of floats of *rf*
+ \return result of agpudm_generate, -9 = *rf* has the wrong length
+ \mt fully threadsafe
+ */
+jint oclwrap_generate( JNIEnv* env, jintArray clustersize, jint features, jlong seed, float* rf,
+                       jlong len ){
+
+  jint ret = AGPUDM_EINVAL;
+
+  if (clustersize == NULL) {
+    return( ret );
+  }
+
+  const jsize clusters = (*env)->GetArrayLength( env, clustersize );
+  jint* sizes = (*env)->GetIntArrayElements( env, clustersize, NULL );
+
+  if (sizes != NULL) {
+
+    long long n = 0;                           // number of data items
+
+    for (jsize i1 = 0; i1 < clusters; i1++) {
+      n += sizes[i1];
+    }
+
+    if ((rf == NULL) || (n * features != len)) {
+      ret = -9;
+    } else {
+      ret = agpudm_generate( (const int*) sizes, clusters, features, (unsigned long long) seed, 0,
+                             rf );
+    }
+
+    (*env)->ReleaseIntArrayElements( env, clustersize, sizes, JNI_ABORT );
+
+  } else {
+    ret = AGPUDM_ENOMEM;
+  }
+
+  return( ret );
+
+} // oclwrap_generate
+
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_createClusters(JNIEnv *env, jclass clazz, jintArray clustersize,
+                                              jint features, jlong seed, jfloatArray rf) {
+
+  if (rf == NULL) {
+    return( -9 );
+  }
+
+  const jsize len = (*env)->GetArrayLength( env, rf );
+  jfloat* data = (*env)->GetFloatArrayElements( env, rf, NULL );
+
+  if (data == NULL) {
+    return( AGPUDM_ENOMEM );
+  }
+
+  jint ret = oclwrap_generate( env, clustersize, features, seed, (float*) data, len );
+
+                                    // copy back (if the VM made a copy)
+  (*env)->ReleaseFloatArrayElements( env, rf, data, (ret == AGPUDM_OK) ? 0 : JNI_ABORT );
+
+  return( ret );
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_createClustersDirect(JNIEnv *env, jclass clazz,
+                                                    jintArray clustersize, jint features,
+                                                    jlong seed, jobject rf) {
+
+  jlong len = 0;
+  float* data = (float*) oclwrap_direct( env, rf, sizeof(float), &len );   // no copy
+
+  return( oclwrap_generate( env, clustersize, features, seed, data, len ) );
+}
+
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_traceStart(JNIEnv *env, jclass clazz, jint capacity) {
+
+  return( trace_start( capacity ) );
+}
+
+
+// see header file
+JNIEXPORT void JNICALL
+Java_com_example_dmocl_oclwrap_traceStop(JNIEnv *env, jclass clazz) {
+
+  trace_stop();
+}
+
+
+// see header file
+JNIEXPORT jint JNICALL
+Java_com_example_dmocl_oclwrap_traceWrite(JNIEnv *env, jclass clazz, jstring file) {
+
+  const char* c = (*env)->GetStringUTFChars( env, file, NULL );    // convert JAVA-String to C-string
+
+  if (c == NULL) {
+    return( -1 );
+  }
+
+  jint ret = trace_write( c );
+
+  (*env)->ReleaseStringUTFChars( env, file, c );
+
+  return( ret );
+}
+
+
+// see header file
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_dmocl_oclwrap_traceDump(JNIEnv *env, jclass clazz) {
+
+  jbyteArray arr = NULL;
+  char* json = NULL;
+  long len = 0;
+  long n = 0;
+
+  do {                                       // spans may be added meanwhile -> repeat
+    len = trace_json( NULL, 0 ) + 4096;
+    free( json );
+    json = (char*) malloc( len );
+    if (json == NULL) break;
+    n = trace_json( json, len );
+  } while (n >= len);
+
+  if (json != NULL) {
+
+    arr = (*env)->NewByteArray( env, (jsize) n );
+
+    if (arr != NULL) {
+      (*env)->SetByteArrayRegion( env, arr, 0, (jsize) n, (const jbyte*) json );
+    }
+
+    free( json );
+  }
+
+  return( arr );
+}
+
+
+
+/*!
+ \brief Calls the Java completion function of a job
+ \details
+ Attaches the calling thread to the VM if necessary, calls jobDone and frees the global
+ reference.
+ \param handle (in) handle of the job
+ \param result (in) result of the job
+ \param arg (in) the completion function (struct oclwrap_cb, freed)
+ \mt fully threadsafe
+ */
+void oclwrap_jobdone( int handle, short result, void* arg ){
+
+  struct oclwrap_cb* cb = (struct oclwrap_cb*) arg;
+  JNIEnv* env = NULL;
+  int attached = 0;
+
+                                          // thread of the scheduler -> attach to the VM
+  if ((*cb->vm)->GetEnv( cb->vm, (void**) &env, JNI_VERSION_1_6 ) == JNI_EDETACHED) {
+
+    if ((*cb->vm)->AttachCurrentThread( cb->vm, &env, NULL ) == JNI_OK) {
+      attached = 1;
+    } else {
+      env = NULL;
+    }
+  }
+
+  if (env != NULL) {
+
+    (*env)->CallVoidMethod( env, cb->obj, cb->mid, (jint) handle, (jint) result );
+
+    if ((*env)->ExceptionCheck( env )) {  // the exception cannot be passed on
+      (*env)->ExceptionClear( env );
+    }
+
+    (*env)->DeleteGlobalRef( env, cb->obj );
+  }
+
+  if (attached == 1) {
+    (*cb->vm)->DetachCurrentThread( cb->vm );
+  }
+
+  free( cb );
+
+} // oclwrap_jobdone
+
+
+
+// see header file
+int oclwrap_setcallback( JNIEnv* env, jobject cb, agpudm_donefn* done, void** arg ){
+
+  *done = NULL;
+  *arg = NULL;
+
+  if (cb == NULL) {
+    return( 0 );
+  }
+
+  int ret = -1;
+
+  struct oclwrap_cb* c = (struct oclwrap_cb*) malloc( sizeof(struct oclwrap_cb) );
+
+  if (c != NULL) {
+
+    jclass cls = (*env)->GetObjectClass( env, cb );
+
+    c->mid = (*env)->GetMethodID( env, cls, "jobDone", "(II)V" );
+
+    (*env)->DeleteLocalRef( env, cls );
+
+    if ((c->mid != NULL) && ((*env)->GetJavaVM( env, &c->vm ) == JNI_OK)) {
+
+      c->obj = (*env)->NewGlobalRef( env, cb );
+
+      if (c->obj != NULL) {
+        *done = &oclwrap_jobdone;
+        *arg = c;
+        ret = 0;
+      }
+
+    } else if ((*env)->ExceptionCheck( env )) {
+      (*env)->ExceptionClear( env );           // NoSuchMethodError -> error code
+    }
+
+    if (ret != 0) {
+      free( c );
+    }
+  }
+
+  return( ret );
+
+} // oclwrap_setcallback
+
+
+
+// see header file
+void oclwrap_dropcallback( JNIEnv* env, void* arg ){
+
+  if (arg != NULL) {
+
+    struct oclwrap_cb* c = (struct oclwrap_cb*) arg;
+
+    (*env)->DeleteGlobalRef( env, c->obj );
+    free( c );
+  }
+
+} // oclwrap_dropcallback
+
+
+
+// see header file
+void* oclwrap_direct( JNIEnv* env, jobject buf, size_t elemsize, jlong* len ){
+
+  *len = 0;
+
+  if (buf == NULL) {
+    return( NULL );
+  }
+
+  void* addr = (*env)->GetDirectBufferAddress( env, buf );   // NULL = heap buffer
+
+  if ((addr == NULL) || (((uintptr_t) addr % elemsize) != 0)) {
+    return( NULL );
+  }
+
+  *len = (*env)->GetDirectBufferCapacity( env, buf );         // in elements of the buffer
+
+  return( addr );
+
+} // oclwrap_direct
@@ -6,6 +6,11 @@
  readers and exclusive for the writers. Once a writer is waiting all readers that have
  acquired a reader lock are allowed to finish but new readers have to queue up until the
  writer has finished.
+ The readers count themselves in *state* with atomic operations. A writer sets RWLOCK_WRITER
+ in *state* as soon as it arrives and waits on the condition variable until the count of the
+ active readers has dropped to zero. A reader that sees the bit after its increment takes the
+ increment back and waits on the condition variable until the bit is cleared. The bit is
+ cleared by the last writer in the queue.
  \copyright Copyright Robert Fritze 2021
  \license MIT
  \version 1.0
@@ -16,37 +21,57 @@
 
 #include "rwlock_wp.h"
 
-// see header file for details
-void rwlockwp_reader_acquire( volatile struct rwlockwp* rwl ){
 
-  pthread_mutex_lock( &rwl->g );              // acquire lock
+/*!
+ \brief Wakes up a writer waiting for the readers
+ \details
+ Called by a reader that has decremented the reader count to zero while a writer is pending.
+ \param rwl (in) Pointer to the reader/writer lock
+ \mt fully threadsafe
+ */
+static void rwlockwp_wake( volatile struct rwlockwp* rwl ){
 
-                                       // wait while there are writers
-                                       // waiting or active
-  while ((rwl->num_writers_waiting>0) || (rwl->writer_active>0)){
-    pthread_cond_wait( &rwl->c, &rwl->g );
-  }
+  pthread_mutex_lock( &rwl->g );       // the writer tests the count with the lock held
 
-  rwl->num_reader_active++;                // one more reader
+  pthread_cond_broadcast( &rwl->c );   // wake up all waiting writers
+
+  pthread_mutex_unlock( &rwl->g );
+
+} // rwlockwp_wake
 
-  pthread_mutex_unlock( &rwl->g );      // release lock
 
-} // rwlockwp_reader_acquire
 
 // see header file for details
-void rwlockwp_reader_release( volatile struct rwlockwp* rwl ){
+void rwlockwp_reader_acquire( volatile struct rwlockwp* rwl ){
 
-  pthread_mutex_lock( &rwl->g );    // acquire lock
+                                       // fast path: one more reader, no writer pending
+  while ((__atomic_add_fetch( &rwl->state, 1, __ATOMIC_ACQUIRE ) & RWLOCK_WRITER) != 0) {
 
-  rwl->num_reader_active--;          // one reader less
+                                       // writer pending -> take the increment back
+    if (__atomic_sub_fetch( &rwl->state, 1, __ATOMIC_RELEASE ) == RWLOCK_WRITER) {
+      rwlockwp_wake( rwl );            // the writer may wait for this reader
+    }
 
-  if (rwl->num_reader_active == 0){    // was the last active reader?
+    pthread_mutex_lock( &rwl->g );     // acquire lock
 
-    pthread_cond_broadcast( &rwl->c );   // wake up all waiting writers
+                                       // wait while there are writers
+                                       // waiting or active
+    while ((__atomic_load_n( &rwl->state, __ATOMIC_ACQUIRE ) & RWLOCK_WRITER) != 0) {
+      pthread_cond_wait( &rwl->c, &rwl->g );
+    }
 
+    pthread_mutex_unlock( &rwl->g );   // release lock and try again
   }
 
-  pthread_mutex_unlock( &rwl->g );     // release lock
+} // rwlockwp_reader_acquire
+
+// see header file for details
+void rwlockwp_reader_release( volatile struct rwlockwp* rwl ){
+
+                                       // one reader less, was the last one before a writer?
+  if (__atomic_sub_fetch( &rwl->state, 1, __ATOMIC_RELEASE ) == RWLOCK_WRITER) {
+    rwlockwp_wake( rwl );              // wake up all waiting writers
+  }
 
 } // rwlockwp_reader_release
 
@@ -58,9 +83,13 @@ void rwlockwp_writer_acquire( volatile struct rwlockwp* rwl ){
   pthread_mutex_lock( &rwl->g );         // acquire lock
   rwl->num_writers_waiting++;          // one more writer WAITING
 
+                                       // new readers have to queue up from now on
+  __atomic_fetch_or( &rwl->state, RWLOCK_WRITER, __ATOMIC_ACQ_REL );
+
                          // wait until there are no more active
                          // readers and no more active writers
-  while ((rwl->num_reader_active>0) || (rwl->writer_active>0)){
+  while (((__atomic_load_n( &rwl->state, __ATOMIC_ACQUIRE ) & ~RWLOCK_WRITER) > 0) ||
+         (rwl->writer_active > 0)) {
     pthread_cond_wait( &rwl->c, &rwl->g );
   }
 
@@ -80,10 +109,12 @@ void rwlockwp_writer_release( volatile struct rwlockwp* rwl ){
 
   rwl->writer_active = 0;            // writer is not any more active
 
+  if (rwl->num_writers_waiting == 0) {     // last writer -> let the readers in
+    __atomic_fetch_and( &rwl->state, ~RWLOCK_WRITER, __ATOMIC_RELEASE );
+  }
+
   pthread_cond_broadcast( &rwl->c );   // wake up waiting readers and writers
 
   pthread_mutex_unlock( &rwl->g );   // release lock
 
 } // rwlockwp_writer_release
-
-
@@ -0,0 +1,942 @@
+/*!
+ \file threadpool.c
+ \brief Process wide native thread pool
+ \details
+ This file implements the worker threads, the task queue and the completion handles of the
+ thread pool. All state of the pool is protected by a single mutex; the workers wait on one
+ condition variable for new tasks, the callers of threadpool_wait on a second one.
+ The work-stealing scheduler uses one small lock per participant range, the pool lock is taken
+ only once per participant and loop.
+ The ranges and the statistics of the participants are allocated aligned to cache lines (the
+ structs are padded to THREADPOOL_CACHELINE), so that no two participants share a line. With
+ an alignment set (threadpool_sched_align) the boundaries produced by the initial split, by
+ the chunks, by the claims and by the steals are rounded up to multiples of *align* data items.
+ Resident participants (threadpool_sched_member) pass the barrier of the scheduler twice per
+ loop: once when the caller starts the loop and once when the loop has finished. The caller is
+ the last party of the barrier.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef _POSIX_C_SOURCE
+                              //! needed for posix_memalign
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "threadpool.h"
+#include "trace.h"
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+                              //! lock that protects the state of the pool
+pthread_mutex_t poollock = PTHREAD_MUTEX_INITIALIZER;
+                              //! signals new tasks (and workers to terminate), use with *poollock*
+pthread_cond_t poolwork = PTHREAD_COND_INITIALIZER;
+                              //! signals finished jobs, use with *poollock*
+pthread_cond_t pooldone = PTHREAD_COND_INITIALIZER;
+                              //! serializes the changes of the number of workers
+pthread_mutex_t poolsizelock = PTHREAD_MUTEX_INITIALIZER;
+                              //! first task of the queue, access with *poollock*
+struct threadpool_task* poolhead = NULL;
+                              //! last task of the queue, access with *poollock*
+struct threadpool_task* pooltail = NULL;
+                              //! the worker threads, access with *poolsizelock*
+pthread_t poolthreads[THREADPOOL_MAXWORKERS];
+                              //! number of workers running, access with *poollock*
+int poolcnt = 0;
+                              //! workers with a number >= this value terminate, access with *poollock*
+int pooltarget = 0;
+                              //! placement policy of the workers, access with *poollock*
+int poolpolicy = CPUTOPO_NONE;
+                              //! incremented on every change of the pinning, access with *poollock*
+int poolgen = 0;
+                              //! number of workers bound to resident tasks, access with *poollock*
+int poolbound = 0;
+
+
+
+/*!
+ \brief Marks a task of a job as finished
+ \param job (in+out) the completion handle
+ \mt caller must hold *poollock*
+ */
+void threadpool_finish( struct threadpool_job* job ){
+
+  job->pending--;
+
+  if (job->pending == 0) {                   // job completed?
+    pthread_cond_broadcast( &pooldone );
+  }
+
+} // threadpool_finish
+
+
+
+/*!
+ \brief Worker thread
+ \details
+ Takes the tasks from the queue and executes them. A worker terminates if the queue is empty
+ and its number is not below the target number of workers. Before a task is executed, a change
+ of the pinning is applied.
+ \param arg (in) number of the worker
+ \returns NULL
+ */
+void* threadpool_worker( void* arg ){
+
+  const int num = (int) (intptr_t) arg;      // number of the worker
+  int gen = 0;                               // pinning applied
+  int calibrated = 0;                        // speed of the CPU measured?
+
+  pthread_mutex_lock( &poollock );
+
+  while (1) {
+
+    if (poolhead != NULL) {                  // task waiting?
+
+      struct threadpool_task* task = poolhead;     // dequeue
+      struct threadpool_job* job = task->job;
+
+      poolhead = task->next;
+
+      if (poolhead == NULL) {
+        pooltail = NULL;
+      }
+
+      int pin = -1;                          // -1 = unchanged, 0 = all CPUs, 1 = single CPU
+
+      if (gen != poolgen) {
+        gen = poolgen;
+        pin = ((poolpolicy & CPUTOPO_PIN) != 0) ? 1 : 0;
+      }
+
+      pthread_mutex_unlock( &poollock );
+
+      if (pin == 1) {
+
+        const int cpu = cputopo_cpu( num );  // worker i -> i-th fastest CPU
+
+        if ((cputopo_pin( cpu ) == 0) && (calibrated == 0)) {
+          cputopo_calibrate( cpu );
+          calibrated = 1;
+        }
+
+      } else if (pin == 0) {
+        cputopo_pin( -1 );
+      }
+
+      task->fn( task->arg, task->start, task->len );     // execute
+
+      pthread_mutex_lock( &poollock );
+
+      threadpool_finish( job );              // the task must not be touched any more
+
+    } else if (num >= pooltarget) {
+      break;                                 // no more work and no longer needed
+
+    } else {
+      pthread_cond_wait( &poolwork, &poollock );   // wait for new tasks
+    }
+  }
+
+  pthread_mutex_unlock( &poollock );
+
+  return( NULL );
+
+} // threadpool_worker
+
+
+
+/*!
+ \brief Changes the number of workers
+ \param workers (in) number of workers (0..THREADPOOL_MAXWORKERS)
+ \param grow (in) 1 = the pool must not shrink
+ \returns number of workers running
+ \mt caller must hold *poolsizelock*
+ */
+int threadpool_setsize( int workers, int grow ){
+
+  pthread_mutex_lock( &poollock );
+
+  const int cnt = poolcnt;                   // workers running
+
+  if ((workers < cnt) && (grow == 0)) {
+
+    pooltarget = workers;                    // remove workers
+    pthread_cond_broadcast( &poolwork );
+
+    pthread_mutex_unlock( &poollock );
+
+    for (int i1 = workers; i1 < cnt; i1++) {   // wait until they have terminated
+      pthread_join( poolthreads[i1], NULL );
+    }
+
+    pthread_mutex_lock( &poollock );
+
+    poolcnt = workers;
+
+  } else if (workers > cnt) {
+
+    pooltarget = workers;                    // add workers
+
+    while (poolcnt < workers) {
+
+      if (pthread_create( &poolthreads[poolcnt], NULL, &threadpool_worker,
+                          (void*) (intptr_t) poolcnt ) != 0) {
+        pooltarget = poolcnt;                // error -> keep the workers created so far
+        break;
+      }
+
+      poolcnt++;
+    }
+  }
+
+  const int ret = poolcnt;
+
+  pthread_mutex_unlock( &poollock );
+
+  return( ret );
+
+} // threadpool_setsize
+
+
+
+// see header file for details
+int threadpool_reserve( int workers ){
+
+  if (workers > THREADPOOL_MAXWORKERS) {
+    workers = THREADPOOL_MAXWORKERS;
+  }
+
+  const long long tr = trace_begin();
+
+  pthread_mutex_lock( &poolsizelock );
+  const int ret = threadpool_setsize( workers, 1 );
+  pthread_mutex_unlock( &poolsizelock );
+
+  trace_end( TRACE_SETUP, "threadpool_reserve", tr, workers );
+
+  return( ret );
+
+} // threadpool_reserve
+
+
+
+// see header file for details
+int threadpool_resize( int workers ){
+
+  if (workers > THREADPOOL_MAXWORKERS) {
+    workers = THREADPOOL_MAXWORKERS;
+  } else if (workers < 0) {
+    workers = 0;
+  }
+
+  pthread_mutex_lock( &poolsizelock );
+  const int ret = threadpool_setsize( workers, 0 );
+  pthread_mutex_unlock( &poolsizelock );
+
+  return( ret );
+
+} // threadpool_resize
+
+
+
+// see header file for details
+void threadpool_shutdown( void ){
+
+  threadpool_resize( 0 );
+
+} // threadpool_shutdown
+
+
+
+// see header file for details
+void threadpool_setpolicy( int policy ){
+
+  pthread_mutex_lock( &poollock );
+
+  if ((policy & CPUTOPO_PIN) != (poolpolicy & CPUTOPO_PIN)) {
+    poolgen++;                               // workers must change their affinity
+  }
+
+  poolpolicy = policy;
+
+  pthread_mutex_unlock( &poollock );
+
+} // threadpool_setpolicy
+
+
+
+// see header file for details
+int threadpool_size( void ){
+
+  pthread_mutex_lock( &poollock );
+  const int ret = poolcnt;
+  pthread_mutex_unlock( &poollock );
+
+  return( ret );
+
+} // threadpool_size
+
+
+
+// see header file for details
+int threadpool_bind( int workers ){
+
+  int ret = 0;
+
+  pthread_mutex_lock( &poollock );
+
+  if (pooltarget - poolbound >= workers) {   // enough workers left for the other tasks?
+    poolbound += workers;
+    ret = 1;
+  }
+
+  pthread_mutex_unlock( &poollock );
+
+  return( ret );
+
+} // threadpool_bind
+
+
+
+// see header file for details
+void threadpool_unbind( int workers ){
+
+  pthread_mutex_lock( &poollock );
+  poolbound -= workers;
+  pthread_mutex_unlock( &poollock );
+
+} // threadpool_unbind
+
+
+
+// see header file for details
+void threadpool_job_init( struct threadpool_job* job ){
+
+  job->pending = 0;
+
+} // threadpool_job_init
+
+
+
+// see header file for details
+void threadpool_submit( struct threadpool_job* job, struct threadpool_task* task,
+                        threadpool_fn fn, void* arg, int start, int len ){
+
+  task->fn = fn;                             // initialize task
+  task->arg = arg;
+  task->start = start;
+  task->len = len;
+  task->job = job;
+  task->next = NULL;
+
+  pthread_mutex_lock( &poollock );
+
+  job->pending++;
+
+  if (pooltarget > 0) {                      // pool running?
+
+    if (pooltail == NULL) {                  // append to queue
+      poolhead = task;
+    } else {
+      pooltail->next = task;
+    }
+
+    pooltail = task;
+
+    pthread_cond_signal( &poolwork );        // wake up one worker
+
+    pthread_mutex_unlock( &poollock );
+
+  } else {
+
+    pthread_mutex_unlock( &poollock );
+
+    fn( arg, start, len );                   // no -> execute in the calling thread
+
+    pthread_mutex_lock( &poollock );
+    threadpool_finish( job );
+    pthread_mutex_unlock( &poollock );
+  }
+
+} // threadpool_submit
+
+
+
+// see header file for details
+int threadpool_done( struct threadpool_job* job ){
+
+  pthread_mutex_lock( &poollock );
+  const int ret = (job->pending == 0) ? 1 : 0;
+  pthread_mutex_unlock( &poollock );
+
+  return( ret );
+
+} // threadpool_done
+
+
+
+// see header file for details
+void threadpool_wait( struct threadpool_job* job ){
+
+  pthread_mutex_lock( &poollock );
+
+  while (job->pending > 0) {
+    pthread_cond_wait( &pooldone, &poollock );
+  }
+
+  pthread_mutex_unlock( &poollock );
+
+} // threadpool_wait
+
+
+
+/*!
+ \brief Returns a monotonic time stamp
+ \returns time in ns
+ \mt fully threadsafe
+ */
+long long threadpool_now( void ){
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return( ((long long) t.tv_sec) * 1000000000LL + t.tv_nsec );
+
+} // threadpool_now
+
+
+
+// see header file for details
+void* threadpool_alloc( size_t size ){
+
+  void* mem = NULL;
+
+  if (posix_memalign( &mem, THREADPOOL_CACHELINE, (size > 0) ? size : 1 ) != 0) {
+    mem = NULL;                              // contents undefined on error
+  }
+
+  return( mem );
+
+} // threadpool_alloc
+
+
+
+/*!
+ \brief Rounds a data item number up to the alignment of the scheduler
+ \param sched (in) the scheduler
+ \param i (in) data item number
+ \returns the smallest multiple of *align* that is >= *i*
+ \mt fully threadsafe
+ */
+int threadpool_sched_round( const struct threadpool_sched* sched, int i ){
+
+  if (sched->align <= 1) {
+    return( i );
+  }
+
+  return( (int) ((((long long) i + sched->align - 1) / sched->align) * sched->align) );
+
+} // threadpool_sched_round
+
+
+
+/*!
+ \brief Takes a chunk from the own range of a participant
+ \param sched (in+out) the scheduler
+ \param part (in) number of the participant
+ \param start (out) first data item of the chunk
+ \returns number of data items of the chunk (0 = range empty)
+ \mt fully threadsafe
+ */
+int threadpool_sched_take( struct threadpool_sched* sched, int part, int* start ){
+
+  struct threadpool_range* r = &sched->ranges[part];
+
+  pthread_mutex_lock( &r->lock );
+
+  int len = r->hi - r->lo;                   // data items left
+
+  if (len > 0) {
+
+    int chunk = len / THREADPOOL_SPLIT;      // chunks shrink with the range
+
+    if (chunk < sched->grain) {
+      chunk = sched->grain;
+    }
+
+    if (chunk < len) {                       // end of the chunk on a cache line
+      chunk = threadpool_sched_round( sched, r->lo + chunk ) - r->lo;
+    }
+
+    if (chunk < len) {
+      len = chunk;
+    }
+
+    *start = r->lo;
+    r->lo += len;
+  }
+
+  pthread_mutex_unlock( &r->lock );
+
+  return( len );
+
+} // threadpool_sched_take
+
+
+
+/*!
+ \brief Steals work for a participant
+ \details
+ Claims up to *share* data items that have not been claimed yet. If there are none, looks for
+ the largest range of the other participants and moves its upper half (or all of it, if it is
+ not larger than the grain size) into the range of the participant.
+ \param sched (in+out) the scheduler
+ \param part (in) number of the participant (its range must be empty)
+ \param share (in) data items claimed at once
+ \returns 1 = data items claimed or stolen, 0 = no work left
+ \mt fully threadsafe
+ */
+int threadpool_sched_steal( struct threadpool_sched* sched, int part, int share ){
+
+  if (sched->cursor < sched->n) {            // unclaimed data items left? (unlocked estimate)
+
+    int start = 0;
+    int len = 0;
+
+    pthread_mutex_lock( &sched->claimlock );
+
+    start = sched->cursor;
+    len = sched->n - start;
+
+    if (len > share) {                       // end of the share on a cache line
+      len = threadpool_sched_round( sched, start + share ) - start;
+    }
+
+    if (len > sched->n - start) {
+      len = sched->n - start;
+    }
+
+    if (len > 0) {
+      sched->cursor = start + len;
+    }
+
+    pthread_mutex_unlock( &sched->claimlock );
+
+    if (len > 0) {
+
+      struct threadpool_range* own = &sched->ranges[part];
+
+      pthread_mutex_lock( &own->lock );
+      own->lo = start;
+      own->hi = start + len;
+      pthread_mutex_unlock( &own->lock );
+
+      return( 1 );
+    }
+  }
+
+  while (1) {
+
+    int victim = -1;                         // participant with the most data items left
+    int most = 0;
+
+    for (int i1 = 0; i1 < sched->parts; i1++) {
+
+      const int left = sched->ranges[i1].hi - sched->ranges[i1].lo;   // unlocked estimate
+
+      if ((i1 != part) && (left > most)) {
+        victim = i1;
+        most = left;
+      }
+    }
+
+    if (victim < 0) {                        // all ranges empty?
+      return( 0 );
+    }
+
+    struct threadpool_range* r = &sched->ranges[victim];
+    int start = 0;
+    int len = 0;
+
+    pthread_mutex_lock( &r->lock );
+
+    const int left = r->hi - r->lo;
+
+    if (left > 0) {
+
+      len = (left > sched->grain) ? (left + 1) / 2 : left;   // upper half
+
+      start = threadpool_sched_round( sched, r->hi - len );  // on a cache line
+
+      if (start >= r->hi) {                  // less than a cache line left -> take all
+        start = r->lo;
+      }
+
+      len = r->hi - start;
+      r->hi = start;
+    }
+
+    pthread_mutex_unlock( &r->lock );
+
+    if (len > 0) {                           // success? (else the victim finished meanwhile)
+
+      struct threadpool_range* own = &sched->ranges[part];
+
+      pthread_mutex_lock( &own->lock );
+      own->lo = start;
+      own->hi = start + len;
+      pthread_mutex_unlock( &own->lock );
+
+      sched->stats[part].steals++;
+
+      return( 1 );
+    }
+  }
+
+} // threadpool_sched_steal
+
+
+
+/*!
+ \brief Task of a participant of the scheduler
+ \details
+ Executes the own range chunk by chunk, claims further data items and steals work from the
+ other participants until no data items are left.
+ \param arg (in+out) the scheduler
+ \param part (in) number of the participant
+ \param unused (in) not used
+ */
+void threadpool_sched_task( void* arg, int part, int unused ){
+
+  struct threadpool_sched* sched = (struct threadpool_sched*) arg;
+  struct threadpool_stats* st = &sched->stats[part];
+
+  (void) unused;
+
+  int start = 0;
+  int share = sched->n;                      // data items claimed at once
+
+  if (sched->cursor < sched->n) {            // share proportional to the speed of the CPU
+
+    share = (int) ((float) sched->n * cputopo_speed( cputopo_current() ) / sched->wsum) + 1;
+
+    if (share < sched->grain) {
+      share = sched->grain;
+    }
+  }
+
+  do {
+
+    int len;
+
+    while ((len = threadpool_sched_take( sched, part, &start )) > 0) {
+
+      const long long t0 = threadpool_now();
+      const long long tr = trace_begin();
+
+      sched->fn( sched->arg, part, start, len );      // execute chunk
+
+      trace_end( TRACE_WORKER, "chunk", tr, len );
+      st->busy += threadpool_now() - t0;
+      st->items += len;
+      st->chunks++;
+    }
+
+  } while (threadpool_sched_steal( sched, part, share ) == 1);
+
+} // threadpool_sched_task
+
+
+
+/*!
+ \brief Resident participant of the scheduler
+ \details
+ Waits at the barrier for the start of a loop, executes its part of the loop (if it is one of
+ the active participants) and arrives at the barrier again when it has finished. Returns when
+ the scheduler is destroyed.
+ \param arg (in+out) the scheduler
+ \param part (in) number of the participant
+ \param unused (in) not used
+ */
+void threadpool_sched_member( void* arg, int part, int unused ){
+
+  struct threadpool_sched* sched = (struct threadpool_sched*) arg;
+
+  (void) unused;
+
+  while (1) {
+
+    barrier_wait( &sched->gate );            // start of a loop
+
+    if (sched->stop != 0) {                  // scheduler destroyed?
+      break;
+    }
+
+    if (part < sched->active) {
+      threadpool_sched_task( sched, part, 0 );
+    }
+
+    barrier_wait( &sched->gate );            // end of the loop
+  }
+
+} // threadpool_sched_member
+
+
+
+// see header file for details
+int threadpool_sched_init( struct threadpool_sched* sched, int parts, int policy ){
+
+  if (parts < 1) {
+    parts = 1;
+  }
+
+  sched->parts = 0;
+  sched->status = 0;
+  sched->policy = policy;
+  sched->grain = 1;
+  sched->align = 1;
+  sched->cursor = 0;
+  sched->n = 0;
+  sched->wsum = 1;
+                                             // one cache line (or more) per participant
+  sched->ranges = (struct threadpool_range*) threadpool_alloc( sizeof(struct threadpool_range) * parts );
+  sched->stats = (struct threadpool_stats*) threadpool_alloc( sizeof(struct threadpool_stats) * parts );
+  sched->tasks = (struct threadpool_task*) malloc( sizeof(struct threadpool_task) * parts );
+  sched->busy0 = 0;
+  sched->items0 = 0;
+  sched->team = 0;
+  sched->active = 0;
+  sched->stop = 0;
+  threadpool_job_init( &sched->job );
+
+  if ((sched->ranges == NULL) || (sched->stats == NULL) || (sched->tasks == NULL)) {
+    threadpool_sched_destroy( sched );
+    return( -1 );
+  }
+
+  memset( sched->stats, 0, sizeof(struct threadpool_stats) * parts );
+
+  if (pthread_mutex_init( &sched->claimlock, NULL ) != 0) {
+    threadpool_sched_destroy( sched );
+    return( -2 );
+  }
+
+  sched->status = 1;                         // claimlock initialized
+
+  for (int i1 = 0; i1 < parts; i1++) {       // initialize the locks
+
+    if (pthread_mutex_init( &sched->ranges[i1].lock, NULL ) != 0) {
+      threadpool_sched_destroy( sched );
+      return( -2 );
+    }
+
+    sched->ranges[i1].lo = 0;
+    sched->ranges[i1].hi = 0;
+    sched->parts = i1 + 1;                   // number of locks to destroy
+  }
+
+  return( 0 );
+
+} // threadpool_sched_init
+
+
+
+// see header file for details
+void threadpool_sched_align( struct threadpool_sched* sched, int size ){
+
+  sched->align = 1;
+
+  if ((size > 0) && (size < THREADPOOL_CACHELINE)) {
+    sched->align = THREADPOOL_CACHELINE / size;    // data items per cache line
+  }
+
+} // threadpool_sched_align
+
+
+
+// see header file for details
+void threadpool_sched_submit( struct threadpool_sched* sched, threadpool_loopfn fn, void* arg,
+                              int n ){
+
+  sched->fn = fn;
+  sched->arg = arg;
+  sched->n = n;
+
+  if (sched->items0 == 0) {                  // first loop -> start with small chunks
+    sched->grain = n / (sched->parts * 16 * THREADPOOL_SPLIT) + 1;
+  }
+
+  int active = n / sched->grain;             // small loops do not need all participants
+
+  if (active > sched->parts) {
+    active = sched->parts;
+  } else if (active < 1) {
+    active = 1;
+  }
+
+  int split = active;                        // participants with a range in advance
+
+  sched->cursor = n;                         // nothing to claim
+
+  if ((sched->policy & CPUTOPO_WEIGHT) != 0) {
+
+    split = 0;                               // participants claim their shares
+    sched->cursor = 0;
+    sched->wsum = 0;
+
+    for (int i1 = 0; i1 < active; i1++) {   // the fastest CPUs are used first
+      sched->wsum += cputopo_speed( cputopo_cpu( i1 ) );
+    }
+  }
+
+  for (int i1 = 0; i1 < sched->parts; i1++) {      // split the data items evenly
+
+    if (i1 < split) {                        // boundaries on cache lines
+      sched->ranges[i1].lo = threadpool_sched_round( sched, (int) (((long long) n * i1) / split) );
+      sched->ranges[i1].hi = threadpool_sched_round( sched, (int) (((long long) n * (i1 + 1)) / split) );
+
+      if (sched->ranges[i1].hi > n) {
+        sched->ranges[i1].hi = n;
+      }
+
+      if (sched->ranges[i1].lo > sched->ranges[i1].hi) {   // tiny loop
+        sched->ranges[i1].lo = sched->ranges[i1].hi;
+      }
+    } else {
+      sched->ranges[i1].lo = 0;
+      sched->ranges[i1].hi = 0;
+    }
+  }
+
+  sched->active = active;
+
+                        // participants not yet resident? (a single CPU cannot spin)
+  if ((sched->team == 0) && (cputopo_count() > 1) && (threadpool_bind( sched->parts ) == 1)) {
+
+    barrier_init( &sched->gate, sched->parts + 1 );    // participants and caller
+    sched->stop = 0;
+    sched->team = sched->parts;
+
+    threadpool_job_init( &sched->job );
+
+    for (int i1 = 0; i1 < sched->parts; i1++) {
+      threadpool_submit( &sched->job, &sched->tasks[i1], &threadpool_sched_member, sched, i1, 0 );
+    }
+  }
+
+  if (sched->team > 0) {
+
+    barrier_wait( &sched->gate );            // start the loop
+
+  } else {
+
+    threadpool_job_init( &sched->job );
+
+    for (int i1 = 0; i1 < active; i1++) {    // one task per active participant
+      threadpool_submit( &sched->job, &sched->tasks[i1], &threadpool_sched_task, sched, i1, 0 );
+    }
+  }
+
+} // threadpool_sched_submit
+
+
+
+// see header file for details
+void threadpool_sched_wait( struct threadpool_sched* sched ){
+
+  if (sched->team > 0) {
+    barrier_wait( &sched->gate );            // all resident participants finished
+  } else {
+    threadpool_wait( &sched->job );
+  }
+
+  long long busy = 0;                        // sum up over all participants
+  long long items = 0;
+
+  for (int i1 = 0; i1 < sched->parts; i1++) {
+    busy += sched->stats[i1].busy;
+    items += sched->stats[i1].items;
+  }
+
+  if ((items > sched->items0) && (busy > sched->busy0)) {
+
+                                 // data items that take THREADPOOL_GRAINNS
+    long long grain = (THREADPOOL_GRAINNS * (items - sched->items0)) / (busy - sched->busy0);
+
+    if (grain > sched->n) {
+      grain = sched->n;
+    }
+
+    sched->grain = (grain < 1) ? 1 : (int) grain;
+  }
+
+  sched->busy0 = busy;
+  sched->items0 = items;
+
+} // threadpool_sched_wait
+
+
+
+// see header file for details
+int threadpool_sched_stats( const struct threadpool_sched* sched, long long* out, int cnt ){
+
+  int ret = 0;
+
+  for (int i1 = 0; (i1 < sched->parts) && (ret + THREADPOOL_NSTATS <= cnt); i1++) {
+
+    out[ret++] = sched->stats[i1].busy;
+    out[ret++] = sched->stats[i1].items;
+    out[ret++] = sched->stats[i1].chunks;
+    out[ret++] = sched->stats[i1].steals;
+  }
+
+  return( ret );
+
+} // threadpool_sched_stats
+
+
+
+// see header file for details
+void threadpool_sched_destroy( struct threadpool_sched* sched ){
+
+  if (sched->team > 0) {                     // terminate the resident participants
+
+    sched->stop = 1;
+    barrier_wait( &sched->gate );
+    threadpool_wait( &sched->job );
+
+    threadpool_unbind( sched->team );
+    sched->team = 0;
+  }
+
+  if (sched->ranges != NULL) {
+
+    for (int i1 = 0; i1 < sched->parts; i1++) {
+      pthread_mutex_destroy( &sched->ranges[i1].lock );
+    }
+  }
+
+  if ((sched->status & 1) != 0) {
+    pthread_mutex_destroy( &sched->claimlock );
+  }
+
+  free( sched->ranges );
+  free( sched->stats );
+  free( sched->tasks );
+
+  sched->ranges = NULL;
+  sched->stats = NULL;
+  sched->tasks = NULL;
+  sched->parts = 0;
+  sched->status = 0;
+
+} // threadpool_sched_destroy
+
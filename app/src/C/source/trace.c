@@ -0,0 +1,299 @@
+/*!
+ \file trace.c
+ \brief The timeline tracer
+ \details
+ The spans are written into a fixed buffer: a recording thread reserves a slot with an atomic
+ increment of *trace_next*, fills it and marks it complete with a release store of *done*. The
+ export reads *done* with acquire semantics and skips slots that are not complete yet, so it may
+ run while workers are still recording.
+ A recording thread is counted in *trace_writers* while it touches the buffer and only writes if
+ the tracer is still on; trace_start switches the tracer off and waits until the count is 0
+ before it replaces or clears the buffer, so spans that were begun before can not write into a
+ freed buffer or tear the events of the new recording.
+ \copyright Copyright Robert Fritze 2021
+ \license MIT
+ \version 1.0
+ \author Robert Fritze
+ \date 11.9.2021
+ */
+
+#ifndef _GNU_SOURCE
+                              //! needed for syscall
+#define _GNU_SOURCE
+#endif
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+
+                              //! the event buffer
+static struct trace_event* trace_events = NULL;
+                              //! size of the buffer (events)
+static int trace_capacity = 0;
+                              //! next free slot (may exceed trace_capacity)
+static int trace_next = 0;
+                              //! dropped spans (buffer full)
+static long long trace_dropped = 0;
+                              //! 1 = recording
+static int trace_enabled = 0;
+                              //! start of the recording (ns)
+static long long trace_epoch = 0;
+                              //! recording threads that are writing into the buffer
+static int trace_writers = 0;
+
+
+
+/*!
+ \brief Reads the monotonic clock
+ \returns time (ns)
+ \mt fully threadsafe
+ */
+long long trace_now( void ){
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return( ((long long) t.tv_sec) * 1000000000LL + t.tv_nsec );
+
+} // trace_now
+
+
+
+/*!
+ \brief Appends formatted text to the JSON
+ \details
+ Text that does not fit is counted but not written, so the JSON stays NUL terminated.
+ \param buf (out) the JSON, NULL = count only
+ \param len (in) size of *buf*
+ \param pos (in) current length of the JSON
+ \param text (in) the text
+ \returns new length of the JSON
+ \mt fully threadsafe
+ */
+long trace_append( char* buf, long len, long pos, const char* text ){
+
+  const long n = (long) strlen( text );
+
+  if ((buf != NULL) && (pos + n < len)) {
+    memcpy( buf + pos, text, n + 1 );
+  } else if ((buf != NULL) && (pos < len)) {
+    buf[pos] = 0;                      // truncated
+  }
+
+  return( pos + n );
+
+} // trace_append
+
+
+
+// see header file for details
+int trace_start( int capacity ){
+
+  if (capacity <= 0) {
+    capacity = TRACE_DEFAULTEVENTS;
+  }
+
+  if (capacity > TRACE_MAXEVENTS) {
+    return( -2 );
+  }
+
+  __atomic_store_n( &trace_enabled, 0, __ATOMIC_SEQ_CST );
+
+                              // wait for the threads that are still writing
+  while (__atomic_load_n( &trace_writers, __ATOMIC_SEQ_CST ) > 0) {
+    sched_yield();
+  }
+
+  if (capacity > trace_capacity) {
+
+    struct trace_event* ev = (struct trace_event*) malloc( sizeof(struct trace_event) * capacity );
+
+    if (ev == NULL) {
+      return( -1 );
+    }
+
+    free( trace_events );
+    trace_events = ev;
+    trace_capacity = capacity;
+  }
+
+  memset( trace_events, 0, sizeof(struct trace_event) * trace_capacity );
+  trace_next = 0;
+  trace_dropped = 0;
+  trace_epoch = trace_now();
+
+  __atomic_store_n( &trace_enabled, 1, __ATOMIC_SEQ_CST );
+
+  return( 0 );
+
+} // trace_start
+
+
+
+// see header file for details
+void trace_stop( void ){
+
+  __atomic_store_n( &trace_enabled, 0, __ATOMIC_RELEASE );
+
+} // trace_stop
+
+
+
+// see header file for details
+long long trace_begin( void ){
+
+  if (__atomic_load_n( &trace_enabled, __ATOMIC_RELAXED ) == 0) {
+    return( 0 );
+  }
+
+  return( trace_now() );
+
+} // trace_begin
+
+
+
+// see header file for details
+void trace_end( const char* cat, const char* name, long long start, long long arg ){
+
+  if (start == 0) {                    // tracer was off
+    return;
+  }
+
+  const long long end = trace_now();
+
+  __atomic_fetch_add( &trace_writers, 1, __ATOMIC_SEQ_CST );
+
+                              // still on, and the span belongs to this recording?
+  if ((__atomic_load_n( &trace_enabled, __ATOMIC_SEQ_CST ) != 0) && (start >= trace_epoch)) {
+
+    const int slot = __atomic_fetch_add( &trace_next, 1, __ATOMIC_RELAXED );
+
+    if (slot < trace_capacity) {
+
+      struct trace_event* ev = trace_events + slot;
+
+      ev->name = name;
+      ev->cat = cat;
+      ev->ts = start;
+      ev->dur = end - start;
+      ev->arg = arg;
+      ev->tid = (int) syscall( SYS_gettid );
+
+      __atomic_store_n( &ev->done, 1, __ATOMIC_RELEASE );
+
+    } else {
+      __atomic_fetch_add( &trace_dropped, 1, __ATOMIC_RELAXED );
+    }
+  }
+
+  __atomic_fetch_sub( &trace_writers, 1, __ATOMIC_RELEASE );
+
+} // trace_end
+
+
+
+// see header file for details
+long trace_json( char* buf, long len ){
+
+  char line[512];
+  long pos = 0;
+  int first = 1;
+
+  if ((buf != NULL) && (len > 0)) {
+    buf[0] = 0;
+  }
+
+  const int pid = (int) getpid();
+  int used = __atomic_load_n( &trace_next, __ATOMIC_ACQUIRE );
+
+  if (used > trace_capacity) {
+    used = trace_capacity;
+  }
+
+  pos = trace_append( buf, len, pos, "{\"traceEvents\":[" );
+
+  for (int i = 0; i < used; i++) {
+
+    const struct trace_event* ev = trace_events + i;
+
+    if (__atomic_load_n( &ev->done, __ATOMIC_ACQUIRE ) == 0) {   // still being written
+      continue;
+    }
+
+    snprintf( line, sizeof(line),
+              "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+              "\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%lld}}",
+              first ? "" : ",", ev->name, ev->cat,
+              (double) (ev->ts - trace_epoch) / 1000.0, (double) ev->dur / 1000.0,
+              pid, ev->tid, ev->arg );
+
+    pos = trace_append( buf, len, pos, line );
+    first = 0;
+  }
+
+  snprintf( line, sizeof(line),
+            "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%lld}}\n",
+            __atomic_load_n( &trace_dropped, __ATOMIC_RELAXED ) );
+
+  pos = trace_append( buf, len, pos, line );
+
+  return( pos );
+
+} // trace_json
+
+
+
+// see header file for details
+int trace_write( const char* file ){
+
+  int ret = 0;
+  char* json = NULL;
+  long len = 0;
+  long n = 0;
+
+  do {                                 // spans may be added meanwhile -> repeat
+    len = trace_json( NULL, 0 ) + 4096;
+    free( json );
+    json = (char*) malloc( len );
+
+    if (json == NULL) {
+      break;
+    }
+
+    n = trace_json( json, len );
+  } while (n >= len);
+
+  if (json != NULL) {
+
+    FILE* f = fopen( file, "w" );
+
+    if (f != NULL) {
+
+      if (fwrite( json, 1, n, f ) != (size_t) n) {
+        ret = -2;
+      }
+
+      if (fclose( f ) != 0) {
+        ret = -2;
+      }
+
+    } else {
+      ret = -2;
+    }
+
+    free( json );
+
+  } else {
+    ret = -1;
+  }
+
+  return( ret );
+
+} // trace_write
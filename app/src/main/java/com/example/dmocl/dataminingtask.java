@@ -133,52 +133,31 @@ public class dataminingtask extends Worker {
     return (s);
   }
 
-  private float[] createRandomClusters(int[] clustersize, int features) {
-
-    final int clusterno = clustersize.length;
-
-    LinkedList<float[]> floatList = new LinkedList<>();
-    Random r = new Random();
-
-    for (int i1 = 0; i1 < clusterno; i1++) {
-
-      float[] fm = new float[features];
-      float[] fd = new float[features];
-
-      for (int i2 = 0; i2 < features; i2++) {
-
-        fm[i2] = (float) r.nextGaussian() * 10;
-        fd[i2] = (float) (r.nextGaussian() * 2.5);
-
-      }
-
-      for (int i2 = 0; i2 < clustersize[i1]; i2 += 1) {
-
-        float[] rf2 = new float[features];
-
-        for (int i3 = 0; i3 < features; i3 += 1) {
-          rf2[i3] = fm[i3] + (float) r.nextGaussian() * fd[i3];
-        }
-
-        floatList.add(rf2);
-
-      }
+  /**
+   * Formats the statistics of the workers returned by the multithreaded C implementations.
+   * @param prepend Name of the algorithm and the implementation
+   * @param ej Elapsed time followed by 4 values per worker (busy ns, data items, chunks, steals)
+   * @return One line per worker
+   */
+  public static final String compileworkerstats( String prepend, long[] ej ) {
+
+    String s = "";
+
+    for (int i1 = 1; i1 + 3 < ej.length; i1 += 4) {
+      s += "[" + prepend + "] Worker #" + ((i1 - 1) / 4) + ": busy " + (ej[i1] / 1000000) +
+        " ms, " + ej[i1 + 1] + " items, " + ej[i1 + 2] + " chunks, " + ej[i1 + 3] + " steals\n";
     }
 
-    Collections.shuffle(floatList);
-
-    float[] rf = new float[floatList.size() * features];
-    int counter = 0;
-
-    while (floatList.size() > 0) {
+    return (s);
+  }
 
-      float[] af = floatList.poll();
+  private float[] createRandomClusters(int[] clustersize, int features) {
 
-      for (int i1 = 0; i1 < features; i1++) {
-        rf[counter] = af[i1];
-        counter++;
-      }
+    final float[] rf = new float[Arrays.stream(clustersize).sum() * features];
 
+                        // generated natively in parallel, seeded like new Random()
+    if (oclwrap.createClusters(clustersize, features, new Random().nextLong(), rf) != 0) {
+      throw new OutOfMemoryError("test data could not be generated");
     }
 
     return (rf);
@@ -369,6 +348,9 @@ public class dataminingtask extends Worker {
         GPUfound = false;
       }
 
+                               // keep the tuned work-group sizes across restarts
+      oclwrap.setTuneDir(getApplicationContext().getFilesDir().getAbsolutePath());
+
       Random ran = new Random();
       LinkedList<dmitem> theitems = new LinkedList<>();
 
@@ -687,7 +669,7 @@ public class dataminingtask extends Worker {
               //Log.i( "--->", "(" + (cnt-1) + ") KMEANS 4");
               //wakeLock.acquire( WAKELOCKTIMEOUT );
 
-              long[] ej = new long[1];
+              long[] ej = new long[1 + 4 * cores];     // time + statistics of the workers
 
               if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q) {
                 beginAsyncSection( "KMEANS - C (mt)", 0 );
@@ -707,7 +689,8 @@ public class dataminingtask extends Worker {
 
               if (cluno>=0){
                 s1 = compileprogressoutput( fn,
-                  0, 4, cores, dmi.clusterno, b9, wct[4] );
+                  0, 4, cores, dmi.clusterno, b9, wct[4] ) +
+                  compileworkerstats( "KMEANS " + prependnames[4], ej );
               }
               else {
                 s1 = "KMEANS_C_PTHREADS aborted (" + cluno + ")";
@@ -891,7 +874,7 @@ public class dataminingtask extends Worker {
               //Log.i( "--->", "(" + (cnt-1) + ") DBSCAN 4");
               //wakeLock.acquire( WAKELOCKTIMEOUT );
 
-              long[] ej = new long[1];
+              long[] ej = new long[1 + 4 * cores];     // time + statistics of the workers
 
               if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q) {
                 beginAsyncSection( "DBSCAN - C (mt)", 0 );
@@ -911,7 +894,8 @@ public class dataminingtask extends Worker {
 
               if (cluno>=0){
                 s1 = compileprogressoutput( fn,
-                  1, 4, cores, cluno + 1, b4, wct[9] );
+                  1, 4, cores, cluno + 1, b4, wct[9] ) +
+                  compileworkerstats( "DBSCAN " + prependnames[4], ej );
               }
               else {
                 s1 = "DBSCAN_C_THREADS aborted (" + cluno + ")";
@@ -0,0 +1,173 @@
+/*!
+ @file dataset.java
+ @brief Binary dataset files
+ @details
+ The class in this file writes and maps the dataset files of the native interface (see
+ agpudm_dataset_write in agpudm.h and dataset.c for the format).
+ @copyright Copyright Robert Fritze 2021
+ @license MIT
+ @version 1.0
+ @author Robert Fritze
+ @date 11.9.2021
+ */
+package com.example.dmocl;
+
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.FloatBuffer;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.charset.StandardCharsets;
+
+/*!
+ @brief A dataset file mapped into memory
+ @details
+ The data items are a read only view of the mapping (a direct buffer in the native byte order),
+ they can be passed to the zero copy methods (kmeans_c_*_direct, dbscan_c_*_direct) without
+ copies and do not count against the Java heap. The mapping is released by the garbage collector
+ when the buffer is not referenced any more. Files of up to 2 GB can be mapped.
+ */
+public class dataset {
+
+  /** Magic of a dataset file */
+  public final static String MAGIC = "AGPUDMDS";
+  /** Version of the format */
+  public final static int VERSION = 1;
+  /** Type of the features: float */
+  public final static int DTYPE_FP32 = 0;
+  /** Layout of the data items: data item after data item */
+  public final static int LAYOUT_ROWS = 0;
+  /** Offset of the data items in the file (page aligned) */
+  public final static int OFFSET = 4096;
+
+  private final static int BOM = 0x01020304;    //!< byte order mark
+  private final static int HEADERSIZE = 64;     //!< bytes of the header
+
+  public final FloatBuffer data;                //!< the data items (n x features, read only)
+  public final int n;                           //!< number of data items
+  public final int features;                    //!< features per data item
+
+  /*!
+  @brief class constructor
+  @param data the data items
+  @param n number of data items
+  @param features features per data item
+  */
+  private dataset( FloatBuffer data, int n, int features ) {
+    this.data = data;
+    this.n = n;
+    this.features = features;
+  }
+
+  /**
+   * Writes data items into a dataset file (byte order of the machine).
+   * @param file The file (overwritten)
+   * @param rf The data items (n x features floats)
+   * @param features Features per data item
+   * @throws IOException The file could not be written
+   * @multithreading fully
+   */
+  public static void write( String file, float[] rf, int features ) throws IOException {
+
+    if ((features <= 0) || (rf.length == 0) || (rf.length % features != 0)) {
+      throw new IllegalArgumentException( "rf must hold a multiple of features values" );
+    }
+
+    ByteBuffer head = ByteBuffer.allocate( OFFSET ).order( ByteOrder.nativeOrder() );
+
+    head.put( MAGIC.getBytes( StandardCharsets.US_ASCII ) );
+    head.putInt( VERSION );
+    head.putInt( DTYPE_FP32 );
+    head.putInt( LAYOUT_ROWS );
+    head.putInt( features );
+    head.putLong( rf.length / features );
+    head.putLong( OFFSET );
+    head.putInt( BOM );
+    head.rewind();                                // rest of the page: 0
+
+    try (RandomAccessFile raf = new RandomAccessFile( file, "rw" );
+         FileChannel ch = raf.getChannel()) {
+
+      ch.truncate( 0 );
+      writeAll( ch, head );
+
+      ByteBuffer body = ByteBuffer.allocateDirect( 1 << 20 ).order( ByteOrder.nativeOrder() );
+      FloatBuffer fb = body.asFloatBuffer();
+
+      for (int i1 = 0; i1 < rf.length; i1 += fb.capacity()) {   // in blocks of 1 MB
+
+        final int len = Math.min( fb.capacity(), rf.length - i1 );
+
+        fb.clear();
+        fb.put( rf, i1, len );
+        body.clear();
+        body.limit( 4 * len );
+        writeAll( ch, body );
+      }
+    }
+  }
+
+  /**
+   * Maps a dataset file into memory (read only).
+   * @param file The file
+   * @return The dataset
+   * @throws IOException The file could not be mapped or has a wrong format
+   * @multithreading fully
+   */
+  public static dataset open( String file ) throws IOException {
+
+    try (RandomAccessFile raf = new RandomAccessFile( file, "r" );
+         FileChannel ch = raf.getChannel()) {
+
+      final long size = ch.size();
+
+      if (size < OFFSET) {
+        throw new IOException( file + ": not a dataset file" );
+      }
+
+      MappedByteBuffer map = ch.map( FileChannel.MapMode.READ_ONLY, 0, size );  // <= 2 GB
+
+      map.order( ByteOrder.nativeOrder() );
+
+      byte[] magic = new byte[8];
+      map.get( magic );
+
+      final int version = map.getInt();
+      final int dtype = map.getInt();
+      final int layout = map.getInt();
+      final int features = map.getInt();
+      final long n = map.getLong();
+      final long offset = map.getLong();
+      final int bom = map.getInt();
+
+      if (!MAGIC.equals( new String( magic, StandardCharsets.US_ASCII ) ) || (version != VERSION) ||
+          (bom != BOM) || (dtype != DTYPE_FP32) || (layout != LAYOUT_ROWS) || (features <= 0) ||
+          (n <= 0) || (offset < HEADERSIZE) || (offset % OFFSET != 0) || (offset > size) ||
+          (n > (size - offset) / 4 / features)) {
+        throw new IOException( file + ": wrong format, version or byte order" );
+      }
+
+      map.position( (int) offset );
+      map.limit( (int) (offset + 4 * n * features) );
+
+      FloatBuffer fb = map.slice().order( ByteOrder.nativeOrder() ).asFloatBuffer();
+
+      return( new dataset( fb, (int) n, features ) );
+    }                                             // the mapping outlives the channel
+  }
+
+  /*!
+  @brief writes a whole buffer into a channel
+  @param ch the channel
+  @param b the buffer (position .. limit)
+  @throws IOException write error
+  */
+  private static void writeAll( FileChannel ch, ByteBuffer b ) throws IOException {
+    while (b.hasRemaining()) {
+      ch.write( b );
+    }
+  }
+
+} // dataset
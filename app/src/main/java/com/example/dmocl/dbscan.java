@@ -1,11 +1,44 @@
 package com.example.dmocl;
 
+import java.nio.FloatBuffer;
+import java.nio.ShortBuffer;
 import java.util.concurrent.Semaphore;
 import java.util.concurrent.atomic.AtomicBoolean;
 import java.util.concurrent.locks.ReentrantReadWriteLock;
 
 public class dbscan {
 
+    /** GPU storage of the data items: single precision */
+    public final static int STORE_FP32 = 0;
+    /** GPU storage of the data items: half precision (borderline distances are rechecked) */
+    public final static int STORE_FP16 = 1;
+    /** GPU storage of the data items: 8 bit quantized (borderline distances are rechecked) */
+    public final static int STORE_INT8 = 2;
+
+    /** Placement of the native workers: default */
+    public final static int POLICY_DEFAULT = 0;
+    /** Placement of the native workers: pinned to single CPUs, fastest first */
+    public final static int POLICY_PIN = 1;
+    /** Placement of the native workers: chunks weighted by CPU speed */
+    public final static int POLICY_WEIGHT = 2;
+    /** Placement of the native workers: pinned and weighted (heterogeneous processors) */
+    public final static int POLICY_HETERO = 3;
+
+    /** Counters of dbscan_c_stats: passes of the cluster expansion */
+    public final static int STATS_PASSES = 0;
+    /** Counters of dbscan_c_stats: distance evaluations */
+    public final static int STATS_DISTANCES = 1;
+    /** Counters of dbscan_c_stats: clusters found */
+    public final static int STATS_CLUSTERS = 2;
+    /** Counters of dbscan_c_stats: core points */
+    public final static int STATS_CORE = 3;
+    /** Counters of dbscan_c_stats: border points */
+    public final static int STATS_BORDER = 4;
+    /** Counters of dbscan_c_stats: noise points */
+    public final static int STATS_NOISE = 5;
+    /** Counters of dbscan_c_stats: length of the array */
+    public final static int STATS_LENGTH = 6;
+
     private static boolean doabort = false;
     private static final Object LOCK = new Object();
     private static final ReentrantReadWriteLock rrwl = new ReentrantReadWriteLock(true);
@@ -35,9 +68,54 @@ public class dbscan {
     private static native void dbscanabort_c();
     private static native void dbscanresume_c();
     public static native short dbscan_c( short[] b, float[] data, float eps , int kk, int features );
+    public static native short dbscan_c_ex( short[] b, float[] data, float eps , int kk, int features,
+                                            int job );
     public static native short dbscan_c_gpu( short[] b, float[] data, float eps , int kk, int features, long[] e );
+    public static native short dbscan_c_gpu_ex( short[] b, float[] data, float eps , int kk,
+                                                int features, int storage, int job, long[] e );
     public static native short dbscan_c_phtreads( short[] b, float[] data, float eps ,
                              int kk, int features, int cores, long[] e );
+    public static native short dbscan_c_phtreads_ex( short[] b, float[] data, float eps ,
+                             int kk, int features, int cores, int policy, int job, long[] e );
+    public static native int dbscan_c_submit( float[] data, float eps , int kk, int features,
+                                              int engine, int cores, int policy, int storage,
+                                              long timeoutms, jobcallback cb );
+    public static native short dbscan_c_gpu_direct( ShortBuffer b, FloatBuffer data, float eps,
+                                                 int kk, int features, int storage, int job,
+                                                 long[] e );
+    public static native short dbscan_c_phtreads_direct( ShortBuffer b, FloatBuffer data, float eps,
+                                                      int kk, int features, int cores, int policy,
+                                                      int job, long[] e );
+    public static native short dbscan_c_stats( short[] b, float[] data, float eps, int kk,
+                                               int features, int engine, int cores, int policy,
+                                               int storage, int job, long[] e, long[] s );
+
+
+  /**
+   * Runs a DBSCAN search asynchronously on the native job scheduler. Returns immediately, the
+   * data items are copied once.
+   * @param data The data items (features values per item)
+   * @param eps Search radius
+   * @param kk Number of neighbours
+   * @param features Number of features per data item
+   * @param engine oclwrap.ENGINE_AUTO, ENGINE_SINGLE, ENGINE_PTHREADS or ENGINE_GPU
+   * @param cores Cores of the multithreaded engine, 0 = chosen by the scheduler
+   * @param policy POLICY_DEFAULT, POLICY_PIN, POLICY_WEIGHT or POLICY_HETERO
+   * @param storage STORE_FP32, STORE_FP16 or STORE_INT8 (GPU)
+   * @param timeoutms Time until the job expires (ms), 0 = no deadline
+   * @param cb Called once when the job has finished (native thread), null = none
+   * @return The job (getJob() < 0 = the job could not be submitted)
+   * @multithreading fully
+   */
+    public static nativejob dbscan_async( float[] data, float eps, int kk, int features,
+                                          int engine, int cores, int policy, int storage,
+                                          long timeoutms, jobcallback cb ) {
+
+      int job = dbscan_c_submit( data, eps, kk, features, engine, cores, policy, storage,
+                                 timeoutms, cb );
+
+      return( new nativejob( job, (features > 0) ? data.length / features : 0 ) );
+    }
 
 
     private class dbscan_thread1 extends Thread {
@@ -0,0 +1,32 @@
+/*!
+ @file jobcallback.java
+ @brief Completion notification of native jobs
+ @details
+ The interface in this file is implemented by the receivers of the completion notifications of
+ jobs submitted to the native job scheduler.
+ @copyright Copyright Robert Fritze 2021
+ @license MIT
+ @version 1.0
+ @author Robert Fritze
+ @date 11.9.2021
+ */
+package com.example.dmocl;
+
+/*!
+ @brief Completion notification of native jobs
+ @details
+ jobDone is called once per job when it has finished (also when it was cancelled or its
+ deadline passed). The call is made in a native thread; the receiver should only hand the result
+ over (e.g. to a Handler) and must not block.
+ */
+public interface jobcallback {
+
+  /*!
+  @brief called when a job has finished
+  @param job handle of the job
+  @param result result of the engine (see the search methods), -30 = cancelled or deadline
+  passed (k-means and DBSCAN), -40 = job could not be started
+  */
+  void jobDone( int job, int result );
+
+} // jobcallback
@@ -1,6 +1,7 @@
 package com.example.dmocl;
 
-
+import java.nio.FloatBuffer;
+import java.nio.ShortBuffer;
 import java.util.concurrent.Semaphore;
 import java.util.Random;
 import java.lang.Float;
@@ -11,6 +12,33 @@ public class kmeans {
 
   final static int maxcycles = 100000;
 
+  /** GPU storage of the data items: single precision */
+  public final static int STORE_FP32 = 0;
+  /** GPU storage of the data items: half precision */
+  public final static int STORE_FP16 = 1;
+  /** GPU storage of the data items: 8 bit quantized per feature */
+  public final static int STORE_INT8 = 2;
+
+  /** Placement of the native workers: default */
+  public final static int POLICY_DEFAULT = 0;
+  /** Placement of the native workers: pinned to single CPUs, fastest first */
+  public final static int POLICY_PIN = 1;
+  /** Placement of the native workers: chunks weighted by CPU speed */
+  public final static int POLICY_WEIGHT = 2;
+  /** Placement of the native workers: pinned and weighted (heterogeneous processors) */
+  public final static int POLICY_HETERO = 3;
+
+  /** Counters of kmeans_c_stats: iterations */
+  public final static int STATS_ITERATIONS = 0;
+  /** Counters of kmeans_c_stats: distance evaluations */
+  public final static int STATS_DISTANCES = 1;
+  /** Counters of kmeans_c_stats: reassignments (the first iteration counts all data items) */
+  public final static int STATS_REASSIGNMENTS = 2;
+  /** Counters of kmeans_c_stats: non-empty clusters */
+  public final static int STATS_CLUSTERS = 3;
+  /** Counters of kmeans_c_stats: first per-iteration value (two per iteration) */
+  public final static int STATS_ITERATION = 4;
+
   private static boolean doabort = false;
   private static final Object LOCKA = new Object();
   private static final ReentrantReadWriteLock rrwl = new ReentrantReadWriteLock(true);
@@ -43,9 +71,96 @@ public class kmeans {
     private static native void kmabort_c();
     private static native void kmresume_c();
     public static native short kmeans_c( short[] b, float[] data, float eps , int cluno, int features );
+    public static native short kmeans_c_ex( short[] b, float[] data, float eps , int cluno, int features,
+                                            int job );
     public static native short kmeans_c_gpu( short[] b, float[] data, float eps , int cluno, int features, long[] e );
+    public static native short kmeans_c_gpu_ex( short[] b, float[] data, float eps , int cluno,
+                                                int features, int storage, int job, long[] e );
     public static native short kmeans_c_phtreads( short[] b, float[] data, float eps , int cluno,
                                                   int features, int cores, long[] e );
+    public static native short kmeans_c_phtreads_ex( short[] b, float[] data, float eps , int cluno,
+                                                     int features, int cores, int policy, int job,
+                                                     long[] e );
+    public static native int kmeans_c_submit( float[] data, float eps , int cluno, int features,
+                                              int engine, int cores, int policy, int storage,
+                                              long timeoutms, jobcallback cb );
+    public static native short kmeans_c_gpu_direct( ShortBuffer b, FloatBuffer data, float eps,
+                                                 int cluno, int features, int storage, int job,
+                                                 long[] e );
+    public static native short kmeans_c_phtreads_direct( ShortBuffer b, FloatBuffer data, float eps,
+                                                      int cluno, int features, int cores, int policy,
+                                                      int job, long[] e );
+    public static native short kmeans_c_stats( short[] b, float[] data, float eps, int cluno,
+                                               int features, int engine, int cores, int policy,
+                                               int storage, int job, long[] e, long[] s );
+  /**
+   * Kmeans search that starts from given cluster centers (e.g. the centers of the last search on
+   * slightly changed data) and returns the final centers and the inertia.
+   * @param init Initial cluster centers (cluno x features), null = random data items
+   * @param c Final cluster centers (cluno x features, may be init), null = not needed
+   * @param in in[0] = sum of the squared distances of the data items to their center, null = not
+   * needed
+   * @return 0 = no error, -4 = lengths of the arrays do not match, <0 = error number
+   * @multithreading fully
+   */
+    public static native short kmeans_c_warm( short[] b, float[] data, float eps, int cluno,
+                                              int features, int engine, int cores, int policy,
+                                              int storage, int job, float[] init, float[] c,
+                                              double[] in, long[] e );
+
+
+  /**
+   * Returns the reassignments of an iteration recorded by kmeans_c_stats.
+   * @param s The counters
+   * @param it The iteration (0 = first)
+   * @return Data items that changed their cluster, -1 = not recorded
+   * @multithreading fully
+   */
+    public static long stats_moved( long[] s, int it ) {
+      int i = STATS_ITERATION + 2 * it;
+      return( ((it < s[STATS_ITERATIONS]) && (i + 1 < s.length)) ? s[i] : -1 );
+    }
+
+
+  /**
+   * Returns the displacement of the cluster centers of an iteration recorded by kmeans_c_stats.
+   * @param s The counters
+   * @param it The iteration (0 = first)
+   * @return The displacement, NaN = not recorded
+   * @multithreading fully
+   */
+    public static float stats_displacement( long[] s, int it ) {
+      int i = STATS_ITERATION + 2 * it + 1;
+      return( ((it < s[STATS_ITERATIONS]) && (i < s.length)) ? Float.intBitsToFloat( (int) s[i] )
+                                                             : Float.NaN );
+    }
+
+
+  /**
+   * Runs a k-means search asynchronously on the native job scheduler. Returns immediately, the
+   * data items are copied once.
+   * @param data The data items (features values per item)
+   * @param eps Maximum displacement of the cluster centers
+   * @param cluno Number of clusters
+   * @param features Number of features per data item
+   * @param engine oclwrap.ENGINE_AUTO, ENGINE_SINGLE, ENGINE_PTHREADS or ENGINE_GPU
+   * @param cores Cores of the multithreaded engine, 0 = chosen by the scheduler
+   * @param policy POLICY_DEFAULT, POLICY_PIN, POLICY_WEIGHT or POLICY_HETERO
+   * @param storage STORE_FP32, STORE_FP16 or STORE_INT8 (GPU)
+   * @param timeoutms Time until the job expires (ms), 0 = no deadline
+   * @param cb Called once when the job has finished (native thread), null = none
+   * @return The job (getJob() < 0 = the job could not be submitted)
+   * @multithreading fully
+   */
+    public static nativejob kmeans_async( float[] data, float eps, int cluno, int features,
+                                          int engine, int cores, int policy, int storage,
+                                          long timeoutms, jobcallback cb ) {
+
+      int job = kmeans_c_submit( data, eps, cluno, features, engine, cores, policy, storage,
+                                 timeoutms, cb );
+
+      return( new nativejob( job, (features > 0) ? data.length / features : 0 ) );
+    }
 
 
 
@@ -0,0 +1,115 @@
+/*!
+ @file nativejob.java
+ @brief A job of the native job scheduler
+ @details
+ The class in this file is a future for the k-means and DBSCAN searches that run asynchronously
+ on the native job scheduler (kmeans.kmeans_async, dbscan.dbscan_async).
+ @copyright Copyright Robert Fritze 2021
+ @license MIT
+ @version 1.0
+ @author Robert Fritze
+ @date 11.9.2021
+ */
+package com.example.dmocl;
+
+/*!
+ @brief A job of the native job scheduler
+ @details
+ The data items have been copied to native memory when the job was submitted, the Java array can
+ be reused immediately. The result stays in native memory until it is fetched; every job must be
+ released when it is not needed any more.
+ */
+public class nativejob {
+
+  private final int job;                      //!< handle of the job (<0 = error of the submission)
+  private final int blen;                     //!< number of data items
+
+  /*!
+  @brief class constructor
+  @param job handle of the job returned by a submit method (<0 = error)
+  @param blen number of data items
+  */
+  public nativejob( int job, int blen ) {
+    this.job = job;
+    this.blen = blen;
+  }
+
+  /*!
+  @brief returns the handle of the job
+  @return the handle (>0) or the error of the submission (<0)
+  */
+  public int getJob() {
+    return( job );
+  }
+
+  /*!
+  @brief returns the state of the job
+  @return oclwrap.SCHED_QUEUED, SCHED_RUNNING, SCHED_DONE or <0 = error
+  */
+  public int poll() {
+    return( (job > 0) ? oclwrap.pollJob( job ) : job );
+  }
+
+  /*!
+  @brief tests if the job has finished
+  @return true = finished (or not submitted)
+  */
+  public boolean isDone() {
+    final int state = poll();
+
+    return( (state != oclwrap.SCHED_QUEUED) && (state != oclwrap.SCHED_RUNNING) );
+  }
+
+  /*!
+  @brief waits until the job has finished
+  @param timeoutms maximum time to wait (ms), 0 = no limit
+  @return oclwrap.SCHED_DONE, SCHED_QUEUED or SCHED_RUNNING (time is up) or <0 = error
+  */
+  public int await( long timeoutms ) {
+    return( (job > 0) ? oclwrap.waitJob( job, timeoutms ) : job );
+  }
+
+  /*!
+  @brief waits until the job has finished and fetches the result
+  @param b receives the cluster numbers (at least one per data item)
+  @param e receives engine, cores, time in the queue, time running and exclusive runtime (ns),
+  may be shorter
+  @return the result of the engine (see the search methods) or <0 = error
+  */
+  public int get( short[] b, long[] e ) {
+
+    if (job <= 0) {
+      return( job );
+    }
+
+    oclwrap.waitJob( job, 0 );
+
+    return( oclwrap.fetchJob( job, b, e ) );
+  }
+
+  /*!
+  @brief returns the number of data items
+  @return number of data items (length of the cluster number array needed by get)
+  */
+  public int size() {
+    return( blen );
+  }
+
+  /*!
+  @brief cancels the job
+  @return 0 = no error, -1 = unknown job
+  */
+  public int cancel() {
+    return( (job > 0) ? oclwrap.cancelJob( job ) : -1 );
+  }
+
+  /*!
+  @brief releases the job (a queued job is cancelled, a running job finishes)
+  */
+  public void release() {
+    if (job > 0) {
+      oclwrap.releaseJob( job );
+    }
+  }
+
+} // nativejob
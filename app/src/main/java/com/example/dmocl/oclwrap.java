@@ -8,6 +8,11 @@
 
 package com.example.dmocl;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.FloatBuffer;
+import java.nio.ShortBuffer;
+
 
 /**
  * <p>A singleton class for the OpenCL wrapper.</p>
@@ -77,6 +82,14 @@ public final class oclwrap {
     static
     {
         System.loadLibrary("oclwrapper");
+
+                          // stop the native worker threads when the VM terminates
+        Runtime.getRuntime().addShutdownHook( new Thread() {
+            @Override
+            public void run() {
+                shutdownPool();
+            }
+        });
     }
 
 
@@ -104,6 +117,231 @@ public final class oclwrap {
     static public native int getArchitecture();
 
 
+  /**
+   * Sets the directory where the work-group size autotuner stores its per-device results.
+   * Without a directory the GPU kernels are tuned again after each restart of the app.
+   * @param dir The directory (must exist and be writable, e.g. the files directory of the app)
+   * @return 0 = no error, -1 = path too long
+   * @multithreading fully
+   */
+    static public native int setTuneDir( String dir );
+
+
+  /**
+   * Sets the number of worker threads of the native thread pool that is shared by the
+   * multithreaded CPU implementations. The pool is started on demand and grows to the number
+   * of cores requested by a calculation, so calling this method is optional.
+   * @param workers The number of workers (0 = stop the pool)
+   * @return The number of workers running
+   * @multithreading fully
+   */
+    static public native int setPoolSize( int workers );
+
+
+  /**
+   * Stops the native thread pool. Queued calculations are finished first. The pool is restarted
+   * automatically by the next multithreaded calculation.
+   * @multithreading fully
+   */
+    static public native void shutdownPool();
+
+
+  /** State of a job: running */
+    public final static int JOB_RUNNING = 0;
+  /** State of a job: cancelled */
+    public final static int JOB_CANCELLED = 1;
+  /** State of a job: deadline passed */
+    public final static int JOB_EXPIRED = 2;
+
+  /**
+   * Creates a job for the native k-means and DBSCAN calculations (the *_ex methods). The
+   * calculations of a job can be cancelled by another thread without affecting other
+   * calculations. Every job must be released with releaseJob.
+   * @param timeoutms Time until the job expires and its calculations stop (ms), 0 = no deadline
+   * @return The handle of the job (>0), -1 = too many jobs
+   * @multithreading fully
+   */
+    static public native int createJob( long timeoutms );
+
+
+  /**
+   * Cancels the calculations of a job. They stop within one distance query (DBSCAN) or a few
+   * thousand data items (k-means) and return an error code.
+   * @param job The handle of the job
+   * @return 0 = no error, -1 = unknown handle
+   * @multithreading fully
+   */
+    static public native int cancelJob( int job );
+
+
+  /**
+   * Returns the state of a job.
+   * @param job The handle of the job
+   * @return JOB_RUNNING, JOB_CANCELLED, JOB_EXPIRED or -1 = unknown handle
+   * @multithreading fully
+   */
+    static public native int jobStatus( int job );
+
+
+  /**
+   * Releases a job. The handle becomes invalid, calculations that are still running continue.
+   * @param job The handle of the job
+   * @multithreading fully
+   */
+    static public native void releaseJob( int job );
+
+
+  /** Engine of a submitted job: chosen by the scheduler (GPU if free, else multithreaded) */
+    public final static int ENGINE_AUTO = 0;
+  /** Engine of a submitted job: single threaded */
+    public final static int ENGINE_SINGLE = 1;
+  /** Engine of a submitted job: multithreaded (native thread pool) */
+    public final static int ENGINE_PTHREADS = 2;
+  /** Engine of a submitted job: GPU */
+    public final static int ENGINE_GPU = 3;
+
+  /** State of a submitted job: waiting in the queue */
+    public final static int SCHED_QUEUED = 0;
+  /** State of a submitted job: running */
+    public final static int SCHED_RUNNING = 1;
+  /** State of a submitted job: finished */
+    public final static int SCHED_DONE = 2;
+  /** Result of fetchJob: the job has not finished yet */
+    public final static int SCHED_PENDING = -41;
+
+  /**
+   * Returns the state of a job submitted with kmeans.kmeans_c_submit or dbscan.dbscan_c_submit.
+   * @param job The handle of the job
+   * @return SCHED_QUEUED, SCHED_RUNNING, SCHED_DONE or -42 = unknown handle
+   * @multithreading fully
+   */
+    static public native int pollJob( int job );
+
+
+  /**
+   * Waits until a job submitted to the native job scheduler has finished.
+   * @param job The handle of the job
+   * @param timeoutms Maximum time to wait (ms), 0 = no limit
+   * @return SCHED_DONE, SCHED_QUEUED or SCHED_RUNNING (time is up) or -42 = unknown handle
+   * @multithreading fully
+   */
+    static public native int waitJob( int job, long timeoutms );
+
+
+  /**
+   * Starts the native timeline tracer. While it is on, the engines record spans of the set up,
+   * of every iteration, of every chunk of a worker and of the OpenCL calls.
+   * @param capacity Number of spans that are kept, <= 0 = default
+   * @return 0 = no error, -1 = out of memory, -2 = capacity too large
+   * @multithreading not threadsafe (no search may run)
+   */
+    static public native int traceStart( int capacity );
+
+
+  /**
+   * Stops the native timeline tracer. The spans are kept until the next traceStart.
+   * @multithreading fully
+   */
+    static public native void traceStop();
+
+
+  /**
+   * Writes the recorded spans as Chrome trace_event JSON (chrome://tracing, Perfetto).
+   * @param file The file (overwritten)
+   * @return 0 = no error, -1 = out of memory, -2 = file could not be written
+   * @multithreading fully
+   */
+    static public native int traceWrite( String file );
+
+
+  /**
+   * Returns the recorded spans as Chrome trace_event JSON.
+   * @return The JSON (UTF-8), null = out of memory
+   * @multithreading fully
+   */
+    static public native byte[] traceDump();
+
+
+  /**
+   * Fetches the result of a finished job. The job still has to be released with releaseJob.
+   * @param job The handle of the job
+   * @param b Receives the cluster numbers (one per data item)
+   * @param e Receives engine, cores, time in the queue (ns), time running (ns), exclusive
+   *          runtime of the engine (ns) and algorithm (1 = k-means, 2 = DBSCAN); shorter
+   *          arrays receive the first values
+   * @return The result of the engine (see the search methods), SCHED_PENDING = not finished,
+   *         -40 = could not be started, -42 = unknown handle, -43 = b too short
+   * @multithreading fully
+   */
+    static public native int fetchJob( int job, short[] b, long[] e );
+
+
+  /**
+   * Sets the limits of the native job scheduler. Queued jobs start when the cores, the memory
+   * and (for the GPU) a GPU slot they need are free; a job always starts when nothing else runs.
+   * @param cores Number of cores, 0 = all CPUs
+   * @param memorymb Memory budget (MB), 0 = a quarter of the physical memory
+   * @param gpus Number of jobs that may use the GPU at the same time (0 = no GPU, < 0 = one if
+   * there is a GPU, the default)
+   * @multithreading fully
+   */
+    static public native void setSchedLimits( int cores, int memorymb, int gpus );
+
+
+  /**
+   * Allocates a direct buffer for the data items of the zero copy methods (kmeans_c_*_direct,
+   * dbscan_c_*_direct). The native code works on its memory, nothing is copied.
+   * @param n Number of floats (data items x features)
+   * @return The buffer (native byte order)
+   * @multithreading fully
+   */
+    static public FloatBuffer directFloats( int n ) {
+      return( ByteBuffer.allocateDirect( 4 * n ).order( ByteOrder.nativeOrder() ).asFloatBuffer() );
+    }
+
+
+  /**
+   * Allocates a direct buffer for the cluster numbers of the zero copy methods.
+   * @param n Number of data items
+   * @return The buffer (native byte order)
+   * @multithreading fully
+   */
+    static public ShortBuffer directShorts( int n ) {
+      return( ByteBuffer.allocateDirect( 2 * n ).order( ByteOrder.nativeOrder() ).asShortBuffer() );
+    }
+
+
+  /**
+   * Generates Gaussian clusters as test data on the native workers. Every cluster gets a center
+   * (N(0,10) per feature) and a spread (N(0,2.5) per feature), its data items are drawn around
+   * the center; the data items of all clusters are shuffled. The result depends only on the seed.
+   * @param clustersize Number of data items of the clusters
+   * @param features Features per data item
+   * @param seed The seed
+   * @param rf The data items (sum of clustersize x features floats)
+   * @return 0 = no error, -1 = invalid arguments, -2 = out of memory, -5 = no workers,
+   * -9 = rf has the wrong length
+   * @multithreading fully
+   */
+    static public native int createClusters( int[] clustersize, int features, long seed,
+                                             float[] rf );
+
+
+  /**
+   * Generates Gaussian clusters (see createClusters) directly into a direct buffer (see
+   * directFloats).
+   * @param clustersize Number of data items of the clusters
+   * @param features Features per data item
+   * @param seed The seed
+   * @param rf The data items (sum of clustersize x features floats)
+   * @return 0 = no error, -1 = invalid arguments, -2 = out of memory, -5 = no workers,
+   * -9 = rf is not direct or has the wrong capacity
+   * @multithreading fully
+   */
+    static public native int createClustersDirect( int[] clustersize, int features, long seed,
+                                                   FloatBuffer rf );
+
+
     /**
      * Loads the OpenCL library on the device. The library does not have to be present at compile time.
      * Must be called once before any other call to an OpenCL function. Subsequent calls to this